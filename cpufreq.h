@@ -0,0 +1,58 @@
+/*
+ * cpufreq.h — sysfs helpers shared by mrsettings and mrsettings-cpufreq
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Both programs are single translation units, so these stay static. */
+#ifndef MRSETTINGS_CPUFREQ_H
+#define MRSETTINGS_CPUFREQ_H
+
+#include <glib.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+static gboolean cpufreq_allowed(const char *const *list, const char *v) {
+	for (; *list; list++) if (strcmp(*list, v) == 0) return TRUE;
+	return FALSE;
+}
+
+static int cpufreq_id_cmp(const void *a, const void *b) {
+	return *(const int *)a - *(const int *)b;
+}
+
+/* Sorted ids of the cpuN directories under `dir`, NULL if unreadable. */
+static GArray *cpufreq_list_cpus(const char *dir) {
+	DIR *d = opendir(dir);
+	if (!d) return NULL;
+	GArray *ids = g_array_new(FALSE, FALSE, sizeof(int));
+	struct dirent *de;
+	while ((de = readdir(d))) {
+		const char *p = de->d_name;
+		if (strncmp(p, "cpu", 3) != 0 || !g_ascii_isdigit(p[3])) continue;
+		char *end;
+		int cpu = (int)strtol(p + 3, &end, 10);
+		if (!*end) g_array_append_val(ids, cpu);
+	}
+	closedir(d);
+	g_array_sort(ids, cpufreq_id_cmp);
+	return ids;
+}
+
+#endif
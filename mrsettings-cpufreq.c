@@ -0,0 +1,151 @@
+/*
+ * mrsettings-cpufreq.c — privileged CPU governor and EPP helper
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* `mrsettings-cpufreq GOV EPP` is the privileged half of the power mode
+ * buttons.  mrsettings runs it through pkexec, and the polkit action
+ * org.mrrobotos.mrsettings.cpufreq names it, so only this program runs
+ * as root; it needs GLib and nothing else.
+ *
+ * It writes the governor and then the energy/performance preference of
+ * every CPU directly, spread over a few threads, reads each value back
+ * and prints one line per core: "cpuN <governor-status> <epp-status>",
+ * where a status is ok, absent, mismatch:<value> or error:<message>.
+ * The exit code is 0 only if every core that has cpufreq took both
+ * values, 2 for bad arguments. */
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "cpufreq.h"
+
+#define CPUFREQ_SYSFS       "/sys/devices/system/cpu"
+#define CPUFREQ_MAX_THREADS 16
+
+/* No "default": the kernel takes it but reads back the firmware's
+ * choice, so it could never be confirmed. */
+static const char *const cpufreq_governors[] = {
+	"performance", "powersave", "schedutil", "ondemand", "conservative", NULL };
+static const char *const cpufreq_epps[] = {
+	"performance", "balance_performance", "balance_power", "power", NULL };
+
+typedef struct {
+	int  cpu;
+	char gov[80], epp[80];
+} CpufreqResult;
+
+typedef struct {
+	const char    *root, *gov, *epp;
+	CpufreqResult *res;
+	int            n, start, stride;
+} CpufreqJob;
+
+static void cpufreq_write_attr(const char *root, int cpu, const char *attr, const char *val,
+			       char *status, size_t sz) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/cpu%d/cpufreq/%s", root, cpu, attr);
+	/* sysfs ignores O_TRUNC; a plain file under --sysfs-root needs it */
+	int fd = open(path, O_RDWR | O_TRUNC | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == ENOENT) g_strlcpy(status, "absent", sz);
+		else snprintf(status, sz, "error:%s", g_strerror(errno));
+		return;
+	}
+	char back[64];
+	if (write(fd, val, strlen(val)) < 0) {
+		snprintf(status, sz, "error:%s", g_strerror(errno));
+	} else {
+		ssize_t n = pread(fd, back, sizeof(back) - 1, 0);
+		back[MAX(n, 0)] = '\0';
+		g_strstrip(back);
+		if (strcmp(back, val) == 0) g_strlcpy(status, "ok", sz);
+		else snprintf(status, sz, "mismatch:%s", back);
+	}
+	close(fd);
+}
+
+static gpointer cpufreq_helper_thread(gpointer ud) {
+	CpufreqJob *j = ud;
+	for (int i = j->start; i < j->n; i += j->stride) {
+		CpufreqResult *r = &j->res[i];
+		/* governor first: some drivers refuse EPP changes under "performance" */
+		cpufreq_write_attr(j->root, r->cpu, "scaling_governor", j->gov, r->gov, sizeof(r->gov));
+		if (j->epp) cpufreq_write_attr(j->root, r->cpu, "energy_performance_preference", j->epp,
+					       r->epp, sizeof(r->epp));
+		else g_strlcpy(r->epp, "absent", sizeof(r->epp));
+	}
+	return NULL;
+}
+
+/* Write gov and epp (NULL to leave it) to every CPU under root; an
+ * array of CpufreqResult in CPU order, NULL with errno if root is
+ * unreadable. */
+static GArray *cpufreq_apply(const char *root, const char *gov, const char *epp) {
+	GArray *ids = cpufreq_list_cpus(root);
+	if (!ids) return NULL;
+	GArray *res = g_array_sized_new(FALSE, TRUE, sizeof(CpufreqResult), ids->len);
+	for (guint i = 0; i < ids->len; i++) {
+		CpufreqResult r = { .cpu = g_array_index(ids, int, i) };
+		g_array_append_val(res, r);
+	}
+	g_array_unref(ids);
+
+	int n = res->len, nt = MIN(MAX(n, 1), MIN((int)g_get_num_processors(), CPUFREQ_MAX_THREADS));
+	CpufreqJob jobs[CPUFREQ_MAX_THREADS];
+	GThread *th[CPUFREQ_MAX_THREADS];
+	for (int t = 0; t < nt; t++) {
+		jobs[t] = (CpufreqJob){ root, gov, epp, (CpufreqResult *)res->data, n, t, nt };
+		th[t] = g_thread_new("cpufreq", cpufreq_helper_thread, &jobs[t]);
+	}
+	for (int t = 0; t < nt; t++) g_thread_join(th[t]);
+	return res;
+}
+
+/* Whether a core failed: offline cores and ones without cpufreq or EPP
+ * don't count. */
+static gboolean cpufreq_result_bad(const CpufreqResult *r) {
+	if (strcmp(r->gov, "absent") == 0) return FALSE;
+	return strcmp(r->gov, "ok") != 0 || (strcmp(r->epp, "ok") != 0 && strcmp(r->epp, "absent") != 0);
+}
+
+int main(int argc, char **argv) {
+	const char *root = CPUFREQ_SYSFS, *gov = argc > 1 ? argv[1] : "", *epp = argc > 2 ? argv[2] : "-";
+	/* an alternative root is for unprivileged test runs only */
+	if (argc > 4 && strcmp(argv[3], "--sysfs-root") == 0 && !getenv("PKEXEC_UID") && getuid() == geteuid())
+		root = argv[4];
+	if (!cpufreq_allowed(cpufreq_governors, gov) || (strcmp(epp, "-") != 0 && !cpufreq_allowed(cpufreq_epps, epp))) {
+		fprintf(stderr, "mrsettings-cpufreq: invalid governor or EPP\n");
+		return 2;
+	}
+
+	GArray *res = cpufreq_apply(root, gov, strcmp(epp, "-") ? epp : NULL);
+	if (!res) { fprintf(stderr, "mrsettings-cpufreq: %s: %s\n", root, g_strerror(errno)); return 1; }
+	int bad = 0;
+	for (guint i = 0; i < res->len; i++) {
+		CpufreqResult *r = &g_array_index(res, CpufreqResult, i);
+		printf("cpu%d %s %s\n", r->cpu, r->gov, r->epp);
+		if (cpufreq_result_bad(r)) bad++;
+	}
+	g_array_unref(res);
+	return bad ? 1 : 0;
+}
@@ -24,6 +24,11 @@
 #include <gdk/x11/gdkx.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XKBrules.h>
+#include <pulse/pulseaudio.h>
+#include <pulse/glib-mainloop.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -38,6 +43,14 @@
 #include <time.h>
 #include <pwd.h>
 #include <grp.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <glib-unix.h>
+#include "cpufreq.h"
 
 
 #define AVATAR_SIDEBAR_SIZE 112
@@ -1446,75 +1459,159 @@ static void card_set_value(GtkWidget *card, const char *value) {
 	if (val && GTK_IS_LABEL(val)) gtk_label_set_text(GTK_LABEL(val), value);
 }
 
+/* Dynamic attributes are re-read with pread() on descriptors kept open
+ * for the life of the page; static ones (design capacity, vendor,
+ * model, chemistry) are read once when the battery is found.  Status
+ * and capacity changes arrive as power_supply uevents from a
+ * NETLINK_KOBJECT_UEVENT socket on the main loop, and each one re-reads
+ * everything.  Drivers do not announce current, voltage or charge as
+ * they drift, so while the page is shown those three are polled every
+ * BAT_POWER_S and only the power, time-left and voltage cards follow
+ * them.  Without the socket the poll re-reads everything. */
+#define BAT_SYSFS       "/sys/class/power_supply"
+#define BAT_POWER_S     5
+
+enum { BA_CAPACITY, BA_STATUS, BA_CHARGE_FULL, BA_CHARGE_NOW, BA_CURRENT,
+       BA_VOLTAGE, BA_CYCLES, BA_TEMP, BA_N };
+static const char *const bat_attr_names[BA_N] = {
+	"capacity", "status", "charge_full", "charge_now", "current_now",
+	"voltage_now", "cycle_count", "temp",
+};
+
 typedef struct {
 	GtkWidget    *gauge, *devlbl;
 	GtkWidget    *card_health, *card_power, *card_time;
 	GtkWidget    *card_cycles, *card_voltage, *card_temp;
-	GtkWidget    *gov_performance, *gov_balanced, *gov_powersave;
+	GtkWidget    *gov_performance, *gov_balanced, *gov_powersave, *gov_status;
 	BatGaugeData *gauge_data;
-	guint         timer_id;
+	guint         timer_id;                   /* power poll, while mapped */
 	gboolean      destroyed;
+	/* open sysfs attributes, -1 when absent */
+	const char   *sysfs;                      /* BAT_SYSFS; tests use a fake tree */
+	char          node[16];
+	int           fd[BA_N], gov_fd, epp_fd;
+	char          s_charge_design[32], s_manufacturer[64], s_model[64], s_tech[32];
+	char          status[32];                 /* from the last full read */
+	long          charge_full;
+	/* uevent socket */
+	int           nl_fd;
+	guint         nl_watch, refresh_idle;
 } BatData;
 
-static const char *bat_node(void) {
-	if (g_file_test("/sys/class/power_supply/BAT0/capacity", G_FILE_TEST_EXISTS)) return "BAT0";
-	if (g_file_test("/sys/class/power_supply/BAT1/capacity", G_FILE_TEST_EXISTS)) return "BAT1";
+static const char *bat_node(const char *sysfs) {
+	static const char *const nodes[] = { "BAT0", "BAT1" };
+	for (guint i = 0; i < G_N_ELEMENTS(nodes); i++) {
+		char p[PATH_MAX];
+		snprintf(p, sizeof(p), "%s/%s/capacity", sysfs, nodes[i]);
+		if (g_file_test(p, G_FILE_TEST_EXISTS)) return nodes[i];
+	}
 	return NULL;
 }
 
-#define BREAD(bat, field, out, sz) do { \
-	char _p[128]; snprintf(_p,sizeof(_p),"/sys/class/power_supply/%s/%s",bat,field); \
-	FILE *_f=fopen(_p,"r"); \
-	if(_f){fgets(out,sz,_f);fclose(_f);char*_n=strchr(out,'\n');if(_n)*_n='\0';} \
-	else strncpy(out,"N/A",sz); } while(0)
+/* Re-read an open sysfs attribute from offset 0; "N/A" when missing. */
+static void bat_pread(int fd, char *out, size_t sz) {
+	ssize_t n = fd >= 0 ? pread(fd, out, sz - 1, 0) : -1;
+	if (n <= 0) { g_strlcpy(out, "N/A", sz); return; }
+	out[n] = '\0';
+	char *nl = strchr(out, '\n');
+	if (nl) *nl = '\0';
+}
 
-static void bat_read_and_update(BatData *bd) {
-	if (!bd || bd->destroyed) return;
-	const char *bat = bat_node();
-	char s_capacity[16]="N/A", s_status[32]="N/A", s_charge_full[32]="N/A";
-	char s_charge_design[32]="N/A", s_charge_now[32]="N/A", s_current[32]="N/A";
-	char s_voltage[32]="N/A", s_cycles[16]="N/A", s_temp[16]="N/A";
-	char s_manufacturer[64]="N/A", s_model[64]="N/A", s_tech[32]="N/A";
+static int bat_open_attr(const char *sysfs, const char *node, const char *attr) {
+	char p[PATH_MAX];
+	snprintf(p, sizeof(p), "%s/%s/%s", sysfs, node, attr);
+	return open(p, O_RDONLY | O_CLOEXEC);
+}
+
+static void bat_read_static(const char *sysfs, const char *node, const char *attr, char *out, size_t sz) {
+	int fd = bat_open_attr(sysfs, node, attr);
+	bat_pread(fd, out, sz);
+	if (fd >= 0) close(fd);
+}
+
+static void bat_close(BatData *bd) {
+	for (int i = 0; i < BA_N; i++)
+		if (bd->fd[i] >= 0) { close(bd->fd[i]); bd->fd[i] = -1; }
+	if (bd->gov_fd >= 0) { close(bd->gov_fd); bd->gov_fd = -1; }
+	if (bd->epp_fd >= 0) { close(bd->epp_fd); bd->epp_fd = -1; }
+	bd->node[0] = '\0';
+}
+
+static void bat_open(BatData *bd) {
+	bat_close(bd);
+	bd->gov_fd = open("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", O_RDONLY | O_CLOEXEC);
+	bd->epp_fd = open("/sys/devices/system/cpu/cpu0/cpufreq/energy_performance_preference", O_RDONLY | O_CLOEXEC);
+	const char *node = bat_node(bd->sysfs);
+	if (!node) return;
+	g_strlcpy(bd->node, node, sizeof(bd->node));
+	for (int i = 0; i < BA_N; i++)
+		bd->fd[i] = bat_open_attr(bd->sysfs, node, bat_attr_names[i]);
+	bat_read_static(bd->sysfs, node, "charge_full_design", bd->s_charge_design, sizeof(bd->s_charge_design));
+	bat_read_static(bd->sysfs, node, "manufacturer",       bd->s_manufacturer,  sizeof(bd->s_manufacturer));
+	bat_read_static(bd->sysfs, node, "model_name",         bd->s_model,         sizeof(bd->s_model));
+	bat_read_static(bd->sysfs, node, "technology",         bd->s_tech,          sizeof(bd->s_tech));
+}
+
+/* Power draw, time left and voltage from current_now, voltage_now and
+ * charge_now, with status and charge_full from the last full read */
+static void bat_update_power(BatData *bd) {
+	gboolean bat = bd->node[0] != '\0';
+	char s_current[32]="N/A", s_voltage[32]="N/A", s_charge_now[32]="N/A";
 	if (bat) {
-		BREAD(bat,"capacity",          s_capacity,    sizeof(s_capacity));
-		BREAD(bat,"status",            s_status,      sizeof(s_status));
-		BREAD(bat,"charge_full",       s_charge_full, sizeof(s_charge_full));
-		BREAD(bat,"charge_full_design",s_charge_design,sizeof(s_charge_design));
-		BREAD(bat,"charge_now",        s_charge_now,  sizeof(s_charge_now));
-		BREAD(bat,"current_now",       s_current,     sizeof(s_current));
-		BREAD(bat,"voltage_now",       s_voltage,     sizeof(s_voltage));
-		BREAD(bat,"cycle_count",       s_cycles,      sizeof(s_cycles));
-		BREAD(bat,"temp",              s_temp,        sizeof(s_temp));
-		BREAD(bat,"manufacturer",      s_manufacturer,sizeof(s_manufacturer));
-		BREAD(bat,"model_name",        s_model,       sizeof(s_model));
-		BREAD(bat,"technology",        s_tech,        sizeof(s_tech));
+		bat_pread(bd->fd[BA_CURRENT],    s_current,    sizeof(s_current));
+		bat_pread(bd->fd[BA_VOLTAGE],    s_voltage,    sizeof(s_voltage));
+		bat_pread(bd->fd[BA_CHARGE_NOW], s_charge_now, sizeof(s_charge_now));
 	}
-	int  capacity = bat ? atoi(s_capacity) : 0;
-	long cf=atol(s_charge_full), cd=atol(s_charge_design);
-	long cnow=atol(s_charge_now), curr=atol(s_current), volt=atol(s_voltage);
-	char s_health[16]="N/A";
-	if (cf>0 && cd>0) snprintf(s_health,sizeof(s_health),"%ld%%",cf*100/cd);
+	long cf=bd->charge_full, cnow=atol(s_charge_now), curr=atol(s_current), volt=atol(s_voltage);
 	char s_power[32]="N/A";
 	if (volt>0 && curr!=0)
 		snprintf(s_power,sizeof(s_power),"%.2f W",
 			 (double)(volt/1000.0)*(double)(curr<0?-curr:curr)/1000.0/1e6);
 	else if (bat && curr==0) strncpy(s_power,"0.00 W",sizeof(s_power));
 	char s_time[32]="N/A";
-	if (strcmp(s_status,"Full")==0) strncpy(s_time,"Full",sizeof(s_time));
+	if (strcmp(bd->status,"Full")==0) strncpy(s_time,"Full",sizeof(s_time));
 	else if (curr!=0 && cnow>0) {
 		long denom=curr<0?-curr:curr;
-		long delta=strcmp(s_status,"Discharging")==0?cnow:(cf>cnow?cf-cnow:0);
+		long delta=strcmp(bd->status,"Discharging")==0?cnow:(cf>cnow?cf-cnow:0);
 		if (denom>0 && delta>0) {
 			long mins=(delta*60)/denom;
 			snprintf(s_time,sizeof(s_time),"%ldh %ldm",mins/60,mins%60);
 		}
 	}
-	char s_temp_fmt[32]="N/A";
-	if (strcmp(s_temp,"N/A")!=0)
-		snprintf(s_temp_fmt,sizeof(s_temp_fmt),"%.1f °C",atof(s_temp)/10.0);
 	char s_volt_fmt[32]="N/A";
 	if (strcmp(s_voltage,"N/A")!=0)
 		snprintf(s_volt_fmt,sizeof(s_volt_fmt),"%.2f V",volt/1e6);
+	card_set_value(bd->card_power,   s_power);
+	card_set_value(bd->card_time,    s_time);
+	card_set_value(bd->card_voltage, s_volt_fmt);
+}
+
+static void bat_read_and_update(BatData *bd) {
+	if (!bd || bd->destroyed) return;
+	gboolean bat = bd->node[0] != '\0';
+	char s_capacity[16]="N/A", s_status[32]="N/A", s_charge_full[32]="N/A";
+	char s_cycles[16]="N/A", s_temp[16]="N/A";
+	const char *s_charge_design="N/A", *s_manufacturer="N/A", *s_model="N/A", *s_tech="N/A";
+	if (bat) {
+		bat_pread(bd->fd[BA_CAPACITY],    s_capacity,    sizeof(s_capacity));
+		bat_pread(bd->fd[BA_STATUS],      s_status,      sizeof(s_status));
+		bat_pread(bd->fd[BA_CHARGE_FULL], s_charge_full, sizeof(s_charge_full));
+		bat_pread(bd->fd[BA_CYCLES],      s_cycles,      sizeof(s_cycles));
+		bat_pread(bd->fd[BA_TEMP],        s_temp,        sizeof(s_temp));
+		s_charge_design = bd->s_charge_design;
+		s_manufacturer  = bd->s_manufacturer;
+		s_model         = bd->s_model;
+		s_tech          = bd->s_tech;
+	}
+	int  capacity = bat ? atoi(s_capacity) : 0;
+	long cf=atol(s_charge_full), cd=atol(s_charge_design);
+	g_strlcpy(bd->status, s_status, sizeof(bd->status));
+	bd->charge_full = cf;
+	char s_health[16]="N/A";
+	if (cf>0 && cd>0) snprintf(s_health,sizeof(s_health),"%ld%%",cf*100/cd);
+	char s_temp_fmt[32]="N/A";
+	if (strcmp(s_temp,"N/A")!=0)
+		snprintf(s_temp_fmt,sizeof(s_temp_fmt),"%.1f °C",atof(s_temp)/10.0);
 	bd->gauge_data->capacity = capacity;
 	strncpy(bd->gauge_data->status, s_status, sizeof(bd->gauge_data->status)-1);
 	gtk_widget_queue_draw(bd->gauge);
@@ -1525,16 +1622,12 @@ static void bat_read_and_update(BatData *bd) {
 		 strcmp(s_tech,"N/A")?s_tech:"Li-ion");
 	gtk_label_set_text(GTK_LABEL(bd->devlbl), devinfo);
 	card_set_value(bd->card_health,  s_health);
-	card_set_value(bd->card_power,   s_power);
-	card_set_value(bd->card_time,    s_time);
 	card_set_value(bd->card_cycles,  s_cycles);
-	card_set_value(bd->card_voltage, s_volt_fmt);
 	card_set_value(bd->card_temp,    s_temp_fmt);
-	char gov[32]="N/A", epp[32]="N/A";
-	FILE *gf=fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor","r");
-	if(gf){fgets(gov,sizeof(gov),gf);fclose(gf);char*n=strchr(gov,'\n');if(n)*n='\0';}
-	FILE *ef=fopen("/sys/devices/system/cpu/cpu0/cpufreq/energy_performance_preference","r");
-	if(ef){fgets(epp,sizeof(epp),ef);fclose(ef);char*n=strchr(epp,'\n');if(n)*n='\0';}
+	bat_update_power(bd);
+	char gov[32], epp[32];
+	bat_pread(bd->gov_fd, gov, sizeof(gov));
+	bat_pread(bd->epp_fd, epp, sizeof(epp));
 	if (bd->gov_performance)
 		gtk_widget_set_sensitive(bd->gov_performance, strcmp(gov,"performance")!=0);
 	if (bd->gov_balanced)
@@ -1549,35 +1642,164 @@ static void bat_read_and_update(BatData *bd) {
 static gboolean bat_timer_cb(gpointer ud) {
 	BatData *bd = ud;
 	if (!bd || bd->destroyed) return G_SOURCE_REMOVE;
+	if (bd->nl_watch) { bat_update_power(bd); return G_SOURCE_CONTINUE; }
+	if (!bd->node[0]) bat_open(bd);
 	bat_read_and_update(bd); return G_SOURCE_CONTINUE;
 }
+
+static gboolean bat_refresh_idle(gpointer ud) {
+	BatData *bd = ud;
+	bd->refresh_idle = 0;
+	/* a battery may have been inserted or removed */
+	char p[PATH_MAX];
+	snprintf(p, sizeof(p), "%s/%s/capacity", bd->sysfs, bd->node);
+	if (!bd->node[0] || !g_file_test(p, G_FILE_TEST_EXISTS))
+		bat_open(bd);
+	bat_read_and_update(bd);
+	return G_SOURCE_REMOVE;
+}
+
+/* Kernel uevents are NUL-separated KEY=value strings after an
+ * "action@devpath" header; a burst of them costs one re-read. */
+static gboolean bat_uevent_cb(gint fd, GIOCondition cond, gpointer ud) {
+	BatData *bd = ud;
+	char buf[4096];
+	ssize_t n;
+	gboolean hit = FALSE;
+	while ((n = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) > 0) {
+		buf[n] = '\0';
+		for (const char *p = buf; p < buf + n; p += strlen(p) + 1)
+			if (strcmp(p, "SUBSYSTEM=power_supply") == 0) { hit = TRUE; break; }
+	}
+	if (hit && !bd->refresh_idle)
+		bd->refresh_idle = g_idle_add(bat_refresh_idle, bd);
+	return G_SOURCE_CONTINUE;
+}
+
+static void bat_uevent_open(BatData *bd) {
+	bd->nl_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (bd->nl_fd < 0) return;
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = 1 };   /* kernel events */
+	if (bind(bd->nl_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		close(bd->nl_fd); bd->nl_fd = -1;
+		return;
+	}
+	bd->nl_watch = g_unix_fd_add(bd->nl_fd, G_IO_IN, bat_uevent_cb, bd);
+}
+
+/* Catch up on what changed while hidden, then poll until unmapped */
+static void bat_page_map(GtkWidget *w, gpointer ud) {
+	BatData *bd = ud;
+	if (!bd->node[0]) bat_open(bd);
+	bat_read_and_update(bd);
+	if (!bd->timer_id) bd->timer_id = g_timeout_add_seconds(BAT_POWER_S, bat_timer_cb, bd);
+}
+
+static void bat_page_unmap(GtkWidget *w, gpointer ud) {
+	BatData *bd = ud;
+	if (bd->timer_id) { g_source_remove(bd->timer_id); bd->timer_id = 0; }
+}
+
 static void bat_page_destroyed(GtkWidget *w, gpointer ud) {
 	BatData *bd = ud;
 	bd->destroyed = TRUE;
 	if (bd->timer_id) { g_source_remove(bd->timer_id); bd->timer_id = 0; }
+	if (bd->refresh_idle) { g_source_remove(bd->refresh_idle); bd->refresh_idle = 0; }
+	if (bd->nl_watch) { g_source_remove(bd->nl_watch); bd->nl_watch = 0; }
+	if (bd->nl_fd >= 0) close(bd->nl_fd);
+	bat_close(bd);
 	g_free(bd);
 }
+
+/* ------------------------------------------------------------------ */
+/* power mode buttons                                                   */
+/* ------------------------------------------------------------------ */
+/* The buttons run mrsettings-cpufreq (see mrsettings-cpufreq.c) through
+ * pkexec on a worker thread; its per-core report comes back in an idle,
+ * which summarises it under the buttons and re-reads the current
+ * governor so the buttons' states follow. */
+#define CPUFREQ_HELPER "/usr/libexec/mrsettings-cpufreq"
+
+typedef struct {
+	BatData   *bd;
+	GtkWidget *status;            /* ref held; unrooted once the page is gone */
+	const char *mode;             /* performance | balanced | powersave */
+	char      *label, *out;
+	int        exit_status;
+	gboolean   spawned;
+} GovJob;
+
+static gboolean gov_done_idle(gpointer ud) {
+	GovJob *j = ud;
+	if (gtk_widget_get_root(j->status)) {
+		BatData *bd = j->bd;
+		int total = 0, good = 0;
+		GString *fail = g_string_new(NULL);
+		char **lines = g_strsplit(j->out ? j->out : "", "\n", -1);
+		for (char **l = lines; *l; l++) {
+			char cpu[16], gs[96], es[96];
+			if (sscanf(*l, "%15s %95s %95s", cpu, gs, es) != 3 || strcmp(gs, "absent") == 0) continue;
+			total++;
+			gboolean ok = strcmp(gs, "ok") == 0 && (strcmp(es, "ok") == 0 || strcmp(es, "absent") == 0);
+			if (ok) { good++; continue; }
+			if (fail->len < 160)
+				g_string_append_printf(fail, "%s%s: %s", fail->len ? "; " : "", cpu,
+						       strcmp(gs, "ok") ? gs : es);
+		}
+		g_strfreev(lines);
+		char msg[320];
+		if (!j->spawned)
+			snprintf(msg, sizeof(msg), "Could not run " CPUFREQ_HELPER);
+		else if (!total && (j->exit_status == 126 || j->exit_status == 127))
+			snprintf(msg, sizeof(msg), "Authorization was not granted");
+		else if (!total)
+			snprintf(msg, sizeof(msg), "No CPU frequency controls found");
+		else if (good == total)
+			snprintf(msg, sizeof(msg), "%s applied to all %d cores", j->label, total);
+		else
+			snprintf(msg, sizeof(msg), "%s applied to %d of %d cores \xe2\x80\x94 %s",
+				 j->label, good, total, fail->str);
+		g_string_free(fail, TRUE);
+		gtk_label_set_text(GTK_LABEL(j->status), msg);
+		bat_read_and_update(bd);
+	}
+	g_object_unref(j->status);
+	g_free(j->label);
+	g_free(j->out);
+	g_free(j);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer gov_thread(gpointer ud) {
+	GovJob *j = ud;
+	const char *gov, *epp;
+	if      (strcmp(j->mode, "performance") == 0) { gov = "performance"; epp = "performance"; }
+	else if (strcmp(j->mode, "balanced") == 0)    { gov = "powersave";   epp = "balance_performance"; }
+	else                                          { gov = "powersave";   epp = "power"; }
+	char *argv[] = { "pkexec", CPUFREQ_HELPER, (char *)gov, (char *)epp, NULL };
+	int status = 0;
+	/* already root: skip pkexec */
+	j->spawned = g_file_test(CPUFREQ_HELPER, G_FILE_TEST_IS_EXECUTABLE) &&
+		     g_spawn_sync(NULL, geteuid() == 0 ? argv + 1 : argv, NULL,
+				  G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+				  NULL, NULL, &j->out, NULL, &status, NULL);
+	j->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	g_idle_add(gov_done_idle, j);
+	return NULL;
+}
+
 static void gov_set(GtkWidget *btn, gpointer ud) {
-	const char *mode = ud, *gov, *epp;
-	if      (strcmp(mode,"performance")==0) { gov="performance"; epp="performance"; }
-	else if (strcmp(mode,"balanced")==0)    { gov="powersave";   epp="balance_performance"; }
-	else                                    { gov="powersave";   epp="power"; }
-	char cmd[512];
-	//snprintf(cmd,sizeof(cmd),
-	//    "for f in /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor; do "
-	//    "echo %s | pkexec tee \"$f\" >/dev/null 2>&1; done && "
-	//    "for f in /sys/devices/system/cpu/cpu*/cpufreq/energy_performance_preference; do "
-	//    "echo %s | pkexec tee \"$f\" >/dev/null 2>&1; done",
-	//    gov, epp);
-	snprintf(cmd, sizeof(cmd),
-		 "for f in /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor; do "
-		 "echo %s | tee \"$f\" >/dev/null 2>&1; done && "
-		 "for f in /sys/devices/system/cpu/cpu*/cpufreq/energy_performance_preference; do "
-		 "echo %s | tee \"$f\" >/dev/null 2>&1; done",
-		 gov, epp);
-	system(cmd);
+	BatData *bd = ud;
+	GovJob *j = g_new0(GovJob, 1);
+	j->bd = bd;
+	j->status = g_object_ref(bd->gov_status);
+	j->mode  = g_object_get_data(G_OBJECT(btn), "gov-mode");
+	j->label = g_strdup(g_object_get_data(G_OBJECT(btn), "gov-label"));
+	gtk_label_set_text(GTK_LABEL(bd->gov_status), "Applying\xe2\x80\xa6");
+	g_thread_unref(g_thread_new("gov-set", gov_thread, j));
 }
-static GtkWidget *make_gov_btn(const char *icon_name, const char *label_str,
+
+static GtkWidget *make_gov_btn(BatData *bd, const char *icon_name, const char *label_str,
 			       const char *sub_str,   const char *mode_str) {
 	GtkWidget *btn = gtk_button_new();
 	gtk_widget_add_css_class(btn, "bat-gov-btn");
@@ -1598,12 +1820,1016 @@ static GtkWidget *make_gov_btn(const char *icon_name, const char *label_str,
 	gtk_label_set_justify(GTK_LABEL(sub),GTK_JUSTIFY_CENTER);
 	gtk_box_append(GTK_BOX(vb),sub);
 	gtk_button_set_child(GTK_BUTTON(btn),vb);
-	g_signal_connect(btn,"clicked",G_CALLBACK(gov_set),(gpointer)mode_str);
+	g_object_set_data(G_OBJECT(btn),"gov-mode",(gpointer)mode_str);
+	g_object_set_data(G_OBJECT(btn),"gov-label",(gpointer)label_str);
+	g_signal_connect(btn,"clicked",G_CALLBACK(gov_set),bd);
 	return btn;
 }
 
+/* ------------------------------------------------------------------ */
+/* battery history                                                      */
+/* ------------------------------------------------------------------ */
+/* While the app runs, a sample is taken every BAT_HIST_PERIOD_S seconds
+ * and appended to a fixed-size circular file, mapped shared, under
+ * ~/.cache/mrrobotos/mrsettings/battery-history.  Memory and disk use
+ * stay constant, and an append is one 16-byte store plus a release
+ * store of the head counter, so the file can be read without locks.
+ * On top of the ring, each graph range keeps BAT_HIST_BUCKETS min/max/
+ * mean buckets.  They are filled from the file once at startup and
+ * then updated per append, so drawing never rescans the samples. */
+#define BAT_HIST_PERIOD_S  5
+#define BAT_HIST_CAP       131072            /* > 7 days of 5 s samples */
+#define BAT_HIST_BUCKETS   240
+#define BAT_HIST_MAGIC     0x48424d52u       /* "MRBH" */
+
+enum { BH_CHARGE, BH_POWER, BH_TIME, BH_N };          /* graph metrics */
+enum { BS_UNKNOWN, BS_CHARGING, BS_DISCHARGING, BS_FULL, BS_IDLE };
+
+typedef struct {
+	guint32 t;                  /* unix seconds */
+	guint32 energy_mwh;
+	gint32  power_mw;           /* negative while discharging */
+	guint8  capacity, status;
+	guint16 reserved;
+} BatSample;
+
+typedef struct {
+	guint32 magic, version, cap, sample_size;
+	guint64 head;               /* samples ever written */
+	guint64 reserved;
+} BatHistHeader;
+
+typedef struct {
+	gint64  id;                 /* t / width of the slot's bucket */
+	float   min[BH_N], max[BH_N], sum[BH_N];
+	guint32 n[BH_N];
+} BatBucket;
+
+static const struct { const char *label; guint32 secs; } bat_ranges[] = {
+	{ "1 h", 3600 }, { "24 h", 86400 }, { "7 d", 7 * 86400 },
+};
+#define BAT_N_RANGES G_N_ELEMENTS(bat_ranges)
+
+typedef struct {
+	BatHistHeader *hdr;
+	BatSample     *ring;
+	size_t         map_len;
+	char           node[16];
+	int            fd[5];                        /* capacity status energy/charge power/current voltage */
+	gboolean       charge_units;                 /* charge_now/current_now instead of energy/power */
+	BatBucket      buckets[BAT_N_RANGES][BAT_HIST_BUCKETS + 1];
+	guint          timer_id;
+	GtkWidget     *area;                         /* weak: open Battery page graph */
+} BatHist;
+
+static BatHist bat_hist;
+
+static void bat_hist_bucket_add(const BatSample *s) {
+	float v[BH_N];
+	gboolean ok[BH_N] = { TRUE, s->power_mw != 0, s->status == BS_DISCHARGING && s->power_mw < 0 };
+	v[BH_CHARGE] = s->capacity;
+	v[BH_POWER]  = fabsf(s->power_mw / 1000.0f);
+	v[BH_TIME]   = ok[BH_TIME] ? s->energy_mwh / (float)-s->power_mw : 0;   /* hours */
+	for (guint r = 0; r < BAT_N_RANGES; r++) {
+		guint32 width = bat_ranges[r].secs / BAT_HIST_BUCKETS;
+		gint64 id = s->t / width;
+		BatBucket *b = &bat_hist.buckets[r][id % (BAT_HIST_BUCKETS + 1)];
+		if (b->id != id) { memset(b, 0, sizeof(*b)); b->id = id; }
+		for (int m = 0; m < BH_N; m++) {
+			if (!ok[m]) continue;
+			if (!b->n[m]) b->min[m] = b->max[m] = v[m];
+			b->min[m] = MIN(b->min[m], v[m]);
+			b->max[m] = MAX(b->max[m], v[m]);
+			b->sum[m] += v[m];
+			b->n[m]++;
+		}
+	}
+}
+
+static void bat_hist_append(const BatSample *s) {
+	guint64 head = bat_hist.hdr->head;
+	bat_hist.ring[head % BAT_HIST_CAP] = *s;
+	__atomic_store_n(&bat_hist.hdr->head, head + 1, __ATOMIC_RELEASE);
+	bat_hist_bucket_add(s);
+}
+
+static gboolean bat_hist_map(void) {
+	char *path = g_build_filename(g_get_user_cache_dir(), "mrrobotos", "mrsettings",
+				      "battery-history", NULL);
+	char *dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	g_free(dir); g_free(path);
+	if (fd < 0) return FALSE;
+	size_t len = sizeof(BatHistHeader) + (size_t)BAT_HIST_CAP * sizeof(BatSample);
+	struct stat st;
+	if (fstat(fd, &st) < 0 || ((size_t)st.st_size != len && ftruncate(fd, len) < 0)) {
+		close(fd);
+		return FALSE;
+	}
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return FALSE;
+	bat_hist.hdr = p;
+	bat_hist.ring = (BatSample *)((char *)p + sizeof(BatHistHeader));
+	bat_hist.map_len = len;
+	BatHistHeader *h = bat_hist.hdr;
+	if (h->magic != BAT_HIST_MAGIC || h->version != 1 || h->cap != BAT_HIST_CAP ||
+	    h->sample_size != sizeof(BatSample)) {
+		/* new file or different layout: start over */
+		memset(h, 0, sizeof(*h));
+		h->magic = BAT_HIST_MAGIC; h->version = 1;
+		h->cap = BAT_HIST_CAP; h->sample_size = sizeof(BatSample);
+	}
+	return TRUE;
+}
+
+static void bat_hist_open_node(void) {
+	for (int i = 0; i < 5; i++)
+		if (bat_hist.fd[i] >= 0) { close(bat_hist.fd[i]); bat_hist.fd[i] = -1; }
+	const char *node = bat_node(BAT_SYSFS);
+	bat_hist.node[0] = '\0';
+	if (!node) return;
+	g_strlcpy(bat_hist.node, node, sizeof(bat_hist.node));
+	bat_hist.fd[0] = bat_open_attr(BAT_SYSFS, node, "capacity");
+	bat_hist.fd[1] = bat_open_attr(BAT_SYSFS, node, "status");
+	bat_hist.fd[2] = bat_open_attr(BAT_SYSFS, node, "energy_now");
+	bat_hist.fd[3] = bat_open_attr(BAT_SYSFS, node, "power_now");
+	bat_hist.charge_units = bat_hist.fd[2] < 0 || bat_hist.fd[3] < 0;
+	if (bat_hist.charge_units) {
+		if (bat_hist.fd[2] < 0) bat_hist.fd[2] = bat_open_attr(BAT_SYSFS, node, "charge_now");
+		if (bat_hist.fd[3] < 0) bat_hist.fd[3] = bat_open_attr(BAT_SYSFS, node, "current_now");
+	}
+	bat_hist.fd[4] = bat_open_attr(BAT_SYSFS, node, "voltage_now");
+}
+
+static gboolean bat_hist_tick(gpointer unused) {
+	if (!bat_hist.node[0]) bat_hist_open_node();
+	if (!bat_hist.node[0]) return G_SOURCE_CONTINUE;
+	char cap[16], st[32], en[32], pw[32], vo[32];
+	bat_pread(bat_hist.fd[0], cap, sizeof(cap));
+	if (strcmp(cap, "N/A") == 0) { bat_hist_open_node(); return G_SOURCE_CONTINUE; }
+	bat_pread(bat_hist.fd[1], st, sizeof(st));
+	bat_pread(bat_hist.fd[2], en, sizeof(en));
+	bat_pread(bat_hist.fd[3], pw, sizeof(pw));
+	bat_pread(bat_hist.fd[4], vo, sizeof(vo));
+	double e = atof(en), p = fabs(atof(pw)), v = atof(vo) / 1e6;
+	if (bat_hist.charge_units) { e *= v; p *= v; }                   /* µAh·V, µA·V */
+	BatSample s = { .t = (guint32)(g_get_real_time() / G_USEC_PER_SEC),
+			.capacity = (guint8)CLAMP(atoi(cap), 0, 100) };
+	s.status = strcmp(st, "Charging") == 0    ? BS_CHARGING
+		 : strcmp(st, "Discharging") == 0 ? BS_DISCHARGING
+		 : strcmp(st, "Full") == 0        ? BS_FULL
+		 : strcmp(st, "Not charging") == 0 ? BS_IDLE : BS_UNKNOWN;
+	s.energy_mwh = (guint32)(e / 1000.0);
+	s.power_mw   = (gint32)(p / 1000.0) * (s.status == BS_DISCHARGING ? -1 : 1);
+	bat_hist_append(&s);
+	if (bat_hist.area) gtk_widget_queue_draw(bat_hist.area);
+	return G_SOURCE_CONTINUE;
+}
+
+/* Started from an idle at launch; does nothing on machines without a battery */
+static gboolean bat_hist_init(gpointer unused) {
+	for (int i = 0; i < 5; i++) bat_hist.fd[i] = -1;
+	bat_hist_open_node();
+	if (!bat_hist.node[0] || !bat_hist_map()) return G_SOURCE_REMOVE;
+	guint32 now = (guint32)(g_get_real_time() / G_USEC_PER_SEC);
+	guint32 oldest = now - bat_ranges[BAT_N_RANGES - 1].secs;
+	guint64 head = bat_hist.hdr->head, n = MIN(head, (guint64)BAT_HIST_CAP);
+	for (guint64 i = head - n; i < head; i++) {
+		const BatSample *s = &bat_hist.ring[i % BAT_HIST_CAP];
+		if (s->t >= oldest && s->t <= now) bat_hist_bucket_add(s);
+	}
+	bat_hist_tick(NULL);
+	bat_hist.timer_id = g_timeout_add_seconds(BAT_HIST_PERIOD_S, bat_hist_tick, NULL);
+	return G_SOURCE_REMOVE;
+}
+
+typedef struct { int range, metric; } BatHistView;
+
+static void bat_hist_draw(GtkDrawingArea *da, cairo_t *cr, int w, int h, gpointer ud) {
+	BatHistView *hv = ud;
+	const double top = 8, bot = h - 18, left = 8, right = w - 44;
+	cairo_set_source_rgba(cr, 0, 0, 0, 0.08);
+	cairo_set_line_width(cr, 1);
+	for (int i = 0; i <= 4; i++) {
+		double y = floor(top + (bot - top) * i / 4) + 0.5;
+		cairo_move_to(cr, left, y); cairo_line_to(cr, right, y);
+	}
+	cairo_stroke(cr);
+
+	guint32 secs = bat_ranges[hv->range].secs, width = secs / BAT_HIST_BUCKETS;
+	gint64 now = g_get_real_time() / G_USEC_PER_SEC, first = (now - secs) / width;
+	const BatBucket *bk = bat_hist.buckets[hv->range];
+	int m = hv->metric;
+
+	/* scale: charge is 0–100 %, the others fit the visible maximum */
+	float vmax = 0;
+	for (gint64 id = first; id <= now / width && bat_hist.hdr; id++) {
+		const BatBucket *b = &bk[id % (BAT_HIST_BUCKETS + 1)];
+		if (b->id == id && b->n[m]) vmax = MAX(vmax, b->max[m]);
+	}
+	if (m == BH_CHARGE) vmax = 100;
+	else vmax = vmax > 0 ? ceilf(vmax * 1.1f) : 1;
+
+	cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size(cr, 10);
+	cairo_set_source_rgba(cr, 0.1, 0.1, 0.1, 0.55);
+	static const char *unit[BH_N] = { "%", "W", "h" };
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%g %s", vmax, unit[m]);
+	cairo_move_to(cr, right + 4, top + 8); cairo_show_text(cr, buf);
+	snprintf(buf, sizeof(buf), "0 %s", unit[m]);
+	cairo_move_to(cr, right + 4, bot); cairo_show_text(cr, buf);
+	cairo_move_to(cr, left, h - 4); cairo_show_text(cr, bat_ranges[hv->range].label);
+	cairo_move_to(cr, right - 22, h - 4); cairo_show_text(cr, "now");
+
+	if (!bat_hist.hdr) {
+		cairo_move_to(cr, left + 8, (top + bot) / 2);
+		cairo_show_text(cr, "No history yet");
+		return;
+	}
+	double bw = (right - left) / BAT_HIST_BUCKETS;
+#define BX(id) (left + ((double)(id) * width - (now - secs)) / secs * (right - left))
+#define BY(v)  (bot - (v) / vmax * (bot - top))
+	/* min/max band */
+	cairo_set_source_rgba(cr, 0.11, 0.72, 0.40, 0.25);
+	for (gint64 id = first; id <= now / width; id++) {
+		const BatBucket *b = &bk[id % (BAT_HIST_BUCKETS + 1)];
+		if (b->id != id || !b->n[m]) continue;
+		double y0 = BY(b->max[m]), y1 = BY(b->min[m]);
+		cairo_rectangle(cr, BX(id), y0, bw, MAX(y1 - y0, 1));
+	}
+	cairo_fill(cr);
+	/* mean line, broken across gaps */
+	cairo_set_source_rgb(cr, 0.11, 0.72, 0.40);
+	cairo_set_line_width(cr, 1.5);
+	gboolean pen = FALSE;
+	for (gint64 id = first; id <= now / width; id++) {
+		const BatBucket *b = &bk[id % (BAT_HIST_BUCKETS + 1)];
+		if (b->id != id || !b->n[m]) { pen = FALSE; continue; }
+		double x = BX(id) + bw / 2, y = BY(b->sum[m] / b->n[m]);
+		if (pen) cairo_line_to(cr, x, y); else cairo_move_to(cr, x, y);
+		pen = TRUE;
+	}
+	cairo_stroke(cr);
+#undef BX
+#undef BY
+}
+
+static void bat_hist_range_toggled(GtkToggleButton *tb, gpointer ud) {
+	if (!gtk_toggle_button_get_active(tb)) return;
+	BatHistView *hv = g_object_get_data(G_OBJECT(tb), "hist-view");
+	hv->range = GPOINTER_TO_INT(ud);
+	gtk_widget_queue_draw(bat_hist.area);
+}
+
+static void bat_hist_metric_changed(GtkDropDown *dd, GParamSpec *ps, gpointer ud) {
+	((BatHistView *)ud)->metric = gtk_drop_down_get_selected(dd);
+	gtk_widget_queue_draw(bat_hist.area);
+}
+
+static GtkWidget *bat_hist_build_section(void) {
+	GtkWidget *frame = make_section_box("History");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+	BatHistView *hv = g_new0(BatHistView, 1);
+
+	GtkWidget *bar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(bar, 14); gtk_widget_set_margin_end(bar, 14);
+	gtk_widget_set_margin_top(bar, 10);   gtk_widget_set_margin_bottom(bar, 4);
+	const char *metrics[] = { "Charge", "Power Draw", "Time Remaining", NULL };
+	GtkWidget *dd = gtk_drop_down_new_from_strings(metrics);
+	gtk_widget_set_hexpand(dd, TRUE); gtk_widget_set_halign(dd, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(bar), dd);
+	GtkWidget *seg = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	gtk_widget_add_css_class(seg, "linked");
+	GtkWidget *group = NULL;
+	for (guint r = 0; r < BAT_N_RANGES; r++) {
+		GtkWidget *tb = gtk_toggle_button_new_with_label(bat_ranges[r].label);
+		if (group) gtk_toggle_button_set_group(GTK_TOGGLE_BUTTON(tb), GTK_TOGGLE_BUTTON(group));
+		else { group = tb; gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tb), TRUE); }
+		g_object_set_data(G_OBJECT(tb), "hist-view", hv);
+		g_signal_connect(tb, "toggled", G_CALLBACK(bat_hist_range_toggled), GINT_TO_POINTER(r));
+		gtk_box_append(GTK_BOX(seg), tb);
+	}
+	gtk_box_append(GTK_BOX(bar), seg);
+	gtk_box_append(GTK_BOX(inner), bar);
+
+	GtkWidget *area = gtk_drawing_area_new();
+	gtk_widget_set_size_request(area, -1, 160);
+	gtk_widget_set_margin_start(area, 14); gtk_widget_set_margin_end(area, 14);
+	gtk_widget_set_margin_bottom(area, 12);
+	gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(area), bat_hist_draw, hv, g_free);
+	gtk_box_append(GTK_BOX(inner), area);
+	g_signal_connect(dd, "notify::selected", G_CALLBACK(bat_hist_metric_changed), hv);
+
+	if (bat_hist.area) g_object_remove_weak_pointer(G_OBJECT(bat_hist.area), (gpointer *)&bat_hist.area);
+	bat_hist.area = area;
+	g_object_add_weak_pointer(G_OBJECT(area), (gpointer *)&bat_hist.area);
+	return frame;
+}
+
+/* ------------------------------------------------------------------ */
+/* CPU activity                                                         */
+/* ------------------------------------------------------------------ */
+/* This panel shows per-core frequency and utilisation, plus the package
+ * temperature.  The sampler opens scaling_cur_freq for every core,
+ * /proc/stat and one hwmon input when the panel is mapped.  On each
+ * tick it re-reads them with pread into reused buffers, and it closes
+ * everything again on unmap.  Each series is a fixed CPU_MON_HIST-entry
+ * ring, and all rings share one head.  The widget draws the rings
+ * directly into its snapshot: utilisation as columns, and frequency as
+ * a trace scaled to the core's maximum.  The sysfs and procfs roots are
+ * parameters, so the sampler can be pointed at a synthetic tree. */
+#define CPU_MON_HIST    120
+#define CPU_MON_CELL_W  168
+#define CPU_MON_CELL_H  46
+#define CPU_MON_TEMP_H  40
+
+static const guint cpu_mon_rates_ms[] = { 250, 500, 1000, 2000 };
+
+typedef struct {
+	int      id, freq_fd;
+	float    max_khz;
+	guint64  busy, total;          /* previous /proc/stat counters */
+	gboolean seen;
+} CpuMonCore;
+
+typedef struct {
+	int         n, n_slots;
+	CpuMonCore *core;
+	int        *slot;              /* cpu id -> index into core, -1 if none */
+	int         stat_fd, temp_fd;
+	char       *buf;               /* /proc/stat, grown as needed */
+	size_t      buf_sz;
+	int         head, count;
+	float      *util, *freq;       /* n x CPU_MON_HIST: 0..1 and kHz */
+	float       temp[CPU_MON_HIST]; /* °C, NAN when unknown */
+} CpuSampler;
+
+static float cpu_pread_num(int fd) {
+	char b[32];
+	ssize_t n = fd >= 0 ? pread(fd, b, sizeof(b) - 1, 0) : -1;
+	if (n <= 0) return NAN;
+	b[n] = '\0';
+	return strtof(b, NULL);
+}
+
+/* Package sensor: coretemp/k10temp/zenpower temp1, else x86_pkg_temp. */
+static int cpu_temp_open(const char *sysfs) {
+	static const char *const chips[] = { "coretemp", "k10temp", "zenpower", "cpu_thermal", NULL };
+	char path[PATH_MAX], name[64];
+	for (int i = 0; i < 32; i++) {
+		snprintf(path, sizeof(path), "%s/class/hwmon/hwmon%d/name", sysfs, i);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) continue;
+		bat_pread(fd, name, sizeof(name));
+		close(fd);
+		if (!cpufreq_allowed(chips, name)) continue;
+		snprintf(path, sizeof(path), "%s/class/hwmon/hwmon%d/temp1_input", sysfs, i);
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0) return fd;
+	}
+	for (int i = 0; i < 32; i++) {
+		snprintf(path, sizeof(path), "%s/class/thermal/thermal_zone%d/type", sysfs, i);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) continue;
+		bat_pread(fd, name, sizeof(name));
+		close(fd);
+		if (strcmp(name, "x86_pkg_temp") != 0) continue;
+		snprintf(path, sizeof(path), "%s/class/thermal/thermal_zone%d/temp", sysfs, i);
+		return open(path, O_RDONLY | O_CLOEXEC);
+	}
+	return -1;
+}
+
+static void cpu_sampler_close(CpuSampler *s) {
+	if (!s) return;
+	for (int i = 0; i < s->n; i++)
+		if (s->core[i].freq_fd >= 0) close(s->core[i].freq_fd);
+	if (s->stat_fd >= 0) close(s->stat_fd);
+	if (s->temp_fd >= 0) close(s->temp_fd);
+	g_free(s->core); g_free(s->slot); g_free(s->buf);
+	g_free(s->util); g_free(s->freq);
+	g_free(s);
+}
+
+static CpuSampler *cpu_sampler_open(const char *sysfs, const char *procfs) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/devices/system/cpu", sysfs);
+	GArray *ids = cpufreq_list_cpus(path);
+	if (!ids || !ids->len) { if (ids) g_array_unref(ids); return NULL; }
+
+	CpuSampler *s = g_new0(CpuSampler, 1);
+	s->n       = ids->len;
+	s->core    = g_new0(CpuMonCore, s->n);
+	s->n_slots = g_array_index(ids, int, s->n - 1) + 1;
+	s->slot    = g_new(int, s->n_slots);
+	for (int i = 0; i < s->n_slots; i++) s->slot[i] = -1;
+	for (int i = 0; i < s->n; i++) {
+		CpuMonCore *c = &s->core[i];
+		c->id = g_array_index(ids, int, i);
+		s->slot[c->id] = i;
+		snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", sysfs, c->id);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		c->max_khz = cpu_pread_num(fd);
+		if (fd >= 0) close(fd);
+		snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", sysfs, c->id);
+		c->freq_fd = open(path, O_RDONLY | O_CLOEXEC);
+	}
+	g_array_unref(ids);
+
+	snprintf(path, sizeof(path), "%s/stat", procfs);
+	s->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+	s->temp_fd = cpu_temp_open(sysfs);
+	s->buf_sz  = 4096 + s->n * 128;
+	s->buf     = g_malloc(s->buf_sz);
+	s->util    = g_new0(float, s->n * CPU_MON_HIST);
+	s->freq    = g_new0(float, s->n * CPU_MON_HIST);
+	return s;
+}
+
+/* Parse the cpuN lines of /proc/stat into the rings at slot h. */
+static void cpu_sampler_parse_stat(CpuSampler *s, int h) {
+	ssize_t len;
+	while ((len = pread(s->stat_fd, s->buf, s->buf_sz - 1, 0)) == (ssize_t)s->buf_sz - 1) {
+		s->buf_sz *= 2;
+		s->buf = g_realloc(s->buf, s->buf_sz);
+	}
+	s->buf[MAX(len, 0)] = '\0';
+
+	const char *p = strchr(s->buf, '\n');             /* skip the aggregate line */
+	while (p && p[1] == 'c' && p[2] == 'p' && p[3] == 'u' && g_ascii_isdigit(p[4])) {
+		char *e;
+		unsigned long id = strtoul(p + 4, &e, 10);
+		guint64 v[8] = { 0 }, total = 0;
+		for (int k = 0; k < 8; k++) { v[k] = g_ascii_strtoull(e, &e, 10); total += v[k]; }
+		p = strchr(e, '\n');
+		if (id >= (unsigned long)s->n_slots || s->slot[id] < 0) continue;
+		CpuMonCore *c = &s->core[s->slot[id]];
+		guint64 busy = total - v[3] - v[4];                 /* minus idle and iowait */
+		if (c->seen && total > c->total)
+			s->util[s->slot[id] * CPU_MON_HIST + h] =
+				CLAMP((float)(busy - c->busy) / (float)(total - c->total), 0.0f, 1.0f);
+		c->busy = busy; c->total = total; c->seen = TRUE;
+	}
+}
+
+static void cpu_sampler_sample(CpuSampler *s) {
+	int h = s->head;
+	for (int i = 0; i < s->n; i++) {
+		s->util[i * CPU_MON_HIST + h] = 0;              /* offline cores drop out of /proc/stat */
+		float f = cpu_pread_num(s->core[i].freq_fd);
+		s->freq[i * CPU_MON_HIST + h] = isnan(f) ? 0 : f;
+	}
+	if (s->stat_fd >= 0) cpu_sampler_parse_stat(s, h);
+	s->temp[h] = cpu_pread_num(s->temp_fd) / 1000.0f;
+	s->head  = (h + 1) % CPU_MON_HIST;
+	s->count = MIN(s->count + 1, CPU_MON_HIST);
+}
+
+#define CPU_TYPE_MON (cpu_mon_get_type())
+G_DECLARE_FINAL_TYPE(CpuMon, cpu_mon, CPU, MON, GtkWidget)
+
+struct _CpuMon {
+	GtkWidget    parent_instance;
+	CpuSampler  *s;
+	guint        rate_ms, timer;
+	PangoLayout *pl;
+};
+
+G_DEFINE_FINAL_TYPE(CpuMon, cpu_mon, GTK_TYPE_WIDGET)
+
+static gboolean cpu_mon_tick(gpointer ud) {
+	CpuMon *m = ud;
+	cpu_sampler_sample(m->s);
+	gtk_widget_queue_draw(GTK_WIDGET(m));
+	return G_SOURCE_CONTINUE;
+}
+
+static void cpu_mon_start(CpuMon *m) {
+	if (m->s || !gtk_widget_get_mapped(GTK_WIDGET(m))) return;
+	m->s = cpu_sampler_open("/sys", "/proc");
+	if (!m->s) return;
+	cpu_sampler_sample(m->s);                               /* baseline for the first delta */
+	m->timer = g_timeout_add(m->rate_ms, cpu_mon_tick, m);
+	gtk_widget_queue_resize(GTK_WIDGET(m));
+}
+
+static void cpu_mon_stop(CpuMon *m) {
+	if (m->timer) { g_source_remove(m->timer); m->timer = 0; }
+	g_clear_pointer(&m->s, cpu_sampler_close);
+}
+
+static void cpu_mon_set_rate(CpuMon *m, guint ms) {
+	m->rate_ms = ms;
+	if (!m->timer) return;
+	g_source_remove(m->timer);
+	m->timer = g_timeout_add(ms, cpu_mon_tick, m);
+}
+
+static void cpu_mon_map(GtkWidget *w) {
+	GTK_WIDGET_CLASS(cpu_mon_parent_class)->map(w);
+	cpu_mon_start(CPU_MON(w));
+}
+
+static void cpu_mon_unmap(GtkWidget *w) {
+	cpu_mon_stop(CPU_MON(w));
+	GTK_WIDGET_CLASS(cpu_mon_parent_class)->unmap(w);
+}
+
+static GtkSizeRequestMode cpu_mon_request_mode(GtkWidget *w) {
+	return GTK_SIZE_REQUEST_HEIGHT_FOR_WIDTH;
+}
+
+static void cpu_mon_measure(GtkWidget *w, GtkOrientation o, int for_size,
+			    int *min, int *nat, int *min_base, int *nat_base) {
+	CpuMon *m = CPU_MON(w);
+	if (o == GTK_ORIENTATION_HORIZONTAL) {
+		*min = CPU_MON_CELL_W; *nat = CPU_MON_CELL_W * 4;
+	} else {
+		int n = m->s ? m->s->n : 0;
+		int cols = for_size > 0 ? MAX(for_size / CPU_MON_CELL_W, 1) : 4;
+		*min = *nat = CPU_MON_TEMP_H + (n + cols - 1) / cols * CPU_MON_CELL_H;
+	}
+}
+
+static void cpu_mon_text(CpuMon *m, GtkSnapshot *s, float x, float y, const char *txt) {
+	static const GdkRGBA fg = { 0.55f, 0.55f, 0.55f, 1 };
+	pango_layout_set_text(m->pl, txt, -1);
+	gtk_snapshot_save(s);
+	gtk_snapshot_translate(s, &GRAPHENE_POINT_INIT(x, y));
+	gtk_snapshot_append_layout(s, m->pl, &fg);
+	gtk_snapshot_restore(s);
+}
+
+/* One sparkline: ring `v` scaled by `scale` into the rect, newest sample
+ * at the right edge; columns when `bars`, else a 2 px trace. */
+static void cpu_mon_spark(GtkSnapshot *s, const CpuSampler *cs, const float *v, float lo, float scale,
+			  gboolean bars, const GdkRGBA *col, float x, float y, float w, float h) {
+	float bw = w / CPU_MON_HIST;
+	for (int k = 0; k < cs->count; k++) {
+		float val = v[(cs->head - cs->count + k + CPU_MON_HIST) % CPU_MON_HIST];
+		if (isnan(val)) continue;
+		float py = CLAMP((val - lo) * scale, 0.0f, 1.0f) * h;
+		float px = x + w - (cs->count - k) * bw;
+		if (bars) {
+			if (py >= 0.5f)
+				gtk_snapshot_append_color(s, col, &GRAPHENE_RECT_INIT(px, y + h - py, bw, py));
+		} else {
+			gtk_snapshot_append_color(s, col,
+				&GRAPHENE_RECT_INIT(px, y + h - MAX(py, 2.0f), MAX(bw, 1.0f), 2.0f));
+		}
+	}
+}
+
+static void cpu_mon_snapshot(GtkWidget *w, GtkSnapshot *s) {
+	CpuMon *m = CPU_MON(w);
+	const CpuSampler *cs = m->s;
+	if (!cs) return;
+	static const GdkRGBA track = { 0.5f, 0.5f, 0.5f, 0.12f };
+	static const GdkRGBA ucol  = { 0.35f, 0.60f, 0.90f, 0.75f };
+	static const GdkRGBA fcol  = { 0.95f, 0.60f, 0.20f, 0.95f };
+	static const GdkRGBA tcol  = { 0.90f, 0.35f, 0.30f, 0.95f };
+	float W = gtk_widget_get_width(w);
+	int last = (cs->head + CPU_MON_HIST - 1) % CPU_MON_HIST;
+	char txt[64];
+
+	/* package temperature strip, 30-100 °C */
+	float t = cs->temp[last];
+	if (isnan(t)) snprintf(txt, sizeof(txt), "Package  —");
+	else          snprintf(txt, sizeof(txt), "Package  %.0f °C", t);
+	cpu_mon_text(m, s, 4, 10, txt);
+	gtk_snapshot_append_color(s, &track, &GRAPHENE_RECT_INIT(120, 4, MAX(W - 124, 0), CPU_MON_TEMP_H - 12));
+	cpu_mon_spark(s, cs, cs->temp, 30.0f, 1.0f / 70.0f, FALSE, &tcol, 120, 4, MAX(W - 124, 0),
+		      CPU_MON_TEMP_H - 12);
+
+	int cols = MAX((int)W / CPU_MON_CELL_W, 1);
+	float cw = W / cols;
+	for (int i = 0; i < cs->n; i++) {
+		const CpuMonCore *c = &cs->core[i];
+		const float *u = &cs->util[i * CPU_MON_HIST], *f = &cs->freq[i * CPU_MON_HIST];
+		float x = (i % cols) * cw + 4, y = CPU_MON_TEMP_H + (i / cols) * CPU_MON_CELL_H;
+		float sw = cw - 8, sh = CPU_MON_CELL_H - 22;
+		snprintf(txt, sizeof(txt), "cpu%d  %.2f GHz  %.0f%%", c->id, f[last] / 1e6, u[last] * 100);
+		cpu_mon_text(m, s, x, y, txt);
+		gtk_snapshot_append_color(s, &track, &GRAPHENE_RECT_INIT(x, y + 16, sw, sh));
+		cpu_mon_spark(s, cs, u, 0, 1.0f, TRUE, &ucol, x, y + 16, sw, sh);
+		if (c->max_khz > 0)
+			cpu_mon_spark(s, cs, f, 0, 1.0f / c->max_khz, FALSE, &fcol, x, y + 16, sw, sh);
+	}
+}
+
+static void cpu_mon_dispose(GObject *obj) {
+	CpuMon *m = CPU_MON(obj);
+	cpu_mon_stop(m);
+	g_clear_object(&m->pl);
+	G_OBJECT_CLASS(cpu_mon_parent_class)->dispose(obj);
+}
+
+static void cpu_mon_class_init(CpuMonClass *klass) {
+	G_OBJECT_CLASS(klass)->dispose            = cpu_mon_dispose;
+	GTK_WIDGET_CLASS(klass)->snapshot         = cpu_mon_snapshot;
+	GTK_WIDGET_CLASS(klass)->measure          = cpu_mon_measure;
+	GTK_WIDGET_CLASS(klass)->get_request_mode = cpu_mon_request_mode;
+	GTK_WIDGET_CLASS(klass)->map              = cpu_mon_map;
+	GTK_WIDGET_CLASS(klass)->unmap            = cpu_mon_unmap;
+}
+
+static void cpu_mon_init(CpuMon *m) {
+	m->rate_ms = 1000;
+	m->pl      = gtk_widget_create_pango_layout(GTK_WIDGET(m), NULL);
+	PangoFontDescription *fd = pango_font_description_from_string("Sans");
+	pango_font_description_set_absolute_size(fd, 11 * PANGO_SCALE);
+	pango_layout_set_font_description(m->pl, fd);
+	pango_font_description_free(fd);
+	gtk_widget_set_hexpand(GTK_WIDGET(m), TRUE);
+}
+
+static void cpu_mon_rate_changed(GtkDropDown *dd, GParamSpec *ps, gpointer ud) {
+	guint i = gtk_drop_down_get_selected(dd);
+	if (i < G_N_ELEMENTS(cpu_mon_rates_ms)) cpu_mon_set_rate(CPU_MON(ud), cpu_mon_rates_ms[i]);
+}
+
+static GtkWidget *cpu_mon_build_section(void) {
+	GtkWidget *frame = make_section_box("CPU Activity");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+
+	GtkWidget *bar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(bar, 14); gtk_widget_set_margin_end(bar, 14);
+	gtk_widget_set_margin_top(bar, 10);   gtk_widget_set_margin_bottom(bar, 4);
+	GtkWidget *lbl = gtk_label_new("Sample every");
+	gtk_widget_add_css_class(lbl, "dim-label");
+	gtk_widget_set_hexpand(lbl, TRUE); gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(bar), lbl);
+	const char *rates[] = { "250 ms", "500 ms", "1 s", "2 s", NULL };
+	GtkWidget *dd = gtk_drop_down_new_from_strings(rates);
+	gtk_drop_down_set_selected(GTK_DROP_DOWN(dd), 2);
+	gtk_box_append(GTK_BOX(bar), dd);
+	gtk_box_append(GTK_BOX(inner), bar);
+
+	GtkWidget *mon = g_object_new(CPU_TYPE_MON, NULL);
+	gtk_widget_set_margin_start(mon, 14); gtk_widget_set_margin_end(mon, 14);
+	gtk_widget_set_margin_bottom(mon, 12);
+	gtk_box_append(GTK_BOX(inner), mon);
+	g_signal_connect(dd, "notify::selected", G_CALLBACK(cpu_mon_rate_changed), mon);
+	return frame;
+}
+
+/* ------------------------------------------------------------------ */
+/* top consumers                                                        */
+/* ------------------------------------------------------------------ */
+/* While the panel is mapped, the scanner walks /proc once every
+ * TOP_PERIOD_S seconds.  It rewinds one directory handle kept open for
+ * that time, opens each <pid>/stat and <pid>/schedstat with openat, and
+ * reads them into a single reused buffer.  Per-pid counters from the
+ * previous pass live in a hash table that only grows for new pids;
+ * stale ones are swept by generation.  Each process gets:
+ * - a CPU share: its utime+stime delta over the wall time of all CPUs.
+ * - an estimated power: while discharging, the battery draw split in
+ *   proportion to CPU time.
+ * - wakeups: the schedstat timeslice count of its main thread.  This is
+ *   re-read only for processes whose CPU time moved, because one that
+ *   ran for no ticks cannot make the list anyway.  That halves the opens
+ *   on an idle system.
+ * A pass over a busy system takes several milliseconds, so it runs on a
+ * worker thread that owns the scanner until its idle hands it back.
+ * The top TOP_N are then pushed into a GListStore by reusing a fixed
+ * pool of items, so a refresh allocates nothing and rebinds only
+ * visible rows.  The procfs root is a parameter, so the scanner can be
+ * pointed at a synthetic tree. */
+#define TOP_PERIOD_S  3
+#define TOP_N         25
+
+typedef struct {
+	guint   gen;
+	guint64 ticks, slices;
+	gint64  slices_us;             /* when slices was read */
+} TopPrev;
+
+typedef struct {
+	int    pid;
+	char   comm[32];
+	double cpu;                    /* share of all CPUs, 0..1 */
+	double wakeups;                /* per second */
+	guint64 d_ticks;
+} TopEntry;
+
+typedef struct {
+	DIR        *dir;
+	GHashTable *prev;              /* pid -> TopPrev */
+	guint       gen;
+	gint64      last_us;
+	double      hz, ncpu;
+	guint64     total_ticks;       /* sum of all deltas in the last pass */
+	GArray     *out;               /* TopEntry, sorted, at most TOP_N */
+	char        buf[1024];
+} TopScanner;
+
+static TopScanner *top_scanner_open(const char *procfs) {
+	DIR *d = opendir(procfs);
+	if (!d) return NULL;
+	TopScanner *t = g_new0(TopScanner, 1);
+	t->dir  = d;
+	t->prev = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	t->out  = g_array_sized_new(FALSE, FALSE, sizeof(TopEntry), 512);
+	t->hz   = sysconf(_SC_CLK_TCK);
+	t->ncpu = g_get_num_processors();
+	return t;
+}
+
+static void top_scanner_close(TopScanner *t) {
+	if (!t) return;
+	closedir(t->dir);
+	g_hash_table_unref(t->prev);
+	g_array_unref(t->out);
+	g_free(t);
+}
+
+static ssize_t top_read_at(TopScanner *t, int dfd, const char *pid, const char *file) {
+	char path[64];
+	snprintf(path, sizeof(path), "%s/%s", pid, file);
+	int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+	ssize_t n = read(fd, t->buf, sizeof(t->buf) - 1);
+	close(fd);
+	t->buf[MAX(n, 0)] = '\0';
+	return n;
+}
+
+static gboolean top_remove_stale(gpointer k, gpointer v, gpointer ud) {
+	return ((TopPrev *)v)->gen != GPOINTER_TO_UINT(ud);
+}
+
+static int top_entry_cmp(const void *a, const void *b) {
+	guint64 x = ((const TopEntry *)a)->d_ticks, y = ((const TopEntry *)b)->d_ticks;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void top_scan(TopScanner *t) {
+	gint64 now = g_get_monotonic_time();
+	double dt = t->last_us ? (now - t->last_us) / (double)G_USEC_PER_SEC : 0;
+	t->last_us = now;
+	t->gen++;
+	t->total_ticks = 0;
+	g_array_set_size(t->out, 0);
+	rewinddir(t->dir);
+	int dfd = dirfd(t->dir);
+	struct dirent *de;
+	while ((de = readdir(t->dir))) {
+		if (!g_ascii_isdigit(de->d_name[0])) continue;
+		if (top_read_at(t, dfd, de->d_name, "stat") <= 0) continue;
+		/* comm may hold spaces and parens; the fields resume after the last ')' */
+		char *lp = strchr(t->buf, '('), *rp = strrchr(t->buf, ')');
+		if (!lp || !rp || rp[1] != ' ') continue;
+		TopEntry e = { .pid = atoi(de->d_name) };
+		g_strlcpy(e.comm, lp + 1, MIN((size_t)(rp - lp), sizeof(e.comm)));
+		char *p = rp + 2;
+		for (int k = 0; k < 11 && p; k++) { p = strchr(p, ' '); if (p) p++; }   /* to utime */
+		if (!p) continue;
+		guint64 ticks = g_ascii_strtoull(p, &p, 10);
+		ticks += g_ascii_strtoull(p, &p, 10);
+
+		TopPrev *pv = g_hash_table_lookup(t->prev, GINT_TO_POINTER(e.pid));
+		gboolean fresh = !pv;
+		if (fresh) {
+			pv = g_new0(TopPrev, 1);
+			g_hash_table_insert(t->prev, GINT_TO_POINTER(e.pid), pv);
+		}
+		if ((fresh || ticks != pv->ticks) && top_read_at(t, dfd, de->d_name, "schedstat") > 0) {
+			char *q = t->buf;
+			g_ascii_strtoull(q, &q, 10); g_ascii_strtoull(q, &q, 10);
+			guint64 slices = g_ascii_strtoull(q, NULL, 10);
+			if (!fresh && pv->slices_us && slices >= pv->slices)
+				e.wakeups = (slices - pv->slices) * (double)G_USEC_PER_SEC / (now - pv->slices_us);
+			pv->slices = slices; pv->slices_us = now;
+		}
+		if (!fresh && dt > 0 && ticks > pv->ticks) {            /* a reused pid goes backwards */
+			e.d_ticks = ticks - pv->ticks;
+			e.cpu     = e.d_ticks / (t->hz * dt * t->ncpu);
+			t->total_ticks += e.d_ticks;
+			g_array_append_val(t->out, e);
+		}
+		pv->gen = t->gen; pv->ticks = ticks;
+	}
+	g_hash_table_foreach_remove(t->prev, top_remove_stale, GUINT_TO_POINTER(t->gen));
+	g_array_sort(t->out, top_entry_cmp);
+	if (t->out->len > TOP_N) g_array_set_size(t->out, TOP_N);
+}
+
+#define TOP_TYPE_ITEM (top_item_get_type())
+G_DECLARE_FINAL_TYPE(TopItem, top_item, TOP, ITEM, GObject)
+
+struct _TopItem {
+	GObject  parent_instance;
+	TopEntry e;
+	double   watts;                /* < 0 when unknown */
+};
+
+G_DEFINE_FINAL_TYPE(TopItem, top_item, G_TYPE_OBJECT)
+static void top_item_class_init(TopItemClass *klass) {}
+static void top_item_init(TopItem *it) {}
+
+/* Shared with the scan threads; the panel's half is gone once dead. */
+typedef struct {
+	const char *procfs;
+	TopScanner *t;                 /* NULL while a scan has it */
+	GListStore *store;
+	TopItem    *pool[TOP_N];
+	guint       timer;
+	guint       seq;               /* bumped on unmap; older scans are dropped */
+	gboolean    scanning, dead;
+	GtkWidget  *note;
+} TopPanel;
+
+typedef struct {
+	TopPanel   *tp;                /* ref held */
+	TopScanner *t;
+	guint       seq;
+	gboolean    baseline;          /* first pass: nothing to show yet */
+} TopScan;
+
+/* Battery draw in watts while discharging, from the latest history sample. */
+static double top_discharge_watts(void) {
+	if (!bat_hist.hdr || !bat_hist.hdr->head) return -1;
+	const BatSample *s = &bat_hist.ring[(bat_hist.hdr->head - 1) % BAT_HIST_CAP];
+	return s->status == BS_DISCHARGING && s->power_mw < 0 ? -s->power_mw / 1000.0 : -1;
+}
+
+static void top_publish(TopPanel *tp) {
+	double w = top_discharge_watts();
+	guint n = tp->t->out->len;
+	for (guint i = 0; i < n; i++) {
+		TopItem *it = tp->pool[i];
+		it->e     = g_array_index(tp->t->out, TopEntry, i);
+		it->watts = w >= 0 && tp->t->total_ticks ? w * it->e.d_ticks / tp->t->total_ticks : -1;
+	}
+	g_list_store_splice(tp->store, 0, g_list_model_get_n_items(G_LIST_MODEL(tp->store)),
+			    (gpointer *)tp->pool, n);
+	gtk_label_set_text(GTK_LABEL(tp->note), w >= 0
+		? "CPU time over the last few seconds. Power is the battery draw split by CPU time."
+		: "CPU time over the last few seconds. Power estimates need the battery to be discharging.");
+}
+
+static void top_scan_free(gpointer ud) {
+	TopScan *job = ud;
+	top_scanner_close(job->t);                  /* unless handed back */
+	g_atomic_rc_box_release(job->tp);
+	g_free(job);
+}
+
+static gboolean top_scan_idle(gpointer ud) {
+	TopScan *job = ud;
+	TopPanel *tp = job->tp;
+	if (tp->dead || job->seq != tp->seq) return G_SOURCE_REMOVE;
+	tp->scanning = FALSE;
+	tp->t = job->t; job->t = NULL;
+	if (!job->baseline) top_publish(tp);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer top_scan_thread(gpointer ud) {
+	TopScan *job = ud;
+	top_scan(job->t);
+	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, top_scan_idle, job, top_scan_free);
+	return NULL;
+}
+
+static void top_scan_start(TopPanel *tp, gboolean baseline) {
+	TopScan *job = g_new0(TopScan, 1);
+	job->tp       = g_atomic_rc_box_acquire(tp);
+	job->t        = tp->t; tp->t = NULL;
+	job->seq      = tp->seq;
+	job->baseline = baseline;
+	tp->scanning  = TRUE;
+	g_thread_unref(g_thread_new("top-scan", top_scan_thread, job));
+}
+
+/* a slow pass skips a tick rather than queueing behind itself */
+static gboolean top_tick(gpointer ud) {
+	TopPanel *tp = ud;
+	if (!tp->scanning && tp->t) top_scan_start(tp, FALSE);
+	return G_SOURCE_CONTINUE;
+}
+
+static void top_map(GtkWidget *w, gpointer ud) {
+	TopPanel *tp = ud;
+	if (tp->timer || !(tp->t = top_scanner_open(tp->procfs))) return;
+	top_scan_start(tp, TRUE);
+	tp->timer = g_timeout_add_seconds(TOP_PERIOD_S, top_tick, tp);
+}
+
+static void top_unmap(GtkWidget *w, gpointer ud) {
+	TopPanel *tp = ud;
+	if (tp->timer) { g_source_remove(tp->timer); tp->timer = 0; }
+	tp->seq++;
+	tp->scanning = FALSE;
+	g_clear_pointer(&tp->t, top_scanner_close);
+}
+
+static void top_panel_free(gpointer ud) {
+	TopPanel *tp = ud;
+	top_unmap(NULL, tp);
+	tp->dead = TRUE;
+	for (int i = 0; i < TOP_N; i++) g_object_unref(tp->pool[i]);
+	g_object_unref(tp->store);
+	g_atomic_rc_box_release(tp);
+}
+
+static GtkWidget *top_row_label(GtkWidget *row, int chars, gboolean dim) {
+	GtkWidget *l = gtk_label_new(NULL);
+	gtk_label_set_width_chars(GTK_LABEL(l), chars);
+	gtk_label_set_xalign(GTK_LABEL(l), 1.0f);
+	if (dim) gtk_widget_add_css_class(l, "dim-label");
+	gtk_box_append(GTK_BOX(row), l);
+	return l;
+}
+
+/* name, pid, CPU, power, wakeups; shared by the header and the rows */
+static GtkWidget *top_row_new(void) {
+	GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	GtkWidget *name = gtk_label_new(NULL);
+	gtk_label_set_xalign(GTK_LABEL(name), 0.0f);
+	gtk_label_set_ellipsize(GTK_LABEL(name), PANGO_ELLIPSIZE_END);
+	gtk_widget_set_hexpand(name, TRUE);
+	gtk_box_append(GTK_BOX(row), name);
+	top_row_label(row, 7, TRUE);
+	top_row_label(row, 7, FALSE);
+	top_row_label(row, 8, FALSE);
+	top_row_label(row, 9, FALSE);
+	return row;
+}
+
+static void top_row_set(GtkWidget *row, const char *name, const char *pid, const char *cpu,
+			const char *watts, const char *wake) {
+	const char *v[] = { name, pid, cpu, watts, wake };
+	int i = 0;
+	for (GtkWidget *c = gtk_widget_get_first_child(row); c && i < 5; c = gtk_widget_get_next_sibling(c))
+		gtk_label_set_text(GTK_LABEL(c), v[i++]);
+}
+
+static void top_setup_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	gtk_list_item_set_child(li, top_row_new());
+}
+
+static void top_bind_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	TopItem *it = gtk_list_item_get_item(li);
+	char pid[16], cpu[16], watts[16], wake[16];
+	snprintf(pid, sizeof(pid), "%d", it->e.pid);
+	snprintf(cpu, sizeof(cpu), "%.1f%%", it->e.cpu * 100);
+	if (it->watts >= 0) snprintf(watts, sizeof(watts), "%.2f W", it->watts);
+	else g_strlcpy(watts, "—", sizeof(watts));
+	snprintf(wake, sizeof(wake), "%.0f/s", it->e.wakeups);
+	top_row_set(gtk_list_item_get_child(li), it->e.comm, pid, cpu, watts, wake);
+}
+
+static GtkWidget *top_build_section(void) {
+	GtkWidget *frame = make_section_box("Top Consumers");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+	TopPanel *tp = g_atomic_rc_box_new0(TopPanel);
+	tp->procfs = "/proc";
+	tp->store = g_list_store_new(TOP_TYPE_ITEM);
+	for (int i = 0; i < TOP_N; i++) tp->pool[i] = g_object_new(TOP_TYPE_ITEM, NULL);
+
+	GtkWidget *hdr = top_row_new();
+	top_row_set(hdr, "Process", "PID", "CPU", "Power", "Wakeups");
+	for (GtkWidget *c = gtk_widget_get_first_child(hdr); c; c = gtk_widget_get_next_sibling(c))
+		gtk_widget_add_css_class(c, "caption-heading");
+	gtk_widget_set_margin_start(hdr, 20); gtk_widget_set_margin_end(hdr, 20);
+	gtk_widget_set_margin_top(hdr, 10);   gtk_widget_set_margin_bottom(hdr, 4);
+	gtk_box_append(GTK_BOX(inner), hdr);
+
+	GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+	g_signal_connect(factory, "setup", G_CALLBACK(top_setup_cb), NULL);
+	g_signal_connect(factory, "bind",  G_CALLBACK(top_bind_cb),  NULL);
+	GtkWidget *list = gtk_list_view_new(
+		GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(g_object_ref(tp->store)))), factory);
+	gtk_widget_add_css_class(list, "navigation-sidebar");
+	GtkWidget *sw = gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(sw), 240);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(sw), list);
+	gtk_widget_set_margin_start(sw, 8); gtk_widget_set_margin_end(sw, 8);
+	gtk_box_append(GTK_BOX(inner), sw);
+
+	tp->note = gtk_label_new("Measuring…");
+	gtk_widget_add_css_class(tp->note, "dim-label"); gtk_widget_add_css_class(tp->note, "caption");
+	gtk_label_set_wrap(GTK_LABEL(tp->note), TRUE);
+	gtk_label_set_xalign(GTK_LABEL(tp->note), 0.0f);
+	gtk_widget_set_margin_start(tp->note, 14); gtk_widget_set_margin_end(tp->note, 14);
+	gtk_widget_set_margin_top(tp->note, 6);    gtk_widget_set_margin_bottom(tp->note, 12);
+	gtk_box_append(GTK_BOX(inner), tp->note);
+
+	g_signal_connect(sw, "map",   G_CALLBACK(top_map),   tp);
+	g_signal_connect(sw, "unmap", G_CALLBACK(top_unmap), tp);
+	g_object_set_data_full(G_OBJECT(frame), "top-panel", tp, top_panel_free);
+	return frame;
+}
+
 GtkWidget *battery_settings(void) {
 	BatData *bd = g_new0(BatData, 1);
+	bd->nl_fd = bd->gov_fd = bd->epp_fd = -1;
+	for (int i = 0; i < BA_N; i++) bd->fd[i] = -1;
+	bd->sysfs = BAT_SYSFS;
 	GtkWidget *root = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
 	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
 	gtk_box_append(GTK_BOX(root), make_page_header("battery-symbolic","Battery"));
@@ -1649,6 +2875,7 @@ GtkWidget *battery_settings(void) {
 	gtk_grid_attach(GTK_GRID(grid),bd->card_temp,   2,1,1,1);
 	gtk_box_append(GTK_BOX(box1),grid);
 	gtk_box_append(GTK_BOX(content),box1_frame);
+	gtk_box_append(GTK_BOX(content),bat_hist_build_section());
 	/* power mode */
 	GtkWidget *box2_frame = make_section_box("Power Mode");
 	GtkWidget *box2 = g_object_get_data(G_OBJECT(box2_frame),"inner-box");
@@ -1656,16 +2883,26 @@ GtkWidget *battery_settings(void) {
 	gtk_widget_set_halign(gov_row,GTK_ALIGN_CENTER);
 	gtk_widget_set_margin_start(gov_row,16); gtk_widget_set_margin_end(gov_row,16);
 	gtk_widget_set_margin_top(gov_row,14);   gtk_widget_set_margin_bottom(gov_row,14);
-	bd->gov_performance = make_gov_btn("starred-symbolic","Performance","Max CPU frequency","performance");
-	bd->gov_balanced    = make_gov_btn("battery-good-symbolic","Balanced","Speed and efficiency","balanced");
-	bd->gov_powersave   = make_gov_btn("battery-low-symbolic","Power Saver","Extend battery life","powersave");
+	bd->gov_performance = make_gov_btn(bd,"starred-symbolic","Performance","Max CPU frequency","performance");
+	bd->gov_balanced    = make_gov_btn(bd,"battery-good-symbolic","Balanced","Speed and efficiency","balanced");
+	bd->gov_powersave   = make_gov_btn(bd,"battery-low-symbolic","Power Saver","Extend battery life","powersave");
 	gtk_box_append(GTK_BOX(gov_row),bd->gov_performance);
 	gtk_box_append(GTK_BOX(gov_row),bd->gov_balanced);
 	gtk_box_append(GTK_BOX(gov_row),bd->gov_powersave);
 	gtk_box_append(GTK_BOX(box2),gov_row);
+	bd->gov_status = gtk_label_new("");
+	gtk_widget_add_css_class(bd->gov_status,"dim-label"); gtk_widget_add_css_class(bd->gov_status,"caption");
+	gtk_label_set_wrap(GTK_LABEL(bd->gov_status),TRUE);
+	gtk_widget_set_margin_start(bd->gov_status,16); gtk_widget_set_margin_end(bd->gov_status,16);
+	gtk_widget_set_margin_bottom(bd->gov_status,12);
+	gtk_box_append(GTK_BOX(box2),bd->gov_status);
 	gtk_box_append(GTK_BOX(content),box2_frame);
-	bat_read_and_update(bd);
-	bd->timer_id = g_timeout_add_seconds(5,bat_timer_cb,bd);
+	gtk_box_append(GTK_BOX(content),cpu_mon_build_section());
+	gtk_box_append(GTK_BOX(content),top_build_section());
+	bat_open(bd);
+	bat_uevent_open(bd);
+	g_signal_connect(root,"map",G_CALLBACK(bat_page_map),bd);
+	g_signal_connect(root,"unmap",G_CALLBACK(bat_page_unmap),bd);
 	g_signal_connect(root,"destroy",G_CALLBACK(bat_page_destroyed),bd);
 	return root;
 }
@@ -1673,6 +2910,18 @@ GtkWidget *battery_settings(void) {
 /* ================================================================== */
 /* Displays                                                             */
 /* ================================================================== */
+/* Monitor identity parsed from the 128-byte EDID base block */
+typedef struct {
+	gboolean valid;
+	char     vendor[4], model[16], serial[16];
+	guint16  product;
+	guint32  serial_num;
+	int      mm_w, mm_h;               /* physical size */
+	int      pref_w, pref_h;           /* preferred detailed timing */
+	double   pref_rr;
+	char     key[17];                  /* stable hash, hex */
+} DispEdid;
+
 typedef struct {
 	char name[64], label[64];
 	int  x, y, w, h;
@@ -1680,10 +2929,11 @@ typedef struct {
 	gboolean primary, connected, active;
 	char   **modes;
 	int      n_modes, cur_mode_idx;
+	DispEdid edid;
 } DispMonitor;
 
 typedef struct {
-	GtkWidget   *root, *canvas, *detail_box, *mon_stack;
+	GtkWidget   *root, *body, *canvas, *detail_box, *mon_stack;
 	GtkWidget  **tab_btns;
 	DispMonitor *monitors;
 	int          n_monitors, selected;
@@ -1693,8 +2943,9 @@ typedef struct {
 static void     disp_select_monitor(DispData *dd, int idx);
 static void     disp_set_primary(GtkWidget *btn, gpointer ud);
 static void     disp_apply(GtkWidget *btn, gpointer ud);
-static void     disp_canvas_draw(GtkDrawingArea *da, cairo_t *cr, int w, int h, gpointer ud);
-static void     disp_canvas_click(GtkGestureClick *gc, int n_press, double ex, double ey, gpointer ud);
+static void     disp_profile_save(DispData *dd);
+static void     disp_pages_reload(void);
+static void     disp_pos_resync(DispData *dd);
 static void     updates_apply_single(GtkWidget *btn, gpointer ud);
 
 static void disp_free_monitors(DispMonitor *m, int n) {
@@ -1703,6 +2954,8 @@ static void disp_free_monitors(DispMonitor *m, int n) {
 	g_free(m);
 }
 
+static void disp_identify_monitors(DispMonitor *mons, int n);
+
 static DispMonitor *disp_parse_xrandr(int *out_n) {
 	char *raw = run_cmd_str("xrandr --query 2>/dev/null");
 	char **lines = g_strsplit(raw, "\n", -1);
@@ -1757,20 +3010,227 @@ static DispMonitor *disp_parse_xrandr(int *out_n) {
 			}
 		}
 	}
-	g_strfreev(lines); *out_n=n; return mons;
+	g_strfreev(lines);
+	disp_identify_monitors(mons, n);
+	*out_n=n; return mons;
 }
 
+/* ------------------------------------------------------------------ */
+/* EDID identification                                                  */
+/* ------------------------------------------------------------------ */
+static void disp_edid_text(const guint8 *d, char *out, size_t sz) {
+	size_t n = 0;
+	for (int i = 5; i < 18 && d[i] != 0x0a && n + 1 < sz; i++)
+		out[n++] = (d[i] >= 0x20 && d[i] < 0x7f) ? (char)d[i] : '?';
+	out[n] = '\0';
+	g_strchomp(out);
+}
+
+static gboolean disp_edid_parse(const guint8 *b, gsize len, DispEdid *e) {
+	static const guint8 hdr[8] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+	memset(e, 0, sizeof(*e));
+	if (len < 128 || memcmp(b, hdr, sizeof(hdr)) != 0) return FALSE;
+	guint8 sum = 0;
+	for (int i = 0; i < 128; i++) sum += b[i];
+	if (sum != 0) return FALSE;
+
+	guint16 v = (guint16)(b[8] << 8 | b[9]);
+	e->vendor[0] = '@' + ((v >> 10) & 0x1f);
+	e->vendor[1] = '@' + ((v >> 5) & 0x1f);
+	e->vendor[2] = '@' + (v & 0x1f);
+	e->product    = (guint16)(b[10] | b[11] << 8);
+	e->serial_num = (guint32)b[12] | (guint32)b[13] << 8 | (guint32)b[14] << 16 | (guint32)b[15] << 24;
+	e->mm_w = b[21] * 10;
+	e->mm_h = b[22] * 10;
+
+	for (int off = 54; off <= 108; off += 18) {
+		const guint8 *d = b + off;
+		int clock = d[0] | d[1] << 8;              /* 10 kHz units */
+		if (clock) {
+			if (e->pref_w) continue;               /* first timing is preferred */
+			int ha = d[2] | (d[4] & 0xf0) << 4, hb = d[3] | (d[4] & 0x0f) << 8;
+			int va = d[5] | (d[7] & 0xf0) << 4, vb = d[6] | (d[7] & 0x0f) << 8;
+			e->pref_w = ha; e->pref_h = va;
+			if ((ha + hb) && (va + vb))
+				e->pref_rr = clock * 10000.0 / ((double)(ha + hb) * (va + vb));
+			int hmm = d[12] | (d[14] & 0xf0) << 4, vmm = d[13] | (d[14] & 0x0f) << 8;
+			if (hmm && vmm) { e->mm_w = hmm; e->mm_h = vmm; }
+		} else if (d[3] == 0xfc) {
+			disp_edid_text(d, e->model, sizeof(e->model));
+		} else if (d[3] == 0xff) {
+			disp_edid_text(d, e->serial, sizeof(e->serial));
+		}
+	}
+	if (!e->serial[0] && e->serial_num)
+		snprintf(e->serial, sizeof(e->serial), "%u", e->serial_num);
+
+	/* FNV-1a over the base block — independent of the port it is plugged into */
+	guint64 h = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 128; i++) { h ^= b[i]; h *= 0x100000001b3ULL; }
+	snprintf(e->key, sizeof(e->key), "%016" G_GINT64_MODIFIER "x", h);
+	e->valid = TRUE;
+	return TRUE;
+}
 
-/* ================================================================== */
-/* DISPLAY CANVAS - FIXED VERSION                                      */
-/* Key fixes:                                                          */
-/*  1. Inactive monitors placed right of active ones in canvas layout  */
-/*  2. All monitors use the SAME reference resolution for the canvas   */
-/*     so they appear at equal visual size (proportional to resolution)*/
-/*  3. Centering uses geometric center of each monitor rectangle       */
-/* ================================================================== */
+/* "card0-HDMI-A-1" / "HDMI-1" → "HDMI1", "card1-DP-2" → "DP2" */
+static void disp_connector_norm(const char *name, char *out, size_t sz) {
+	static const struct { const char *from, *to; } aliases[] = {
+		{ "HDMIA", "HDMI" }, { "HDMIB", "HDMI" },
+		{ "DVII",  "DVI"  }, { "DVID",  "DVI"  },
+		{ "DISPLAYPORT", "DP" },
+	};
+	if (g_str_has_prefix(name, "card")) {
+		const char *dash = strchr(name, '-');
+		if (dash) name = dash + 1;
+	}
+	size_t n = 0;
+	for (const char *p = name; *p && n + 1 < sz; p++)
+		if (g_ascii_isalnum(*p)) out[n++] = g_ascii_toupper(*p);
+	out[n] = '\0';
+	for (size_t i = 0; i < G_N_ELEMENTS(aliases); i++) {
+		size_t fl = strlen(aliases[i].from), tl = strlen(aliases[i].to);
+		if (strncmp(out, aliases[i].from, fl) != 0) continue;
+		memmove(out + tl, out + fl, strlen(out + fl) + 1);
+		memcpy(out, aliases[i].to, tl);
+		break;
+	}
+}
 
-/* Helper: get effective width/height for canvas (placeholder if off) */
+/* EDID from the RandR output property; works on any driver that exposes it */
+static gboolean disp_edid_read_output(Display *xd, RROutput out, Atom edid_atom, DispEdid *e) {
+	Atom type; int fmt; unsigned long nitems, after;
+	unsigned char *prop = NULL;
+	gboolean ok = FALSE;
+	if (XRRGetOutputProperty(xd, out, edid_atom, 0, 64, False, False,
+				 AnyPropertyType, &type, &fmt, &nitems, &after, &prop) == Success
+	    && prop && fmt == 8)
+		ok = disp_edid_parse(prop, nitems, e);
+	if (prop) XFree(prop);
+	return ok;
+}
+
+static gboolean disp_edid_from_randr(Display *xd, XRRScreenResources *res, Atom edid_atom,
+				     const char *output, DispEdid *e) {
+	gboolean ok = FALSE;
+	if (!res || edid_atom == None) return FALSE;
+	for (int i = 0; i < res->noutput && !ok; i++) {
+		XRROutputInfo *oi = XRRGetOutputInfo(xd, res, res->outputs[i]);
+		if (!oi) continue;
+		if (strcmp(oi->name, output) == 0)
+			ok = disp_edid_read_output(xd, res->outputs[i], edid_atom, e);
+		XRRFreeOutputInfo(oi);
+	}
+	return ok;
+}
+
+/* DRM connector object id of an output, from the CONNECTOR_ID property
+ * the modesetting and amdgpu drivers set; 0 when the driver has none. */
+static long disp_output_conn_id(Display *xd, RROutput out) {
+	Atom atom = XInternAtom(xd, "CONNECTOR_ID", True), type;
+	int fmt; unsigned long nitems, after;
+	unsigned char *prop = NULL;
+	long id = 0;
+	if (atom != None &&
+	    XRRGetOutputProperty(xd, out, atom, 0, 1, False, False, AnyPropertyType,
+				 &type, &fmt, &nitems, &after, &prop) == Success
+	    && prop && fmt == 32 && nitems == 1)
+		id = *(long *)prop;
+	if (prop) XFree(prop);
+	return id;
+}
+
+static long disp_output_conn_id_by_name(Display *xd, XRRScreenResources *res, const char *output) {
+	long id = 0;
+	for (int i = 0; res && i < res->noutput && !id; i++) {
+		XRROutputInfo *oi = XRRGetOutputInfo(xd, res, res->outputs[i]);
+		if (!oi) continue;
+		if (strcmp(oi->name, output) == 0) id = disp_output_conn_id(xd, res->outputs[i]);
+		XRRFreeOutputInfo(oi);
+	}
+	return id;
+}
+
+#define DISP_DRM_DIR "/sys/class/drm"
+
+/* Connector names repeat across GPUs (card0-HDMI-A-1, card1-HDMI-A-1),
+ * so the name alone can match one connector per card.  conn_id, when
+ * the driver exposes it, picks the card whose connector_id agrees;
+ * without it, an output matching more than one connector with an EDID
+ * is left unidentified rather than given another monitor's identity. */
+static gboolean disp_edid_from_sysfs(const char *drm_dir, const char *output, long conn_id,
+				     DispEdid *e) {
+	char want[64]; disp_connector_norm(output, want, sizeof(want));
+	DIR *dir = opendir(drm_dir);
+	if (!dir) return FALSE;
+	int found = 0;
+	struct dirent *de;
+	while ((de = readdir(dir))) {
+		if (!g_str_has_prefix(de->d_name, "card") || !strchr(de->d_name, '-')) continue;
+		char have[64]; disp_connector_norm(de->d_name, have, sizeof(have));
+		if (strcmp(have, want) != 0) continue;
+		char path[PATH_MAX]; gchar *buf = NULL; gsize len = 0;
+		if (conn_id > 0) {
+			snprintf(path, sizeof(path), "%s/%s/connector_id", drm_dir, de->d_name);
+			if (!g_file_get_contents(path, &buf, NULL, NULL)) continue;
+			gboolean same = g_ascii_strtoll(buf, NULL, 10) == conn_id;
+			g_free(buf); buf = NULL;
+			if (!same) continue;
+		}
+		DispEdid cand;
+		snprintf(path, sizeof(path), "%s/%s/edid", drm_dir, de->d_name);
+		if (g_file_get_contents(path, &buf, &len, NULL) &&
+		    disp_edid_parse((const guint8 *)buf, len, &cand)) {
+			if (!found) { *e = cand; found = 1; }
+			else if (strcmp(cand.key, e->key) != 0) found++;
+		}
+		g_free(buf);
+		if (found && conn_id > 0) break;
+	}
+	closedir(dir);
+	if (found != 1) memset(e, 0, sizeof(*e));
+	return found == 1;
+}
+
+/* Attach EDID identity to each connected monitor and derive labels from
+ * it; identical panels get their serial (or port) appended. */
+static void disp_identify_monitors(DispMonitor *mons, int n) {
+	GdkDisplay *gd = gdk_display_get_default();
+	Display    *xd = (gd && GDK_IS_X11_DISPLAY(gd)) ? gdk_x11_display_get_xdisplay(gd) : NULL;
+	XRRScreenResources *res = xd ? XRRGetScreenResourcesCurrent(xd, DefaultRootWindow(xd)) : NULL;
+	Atom edid_atom = xd ? XInternAtom(xd, RR_PROPERTY_RANDR_EDID, True) : None;
+	for (int i = 0; i < n; i++) {
+		DispMonitor *m = &mons[i];
+		if (!disp_edid_from_randr(xd, res, edid_atom, m->name, &m->edid))
+			disp_edid_from_sysfs(DISP_DRM_DIR, m->name,
+					     xd ? disp_output_conn_id_by_name(xd, res, m->name) : 0, &m->edid);
+		if (m->edid.valid && m->edid.model[0])
+			snprintf(m->label, sizeof(m->label), "%s", m->edid.model);
+	}
+	if (res) XRRFreeScreenResources(res);
+	gboolean *dup = g_new0(gboolean, MAX(n, 1));
+	for (int i = 0; i < n; i++)
+		for (int j = i + 1; j < n; j++)
+			if (strcmp(mons[i].label, mons[j].label) == 0) dup[i] = dup[j] = TRUE;
+	for (int i = 0; i < n; i++) {
+		if (!dup[i]) continue;
+		char base[64]; snprintf(base, sizeof(base), "%s", mons[i].label);
+		snprintf(mons[i].label, sizeof(mons[i].label), "%s (%s)", base,
+			 mons[i].edid.serial[0] ? mons[i].edid.serial : mons[i].name);
+	}
+	g_free(dup);
+}
+
+
+/* ================================================================== */
+/* DISPLAY CANVAS - FIXED VERSION                                      */
+/* Key fixes:                                                          */
+/*  1. Inactive monitors placed right of active ones in canvas layout  */
+/*  2. All monitors use the SAME reference resolution for the canvas   */
+/*     so they appear at equal visual size (proportional to resolution)*/
+/*  3. Centering uses geometric center of each monitor rectangle       */
+/* ================================================================== */
+
+/* Helper: get effective width/height for canvas (placeholder if off) */
 static void disp_eff_size(DispMonitor *m, int *ew, int *eh) {
 	if (m->active) {
 		*ew = m->w > 0 ? m->w : 1920;
@@ -1809,173 +3269,301 @@ static void disp_normalize_coords(DispData *dd) {
 	}
 }
 
-static void disp_layout_inactive(DispData *dd) {
-	/* Inactive monitors are only shown in tabs, NOT in the canvas.
-	 * We normalize active monitor coordinates so they always start at 0,0. */
-	disp_normalize_coords(dd);
+/* ------------------------------------------------------------------ */
+/* DispCanvas — arrangement widget                                      */
+/* Layout (scale, offset, per-monitor rects and text layouts) is cached */
+/* and only rebuilt when the model or the widget size changes; the      */
+/* snapshot just replays render nodes from the cache.  Dragging moves   */
+/* one cached rect, so a drag costs no relayout at all.                 */
+/* ------------------------------------------------------------------ */
+#define DISP_CANVAS_PAD  28.0
+#define DISP_SNAP_PX     12.0
+
+typedef struct {
+	graphene_rect_t rect;
+	PangoLayout    *num, *label, *badge;
+} DispCanvasItem;
+
+#define DISP_TYPE_CANVAS (disp_canvas_get_type())
+G_DECLARE_FINAL_TYPE(DispCanvas, disp_canvas, DISP, CANVAS, GtkWidget)
+
+struct _DispCanvas {
+	GtkWidget       parent_instance;
+	DispData       *dd;
+	DispCanvasItem *items;
+	int             n_items, cache_w, cache_h;
+	double          scale, off_x, off_y;
+	gboolean        valid, empty;
+	PangoLayout    *empty_msg;
+	/* drag state */
+	int             drag_idx, drag_x0, drag_y0;
+};
+
+G_DEFINE_FINAL_TYPE(DispCanvas, disp_canvas, GTK_TYPE_WIDGET)
+
+static void disp_canvas_clear_items(DispCanvas *dc) {
+	for (int i = 0; i < dc->n_items; i++) {
+		g_clear_object(&dc->items[i].num);
+		g_clear_object(&dc->items[i].label);
+		g_clear_object(&dc->items[i].badge);
+	}
+	g_clear_pointer(&dc->items, g_free);
+	dc->n_items = 0;
 }
 
-static void disp_canvas_draw_v2(GtkDrawingArea *da, cairo_t *cr,
-				int w, int h, gpointer ud) {
-	DispData *dd = ud;
-	if (!dd || dd->n_monitors == 0) return;
+static PangoLayout *disp_canvas_text(DispCanvas *dc, const char *txt,
+				     double px, gboolean bold) {
+	PangoLayout *pl = gtk_widget_create_pango_layout(GTK_WIDGET(dc), txt);
+	PangoFontDescription *fd = pango_font_description_from_string("Sans");
+	pango_font_description_set_absolute_size(fd, MAX(px, 1.0) * PANGO_SCALE);
+	pango_font_description_set_weight(fd, bold ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL);
+	pango_layout_set_font_description(pl, fd);
+	pango_font_description_free(fd);
+	return pl;
+}
 
-	/* Layout inactive monitors into canvas space first */
-	disp_layout_inactive(dd);
+static void disp_canvas_item_rect(DispCanvas *dc, int i) {
+	DispMonitor *m = &dc->dd->monitors[i];
+	int ew, eh; disp_eff_size(m, &ew, &eh);
+	graphene_rect_init(&dc->items[i].rect,
+			   dc->off_x + m->x * dc->scale, dc->off_y + m->y * dc->scale,
+			   ew * dc->scale, eh * dc->scale);
+}
+
+static void disp_canvas_relayout(DispCanvas *dc) {
+	DispData *dd = dc->dd;
+	int w = gtk_widget_get_width(GTK_WIDGET(dc));
+	int h = gtk_widget_get_height(GTK_WIDGET(dc));
+
+	disp_canvas_clear_items(dc);
+	dc->cache_w = w; dc->cache_h = h;
+	dc->valid = TRUE;
+	if (!dd) return;
+
+	/* never shift the coordinate frame under the pointer mid-drag */
+	if (dc->drag_idx < 0) disp_normalize_coords(dd);
 
-	/* Compute bounding box of all visible monitors */
-	int total_w = 0, total_h = 0;
+	int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
 	for (int i = 0; i < dd->n_monitors; i++) {
 		DispMonitor *m = &dd->monitors[i];
+		if (!m->active) continue;
 		int ew, eh; disp_eff_size(m, &ew, &eh);
-		if (ew == 0) continue;
-		if (m->x + ew > total_w) total_w = m->x + ew;
-		if (m->y + eh > total_h) total_h = m->y + eh;
-	}
-	if (total_w == 0 || total_h == 0) {
-		/* All monitors inactive — show message */
-		cairo_set_source_rgba(cr, 0, 0, 0, 0.35);
-		cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-		cairo_set_font_size(cr, 14.0);
-		const char *msg = "All displays are off";
-		cairo_text_extents_t te;
-		cairo_text_extents(cr, msg, &te);
-		cairo_move_to(cr, w/2.0 - te.width/2.0 - te.x_bearing,
-			      h/2.0 - te.height/2.0 - te.y_bearing);
-		cairo_show_text(cr, msg);
+		min_x = MIN(min_x, m->x);      min_y = MIN(min_y, m->y);
+		max_x = MAX(max_x, m->x + ew); max_y = MAX(max_y, m->y + eh);
+	}
+	dc->empty = (min_x == INT_MAX);
+	if (dc->empty) {
+		if (!dc->empty_msg)
+			dc->empty_msg = disp_canvas_text(dc, "All displays are off", 14.0, FALSE);
 		return;
 	}
 
-	double pad = 28.0;
-	double scale = MIN((w - pad * 2) / (double)total_w,
-			   (h - pad * 2) / (double)total_h);
-	double off_x = (w - total_w * scale) / 2.0;
-	double off_y = (h - total_h * scale) / 2.0;
-
-	static const double cols[][3] = {
-		{ 0.21, 0.52, 0.89 },
-		{ 0.18, 0.64, 0.47 },
-		{ 0.75, 0.36, 0.20 },
-		{ 0.56, 0.27, 0.68 },
-	};
+	int total_w = max_x - min_x, total_h = max_y - min_y;
+	dc->scale = MIN((w - DISP_CANVAS_PAD * 2) / (double)total_w,
+			(h - DISP_CANVAS_PAD * 2) / (double)total_h);
+	if (dc->scale <= 0) dc->scale = 0.01;
+	dc->off_x = (w - total_w * dc->scale) / 2.0 - min_x * dc->scale;
+	dc->off_y = (h - total_h * dc->scale) / 2.0 - min_y * dc->scale;
 
+	dc->n_items = dd->n_monitors;
+	dc->items   = g_new0(DispCanvasItem, dc->n_items);
 	for (int i = 0; i < dd->n_monitors; i++) {
 		DispMonitor *m = &dd->monitors[i];
-		int ew, eh; disp_eff_size(m, &ew, &eh);
-		if (ew == 0) continue;
-
-		double rx = off_x + m->x * scale;
-		double ry = off_y + m->y * scale;
-		double rw = ew * scale;
-		double rh = eh * scale;
-		double radius = 8.0;
-		const double *c = cols[i % 4];
-		gboolean sel = (i == dd->selected);
-
-		if (!m->active) continue; /* inactive monitors shown only in tabs */
-
-		/* Shadow */
-		cairo_set_source_rgba(cr, 0, 0, 0, sel ? 0.18 : 0.07);
-		cairo_rectangle(cr, rx + 3, ry + 3, rw, rh);
-		cairo_fill(cr);
-
-		/* Filled rounded rect */
-		cairo_new_path(cr);
-		cairo_arc(cr, rx+radius,    ry+radius,    radius, G_PI,    G_PI*1.5);
-		cairo_arc(cr, rx+rw-radius, ry+radius,    radius, G_PI*1.5, 0);
-		cairo_arc(cr, rx+rw-radius, ry+rh-radius, radius, 0,       G_PI*0.5);
-		cairo_arc(cr, rx+radius,    ry+rh-radius, radius, G_PI*0.5, G_PI);
-		cairo_close_path(cr);
-		cairo_set_source_rgba(cr, c[0], c[1], c[2], sel ? 0.88 : 0.60);
-		cairo_fill_preserve(cr);
-		if (sel) {
-			cairo_set_source_rgb(cr, c[0]*0.65, c[1]*0.65, c[2]*0.65);
-			cairo_set_line_width(cr, 2.8);
-		} else {
-			cairo_set_source_rgba(cr, 0, 0, 0, 0.18);
-			cairo_set_line_width(cr, 1.0);
-		}
-		cairo_stroke(cr);
-
-		/* Number — centered */
-		cairo_set_source_rgb(cr, 1, 1, 1);
-		cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL,
-				       sel ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+		disp_canvas_item_rect(dc, i);
+		if (!m->active) continue;
+		double sz = MIN(dc->items[i].rect.size.width, dc->items[i].rect.size.height);
 		char num[4]; snprintf(num, sizeof(num), "%d", i + 1);
-		cairo_set_font_size(cr, MIN(rw, rh) * 0.32);
-		cairo_text_extents_t te;
-		cairo_text_extents(cr, num, &te);
-		cairo_move_to(cr,
-			      rx + (rw - te.width)  / 2.0 - te.x_bearing,
-			      ry + (rh - te.height) / 2.0 - te.y_bearing - rh * 0.06);
-		cairo_show_text(cr, num);
-
-		/* Label — centered below number */
-		cairo_set_font_size(cr, MIN(rw, rh) * 0.10);
-		cairo_text_extents(cr, m->label, &te);
-		if (te.width < rw - 8) {
-			cairo_move_to(cr,
-				      rx + (rw - te.width) / 2.0 - te.x_bearing,
-				      ry + (rh - te.height) / 2.0 - te.y_bearing + rh * 0.18);
-			cairo_show_text(cr, m->label);
-		}
+		dc->items[i].num   = disp_canvas_text(dc, num, sz * 0.32, i == dd->selected);
+		dc->items[i].label = disp_canvas_text(dc, m->label, sz * 0.10, i == dd->selected);
+		if (m->primary)
+			dc->items[i].badge = disp_canvas_text(dc, "Primary", sz * 0.09, FALSE);
+	}
+}
 
-		/* Primary badge */
-		if (m->primary) {
-			const char *badge = "Primary";
-			cairo_set_font_size(cr, MIN(rw, rh) * 0.09);
-			cairo_text_extents(cr, badge, &te);
-			double bx = rx + (rw - te.width) / 2.0 - te.x_bearing - 6;
-			double by = ry + 8;
-			double bw = te.width + 12, bh = te.height + 6;
-			cairo_set_source_rgba(cr, 1, 1, 1, 0.28);
-			cairo_rectangle(cr, bx, by, bw, bh);
-			cairo_fill(cr);
-			cairo_set_source_rgb(cr, 1, 1, 1);
-			cairo_move_to(cr, bx + 6, by + bh - 3 - te.y_bearing - te.height);
-			cairo_show_text(cr, badge);
-		}
+static void disp_canvas_invalidate(GtkWidget *canvas) {
+	DispCanvas *dc = DISP_CANVAS(canvas);
+	dc->valid = FALSE;
+	gtk_widget_queue_draw(canvas);
+}
+
+/* Append a layout with its centre at (cx, cy) */
+static void disp_canvas_append_text(GtkSnapshot *s, PangoLayout *pl,
+				    double cx, double cy, const GdkRGBA *col) {
+	int lw, lh; pango_layout_get_pixel_size(pl, &lw, &lh);
+	gtk_snapshot_save(s);
+	gtk_snapshot_translate(s, &GRAPHENE_POINT_INIT(cx - lw / 2.0, cy - lh / 2.0));
+	gtk_snapshot_append_layout(s, pl, col);
+	gtk_snapshot_restore(s);
+}
+
+static void disp_canvas_append_monitor(DispCanvas *dc, GtkSnapshot *s, int i) {
+	static const GdkRGBA cols[] = {
+		{ 0.21, 0.52, 0.89, 1 },
+		{ 0.18, 0.64, 0.47, 1 },
+		{ 0.75, 0.36, 0.20, 1 },
+		{ 0.56, 0.27, 0.68, 1 },
+	};
+	static const GdkRGBA white = { 1, 1, 1, 1 };
+	DispCanvasItem *it  = &dc->items[i];
+	gboolean        sel = (i == dc->dd->selected);
+	const GdkRGBA  *c   = &cols[i % 4];
+
+	GskRoundedRect rr;
+	gsk_rounded_rect_init_from_rect(&rr, &it->rect, 8.0);
+
+	GdkRGBA shadow = { 0, 0, 0, sel ? 0.18 : 0.07 };
+	gtk_snapshot_append_outset_shadow(s, &rr, &shadow, 3, 3, 0, 0);
+
+	GdkRGBA fill = { c->red, c->green, c->blue, sel ? 0.88 : 0.60 };
+	gtk_snapshot_push_rounded_clip(s, &rr);
+	gtk_snapshot_append_color(s, &fill, &it->rect);
+	gtk_snapshot_pop(s);
+
+	float   bw = sel ? 2.8f : 1.0f;
+	GdkRGBA bc = sel ? (GdkRGBA){ c->red * 0.65f, c->green * 0.65f, c->blue * 0.65f, 1 }
+			 : (GdkRGBA){ 0, 0, 0, 0.18f };
+	const float   widths[4] = { bw, bw, bw, bw };
+	const GdkRGBA colors[4] = { bc, bc, bc, bc };
+	gtk_snapshot_append_border(s, &rr, widths, colors);
+
+	/* Number and label centred, primary badge at the top */
+	double cx = it->rect.origin.x + it->rect.size.width  / 2.0;
+	double cy = it->rect.origin.y + it->rect.size.height / 2.0;
+	double rh = it->rect.size.height;
+	disp_canvas_append_text(s, it->num, cx, cy - rh * 0.06, &white);
+	int lw; pango_layout_get_pixel_size(it->label, &lw, NULL);
+	if (lw < it->rect.size.width - 8)
+		disp_canvas_append_text(s, it->label, cx, cy + rh * 0.18, &white);
+
+	if (it->badge) {
+		int tw, th; pango_layout_get_pixel_size(it->badge, &tw, &th);
+		graphene_rect_t br = GRAPHENE_RECT_INIT(cx - tw / 2.0 - 6, it->rect.origin.y + 8,
+						       tw + 12, th + 6);
+		GdkRGBA bg = { 1, 1, 1, 0.28 };
+		gtk_snapshot_append_color(s, &bg, &br);
+		disp_canvas_append_text(s, it->badge, cx, br.origin.y + br.size.height / 2.0, &white);
 	}
 }
 
-static void disp_canvas_click_v2(GtkGestureClick *gc, int n_press,
-				 double ex, double ey, gpointer ud) {
-	DispData *dd = ud;
-	if (!dd || dd->n_monitors == 0) return;
+static void disp_canvas_snapshot(GtkWidget *widget, GtkSnapshot *s) {
+	DispCanvas *dc = DISP_CANVAS(widget);
+	DispData   *dd = dc->dd;
 
-	disp_layout_inactive(dd);
+	if (!dd || dd->n_monitors == 0) return;
+	if (!dc->valid || dc->cache_w != gtk_widget_get_width(widget) ||
+	    dc->cache_h != gtk_widget_get_height(widget))
+		disp_canvas_relayout(dc);
 
-	int cw = gtk_widget_get_width(dd->canvas);
-	int ch = gtk_widget_get_height(dd->canvas);
-	int total_w = 0, total_h = 0;
-	for (int i = 0; i < dd->n_monitors; i++) {
-		DispMonitor *m = &dd->monitors[i];
-		int ew, eh; disp_eff_size(m, &ew, &eh);
-		if (ew == 0) continue;
-		if (m->x + ew > total_w) total_w = m->x + ew;
-		if (m->y + eh > total_h) total_h = m->y + eh;
+	if (dc->empty) {
+		GdkRGBA dim = { 0, 0, 0, 0.35 };
+		disp_canvas_append_text(s, dc->empty_msg, dc->cache_w / 2.0, dc->cache_h / 2.0, &dim);
+		return;
 	}
-	if (total_w == 0 || total_h == 0) return;
 
-	double pad   = 28.0;
-	double scale = MIN((cw - pad * 2) / (double)total_w,
-			   (ch - pad * 2) / (double)total_h);
-	double off_x = (cw - total_w * scale) / 2.0;
-	double off_y = (ch - total_h * scale) / 2.0;
+	/* inactive monitors are shown only in tabs; the dragged one goes on top */
+	for (int i = 0; i < dc->n_items; i++)
+		if (dd->monitors[i].active && i != dc->drag_idx)
+			disp_canvas_append_monitor(dc, s, i);
+	if (dc->drag_idx >= 0 && dc->drag_idx < dc->n_items)
+		disp_canvas_append_monitor(dc, s, dc->drag_idx);
+}
+
+/* Snap the dragged monitor's edges to the edges of the other active
+ * monitors when they come within DISP_SNAP_PX screen pixels. */
+static void disp_canvas_snap(DispCanvas *dc, int idx, int *px, int *py) {
+	DispData *dd  = dc->dd;
+	double    thr = DISP_SNAP_PX / dc->scale;
+	double    best_dx = thr, best_dy = thr;
+	int       sx = *px, sy = *py;
+	int mw, mh; disp_eff_size(&dd->monitors[idx], &mw, &mh);
 
 	for (int i = 0; i < dd->n_monitors; i++) {
-		DispMonitor *m = &dd->monitors[i];
-		int ew, eh; disp_eff_size(m, &ew, &eh);
-		if (ew == 0) continue;
-		double rx = off_x + m->x * scale;
-		double ry = off_y + m->y * scale;
-		double rw = ew * scale;
-		double rh = eh * scale;
-		if (ex >= rx && ex <= rx + rw && ey >= ry && ey <= ry + rh) {
-			disp_select_monitor(dd, i);
-			return;
+		DispMonitor *o = &dd->monitors[i];
+		if (i == idx || !o->active) continue;
+		int ow, oh; disp_eff_size(o, &ow, &oh);
+		int cx[4] = { o->x + ow, o->x - mw, o->x, o->x + ow - mw };
+		int cy[4] = { o->y + oh, o->y - mh, o->y, o->y + oh - mh };
+		for (int k = 0; k < 4; k++) {
+			if (fabs((double)(cx[k] - *px)) < best_dx) { best_dx = fabs((double)(cx[k] - *px)); sx = cx[k]; }
+			if (fabs((double)(cy[k] - *py)) < best_dy) { best_dy = fabs((double)(cy[k] - *py)); sy = cy[k]; }
 		}
 	}
+	*px = sx; *py = sy;
+}
+
+static int disp_canvas_hit(DispCanvas *dc, double x, double y) {
+	for (int i = dc->n_items - 1; i >= 0; i--) {
+		if (!dc->dd->monitors[i].active) continue;
+		if (graphene_rect_contains_point(&dc->items[i].rect, &GRAPHENE_POINT_INIT(x, y)))
+			return i;
+	}
+	return -1;
+}
+
+static void disp_canvas_drag_begin(GtkGestureDrag *g, double x, double y, gpointer ud) {
+	DispCanvas *dc = ud;
+	if (!dc->dd) return;
+	if (!dc->valid) disp_canvas_relayout(dc);
+	int idx = disp_canvas_hit(dc, x, y);
+	if (idx < 0) { gtk_gesture_set_state(GTK_GESTURE(g), GTK_EVENT_SEQUENCE_DENIED); return; }
+	dc->drag_idx = idx;
+	dc->drag_x0  = dc->dd->monitors[idx].x;
+	dc->drag_y0  = dc->dd->monitors[idx].y;
+	/* selection restyles the item; relayout now so scale stays fixed for the drag */
+	disp_select_monitor(dc->dd, idx);
+	disp_canvas_relayout(dc);
+}
+
+static void disp_canvas_drag_update(GtkGestureDrag *g, double ox, double oy, gpointer ud) {
+	DispCanvas *dc = ud;
+	if (dc->drag_idx < 0 || !dc->items) return;
+	DispMonitor *m = &dc->dd->monitors[dc->drag_idx];
+	int nx = dc->drag_x0 + (int)lround(ox / dc->scale);
+	int ny = dc->drag_y0 + (int)lround(oy / dc->scale);
+	disp_canvas_snap(dc, dc->drag_idx, &nx, &ny);
+	if (nx == m->x && ny == m->y) return;
+	m->x = nx; m->y = ny;
+	disp_canvas_item_rect(dc, dc->drag_idx);
+	gtk_widget_queue_draw(GTK_WIDGET(dc));
+}
+
+static void disp_canvas_drag_end(GtkGestureDrag *g, double ox, double oy, gpointer ud) {
+	DispCanvas *dc = ud;
+	if (dc->drag_idx < 0) return;
+	DispMonitor *m = &dc->dd->monitors[dc->drag_idx];
+	gboolean moved = m->x != dc->drag_x0 || m->y != dc->drag_y0;
+	dc->drag_idx = -1;
+	disp_canvas_invalidate(GTK_WIDGET(dc));
+	if (moved) disp_pos_resync(dc->dd);
+}
+
+static void disp_canvas_dispose(GObject *obj) {
+	DispCanvas *dc = DISP_CANVAS(obj);
+	disp_canvas_clear_items(dc);
+	g_clear_object(&dc->empty_msg);
+	dc->dd = NULL;
+	G_OBJECT_CLASS(disp_canvas_parent_class)->dispose(obj);
+}
+
+static void disp_canvas_class_init(DispCanvasClass *klass) {
+	G_OBJECT_CLASS(klass)->dispose   = disp_canvas_dispose;
+	GTK_WIDGET_CLASS(klass)->snapshot = disp_canvas_snapshot;
+}
+
+static void disp_canvas_init(DispCanvas *dc) {
+	dc->drag_idx = -1;
+	GtkGesture *drag = gtk_gesture_drag_new();
+	gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(drag), GDK_BUTTON_PRIMARY);
+	g_signal_connect(drag, "drag-begin",  G_CALLBACK(disp_canvas_drag_begin),  dc);
+	g_signal_connect(drag, "drag-update", G_CALLBACK(disp_canvas_drag_update), dc);
+	g_signal_connect(drag, "drag-end",    G_CALLBACK(disp_canvas_drag_end),    dc);
+	gtk_widget_add_controller(GTK_WIDGET(dc), GTK_EVENT_CONTROLLER(drag));
+}
+
+static GtkWidget *disp_canvas_new(DispData *dd) {
+	DispCanvas *dc = g_object_new(DISP_TYPE_CANVAS, NULL);
+	dc->dd = dd;
+	return GTK_WIDGET(dc);
 }
 
 /* Fixed position change: centers new monitor relative to reference */
@@ -2012,19 +3600,16 @@ static void disp_enable_toggled(GtkSwitch *sw, GParamSpec *ps, gpointer ud) {
 		m->x = rx; m->y = 0;
 	}
 	gtk_widget_set_sensitive(ed->settings_box, enable);
-	gtk_widget_queue_draw(dd->canvas);
+	disp_canvas_invalidate(dd->canvas);
+	disp_pos_resync(dd);
 }
 
 /* ------------------------------------------------------------------ */
 /* apply xrandr changes for selected monitor                           */
 /* ------------------------------------------------------------------ */
-typedef struct { DispData *dd; int idx; } DispApplyData;
-
-static gpointer disp_apply_thread(gpointer ud) {
-	DispApplyData *ad = ud;
-	DispData      *dd = ad->dd;
-	int            idx = ad->idx;
-	g_free(ad);
+/* The command is built here, on the main thread: a hotplug may rebuild
+ * dd->monitors while the worker is still running xrandr. */
+static char *disp_apply_cmd(DispData *dd, int idx) {
 	if (idx < 0 || idx >= dd->n_monitors) return NULL;
 	DispMonitor *m = &dd->monitors[idx];
 	GString *cmd = g_string_new("xrandr");
@@ -2035,19 +3620,31 @@ static gpointer disp_apply_thread(gpointer ud) {
 			sscanf(m->modes[m->cur_mode_idx], "%dx%d @ %lf Hz", &W, &H, &RR);
 		g_string_append_printf(cmd, " --mode %dx%d --rate %.2f --pos %dx%d", W, H, RR, m->x, m->y);
 		if (m->primary) g_string_append(cmd, " --primary");
+		/* dragging on the canvas can shift the whole arrangement */
+		for (int i = 0; i < dd->n_monitors; i++) {
+			if (i == idx || !dd->monitors[i].active) continue;
+			g_string_append_printf(cmd, " --output %s --pos %dx%d", dd->monitors[i].name,
+					       dd->monitors[i].x, dd->monitors[i].y);
+		}
 	} else {
 		g_string_append(cmd, " --off");
 	}
-	system(cmd->str);
-	g_string_free(cmd, TRUE);
+	return g_string_free(cmd, FALSE);
+}
+
+static gpointer disp_apply_thread(gpointer ud) {
+	char *cmd = ud;
+	system(cmd);
+	g_free(cmd);
 	return NULL;
 }
 
 static void disp_apply(GtkWidget *btn, gpointer ud) {
 	DispData *dd = ud;
-	DispApplyData *ad = g_new0(DispApplyData, 1);
-	ad->dd = dd; ad->idx = dd->selected;
-	g_thread_unref(g_thread_new("xrandr", disp_apply_thread, ad));
+	char *cmd = disp_apply_cmd(dd, dd->selected);
+	if (!cmd) return;
+	disp_profile_save(dd);
+	g_thread_unref(g_thread_new("xrandr", disp_apply_thread, cmd));
 }
 
 /* ------------------------------------------------------------------ */
@@ -2061,20 +3658,251 @@ static void disp_set_primary(GtkWidget *btn, gpointer ud) {
 	snprintf(cmd, sizeof(cmd), "xrandr --output %s --primary",
 		 dd->monitors[dd->selected].name);
 	system(cmd);
-	gtk_widget_queue_draw(dd->canvas);
+	disp_canvas_invalidate(dd->canvas);
 	gtk_widget_set_sensitive(btn, FALSE);
 }
 
 /* ------------------------------------------------------------------ */
-/* canvas draw/click wrappers                                           */
+/* per-setup profiles, re-applied when the connected set changes        */
 /* ------------------------------------------------------------------ */
-static void disp_canvas_draw(GtkDrawingArea *da, cairo_t *cr, int w, int h, gpointer ud) {
-	disp_canvas_draw_v2(da, cr, w, h, ud);
+/* ~/.config/mrrobotos/mrsettings/displays/profiles is a GKeyFile with  */
+/* one group per setup (sorted monitor ids joined by '+') and one key   */
+/* per monitor: "active;x;y;width;height;rate;primary".  Identical     */
+/* panels without a serial share an EDID hash; those keys get the       */
+/* output name appended ("hash@DP-1") so each keeps its own entry.      */
+typedef struct { char id[144], output[64]; } DispConnId;
+
+static gboolean disp_hotplug_busy = FALSE;
+static char    *disp_hotplug_setup = NULL;
+
+/* EDID hash, or output name + first mode when the EDID is unavailable */
+static void disp_monitor_id(const DispMonitor *m, char *out, size_t sz) {
+	int W = 0, H = 0;
+	if (m->edid.valid) { snprintf(out, sz, "%s", m->edid.key); return; }
+	if (m->n_modes > 0) sscanf(m->modes[0], "%dx%d", &W, &H);
+	snprintf(out, sz, "%s@%dx%d", m->name, W, H);
+}
+
+static char *disp_profiles_path(void) {
+	return g_build_filename(g_get_user_config_dir(), "mrrobotos", "mrsettings",
+				"displays", "profiles", NULL);
+}
+
+static int disp_cmp_connid(const void *a, const void *b) {
+	return strcmp(((const DispConnId *)a)->id, ((const DispConnId *)b)->id);
+}
+
+/* Make ids unique per output and build the setup key.  Save and apply
+ * both key their entries by ids[i].id after this call. */
+static char *disp_setup_key(DispConnId *ids, int n) {
+	gboolean *dup = g_new0(gboolean, MAX(n, 1));
+	for (int i = 0; i < n; i++)
+		for (int j = i + 1; j < n; j++)
+			if (strcmp(ids[i].id, ids[j].id) == 0) dup[i] = dup[j] = TRUE;
+	for (int i = 0; i < n; i++) {
+		if (!dup[i]) continue;
+		size_t len = strlen(ids[i].id);
+		snprintf(ids[i].id + len, sizeof(ids[i].id) - len, "@%s", ids[i].output);
+	}
+	g_free(dup);
+	qsort(ids, n, sizeof(*ids), disp_cmp_connid);
+	GString *k = g_string_new(NULL);
+	for (int i = 0; i < n; i++) {
+		if (i) g_string_append_c(k, '+');
+		g_string_append(k, ids[i].id);
+	}
+	return g_string_free(k, FALSE);
+}
+
+/* Connected outputs straight from RandR — no xrandr subprocess, so this
+ * is cheap enough to run on every screen-change event. */
+static DispConnId *disp_connected_ids(Display *xd, int *out_n) {
+	*out_n = 0;
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(xd, DefaultRootWindow(xd));
+	if (!res) return NULL;
+	Atom edid_atom = XInternAtom(xd, RR_PROPERTY_RANDR_EDID, True);
+	DispConnId *ids = g_new0(DispConnId, MAX(res->noutput, 1));
+	int n = 0;
+	for (int i = 0; i < res->noutput; i++) {
+		XRROutputInfo *oi = XRRGetOutputInfo(xd, res, res->outputs[i]);
+		if (!oi) continue;
+		if (oi->connection == RR_Connected) {
+			DispEdid e;
+			snprintf(ids[n].output, sizeof(ids[n].output), "%s", oi->name);
+			if ((edid_atom != None && disp_edid_read_output(xd, res->outputs[i], edid_atom, &e)) ||
+			    disp_edid_from_sysfs(DISP_DRM_DIR, oi->name,
+						 disp_output_conn_id(xd, res->outputs[i]), &e)) {
+				snprintf(ids[n].id, sizeof(ids[n].id), "%s", e.key);
+			} else {
+				unsigned W = 0, H = 0;
+				for (int j = 0; oi->nmode > 0 && j < res->nmode; j++)
+					if (res->modes[j].id == oi->modes[0]) { W = res->modes[j].width; H = res->modes[j].height; break; }
+				snprintf(ids[n].id, sizeof(ids[n].id), "%s@%ux%u", oi->name, W, H);
+			}
+			n++;
+		}
+		XRRFreeOutputInfo(oi);
+	}
+	XRRFreeScreenResources(res);
+	*out_n = n;
+	return ids;
+}
+
+static void disp_profile_save(DispData *dd) {
+	DispConnId *ids = g_new0(DispConnId, MAX(dd->n_monitors, 1));
+	int n = 0;
+	for (int i = 0; i < dd->n_monitors; i++) {
+		if (!dd->monitors[i].connected) continue;
+		disp_monitor_id(&dd->monitors[i], ids[n].id, sizeof(ids[n].id));
+		snprintf(ids[n].output, sizeof(ids[n].output), "%s", dd->monitors[i].name);
+		n++;
+	}
+	char *setup = disp_setup_key(ids, n);
+	char *path  = disp_profiles_path();
+	char *dir   = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+
+	GKeyFile *kf = g_key_file_new();
+	g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL);
+	g_key_file_remove_group(kf, setup, NULL);
+	for (int k = 0; k < n; k++) {
+		DispMonitor *m = NULL;
+		for (int i = 0; i < dd->n_monitors && !m; i++)
+			if (dd->monitors[i].connected && strcmp(dd->monitors[i].name, ids[k].output) == 0)
+				m = &dd->monitors[i];
+		if (!m) continue;
+		int W = m->w, H = m->h; double RR = m->refresh;
+		if (m->n_modes > 0 && m->cur_mode_idx >= 0 && m->cur_mode_idx < m->n_modes)
+			sscanf(m->modes[m->cur_mode_idx], "%dx%d @ %lf Hz", &W, &H, &RR);
+		char val[96];
+		snprintf(val, sizeof(val), "%d;%d;%d;%d;%d;%.2f;%d",
+			 m->active, m->x, m->y, W, H, RR, m->primary);
+		g_key_file_set_string(kf, setup, ids[k].id, val);
+	}
+	g_key_file_save_to_file(kf, path, NULL);
+	g_key_file_free(kf);
+
+	/* our own apply must not look like a new setup to the hotplug watcher */
+	g_free(disp_hotplug_setup);
+	disp_hotplug_setup = setup;
+	g_free(dir); g_free(path); g_free(ids);
+}
+
+typedef struct { char *cmd, *setup; gint64 t0; } DispProfileJob;
+
+static gboolean disp_profile_applied(gpointer p) {
+	DispProfileJob *job = p;
+	g_debug("display profile '%s' applied %.1f ms after the screen change",
+		job->setup, (g_get_monotonic_time() - job->t0) / 1000.0);
+	disp_hotplug_busy = FALSE;
+	disp_pages_reload();
+	g_free(job->cmd); g_free(job->setup); g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer disp_profile_thread(gpointer p) {
+	DispProfileJob *job = p;
+	system(job->cmd);
+	g_idle_add(disp_profile_applied, job);
+	return NULL;
+}
+
+/* Look up the profile for the connected set and apply every output in
+ * one xrandr invocation. Returns FALSE if no profile matches.  Open
+ * Displays pages are rebuilt for a new set, after the profile is on. */
+static gboolean disp_profile_apply(Display *xd, gint64 t0) {
+	int n = 0;
+	DispConnId *ids = disp_connected_ids(xd, &n);
+	char *setup = disp_setup_key(ids, n);
+	if (g_strcmp0(setup, disp_hotplug_setup) == 0) {
+		g_free(setup); g_free(ids);
+		return FALSE;
+	}
+	g_free(disp_hotplug_setup);
+	disp_hotplug_setup = g_strdup(setup);
+
+	char *path = disp_profiles_path();
+	GKeyFile *kf = g_key_file_new();
+	gboolean found = g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL)
+			 && g_key_file_has_group(kf, setup);
+	GString *cmd = g_string_new("xrandr");
+	for (int i = 0; found && i < n; i++) {
+		char *val = g_key_file_get_string(kf, setup, ids[i].id, NULL);
+		int active = 0, x = 0, y = 0, W = 0, H = 0, primary = 0; double RR = 0;
+		if (val && sscanf(val, "%d;%d;%d;%d;%d;%lf;%d", &active, &x, &y, &W, &H, &RR, &primary) == 7) {
+			g_string_append_printf(cmd, " --output %s", ids[i].output);
+			if (active)
+				g_string_append_printf(cmd, " --mode %dx%d --rate %.2f --pos %dx%d%s",
+						       W, H, RR, x, y, primary ? " --primary" : "");
+			else
+				g_string_append(cmd, " --off");
+		}
+		g_free(val);
+	}
+	g_key_file_free(kf);
+	g_free(path); g_free(ids);
+
+	if (!found) {
+		g_string_free(cmd, TRUE); g_free(setup);
+		disp_pages_reload();
+		return FALSE;
+	}
+	DispProfileJob *job = g_new0(DispProfileJob, 1);
+	job->cmd = g_string_free(cmd, FALSE); job->setup = setup; job->t0 = t0;
+	disp_hotplug_busy = TRUE;
+	g_thread_unref(g_thread_new("xrandr-profile", disp_profile_thread, job));
+	return TRUE;
 }
-static void disp_canvas_click(GtkGestureClick *gc, int n_press, double ex, double ey, gpointer ud) {
-	disp_canvas_click_v2(gc, n_press, ex, ey, ud);
+
+static int    disp_rr_event_base = -1;
+static guint  disp_hotplug_timer = 0;
+static gint64 disp_hotplug_t0    = 0;
+
+static gboolean disp_hotplug_settle(gpointer ud) {
+	disp_hotplug_timer = 0;
+	if (disp_hotplug_busy) {
+		/* a profile is being applied; look again once it is done */
+		disp_hotplug_timer = g_timeout_add(30, disp_hotplug_settle, ud);
+		return G_SOURCE_REMOVE;
+	}
+	disp_profile_apply(ud, disp_hotplug_t0);
+	return G_SOURCE_REMOVE;
 }
 
+/* Output connect/disconnect arrives as a burst of RandR events; wait
+ * for a short quiet period and then handle the set once. */
+static gboolean disp_hotplug_xevent(GdkX11Display *gd, gpointer xev, gpointer ud) {
+	XEvent *e = xev;
+	if (e->type != disp_rr_event_base + RRNotify &&
+	    e->type != disp_rr_event_base + RRScreenChangeNotify)
+		return FALSE;
+	if (!disp_hotplug_timer) disp_hotplug_t0 = g_get_monotonic_time();
+	else g_source_remove(disp_hotplug_timer);
+	disp_hotplug_timer = g_timeout_add(30, disp_hotplug_settle,
+					   gdk_x11_display_get_xdisplay(GDK_DISPLAY(gd)));
+	return FALSE;
+}
+
+/* Run from an idle after startup so the first window is not delayed */
+static gboolean disp_hotplug_init(gpointer unused) {
+	GdkDisplay *gd = gdk_display_get_default();
+	if (!gd || !GDK_IS_X11_DISPLAY(gd) || disp_rr_event_base >= 0) return G_SOURCE_REMOVE;
+	Display *xd = gdk_x11_display_get_xdisplay(gd);
+	int err_base;
+	if (!XRRQueryExtension(xd, &disp_rr_event_base, &err_base)) {
+		disp_rr_event_base = -1;
+		return G_SOURCE_REMOVE;
+	}
+
+	int n = 0;
+	DispConnId *ids = disp_connected_ids(xd, &n);
+	disp_hotplug_setup = disp_setup_key(ids, n);
+	g_free(ids);
+
+	XRRSelectInput(xd, DefaultRootWindow(xd), RRScreenChangeNotifyMask | RROutputChangeNotifyMask);
+	g_signal_connect(gd, "xevent", G_CALLBACK(disp_hotplug_xevent), NULL);
+	return G_SOURCE_REMOVE;
+}
 
 static void disp_position_changed_v2(GtkDropDown *dd_w, GParamSpec *ps, gpointer ud) {
 	DispPosData *pd = ud;
@@ -2127,7 +3955,69 @@ static void disp_position_changed_v2(GtkDropDown *dd_w, GParamSpec *ps, gpointer
 	}
 	/* Normalize so no negative coords appear in canvas */
 	disp_normalize_coords(dd);
-	gtk_widget_queue_draw(dd->canvas);
+	disp_canvas_invalidate(dd->canvas);
+	disp_pos_resync(dd);
+}
+
+static guint disp_pos_find(GListModel *model, const char *text) {
+	guint n = g_list_model_get_n_items(model);
+	for (guint i = 0; i < n; i++) {
+		GtkStringObject *so = g_list_model_get_item(model, i);
+		gboolean same = strcmp(gtk_string_object_get_string(so), text) == 0;
+		g_object_unref(so);
+		if (same) return i;
+	}
+	return GTK_INVALID_LIST_POSITION;
+}
+
+/* Placement entry describing where monitor idx sits: "<dir> <name>" for
+ * the first active monitor it touches that the dropdown lists, or
+ * GTK_INVALID_LIST_POSITION when there is none (placed freely on the
+ * canvas).  The list is built with the panel and not rebuilt when a
+ * monitor is switched on or off, so entries are found by text rather
+ * than counted from the monitors active now. */
+static guint disp_pos_entry(DispData *dd, int idx, GListModel *model) {
+	static const char *dirs[] = { "Right of", "Left of", "Above", "Below" };
+	DispMonitor *m = &dd->monitors[idx];
+	int mw, mh; disp_eff_size(m, &mw, &mh);
+	for (int i = 0; i < dd->n_monitors; i++) {
+		DispMonitor *r = &dd->monitors[i];
+		if (i == idx || !r->active) continue;
+		int rw, rh; disp_eff_size(r, &rw, &rh);
+		gboolean vlap = m->y < r->y + rh && r->y < m->y + mh;
+		gboolean hlap = m->x < r->x + rw && r->x < m->x + mw;
+		gboolean touch[4] = {
+			vlap && abs(m->x - (r->x + rw)) <= 10,
+			vlap && abs(m->x + mw - r->x) <= 10,
+			hlap && abs(m->y + mh - r->y) <= 10,
+			hlap && abs(m->y - (r->y + rh)) <= 10,
+		};
+		for (int d = 0; d < 4; d++) {
+			if (!touch[d]) continue;
+			char text[128];
+			snprintf(text, sizeof(text), "%s %s", dirs[d], r->name);
+			guint pos = disp_pos_find(model, text);
+			if (pos != GTK_INVALID_LIST_POSITION) return pos;
+		}
+	}
+	return GTK_INVALID_LIST_POSITION;
+}
+
+/* Point every panel's Placement dropdown at the current layout after a
+ * drag or a placement change moved monitors under it. */
+static void disp_pos_resync(DispData *dd) {
+	if (!dd->mon_stack) return;
+	for (int i = 0; i < dd->n_monitors; i++) {
+		GtkWidget *panel  = gtk_stack_get_child_by_name(GTK_STACK(dd->mon_stack), dd->monitors[i].name);
+		GtkWidget *pos_dd = panel ? g_object_get_data(G_OBJECT(panel), "pos-dd") : NULL;
+		if (!pos_dd) continue;
+		g_signal_handlers_block_matched(pos_dd, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+						(gpointer)disp_position_changed_v2, NULL);
+		gtk_drop_down_set_selected(GTK_DROP_DOWN(pos_dd),
+					   disp_pos_entry(dd, i, gtk_drop_down_get_model(GTK_DROP_DOWN(pos_dd))));
+		g_signal_handlers_unblock_matched(pos_dd, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+						  (gpointer)disp_position_changed_v2, NULL);
+	}
 }
 
 /* ------------------------------------------------------------------ */
@@ -2201,30 +4091,8 @@ static GtkWidget *disp_build_monitor_panel(DispData *dd, int idx) {
 		gtk_box_append(GTK_BOX(pos_row), pos_dd);
 
 		/* Detect current relationship to pick correct default entry */
-		guint default_pos = 0;
-		{
-			guint entry_idx = 0;
-			const char *dirs2[] = { "Right of", "Left of", "Above", "Below", NULL };
-			gboolean found = FALSE;
-			for (int ii = 0; ii < dd->n_monitors && !found; ii++) {
-				if (ii == idx || !dd->monitors[ii].active) continue;
-				DispMonitor *ref2 = &dd->monitors[ii];
-				int mw2, mh2; disp_eff_size(m, &mw2, &mh2);
-				int rw2, rh2; disp_eff_size(ref2, &rw2, &rh2);
-				/* determine relationship: which side of ref is m on? */
-				int dir_guess = 0; /* 0=right,1=left,2=above,3=below */
-				if (m->x >= ref2->x + rw2 - 10)       dir_guess = 0;
-				else if (m->x + mw2 <= ref2->x + 10)  dir_guess = 1;
-				else if (m->y + mh2 <= ref2->y + 10)  dir_guess = 2;
-				else                                    dir_guess = 3;
-				for (int d = 0; dirs2[d]; d++) {
-					if (d == dir_guess) { default_pos = entry_idx; found = TRUE; break; }
-					entry_idx++;
-				}
-				if (!found) entry_idx += 4;
-			}
-		}
-		gtk_drop_down_set_selected(GTK_DROP_DOWN(pos_dd), default_pos);
+		gtk_drop_down_set_selected(GTK_DROP_DOWN(pos_dd), disp_pos_entry(dd, idx, G_LIST_MODEL(pos_sl)));
+		g_object_set_data(G_OBJECT(root), "pos-dd", pos_dd);
 
 		DispPosData *pd = g_new0(DispPosData, 1);
 		pd->dd = dd; pd->idx = idx;
@@ -2268,6 +4136,22 @@ static GtkWidget *disp_build_monitor_panel(DispData *dd, int idx) {
 		IROW("Position",   pos_str);
 	}
 IROW("Primary", m->primary ? "Yes" : "No");
+if (m->edid.valid) {
+	char ven[48], size_str[48], pref_str[48];
+	snprintf(ven, sizeof(ven), "%s (0x%04x)", m->edid.vendor, m->edid.product);
+	IROW("Manufacturer", ven);
+	if (m->edid.serial[0]) IROW("Serial", m->edid.serial);
+	if (m->edid.mm_w && m->edid.mm_h) {
+		snprintf(size_str, sizeof(size_str), "%d \xc3\x97 %d mm (%.1f\")", m->edid.mm_w, m->edid.mm_h,
+			 sqrt((double)m->edid.mm_w * m->edid.mm_w + (double)m->edid.mm_h * m->edid.mm_h) / 25.4);
+		IROW("Physical Size", size_str);
+	}
+	if (m->edid.pref_w) {
+		snprintf(pref_str, sizeof(pref_str), "%d \xc3\x97 %d @ %.2f Hz",
+			 m->edid.pref_w, m->edid.pref_h, m->edid.pref_rr);
+		IROW("Preferred Mode", pref_str);
+	}
+}
 #undef IROW
 gtk_box_append(GTK_BOX(settings_box), inf_frame);
 
@@ -2352,7 +4236,7 @@ static void disp_select_monitor(DispData *dd, int idx) {
 			gtk_widget_set_opacity(b, dd->monitors[i].active ? 1.0 : 0.55);
 		}
 	}
-	gtk_widget_queue_draw(dd->canvas);
+	disp_canvas_invalidate(dd->canvas);
 	gtk_stack_set_visible_child_name(GTK_STACK(dd->mon_stack),dd->monitors[idx].name);
 }
 static void disp_tab_clicked(GtkWidget *btn, gpointer ud) {
@@ -2360,8 +4244,13 @@ static void disp_tab_clicked(GtkWidget *btn, gpointer ud) {
 	int idx=GPOINTER_TO_INT(g_object_get_data(G_OBJECT(btn),"mon-idx"));
 	disp_select_monitor(dd,idx);
 }
+/* Open Displays pages.  A hotplug changes the monitor set under them,
+ * so each is rebuilt once the new set's profile has been applied. */
+static GSList *disp_pages = NULL;
+
 static void disp_page_destroyed(GtkWidget *w, gpointer ud) {
 	DispData *dd=ud; dd->destroyed=TRUE;
+	disp_pages=g_slist_remove(disp_pages,dd);
 	disp_free_monitors(dd->monitors,dd->n_monitors);
 	g_free(dd->tab_btns); g_free(dd);
 }
@@ -2369,13 +4258,8 @@ static void disp_paned_map_cb(GtkWidget *paned, gpointer unused) {
 	gtk_paned_set_position(GTK_PANED(paned),340);
 }
 
-GtkWidget *displays_settings(void) {
-	DispData *dd=g_new0(DispData,1); dd->selected=0;
-	dd->monitors=disp_parse_xrandr(&dd->n_monitors);
-	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
-	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE); dd->root=root;
-	gtk_box_append(GTK_BOX(root),make_page_header("video-display-symbolic","Displays"));
-	gtk_box_append(GTK_BOX(root),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+/* Arrangement canvas, monitor tabs and per-monitor panels */
+static GtkWidget *disp_build_body(DispData *dd) {
 	GtkWidget *paned=gtk_paned_new(GTK_ORIENTATION_VERTICAL);
 	gtk_widget_set_vexpand(paned,TRUE);
 	GtkWidget *cw=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
@@ -2384,13 +4268,9 @@ GtkWidget *displays_settings(void) {
 	gtk_widget_add_css_class(al,"title-4"); gtk_widget_set_halign(al,GTK_ALIGN_START);
 	gtk_widget_set_margin_start(al,16); gtk_widget_set_margin_top(al,12); gtk_widget_set_margin_bottom(al,8);
 	gtk_box_append(GTK_BOX(cw),al);
-	GtkWidget *canvas=gtk_drawing_area_new();
+	GtkWidget *canvas=disp_canvas_new(dd);
 	gtk_widget_set_size_request(canvas,-1,280);
 	gtk_widget_set_vexpand(canvas,TRUE); gtk_widget_set_hexpand(canvas,TRUE); dd->canvas=canvas;
-	gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(canvas),disp_canvas_draw,dd,NULL);
-	GtkGesture *click=gtk_gesture_click_new();
-	g_signal_connect(click,"pressed",G_CALLBACK(disp_canvas_click),dd);
-	gtk_widget_add_controller(canvas,GTK_EVENT_CONTROLLER(click));
 	gtk_box_append(GTK_BOX(cw),canvas);
 	GtkWidget *tab_row=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,8);
 	gtk_widget_set_halign(tab_row,GTK_ALIGN_CENTER);
@@ -2438,7 +4318,38 @@ GtkWidget *displays_settings(void) {
 	gtk_paned_set_shrink_start_child(GTK_PANED(paned),FALSE);
 	gtk_paned_set_shrink_end_child(GTK_PANED(paned),FALSE);
 	g_signal_connect(paned,"map",G_CALLBACK(disp_paned_map_cb),NULL);
-	gtk_box_append(GTK_BOX(root),paned);
+	return paned;
+}
+
+/* Re-read the monitors and replace the page body, keeping the selected
+ * monitor when it is still connected */
+static void disp_page_reload(DispData *dd) {
+	char sel[64]="";
+	if (dd->selected>=0 && dd->selected<dd->n_monitors)
+		g_strlcpy(sel,dd->monitors[dd->selected].name,sizeof(sel));
+	gtk_box_remove(GTK_BOX(dd->root),dd->body);
+	disp_free_monitors(dd->monitors,dd->n_monitors); g_free(dd->tab_btns);
+	dd->monitors=disp_parse_xrandr(&dd->n_monitors); dd->selected=0;
+	dd->body=disp_build_body(dd);
+	gtk_box_append(GTK_BOX(dd->root),dd->body);
+	for (int i=1;i<dd->n_monitors;i++)
+		if (strcmp(dd->monitors[i].name,sel)==0) disp_select_monitor(dd,i);
+}
+
+static void disp_pages_reload(void) {
+	for (GSList *l=disp_pages;l;l=l->next) disp_page_reload(l->data);
+}
+
+GtkWidget *displays_settings(void) {
+	DispData *dd=g_new0(DispData,1); dd->selected=0;
+	dd->monitors=disp_parse_xrandr(&dd->n_monitors);
+	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
+	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE); dd->root=root;
+	gtk_box_append(GTK_BOX(root),make_page_header("video-display-symbolic","Displays"));
+	gtk_box_append(GTK_BOX(root),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	dd->body=disp_build_body(dd);
+	gtk_box_append(GTK_BOX(root),dd->body);
+	disp_pages=g_slist_prepend(disp_pages,dd);
 	g_signal_connect(root,"destroy",G_CALLBACK(disp_page_destroyed),dd);
 	return root;
 }
@@ -2453,125 +4364,151 @@ typedef struct {
 	char   active_port[128];
 	char **ports; int n_ports;
 	int    is_default;
+	int    channels;          /* 0 when unknown (pactl fallback) */
+	char   monitor[256];      /* sinks: monitor source */
 } SndDevice;
 
+typedef struct SndLat SndLat;
+
+/* One server connection.  The page, every volume channel and every level
+ * meter hold a reference; whoever drops the last one disconnects the
+ * context and frees the main loop adapter it was created on. */
+typedef struct {
+	pa_glib_mainloop *ml;
+	pa_context       *ctx;
+} SndPa;
+
+static void snd_pa_clear(gpointer p) {
+	SndPa *pa=p;
+	if (pa->ctx) {
+		pa_context_set_state_callback(pa->ctx,NULL,NULL);
+		pa_context_set_subscribe_callback(pa->ctx,NULL,NULL);
+		pa_context_disconnect(pa->ctx);
+		pa_context_unref(pa->ctx);
+	}
+	pa_glib_mainloop_free(pa->ml);
+}
+static SndPa *snd_pa_ref(SndPa *pa) { return pa?g_rc_box_acquire(pa):NULL; }
+static void snd_pa_unref(SndPa *pa) { if (pa) g_rc_box_release_full(pa,snd_pa_clear); }
+static gboolean snd_pa_is_ready(const SndPa *pa) {
+	return pa&&pa->ctx&&pa_context_get_state(pa->ctx)==PA_CONTEXT_READY;
+}
+
 typedef struct {
 	GtkWidget *root, *out_list, *in_list;
 	guint timer_id; gboolean destroyed;
+	/* libpulse backend (pipewire-pulse compatible); pactl is the fallback */
+	SndPa            *pa;
+	pa_context       *pa_ctx;               /* borrowed from pa */
+	gboolean          pa_ready;
+	guint             pa_retry, pa_backoff;  /* reconnect timer, seconds */
+	GArray           *sinks, *sources;      /* of SndDevice, kept in sync by events */
+	char              def_sink[256], def_source[256];
+	guint             ui_idle;
+	/* device rows by name, see snd_fill_box */
+	GHashTable       *out_rows, *in_rows;
+	guint             row_gen;
+	SndLat           *lat;                  /* Latency tab */
 } SndData;
 
-static SndDevice *snd_get_devices(const char *type, int *out_n)
+/* Copy a field value, dropping trailing blanks, truncating to fit. */
+static void snd_copy_field(char *dst, size_t size, const char *src, size_t len) {
+	while (len && (src[len - 1] == ' ' || src[len - 1] == '\t' || src[len - 1] == '\r')) len--;
+	if (len >= size) len = size - 1;
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+/* Single pass over `pactl list sinks|sources`.  Each line is split once
+ * into indent, key and value; an indent-0 "Sink #"/"Source #" line opens
+ * a record and indent-1 keys fill it.  Indent-2 lines are port entries
+ * only directly under "Ports:" (properties and formats share the same
+ * indent).  Values are copied straight into the record, so nothing is
+ * duplicated per block and a description containing ':' stays whole. */
+static SndDevice *snd_parse_pactl(const char *raw, size_t len, const char *hdr,
+				  const char *def_name, int *out_n)
 {
-	char cmd[128];
-	snprintf(cmd, sizeof(cmd), "pactl list %s 2>/dev/null", type);
-	char *raw_orig = run_cmd_str(cmd);
-	/* Prepend \n so the first entry is found by "\nSink #" / "\nSource #" */
-	char *raw = g_strdup_printf("\n%s", raw_orig);
-	g_free(raw_orig);
-
-	char def_cmd[128];
-	snprintf(def_cmd, sizeof(def_cmd), "%s",
-		 strcmp(type, "sinks") == 0
-		 ? "pactl get-default-sink 2>/dev/null"
-		 : "pactl get-default-source 2>/dev/null");
-	char *def_raw = run_cmd_str(def_cmd);
-	g_strstrip(def_raw);
-
-	const char *entry_hdr = strcmp(type, "sinks") == 0 ? "\nSink #" : "\nSource #";
-	int n = 0;
-	const char *p = raw;
-	while ((p = strstr(p, entry_hdr))) { n++; p++; }
-	if (n == 0) { g_free(raw); g_free(def_raw); *out_n = 0; return NULL; }
-
-	SndDevice *devs = g_new0(SndDevice, n);
-	p = raw;
-
-	for (int i = 0; i < n; i++) {
-		p = strstr(p, entry_hdr);
-		if (!p) break;
-		p++;
-
-		const char *next = strstr(p + 1, entry_hdr);
-		size_t block_len = next ? (size_t)(next - p) : strlen(p);
-		char *block = g_strndup(p, block_len);
-
-		SndDevice *d = &devs[i];
-
-		/* Index */
-		const char *idx_p = strchr(block, '#');
-		if (idx_p) d->index = (uint32_t)atol(idx_p + 1);
-
-		/* Name — "\n\tName: " = 8 chars */
-		char *name_p = strstr(block, "\n\tName: ");
-		if (name_p) {
-			name_p += 8;
-			char *end = strchr(name_p, '\n');
-			size_t len = end ? (size_t)(end - name_p) : strlen(name_p);
-			if (len >= sizeof(d->name)) len = sizeof(d->name) - 1;
-			memcpy(d->name, name_p, len);
-		}
-
-		/* Description — "\n\tDescription: " = 15 chars */
-		char *desc_p = strstr(block, "\n\tDescription: ");
-		if (desc_p) {
-			desc_p += 15;
-			char *end = strchr(desc_p, '\n');
-			size_t len = end ? (size_t)(end - desc_p) : strlen(desc_p);
-			if (len >= sizeof(d->desc)) len = sizeof(d->desc) - 1;
-			memcpy(d->desc, desc_p, len);
-		}
-
-		/* Volume */
-		char *vol_p = strstr(block, "\n\tVolume:");
-		if (vol_p) {
-			char *pct = strstr(vol_p, "%");
-			if (pct) {
-				char *start = pct - 1;
-				while (start > vol_p && *start >= '0' && *start <= '9') start--;
-				d->volume = atoi(start + 1);
+	SndDevice *devs = NULL, *d = NULL;
+	int n = 0, cap = 0;
+	gboolean in_ports = FALSE;
+	size_t hdr_len = strlen(hdr);
+	const char *p = raw, *end = raw + len;
+
+	while (p < end) {
+		const char *nl = memchr(p, '\n', end - p);
+		const char *le = nl ? nl : end;
+		int indent = 0;
+		while (p < le && *p == '\t') { p++; indent++; }
+
+		if (indent == 0) {
+			in_ports = FALSE;
+			if ((size_t)(le - p) > hdr_len && memcmp(p, hdr, hdr_len) == 0) {
+				if (n == cap) {
+					cap = cap ? cap * 2 : 8;
+					devs = g_renew(SndDevice, devs, cap);
+				}
+				d = &devs[n++];
+				memset(d, 0, sizeof(*d));
+				d->index = (uint32_t)strtoul(p + hdr_len, NULL, 10);
 			}
-		}
-
-		/* Mute */
-		char *mute_p = strstr(block, "\n\tMute: ");
-		if (mute_p) d->muted = strncmp(mute_p + 8, "yes", 3) == 0;
-
-		/* Active Port — "\n\tActive Port: " = 15 chars */
-		char *port_p = strstr(block, "\n\tActive Port: ");
-		if (port_p) {
-			port_p += 15;
-			char *end = strchr(port_p, '\n');
-			size_t len = end ? (size_t)(end - port_p) : strlen(port_p);
-			if (len >= sizeof(d->active_port)) len = sizeof(d->active_port) - 1;
-			memcpy(d->active_port, port_p, len);
-		}
-
-		/* Ports list */
-		char *ports_hdr = strstr(block, "\n\tPorts:\n");
-		if (ports_hdr) {
-			char *pp = ports_hdr + 9;
-			while (*pp) {
-				if (pp[0] != '\t' || pp[1] != '\t') break;
-				char *colon = strchr(pp + 2, ':');
-				char *nl    = strchr(pp + 2, '\n');
-				if (!colon || (nl && colon > nl)) { pp = nl ? nl + 1 : pp + 2; continue; }
-				size_t plen = (size_t)(colon - (pp + 2));
-				char port_name[128] = "";
-				if (plen >= sizeof(port_name)) plen = sizeof(port_name) - 1;
-				memcpy(port_name, pp + 2, plen);
-				d->ports = g_realloc(d->ports, (d->n_ports + 1) * sizeof(char *));
-				d->ports[d->n_ports++] = g_strdup(port_name);
-				pp = nl ? nl + 1 : pp + plen + 2;
+		} else if (d && indent == 1) {
+			const char *colon = memchr(p, ':', le - p);
+			size_t klen = colon ? (size_t)(colon - p) : 0;
+			const char *v = colon ? colon + 1 : le;
+			while (v < le && *v == ' ') v++;
+			size_t vlen = le - v;
+			in_ports = FALSE;
+#define KEY(k) (klen == sizeof(k) - 1 && memcmp(p, k, klen) == 0)
+			if      (KEY("Name"))           snd_copy_field(d->name, sizeof(d->name), v, vlen);
+			else if (KEY("Description"))    snd_copy_field(d->desc, sizeof(d->desc), v, vlen);
+			else if (KEY("Active Port"))    snd_copy_field(d->active_port, sizeof(d->active_port), v, vlen);
+			else if (KEY("Monitor Source")) snd_copy_field(d->monitor, sizeof(d->monitor), v, vlen);
+			else if (KEY("Mute"))           d->muted = vlen >= 3 && memcmp(v, "yes", 3) == 0;
+			else if (KEY("Ports"))          in_ports = TRUE;
+			else if (KEY("Volume")) {
+				/* first channel: "front-left: 65536 / 100% / 0.00 dB" */
+				const char *pct = memchr(v, '%', vlen);
+				if (pct) {
+					const char *s = pct;
+					while (s > v && s[-1] >= '0' && s[-1] <= '9') s--;
+					d->volume = atoi(s);
+				}
+			}
+#undef KEY
+		} else if (d && indent == 2 && in_ports) {
+			const char *colon = memchr(p, ':', le - p);
+			if (colon) {
+				char buf[128];
+				snd_copy_field(buf, sizeof(buf), p, colon - p);
+				d->ports = g_renew(char *, d->ports, d->n_ports + 2);
+				d->ports[d->n_ports++] = g_strdup(buf);
+				d->ports[d->n_ports] = NULL;
 			}
 		}
-
-		d->is_default = (d->name[0] && strcmp(d->name, def_raw) == 0);
-		g_free(block);
+		p = nl ? nl + 1 : end;
 	}
 
+	for (int i = 0; i < n; i++)
+		devs[i].is_default = devs[i].name[0] && def_name && strcmp(devs[i].name, def_name) == 0;
+	*out_n = n;
+	return devs;
+}
+
+static SndDevice *snd_get_devices(const char *type, int *out_n)
+{
+	gboolean sinks = strcmp(type, "sinks") == 0;
+	char cmd[128];
+	/* untranslated keys; descriptions stay in whatever encoding pactl gives */
+	snprintf(cmd, sizeof(cmd), "LC_ALL=C pactl list %s 2>/dev/null", type);
+	char *raw = run_cmd_str(cmd);
+	char *def_raw = run_cmd_str(sinks ? "pactl get-default-sink 2>/dev/null"
+					  : "pactl get-default-source 2>/dev/null");
+	g_strstrip(def_raw);
+
+	SndDevice *devs = snd_parse_pactl(raw, strlen(raw), sinks ? "Sink #" : "Source #", def_raw, out_n);
 	g_free(raw);
 	g_free(def_raw);
-	*out_n = n;
+	if (*out_n == 0) { g_free(devs); return NULL; }
 	return devs;
 }
 
@@ -2695,9 +4632,15 @@ static SndDevice *snd_get_devices(const char *type, int *out_n)
 //    return devs;
 //}
 
+static void snd_device_clear(gpointer p) {
+	SndDevice *d=p;
+	for(int j=0;j<d->n_ports;j++)g_free(d->ports[j]);
+	g_free(d->ports); d->ports=NULL; d->n_ports=0;
+}
+
 static void snd_free_devices(SndDevice *devs, int n) {
 	if (!devs) return;
-	for(int i=0;i<n;i++){for(int j=0;j<devs[i].n_ports;j++)g_free(devs[i].ports[j]);g_free(devs[i].ports);}
+	for(int i=0;i<n;i++) snd_device_clear(&devs[i]);
 	g_free(devs);
 }
 
@@ -2705,10 +4648,111 @@ typedef struct { char name[256]; char type[16]; GtkWidget *mute_btn; SndData *sd
 typedef struct { char name[256]; char type[16]; SndData *sd; } SndDefaultData;
 typedef struct { char dev_name[256]; char type[16]; } SndPortData;
 
+/* ------------------------------------------------------------------ */
+/* volume channel: one per slider, latest value wins                    */
+/* ------------------------------------------------------------------ */
+/* A drag produces far more value-changed signals than the server needs.
+ * The channel keeps only the newest volume, has at most one operation
+ * in flight (a libpulse set-volume call, or an async pactl when there
+ * is no context) and issues at most SND_VOL_MAX_OPS_HZ per second.
+ * The newest value is always sent once the previous one completes. */
+#define SND_VOL_MAX_OPS_HZ 30
+
+typedef struct {
+	SndPa      *pa;                  /* NULL: use pactl */
+	char        name[256], type[16];
+	uint32_t    index;
+	int         channels;
+	int         pending;
+	gboolean    has_pending, in_flight;
+	gint64      last_send;
+	guint       timer;
+	guint       n_ops;
+} SndVolChan;
+
+static void snd_vol_chan_clear(gpointer p) {
+	SndVolChan *vc=p;
+	snd_pa_unref(vc->pa);
+}
+static void snd_vol_chan_unref(gpointer p) { g_rc_box_release_full(p,snd_vol_chan_clear); }
+
+static SndVolChan *snd_vol_chan_new(SndPa *pa, const SndDevice *d, const char *type) {
+	SndVolChan *vc=g_rc_box_new0(SndVolChan);
+	vc->pa=snd_pa_ref(pa);
+	g_strlcpy(vc->name,d->name,sizeof(vc->name));
+	g_strlcpy(vc->type,type,sizeof(vc->type));
+	vc->index=d->index; vc->channels=d->channels;
+	return vc;
+}
+
+static void snd_vol_chan_kick(SndVolChan *vc);
+
+static void snd_vol_chan_done(SndVolChan *vc) {
+	vc->in_flight=FALSE;
+	snd_vol_chan_kick(vc);
+	snd_vol_chan_unref(vc);
+}
+static void snd_vol_pa_done(pa_context *c, int success, void *ud) { snd_vol_chan_done(ud); }
+/* a disconnect cancels the operation without running snd_vol_pa_done;
+ * drop its reference here or the channel would keep the connection alive */
+static void snd_vol_pa_state(pa_operation *o, void *ud) {
+	if (pa_operation_get_state(o)==PA_OPERATION_CANCELLED) snd_vol_chan_unref(ud);
+}
+static void snd_vol_pactl_done(GPid pid, gint status, gpointer ud) {
+	g_spawn_close_pid(pid);
+	snd_vol_chan_done(ud);
+}
+
+static gboolean snd_vol_chan_timer(gpointer ud) {
+	SndVolChan *vc=ud;
+	vc->timer=0;
+	snd_vol_chan_kick(vc);
+	return G_SOURCE_REMOVE;
+}
+
+static void snd_vol_chan_kick(SndVolChan *vc) {
+	if (vc->in_flight||!vc->has_pending) return;
+	gint64 now=g_get_monotonic_time(), due=vc->last_send+G_USEC_PER_SEC/SND_VOL_MAX_OPS_HZ;
+	if (now<due) {
+		if (!vc->timer)
+			vc->timer=g_timeout_add_full(G_PRIORITY_DEFAULT,(guint)((due-now)/1000)+1,snd_vol_chan_timer,
+						     g_rc_box_acquire(vc),snd_vol_chan_unref);
+		return;
+	}
+	int val=vc->pending;
+	vc->has_pending=FALSE; vc->in_flight=TRUE; vc->last_send=now; vc->n_ops++;
+
+	if (vc->channels>0&&snd_pa_is_ready(vc->pa)) {
+		pa_cvolume cv;
+		pa_cvolume_set(&cv,vc->channels,(pa_volume_t)((double)val*PA_VOLUME_NORM/100.0+0.5));
+		pa_operation *o=strcmp(vc->type,"sink")==0
+			? pa_context_set_sink_volume_by_index(vc->pa->ctx,vc->index,&cv,snd_vol_pa_done,g_rc_box_acquire(vc))
+			: pa_context_set_source_volume_by_index(vc->pa->ctx,vc->index,&cv,snd_vol_pa_done,g_rc_box_acquire(vc));
+		if (o) {
+			pa_operation_set_state_callback(o,snd_vol_pa_state,vc);
+			pa_operation_unref(o);
+			return;
+		}
+		snd_vol_chan_unref(vc);       /* callback will never run */
+	}
+
+	char verb[32], pct[16];
+	snprintf(verb,sizeof(verb),"set-%s-volume",vc->type);
+	snprintf(pct,sizeof(pct),"%d%%",val);
+	char *argv[]={ "pactl", verb, vc->name, pct, NULL };
+	GPid pid;
+	if (g_spawn_async(NULL,argv,NULL,G_SPAWN_SEARCH_PATH|G_SPAWN_DO_NOT_REAP_CHILD|
+			  G_SPAWN_STDOUT_TO_DEV_NULL|G_SPAWN_STDERR_TO_DEV_NULL,NULL,NULL,&pid,NULL))
+		g_child_watch_add(pid,snd_vol_pactl_done,g_rc_box_acquire(vc));
+	else
+		vc->in_flight=FALSE;
+}
+
 static void snd_vol_changed(GtkRange *range, gpointer ud) {
-	SndVolData *vd=ud; int val=(int)gtk_range_get_value(range);
-	char cmd[512]; snprintf(cmd,sizeof(cmd),"pactl set-%s-volume '%s' %d%% 2>/dev/null",vd->type,vd->name,val);
-	system(cmd);
+	SndVolChan *vc=ud;
+	vc->pending=(int)gtk_range_get_value(range);
+	vc->has_pending=TRUE;
+	snd_vol_chan_kick(vc);
 }
 static void snd_mute_toggled(GtkToggleButton *btn, gpointer ud) {
 	SndVolData *vd=ud; gboolean muted=gtk_toggle_button_get_active(btn);
@@ -2735,11 +4779,519 @@ static char *snd_format_vol(GtkScale *s, double v, gpointer ud) {
 	return g_strdup_printf("%d%%",(int)v);
 }
 
-static GtkWidget *snd_build_device_row(SndDevice *d, const char *type) {
-	GtkWidget *frame=gtk_frame_new(NULL);
-	gtk_widget_add_css_class(frame,"bat-box");
-	gtk_widget_set_margin_bottom(frame,8);
-	GtkWidget *box=gtk_box_new(GTK_ORIENTATION_VERTICAL,10);
+/* ------------------------------------------------------------------ */
+/* level meter and spectrum                                             */
+/* ------------------------------------------------------------------ */
+/* The meter records from a source (a sink's monitor for outputs) only
+ * while it is mapped.  Levels come from a 25 Hz peak-detect stream, so
+ * the server does the reduction and the read callback touches a single
+ * float.  A click switches on the spectrum: a second, low-rate float
+ * stream whose windows are handed to a worker thread for the FFT; the
+ * main loop never waits on it and only picks up the finished bars at
+ * the next frame.  The frame tick runs only while something is moving:
+ * it removes itself once the level, hold and bars have fallen to zero,
+ * and the next sample above the floor adds it back. */
+#define SND_PEAK_RATE     25
+#define SND_SPEC_RATE     24000
+#define SND_FFT_N         1024
+#define SND_FFT_M         (SND_FFT_N / 2)
+#define SND_SPEC_BARS     32
+#define SND_METER_FLOOR_DB (-60.0f)
+
+typedef struct {
+	GMutex   lock;
+	GCond    cond;
+	float    fill[SND_FFT_N];   /* written by the stream callback */
+	int      n_fill;
+	float    window[SND_FFT_N];  /* latest complete window, newest wins */
+	gboolean have_window, stop;
+	float    bars[SND_SPEC_BARS];
+	gboolean bars_new;
+} SndFft;
+
+static void snd_fft_clear(gpointer p) {
+	SndFft *f = p;
+	g_mutex_clear(&f->lock);
+	g_cond_clear(&f->cond);
+}
+static void snd_fft_unref(SndFft *f) { g_atomic_rc_box_release_full(f, snd_fft_clear); }
+
+/* Real FFT as a half-size complex radix-2 transform plus a split step.
+ * Real and imaginary parts live in separate arrays and the butterflies
+ * run over contiguous spans, which the compiler can vectorise. */
+typedef struct {
+	int   rev[SND_FFT_M];
+	float tw_re[SND_FFT_M / 2], tw_im[SND_FFT_M / 2];   /* e^-2πik/M */
+	float rt_re[SND_FFT_M], rt_im[SND_FFT_M];           /* e^-2πik/N */
+	float win[SND_FFT_N];                                /* Hann */
+	float re[SND_FFT_M], im[SND_FFT_M];
+	int   band[SND_SPEC_BARS + 1];                       /* bin edges */
+} SndFftPlan;
+
+static void snd_fft_plan_init(SndFftPlan *p) {
+	int bits = 0;
+	while ((1 << bits) < SND_FFT_M) bits++;
+	for (int i = 0; i < SND_FFT_M; i++) {
+		int r = 0;
+		for (int b = 0; b < bits; b++) if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+		p->rev[i] = r;
+	}
+	for (int k = 0; k < SND_FFT_M / 2; k++) {
+		p->tw_re[k] = cosf(-2 * M_PI * k / SND_FFT_M);
+		p->tw_im[k] = sinf(-2 * M_PI * k / SND_FFT_M);
+	}
+	for (int k = 0; k < SND_FFT_M; k++) {
+		p->rt_re[k] = cosf(-2 * M_PI * k / SND_FFT_N);
+		p->rt_im[k] = sinf(-2 * M_PI * k / SND_FFT_N);
+	}
+	for (int i = 0; i < SND_FFT_N; i++)
+		p->win[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / (SND_FFT_N - 1));
+	/* log-spaced bands from 40 Hz to Nyquist, at least one bin each */
+	double lo = 40.0 * SND_FFT_N / SND_SPEC_RATE, hi = SND_FFT_M;
+	p->band[0] = (int)lo;
+	for (int b = 1; b <= SND_SPEC_BARS; b++) {
+		int e = (int)(lo * pow(hi / lo, (double)b / SND_SPEC_BARS));
+		p->band[b] = MAX(e, p->band[b - 1] + 1);
+	}
+	p->band[SND_SPEC_BARS] = SND_FFT_M;
+}
+
+/* power spectrum of x[0..N-1] into pw[0..N/2-1] */
+static void snd_fft_power(SndFftPlan *p, const float *x, float *pw) {
+	float *re = p->re, *im = p->im;
+	for (int k = 0; k < SND_FFT_M; k++) {
+		int j = p->rev[k];
+		re[k] = x[2 * j]     * p->win[2 * j];
+		im[k] = x[2 * j + 1] * p->win[2 * j + 1];
+	}
+	for (int len = 2; len <= SND_FFT_M; len <<= 1) {
+		int half = len >> 1, step = SND_FFT_M / len;
+		for (int s = 0; s < SND_FFT_M; s += len) {
+			float *ar = re + s, *ai = im + s, *br = re + s + half, *bi = im + s + half;
+			for (int j = 0; j < half; j++) {
+				float wr = p->tw_re[j * step], wi = p->tw_im[j * step];
+				float tr = br[j] * wr - bi[j] * wi, ti = br[j] * wi + bi[j] * wr;
+				br[j] = ar[j] - tr; bi[j] = ai[j] - ti;
+				ar[j] += tr;        ai[j] += ti;
+			}
+		}
+	}
+	for (int k = 0; k < SND_FFT_M; k++) {
+		int   m  = (SND_FFT_M - k) & (SND_FFT_M - 1);
+		float er = 0.5f * (re[k] + re[m]), ei = 0.5f * (im[k] - im[m]);
+		float odr = 0.5f * (im[k] + im[m]), oi = -0.5f * (re[k] - re[m]);
+		float xr = er + p->rt_re[k] * odr - p->rt_im[k] * oi;
+		float xi = ei + p->rt_re[k] * oi + p->rt_im[k] * odr;
+		pw[k] = xr * xr + xi * xi;
+	}
+}
+
+/* loudest bin of each band, 0..1 on the meter's dB scale */
+static void snd_fft_bars(const SndFftPlan *p, const float *pw, float *bars) {
+	/* full-scale sine through the Hann window peaks at (N/4)^2 */
+	const float norm = 1.0f / ((SND_FFT_N / 4.0f) * (SND_FFT_N / 4.0f));
+	for (int b = 0; b < SND_SPEC_BARS; b++) {
+		float m = 0;
+		for (int k = p->band[b]; k < p->band[b + 1]; k++) m = MAX(m, pw[k]);
+		float db = 10.0f * log10f(m * norm + 1e-12f);
+		bars[b] = CLAMP(1.0f - db / SND_METER_FLOOR_DB, 0.0f, 1.0f);
+	}
+}
+
+static gpointer snd_fft_thread(gpointer ud) {
+	SndFft *f = ud;
+	SndFftPlan *p = g_new(SndFftPlan, 1);
+	snd_fft_plan_init(p);
+	float x[SND_FFT_N], pw[SND_FFT_M], bars[SND_SPEC_BARS];
+
+	g_mutex_lock(&f->lock);
+	for (;;) {
+		while (!f->stop && !f->have_window) g_cond_wait(&f->cond, &f->lock);
+		if (f->stop) break;
+		memcpy(x, f->window, sizeof(x));
+		f->have_window = FALSE;
+		g_mutex_unlock(&f->lock);
+
+		snd_fft_power(p, x, pw);
+		snd_fft_bars(p, pw, bars);
+
+		g_mutex_lock(&f->lock);
+		memcpy(f->bars, bars, sizeof(bars));
+		f->bars_new = TRUE;
+	}
+	g_mutex_unlock(&f->lock);
+	g_free(p);
+	snd_fft_unref(f);
+	return NULL;
+}
+
+#define SND_TYPE_METER (snd_meter_get_type())
+G_DECLARE_FINAL_TYPE(SndMeter, snd_meter, SND, METER, GtkWidget)
+
+struct _SndMeter {
+	GtkWidget   parent_instance;
+	SndPa      *pa;
+	char        source[256];
+	pa_stream  *peak, *pcm;
+	float       in_peak;          /* max since the last frame */
+	float       level, hold;      /* 0..1 on the dB scale */
+	gint64      hold_until;
+	guint       tick;
+	gboolean    spectrum;
+	SndFft     *fft;
+	float       bars[SND_SPEC_BARS];
+};
+
+G_DEFINE_FINAL_TYPE(SndMeter, snd_meter, GTK_TYPE_WIDGET)
+
+static float snd_meter_pos(float linear) {
+	if (linear <= 0) return 0;
+	float db = 20.0f * log10f(linear);
+	return CLAMP(1.0f - db / SND_METER_FLOOR_DB, 0.0f, 1.0f);
+}
+
+static gboolean snd_meter_tick(GtkWidget *w, GdkFrameClock *fc, gpointer ud);
+
+/* Restart the frame tick for a sample above the floor. */
+static void snd_meter_wake(SndMeter *m) {
+	if (!m->tick && gtk_widget_get_mapped(GTK_WIDGET(m)))
+		m->tick = gtk_widget_add_tick_callback(GTK_WIDGET(m), snd_meter_tick, NULL, NULL);
+}
+
+static void snd_meter_peak_read(pa_stream *s, size_t nbytes, void *ud) {
+	SndMeter *m = ud;
+	const void *data;
+	while (pa_stream_readable_size(s) > 0) {
+		if (pa_stream_peek(s, &data, &nbytes) < 0) return;
+		if (!nbytes) break;
+		if (data) {
+			const float *v = data;
+			for (size_t i = 0; i < nbytes / sizeof(float); i++)
+				m->in_peak = MAX(m->in_peak, fabsf(v[i]));
+		}
+		pa_stream_drop(s);
+	}
+	if (snd_meter_pos(m->in_peak) > 0) snd_meter_wake(m);
+}
+
+static void snd_meter_pcm_read(pa_stream *s, size_t nbytes, void *ud) {
+	SndMeter *m = ud;
+	const void *data;
+	float peak = 0;
+	while (pa_stream_readable_size(s) > 0) {
+		if (pa_stream_peek(s, &data, &nbytes) < 0) return;
+		if (!nbytes) break;
+		if (data && m->fft) {
+			const float *v = data;
+			size_t n = nbytes / sizeof(float);
+			SndFft *f = m->fft;
+			g_mutex_lock(&f->lock);
+			for (size_t i = 0; i < n; i++) {
+				peak = MAX(peak, fabsf(v[i]));
+				f->fill[f->n_fill++] = v[i];
+				if (f->n_fill == SND_FFT_N) {
+					memcpy(f->window, f->fill, sizeof(f->window));
+					f->n_fill = 0;
+					f->have_window = TRUE;
+					g_cond_signal(&f->cond);
+				}
+			}
+			g_mutex_unlock(&f->lock);
+		}
+		pa_stream_drop(s);
+	}
+	if (snd_meter_pos(peak) > 0) snd_meter_wake(m);
+}
+
+static pa_stream *snd_meter_stream(SndMeter *m, const char *what, uint32_t rate, uint32_t frag,
+				   pa_stream_flags_t flags, pa_stream_request_cb_t cb) {
+	pa_sample_spec ss = { .format = PA_SAMPLE_FLOAT32NE, .rate = rate, .channels = 1 };
+	pa_buffer_attr ba = { .maxlength = (uint32_t)-1, .fragsize = frag };
+	pa_stream *s = pa_stream_new(m->pa->ctx, what, &ss, NULL);
+	if (!s) return NULL;
+	pa_stream_set_read_callback(s, cb, m);
+	if (pa_stream_connect_record(s, m->source, &ba, flags | PA_STREAM_DONT_MOVE |
+				     PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND) < 0) {
+		pa_stream_unref(s);
+		return NULL;
+	}
+	return s;
+}
+
+static void snd_meter_drop_stream(pa_stream **s) {
+	if (!*s) return;
+	pa_stream_set_read_callback(*s, NULL, NULL);
+	pa_stream_disconnect(*s);
+	pa_stream_unref(*s);
+	*s = NULL;
+}
+
+static void snd_meter_stop_spectrum(SndMeter *m) {
+	snd_meter_drop_stream(&m->pcm);
+	if (m->fft) {
+		g_mutex_lock(&m->fft->lock);
+		m->fft->stop = TRUE;
+		g_cond_signal(&m->fft->cond);
+		g_mutex_unlock(&m->fft->lock);
+		snd_fft_unref(m->fft);
+		m->fft = NULL;
+	}
+	memset(m->bars, 0, sizeof(m->bars));
+}
+
+static void snd_meter_start_spectrum(SndMeter *m) {
+	if (m->fft || !snd_pa_is_ready(m->pa)) return;
+	m->fft = g_atomic_rc_box_new0(SndFft);
+	g_mutex_init(&m->fft->lock);
+	g_cond_init(&m->fft->cond);
+	g_thread_unref(g_thread_new("snd-fft", snd_fft_thread, g_atomic_rc_box_acquire(m->fft)));
+	m->pcm = snd_meter_stream(m, "Spectrum", SND_SPEC_RATE, SND_FFT_N / 2 * sizeof(float), 0,
+				  snd_meter_pcm_read);
+	if (!m->pcm) snd_meter_stop_spectrum(m);
+}
+
+static gboolean snd_meter_tick(GtkWidget *w, GdkFrameClock *fc, gpointer ud) {
+	SndMeter *m = SND_METER(w);
+	gint64 now = gdk_frame_clock_get_frame_time(fc);
+	float lv = MAX(snd_meter_pos(m->in_peak), m->level - 0.015f), hold = m->hold;
+	m->in_peak = 0;
+	if (lv >= hold) { hold = lv; m->hold_until = now + G_USEC_PER_SEC; }
+	else if (now > m->hold_until) hold = MAX(lv, hold - 0.01f);
+	gboolean dirty = fabsf(lv - m->level) > 1e-3f || fabsf(hold - m->hold) > 1e-3f;
+	m->level = lv; m->hold = hold;
+
+	if (m->fft) {
+		float bars[SND_SPEC_BARS];
+		gboolean got = FALSE;
+		g_mutex_lock(&m->fft->lock);
+		if (m->fft->bars_new) { memcpy(bars, m->fft->bars, sizeof(bars)); m->fft->bars_new = FALSE; got = TRUE; }
+		g_mutex_unlock(&m->fft->lock);
+		for (int b = 0; b < SND_SPEC_BARS; b++) {
+			float v = MAX(got ? bars[b] : 0.0f, m->bars[b] - 0.02f);
+			v = MAX(v, 0.0f);
+			if (fabsf(v - m->bars[b]) > 1e-3f) dirty = TRUE;
+			m->bars[b] = v;
+		}
+	}
+	if (dirty) gtk_widget_queue_draw(w);
+	if (m->level > 0 || m->hold > 0) return G_SOURCE_CONTINUE;
+	for (int b = 0; b < SND_SPEC_BARS; b++) if (m->bars[b] > 0) return G_SOURCE_CONTINUE;
+	m->tick = 0;                                  /* silent: wait for snd_meter_wake */
+	return G_SOURCE_REMOVE;
+}
+
+static void snd_meter_start(SndMeter *m) {
+	if (!gtk_widget_get_mapped(GTK_WIDGET(m)) || m->peak || !m->source[0] || !snd_pa_is_ready(m->pa))
+		return;
+	m->peak = snd_meter_stream(m, "Peak detect", SND_PEAK_RATE, sizeof(float), PA_STREAM_PEAK_DETECT,
+				   snd_meter_peak_read);
+	if (m->spectrum) snd_meter_start_spectrum(m);
+	if (!m->tick) m->tick = gtk_widget_add_tick_callback(GTK_WIDGET(m), snd_meter_tick, NULL, NULL);
+}
+
+static void snd_meter_stop(SndMeter *m) {
+	snd_meter_drop_stream(&m->peak);
+	snd_meter_stop_spectrum(m);
+	if (m->tick) { gtk_widget_remove_tick_callback(GTK_WIDGET(m), m->tick); m->tick = 0; }
+	m->in_peak = m->level = m->hold = 0;
+}
+
+static void snd_meter_map(GtkWidget *w) {
+	GTK_WIDGET_CLASS(snd_meter_parent_class)->map(w);
+	snd_meter_start(SND_METER(w));
+}
+
+static void snd_meter_unmap(GtkWidget *w) {
+	snd_meter_stop(SND_METER(w));
+	GTK_WIDGET_CLASS(snd_meter_parent_class)->unmap(w);
+}
+
+static void snd_meter_fill_level(GtkSnapshot *s, float x, float y, float w, float h, float pos) {
+	/* green up to -12 dB, amber to -3 dB, red above */
+	static const struct { float end; GdkRGBA c; } seg[] = {
+		{ 0.80f, { 0.30f, 0.75f, 0.35f, 1 } },
+		{ 0.95f, { 0.95f, 0.70f, 0.20f, 1 } },
+		{ 1.00f, { 0.90f, 0.25f, 0.20f, 1 } },
+	};
+	float start = 0;
+	for (guint i = 0; i < G_N_ELEMENTS(seg) && start < pos; i++) {
+		float end = MIN(pos, seg[i].end);
+		gtk_snapshot_append_color(s, &seg[i].c,
+			&GRAPHENE_RECT_INIT(x + start * w, y, (end - start) * w, h));
+		start = seg[i].end;
+	}
+}
+
+static void snd_meter_snapshot(GtkWidget *w, GtkSnapshot *s) {
+	SndMeter *m = SND_METER(w);
+	float W = gtk_widget_get_width(w), H = gtk_widget_get_height(w);
+	GdkRGBA track = { 0.5f, 0.5f, 0.5f, 0.18f }, hold = { 0.9f, 0.9f, 0.9f, 0.9f };
+	float bar_h = MIN(H, 6.0f), bar_y = H - bar_h;
+
+	if (m->spectrum && H > bar_h + 4) {
+		float sh = bar_y - 4, bw = W / SND_SPEC_BARS;
+		GdkRGBA col = { 0.35f, 0.60f, 0.90f, 0.85f };
+		gtk_snapshot_append_color(s, &track, &GRAPHENE_RECT_INIT(0, 0, W, sh));
+		for (int b = 0; b < SND_SPEC_BARS; b++) {
+			float bh = m->bars[b] * sh;
+			if (bh < 0.5f) continue;
+			gtk_snapshot_append_color(s, &col,
+				&GRAPHENE_RECT_INIT(b * bw + 1, sh - bh, MAX(bw - 2, 1), bh));
+		}
+	}
+	gtk_snapshot_append_color(s, &track, &GRAPHENE_RECT_INIT(0, bar_y, W, bar_h));
+	snd_meter_fill_level(s, 0, bar_y, W, bar_h, m->level);
+	if (m->hold > 0.01f)
+		gtk_snapshot_append_color(s, &hold,
+			&GRAPHENE_RECT_INIT(MIN(m->hold * W, W - 2), bar_y, 2, bar_h));
+}
+
+static void snd_meter_set_spectrum(SndMeter *m, gboolean on) {
+	m->spectrum = on;
+	gtk_widget_set_size_request(GTK_WIDGET(m), -1, on ? 64 : 6);
+	if (!on) snd_meter_stop_spectrum(m);
+	else if (m->peak) snd_meter_start_spectrum(m);
+	gtk_widget_queue_draw(GTK_WIDGET(m));
+}
+
+static void snd_meter_clicked(GtkGestureClick *g, int n, double x, double y, gpointer ud) {
+	snd_meter_set_spectrum(ud, !SND_METER(ud)->spectrum);
+}
+
+/* (Re)point the meter at a source; restarts recording if it changed. */
+static void snd_meter_set_source(SndMeter *m, SndPa *pa, const char *source) {
+	if (m->pa == pa && strcmp(m->source, source ? source : "") == 0) return;
+	snd_meter_stop(m);
+	SndPa *old = m->pa;
+	m->pa = snd_pa_ref(pa);
+	snd_pa_unref(old);
+	g_strlcpy(m->source, source ? source : "", sizeof(m->source));
+	snd_meter_start(m);
+}
+
+static void snd_meter_dispose(GObject *obj) {
+	SndMeter *m = SND_METER(obj);
+	snd_meter_stop(m);
+	g_clear_pointer(&m->pa, snd_pa_unref);
+	G_OBJECT_CLASS(snd_meter_parent_class)->dispose(obj);
+}
+
+static void snd_meter_class_init(SndMeterClass *klass) {
+	G_OBJECT_CLASS(klass)->dispose    = snd_meter_dispose;
+	GTK_WIDGET_CLASS(klass)->snapshot = snd_meter_snapshot;
+	GTK_WIDGET_CLASS(klass)->map      = snd_meter_map;
+	GTK_WIDGET_CLASS(klass)->unmap    = snd_meter_unmap;
+}
+
+static void snd_meter_init(SndMeter *m) {
+	gtk_widget_set_size_request(GTK_WIDGET(m), -1, 6);
+	gtk_widget_set_tooltip_text(GTK_WIDGET(m), "Click to show the spectrum");
+	GtkGesture *click = gtk_gesture_click_new();
+	g_signal_connect(click, "pressed", G_CALLBACK(snd_meter_clicked), m);
+	gtk_widget_add_controller(GTK_WIDGET(m), GTK_EVENT_CONTROLLER(click));
+}
+
+static GtkWidget *snd_meter_new(SndPa *pa, const char *source) {
+	SndMeter *m = g_object_new(SND_TYPE_METER, NULL);
+	snd_meter_set_source(m, pa, source);
+	return GTK_WIDGET(m);
+}
+
+/* ------------------------------------------------------------------ */
+/* device rows, updated in place                                        */
+/* ------------------------------------------------------------------ */
+/* Rows are keyed by sink/source name.  A refresh diffs the new device
+ * list against the existing rows: new devices get a row, vanished ones
+ * lose theirs, and for the rest only changed properties are pushed into
+ * the existing widgets with their handlers blocked, so nothing is echoed
+ * back to the server.  External volume updates are ignored while the
+ * slider is held or its channel still has a change on the way. */
+typedef struct {
+	char           name[256];
+	guint          gen;
+	GtkWidget     *frame, *desc_lbl, *def_btn, *mute_btn, *scale, *port_row, *port_dd;
+	GtkWidget     *meter;             /* NULL without a libpulse context */
+	GtkStringList *port_list;
+	SndVolChan    *vc;                /* owned by the scale's handler */
+	gboolean       dragging;
+	gulong         mute_sig, vol_sig, port_sig;
+} SndRow;
+
+static gboolean snd_scale_event(GtkEventControllerLegacy *c, GdkEvent *ev, gpointer ud) {
+	SndRow *row=ud;
+	switch (gdk_event_get_event_type(ev)) {
+	case GDK_BUTTON_PRESS:   case GDK_TOUCH_BEGIN:  row->dragging=TRUE;  break;
+	case GDK_BUTTON_RELEASE: case GDK_TOUCH_END:
+	case GDK_TOUCH_CANCEL:                          row->dragging=FALSE; break;
+	default: break;
+	}
+	return FALSE;
+}
+
+static void snd_row_set_default(SndRow *row, gboolean is_default) {
+	gtk_button_set_label(GTK_BUTTON(row->def_btn),is_default?"Default":"Set Default");
+	gtk_widget_set_sensitive(row->def_btn,!is_default);
+	if (is_default) { gtk_widget_add_css_class(row->def_btn,"suggested-action"); gtk_widget_remove_css_class(row->def_btn,"flat"); }
+	else            { gtk_widget_add_css_class(row->def_btn,"flat"); gtk_widget_remove_css_class(row->def_btn,"suggested-action"); }
+}
+
+static void snd_row_set_ports(SndRow *row, SndDevice *d) {
+	guint n=g_list_model_get_n_items(G_LIST_MODEL(row->port_list));
+	gboolean same=(n==(guint)d->n_ports);
+	for (guint j=0;same&&j<n;j++)
+		same=strcmp(gtk_string_list_get_string(row->port_list,j),d->ports[j])==0;
+	g_signal_handler_block(row->port_dd,row->port_sig);
+	if (!same) {
+		gtk_string_list_splice(row->port_list,0,n,NULL);
+		for (int j=0;j<d->n_ports;j++) gtk_string_list_append(row->port_list,d->ports[j]);
+	}
+	for (int j=0;j<d->n_ports;j++)
+		if (strcmp(d->ports[j],d->active_port)==0 &&
+		    gtk_drop_down_get_selected(GTK_DROP_DOWN(row->port_dd))!=(guint)j)
+			gtk_drop_down_set_selected(GTK_DROP_DOWN(row->port_dd),j);
+	g_signal_handler_unblock(row->port_dd,row->port_sig);
+	gtk_widget_set_visible(row->port_row,d->n_ports>1);
+}
+
+static void snd_row_update(SndRow *row, SndDevice *d) {
+	const char *desc=d->desc[0]?d->desc:d->name;
+	if (strcmp(gtk_label_get_text(GTK_LABEL(row->desc_lbl)),desc)!=0)
+		gtk_label_set_text(GTK_LABEL(row->desc_lbl),desc);
+	if (gtk_widget_get_sensitive(row->def_btn)==!!d->is_default)
+		snd_row_set_default(row,d->is_default);
+
+	if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(row->mute_btn))!=!!d->muted) {
+		g_signal_handler_block(row->mute_btn,row->mute_sig);
+		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(row->mute_btn),d->muted);
+		gtk_button_set_label(GTK_BUTTON(row->mute_btn),d->muted?"🔇 Muted":"🔊 Mute");
+		g_signal_handler_unblock(row->mute_btn,row->mute_sig);
+	}
+
+	/* the index changes when a device is re-created under the same name */
+	row->vc->index=d->index;
+	if (d->channels) row->vc->channels=d->channels;
+	if (!row->dragging && !row->vc->in_flight && !row->vc->has_pending &&
+	    (int)gtk_range_get_value(GTK_RANGE(row->scale))!=d->volume) {
+		g_signal_handler_block(row->scale,row->vol_sig);
+		gtk_range_set_value(GTK_RANGE(row->scale),d->volume);
+		g_signal_handler_unblock(row->scale,row->vol_sig);
+	}
+	snd_row_set_ports(row,d);
+	if (row->meter) {
+		SndMeter *m=SND_METER(row->meter);
+		snd_meter_set_source(m,m->pa,d->monitor[0]?d->monitor:d->name);
+	}
+}
+
+static SndRow *snd_build_device_row(SndData *sd, SndDevice *d, const char *type) {
+	SndRow *row=g_new0(SndRow,1);
+	g_strlcpy(row->name,d->name,sizeof(row->name));
+	GtkWidget *frame=gtk_frame_new(NULL);
+	g_object_set_data_full(G_OBJECT(frame),"snd-row",row,g_free);
+	row->frame=frame;
+	gtk_widget_add_css_class(frame,"bat-box");
+	gtk_widget_set_margin_bottom(frame,8);
+	GtkWidget *box=gtk_box_new(GTK_ORIENTATION_VERTICAL,10);
 	gtk_widget_set_margin_start(box,14); gtk_widget_set_margin_end(box,14);
 	gtk_widget_set_margin_top(box,12);   gtk_widget_set_margin_bottom(box,12);
 	gtk_frame_set_child(GTK_FRAME(frame),box);
@@ -2751,15 +5303,16 @@ static GtkWidget *snd_build_device_row(SndDevice *d, const char *type) {
 	GtkWidget *dl=gtk_label_new(d->desc[0]?d->desc:d->name);
 	gtk_widget_add_css_class(dl,"title-4"); gtk_widget_set_halign(dl,GTK_ALIGN_START);
 	gtk_box_append(GTK_BOX(nb),dl);
+	row->desc_lbl=dl;
 	GtkWidget *nl=gtk_label_new(d->name);
 	gtk_widget_add_css_class(nl,"dim-label"); gtk_widget_add_css_class(nl,"caption");
 	gtk_widget_set_halign(nl,GTK_ALIGN_START); gtk_box_append(GTK_BOX(nb),nl);
 	gtk_box_append(GTK_BOX(hdr),nb);
 	SndDefaultData *dd_data=g_new0(SndDefaultData,1);
 	strncpy(dd_data->name,d->name,sizeof(dd_data->name)-1); strncpy(dd_data->type,type,sizeof(dd_data->type)-1);
-	GtkWidget *def_btn=gtk_button_new_with_label(d->is_default?"Default":"Set Default");
-	if(d->is_default){gtk_widget_add_css_class(def_btn,"suggested-action");gtk_widget_set_sensitive(def_btn,FALSE);}
-	else gtk_widget_add_css_class(def_btn,"flat");
+	GtkWidget *def_btn=gtk_button_new();
+	row->def_btn=def_btn;
+	snd_row_set_default(row,d->is_default);
 	gtk_widget_set_valign(def_btn,GTK_ALIGN_CENTER);
 	g_signal_connect_data(def_btn,"clicked",G_CALLBACK(snd_set_default),dd_data,(GClosureNotify)g_free,0);
 	gtk_box_append(GTK_BOX(hdr),def_btn);
@@ -2768,8 +5321,8 @@ static GtkWidget *snd_build_device_row(SndDevice *d, const char *type) {
 	GtkWidget *mb=gtk_toggle_button_new_with_label(d->muted?"🔇 Muted":"🔊 Mute");
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mb),d->muted);
 	gtk_widget_set_valign(mb,GTK_ALIGN_CENTER); gtk_widget_add_css_class(mb,"flat");
-	vd->mute_btn=mb;
-	g_signal_connect_data(mb,"toggled",G_CALLBACK(snd_mute_toggled),vd,(GClosureNotify)g_free,0);
+	vd->mute_btn=mb; row->mute_btn=mb;
+	row->mute_sig=g_signal_connect_data(mb,"toggled",G_CALLBACK(snd_mute_toggled),vd,(GClosureNotify)g_free,0);
 	gtk_box_append(GTK_BOX(hdr),mb); gtk_box_append(GTK_BOX(box),hdr);
 	GtkWidget *vr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,10);
 	GtkWidget *vl=gtk_label_new("Volume");
@@ -2780,41 +5333,746 @@ static GtkWidget *snd_build_device_row(SndDevice *d, const char *type) {
 	gtk_scale_set_draw_value(GTK_SCALE(vs),TRUE);
 	gtk_scale_set_format_value_func(GTK_SCALE(vs),snd_format_vol,NULL,NULL);
 	gtk_widget_set_hexpand(vs,TRUE); gtk_widget_set_valign(vs,GTK_ALIGN_CENTER);
-	SndVolData *vd2=g_new0(SndVolData,1);
-	strncpy(vd2->name,d->name,sizeof(vd2->name)-1); strncpy(vd2->type,type,sizeof(vd2->type)-1);
-	g_signal_connect_data(vs,"value-changed",G_CALLBACK(snd_vol_changed),vd2,(GClosureNotify)g_free,0);
+	row->scale=vs;
+	row->vc=snd_vol_chan_new(sd->pa_ready?sd->pa:NULL,d,type);
+	row->vol_sig=g_signal_connect_data(vs,"value-changed",G_CALLBACK(snd_vol_changed),
+					   row->vc,(GClosureNotify)snd_vol_chan_unref,0);
+	GtkEventController *lc=gtk_event_controller_legacy_new();
+	gtk_event_controller_set_propagation_phase(lc,GTK_PHASE_CAPTURE);
+	g_signal_connect(lc,"event",G_CALLBACK(snd_scale_event),row);
+	gtk_widget_add_controller(vs,lc);
 	gtk_box_append(GTK_BOX(vr),vs); gtk_box_append(GTK_BOX(box),vr);
-	if (d->n_ports>1) {
-		GtkWidget *pr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,10);
-		GtkWidget *pl=gtk_label_new("Port");
-		gtk_widget_add_css_class(pl,"dim-label"); gtk_widget_set_size_request(pl,60,-1);
-		gtk_widget_set_valign(pl,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(pr),pl);
-		GtkStringList *sl=gtk_string_list_new(NULL); int ai=0;
-		for(int j=0;j<d->n_ports;j++){gtk_string_list_append(sl,d->ports[j]);if(strcmp(d->ports[j],d->active_port)==0)ai=j;}
-		GtkWidget *pd_w=gtk_drop_down_new(G_LIST_MODEL(sl),NULL);
-		gtk_drop_down_set_selected(GTK_DROP_DOWN(pd_w),ai); gtk_widget_set_hexpand(pd_w,TRUE);
-		SndPortData *pd=g_new0(SndPortData,1);
-		strncpy(pd->dev_name,d->name,sizeof(pd->dev_name)-1); strncpy(pd->type,type,sizeof(pd->type)-1);
-		g_signal_connect_data(pd_w,"notify::selected",G_CALLBACK(snd_port_changed),pd,(GClosureNotify)g_free,0);
-		gtk_box_append(GTK_BOX(pr),pd_w); gtk_box_append(GTK_BOX(box),pr);
+	if (sd->pa_ready) {
+		GtkWidget *lr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,10);
+		GtkWidget *ll=gtk_label_new("Level");
+		gtk_widget_add_css_class(ll,"dim-label"); gtk_widget_set_size_request(ll,60,-1);
+		gtk_widget_set_valign(ll,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(lr),ll);
+		row->meter=snd_meter_new(sd->pa,d->monitor[0]?d->monitor:d->name);
+		gtk_widget_set_hexpand(row->meter,TRUE); gtk_widget_set_valign(row->meter,GTK_ALIGN_CENTER);
+		gtk_box_append(GTK_BOX(lr),row->meter); gtk_box_append(GTK_BOX(box),lr);
+	}
+	/* the port row always exists so a device gaining ports needs no rebuild */
+	GtkWidget *pr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,10);
+	GtkWidget *pl=gtk_label_new("Port");
+	gtk_widget_add_css_class(pl,"dim-label"); gtk_widget_set_size_request(pl,60,-1);
+	gtk_widget_set_valign(pl,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(pr),pl);
+	row->port_list=gtk_string_list_new(NULL);
+	GtkWidget *pd_w=gtk_drop_down_new(G_LIST_MODEL(row->port_list),NULL);
+	gtk_widget_set_hexpand(pd_w,TRUE);
+	SndPortData *pd=g_new0(SndPortData,1);
+	strncpy(pd->dev_name,d->name,sizeof(pd->dev_name)-1); strncpy(pd->type,type,sizeof(pd->type)-1);
+	row->port_sig=g_signal_connect_data(pd_w,"notify::selected",G_CALLBACK(snd_port_changed),pd,(GClosureNotify)g_free,0);
+	gtk_box_append(GTK_BOX(pr),pd_w); gtk_box_append(GTK_BOX(box),pr);
+	row->port_row=pr; row->port_dd=pd_w;
+	snd_row_set_ports(row,d);
+	return row;
+}
+
+static void snd_fill_box(SndData *sd, GtkWidget *box, SndDevice *devs, int n, const char *dev_type)
+{
+	GHashTable *rows = (box == sd->out_list) ? sd->out_rows : sd->in_rows;
+	guint gen = ++sd->row_gen;
+	GtkWidget *prev = NULL;
+
+	for (int i = 0; i < n; i++) {
+		SndRow *row = g_hash_table_lookup(rows, devs[i].name);
+		if (row) {
+			snd_row_update(row, &devs[i]);
+		} else {
+			row = snd_build_device_row(sd, &devs[i], dev_type);
+			g_hash_table_insert(rows, row->name, row);
+			gtk_box_append(GTK_BOX(box), row->frame);
+		}
+		row->gen = gen;
+		if (gtk_widget_get_prev_sibling(row->frame) != prev)
+			gtk_box_reorder_child_after(GTK_BOX(box), row->frame, prev);
+		prev = row->frame;
+	}
+
+	/* drop rows whose device went away */
+	GHashTableIter it; gpointer v;
+	g_hash_table_iter_init(&it, rows);
+	while (g_hash_table_iter_next(&it, NULL, &v)) {
+		SndRow *row = v;
+		if (row->gen == gen) continue;
+		g_hash_table_iter_remove(&it);
+		gtk_box_remove(GTK_BOX(box), row->frame);   /* frees the row */
 	}
-	return frame;
 }
 
-static void snd_rebuild_list(GtkWidget *box, const char *pa_type, const char *dev_type)
+static void snd_rebuild_list(SndData *sd, GtkWidget *box, const char *pa_type, const char *dev_type)
 {
-	/* Clear */
-	GtkWidget *c;
-	while ((c = gtk_widget_get_first_child(box)))
-		gtk_box_remove(GTK_BOX(box), c);
-
 	int n = 0;
 	SndDevice *devs = snd_get_devices(pa_type, &n);
-	for (int i = 0; i < n; i++)
-		gtk_box_append(GTK_BOX(box), snd_build_device_row(&devs[i], dev_type));
+	snd_fill_box(sd, box, devs, n, dev_type);
 	snd_free_devices(devs, n);
 }
 
+/* ------------------------------------------------------------------ */
+/* latency: PipeWire clock settings                                     */
+/* ------------------------------------------------------------------ */
+/* The graph's buffer size and rate live in PipeWire's "settings"
+ * metadata object.  Reading it runs pw-metadata on a worker thread that
+ * parses into its own SndClockRead and posts that to an idle, which
+ * copies it into the page if no later read has been started since; a
+ * forced value is written with an async pw-metadata and read back when
+ * that exits.  0 means "not forced", which is also what the Default
+ * entries write.  The tool is used rather than libpipewire's metadata
+ * proxy because this is the only PipeWire-native access in the program:
+ * everything else goes through pipewire-pulse, and two keys read when
+ * the tab opens do not justify a second library and main loop.
+ *
+ * clock.rate and clock.quantum there are only the configured defaults;
+ * a device that asks for another rate or latency runs its driver at
+ * that.  What the graph actually runs at is the running driver node's
+ * quantum and rate, which pw-top reports, so the same worker runs
+ * "pw-top -b -n 2" (the first sample can be empty) and the page shows
+ * that.  With nothing playing, or without pw-top, it falls back to the
+ * metadata and says those values are the configured ones. */
+static const int snd_quanta[] = { 0, 32, 64, 128, 256, 512, 1024, 2048 };
+static const int snd_rates[]  = { 0, 44100, 48000, 88200, 96000, 192000 };
+
+typedef struct {
+	GtkWidget *cur_lbl, *q_dd, *r_dd;
+	gulong     q_sig, r_sig;
+	gboolean   destroyed, available;
+	guint      seq;                    /* bumped by every refresh */
+	int        rate, quantum, force_rate, force_quantum;
+	int        drv_rate, drv_quantum;  /* running driver, 0 when idle */
+} SndClock;
+
+typedef struct {
+	SndClock  *sc;
+	guint      seq;
+	gboolean   available;
+	int        rate, quantum, force_rate, force_quantum;
+	int        drv_rate, drv_quantum;
+} SndClockRead;
+
+static void snd_clock_unref(gpointer p) { g_atomic_rc_box_release(p); }
+
+static int snd_clock_value(const char *out, const char *key) {
+	char pat[64];
+	snprintf(pat, sizeof(pat), "key:'%s' value:'", key);
+	const char *p = strstr(out, pat);
+	return p ? atoi(p + strlen(pat)) : 0;
+}
+
+/* Quantum and rate of the first running driver in the last sample of
+ * "pw-top -b" output.  Followers carry a "+" before their name and are
+ * skipped; a new header line starts a new sample.  FALSE if none ran. */
+static gboolean snd_clock_parse_top(const char *out, int *rate, int *quantum) {
+	*rate = *quantum = 0;
+	gboolean found = FALSE, in_sample = FALSE;
+	char **lines = g_strsplit(out, "\n", -1);
+	for (int i = 0; lines[i]; i++) {
+		const char *l = lines[i];
+		char state;
+		int id, q, r;
+		if (g_str_has_prefix(l, "S ") && strstr(l, " QUANT ")) {   /* header */
+			found = FALSE; in_sample = TRUE;
+			*rate = *quantum = 0;
+			continue;
+		}
+		if (!in_sample || found || sscanf(l, "%c %d %d %d", &state, &id, &q, &r) != 4) continue;
+		if (state != 'R' || q <= 0 || r <= 0 || strstr(l, " + ")) continue;
+		*rate = r; *quantum = q; found = TRUE;
+	}
+	g_strfreev(lines);
+	return found;
+}
+
+static void snd_clock_select(GtkWidget *dd, gulong sig, const int *vals, int n, int v) {
+	for (int i = 0; i < n; i++) {
+		if (vals[i] != v) continue;
+		g_signal_handler_block(dd, sig);
+		gtk_drop_down_set_selected(GTK_DROP_DOWN(dd), i);
+		g_signal_handler_unblock(dd, sig);
+		return;
+	}
+}
+
+static void snd_clock_read_free(gpointer ud) {
+	SndClockRead *r = ud;
+	snd_clock_unref(r->sc);
+	g_free(r);
+}
+
+static gboolean snd_clock_idle(gpointer ud) {
+	SndClockRead *r = ud;
+	SndClock *sc = r->sc;
+	if (sc->destroyed || r->seq != sc->seq) return G_SOURCE_REMOVE;
+	sc->available     = r->available;
+	sc->rate          = r->rate;
+	sc->quantum       = r->quantum;
+	sc->force_rate    = r->force_rate;
+	sc->force_quantum = r->force_quantum;
+	sc->drv_rate      = r->drv_rate;
+	sc->drv_quantum   = r->drv_quantum;
+	gtk_widget_set_sensitive(sc->q_dd, sc->available);
+	gtk_widget_set_sensitive(sc->r_dd, sc->available);
+	if (!sc->available) {
+		gtk_label_set_text(GTK_LABEL(sc->cur_lbl), "PipeWire settings not available");
+		return G_SOURCE_REMOVE;
+	}
+	gboolean running = sc->drv_rate > 0 && sc->drv_quantum > 0;
+	int rate = running ? sc->drv_rate : sc->force_rate ? sc->force_rate : sc->rate;
+	int q    = running ? sc->drv_quantum : sc->force_quantum ? sc->force_quantum : sc->quantum;
+	char buf[160];
+	if (rate > 0 && q > 0)
+		snprintf(buf, sizeof(buf), "%d Hz, %d samples (%.1f ms per cycle)%s", rate, q, q * 1000.0 / rate,
+			 running ? "" : ", configured; nothing is playing");
+	else
+		snprintf(buf, sizeof(buf), "Unknown");
+	gtk_label_set_text(GTK_LABEL(sc->cur_lbl), buf);
+	snd_clock_select(sc->q_dd, sc->q_sig, snd_quanta, G_N_ELEMENTS(snd_quanta), sc->force_quantum);
+	snd_clock_select(sc->r_dd, sc->r_sig, snd_rates,  G_N_ELEMENTS(snd_rates),  sc->force_rate);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer snd_clock_read_thread(gpointer ud) {
+	SndClockRead *r = ud;
+	char *out = run_cmd_str("pw-metadata -n settings 0 2>/dev/null");
+	r->available     = strstr(out, "key:'clock.") != NULL;
+	r->rate          = snd_clock_value(out, "clock.rate");
+	r->quantum       = snd_clock_value(out, "clock.quantum");
+	r->force_rate    = snd_clock_value(out, "clock.force-rate");
+	r->force_quantum = snd_clock_value(out, "clock.force-quantum");
+	g_free(out);
+	if (r->available) {
+		out = run_cmd_str("pw-top -b -n 2 2>/dev/null");
+		snd_clock_parse_top(out, &r->drv_rate, &r->drv_quantum);
+		g_free(out);
+	}
+	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, snd_clock_idle, r, snd_clock_read_free);
+	return NULL;
+}
+
+static void snd_clock_refresh(SndClock *sc) {
+	SndClockRead *r = g_new0(SndClockRead, 1);
+	r->sc  = g_atomic_rc_box_acquire(sc);
+	r->seq = ++sc->seq;
+	g_thread_unref(g_thread_new("snd-clock", snd_clock_read_thread, r));
+}
+
+static void snd_clock_written(GPid pid, gint status, gpointer ud) {
+	g_spawn_close_pid(pid);
+	if (!((SndClock *)ud)->destroyed) snd_clock_refresh(ud);
+}
+
+static void snd_clock_set(SndClock *sc, const char *key, int value) {
+	char val[16];
+	snprintf(val, sizeof(val), "%d", value);
+	char *argv[] = { "pw-metadata", "-n", "settings", "0", (char *)key, val, NULL };
+	GPid pid;
+	if (g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+			  G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &pid, NULL))
+		g_child_watch_add_full(G_PRIORITY_DEFAULT, pid, snd_clock_written,
+				       g_atomic_rc_box_acquire(sc), snd_clock_unref);
+}
+
+static void snd_clock_quantum_changed(GtkDropDown *dd, GParamSpec *ps, gpointer ud) {
+	guint i = gtk_drop_down_get_selected(dd);
+	if (i < G_N_ELEMENTS(snd_quanta)) snd_clock_set(ud, "clock.force-quantum", snd_quanta[i]);
+}
+
+static void snd_clock_rate_changed(GtkDropDown *dd, GParamSpec *ps, gpointer ud) {
+	guint i = gtk_drop_down_get_selected(dd);
+	if (i < G_N_ELEMENTS(snd_rates)) snd_clock_set(ud, "clock.force-rate", snd_rates[i]);
+}
+
+static void snd_clock_destroyed(GtkWidget *w, gpointer ud) {
+	((SndClock *)ud)->destroyed = TRUE;
+	snd_clock_unref(ud);
+}
+
+static GtkWidget *snd_lat_row(GtkWidget *inner, const char *title, GtkWidget *w) {
+	GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(row, 14); gtk_widget_set_margin_end(row, 14);
+	gtk_widget_set_margin_top(row, 10);   gtk_widget_set_margin_bottom(row, 10);
+	GtkWidget *l = gtk_label_new(title);
+	gtk_widget_add_css_class(l, "dim-label");
+	gtk_widget_set_size_request(l, 120, -1);
+	gtk_widget_set_halign(l, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(row), l);
+	gtk_widget_set_hexpand(w, TRUE);
+	gtk_box_append(GTK_BOX(row), w);
+	gtk_box_append(GTK_BOX(inner), row);
+	return row;
+}
+
+static GtkWidget *snd_clock_build_section(void) {
+	SndClock *sc = g_atomic_rc_box_new0(SndClock);
+	GtkWidget *frame = make_section_box("PipeWire Clock");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+
+	sc->cur_lbl = gtk_label_new("Reading\xe2\x80\xa6");
+	gtk_widget_set_halign(sc->cur_lbl, GTK_ALIGN_START);
+	snd_lat_row(inner, "Current", sc->cur_lbl);
+
+	const char *qs[] = { "Default", "32", "64", "128", "256", "512", "1024", "2048", NULL };
+	sc->q_dd = gtk_drop_down_new_from_strings(qs);
+	snd_lat_row(inner, "Force quantum", sc->q_dd);
+	const char *rs[] = { "Default", "44100 Hz", "48000 Hz", "88200 Hz", "96000 Hz", "192000 Hz", NULL };
+	sc->r_dd = gtk_drop_down_new_from_strings(rs);
+	snd_lat_row(inner, "Force rate", sc->r_dd);
+	gtk_widget_set_sensitive(sc->q_dd, FALSE);
+	gtk_widget_set_sensitive(sc->r_dd, FALSE);
+
+	sc->q_sig = g_signal_connect(sc->q_dd, "notify::selected", G_CALLBACK(snd_clock_quantum_changed), sc);
+	sc->r_sig = g_signal_connect(sc->r_dd, "notify::selected", G_CALLBACK(snd_clock_rate_changed), sc);
+	g_signal_connect(frame, "destroy", G_CALLBACK(snd_clock_destroyed), sc);
+	snd_clock_refresh(sc);
+	return frame;
+}
+
+/* ------------------------------------------------------------------ */
+/* latency: round-trip measurement                                      */
+/* ------------------------------------------------------------------ */
+/* Plays short 2 kHz bursts on a sink and listens for them on a source
+ * (a sink's monitor measures the graph alone; a microphone next to the
+ * speaker measures the whole path).  The playback side timestamps each
+ * burst from the stream latency right after writing it, the record
+ * side timestamps each captured sample the same way, and the
+ * difference between the burst and its first loud sample is the round
+ * trip.  Everything runs in stream callbacks on the main loop. */
+#define SND_LAT_RATE   48000
+#define SND_LAT_SHOTS  5
+#define SND_LAT_GAP    (SND_LAT_RATE * 6 / 10)   /* samples between bursts */
+#define SND_LAT_BURST  48                        /* 1 ms */
+
+struct SndLat {
+	GtkWidget     *sink_dd, *src_dd, *btn, *result;
+	GtkStringList *sink_list, *src_list;
+	GPtrArray     *sink_names, *src_names;
+	pa_stream     *play, *rec;
+	guint          timeout;
+	uint64_t       pos, next_shot;            /* playback samples */
+	int            sent;
+	gint64         t_play;                    /* pending burst, monotonic us */
+	float          noise;
+	double         rtt[SND_LAT_SHOTS];
+	int            n_rtt;
+};
+
+static void snd_lat_drop(pa_stream **s) {
+	if (!*s) return;
+	pa_stream_set_read_callback(*s, NULL, NULL);
+	pa_stream_set_write_callback(*s, NULL, NULL);
+	pa_stream_disconnect(*s);
+	pa_stream_unref(*s);
+	*s = NULL;
+}
+
+static int snd_lat_cmp(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void snd_lat_stop(SndLat *l, const char *msg) {
+	snd_lat_drop(&l->play);
+	snd_lat_drop(&l->rec);
+	if (l->timeout) { g_source_remove(l->timeout); l->timeout = 0; }
+	if (!l->btn) return;
+	gtk_widget_set_sensitive(l->btn, TRUE);
+	if (msg) { gtk_label_set_text(GTK_LABEL(l->result), msg); return; }
+	if (!l->n_rtt) {
+		gtk_label_set_text(GTK_LABEL(l->result), "No burst detected \xe2\x80\x94 can the source hear the sink?");
+		return;
+	}
+	qsort(l->rtt, l->n_rtt, sizeof(double), snd_lat_cmp);
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%.1f ms round trip (median of %d, range %.1f\xe2\x80\x93%.1f ms)",
+		 l->rtt[l->n_rtt / 2], l->n_rtt, l->rtt[0], l->rtt[l->n_rtt - 1]);
+	gtk_label_set_text(GTK_LABEL(l->result), buf);
+}
+
+static gboolean snd_lat_timeout(gpointer ud) {
+	SndLat *l = ud;
+	l->timeout = 0;
+	snd_lat_stop(l, NULL);
+	return G_SOURCE_REMOVE;
+}
+
+static void snd_lat_play_cb(pa_stream *s, size_t nbytes, void *ud) {
+	SndLat *l = ud;
+	float *buf;
+	if (pa_stream_begin_write(s, (void **)&buf, &nbytes) < 0 || !buf) return;
+	size_t n = nbytes / sizeof(float);
+	memset(buf, 0, n * sizeof(float));
+
+	int at = -1;
+	pa_usec_t lat; int neg;
+	if (!l->t_play && l->sent < SND_LAT_SHOTS && l->pos + n > l->next_shot) {
+		uint64_t off = l->next_shot > l->pos ? l->next_shot - l->pos : 0;
+		/* only fire once timing is known and the burst fits this write */
+		if (off + SND_LAT_BURST <= n && pa_stream_get_latency(s, &lat, &neg) >= 0) {
+			at = (int)off;
+			for (int i = 0; i < SND_LAT_BURST; i++)
+				buf[at + i] = 0.5f * cosf(2 * M_PI * 2000.0 * i / SND_LAT_RATE);
+		} else {
+			l->next_shot = l->pos + n;
+		}
+	}
+	pa_stream_write(s, buf, n * sizeof(float), NULL, 0, PA_SEEK_RELATIVE);
+	if (at >= 0 && pa_stream_get_latency(s, &lat, &neg) >= 0) {
+		/* latency now covers everything up to the end of this write */
+		l->t_play = g_get_monotonic_time() + (neg ? 0 : (gint64)lat)
+			    - (gint64)((n - at) * G_USEC_PER_SEC / SND_LAT_RATE);
+		l->sent++;
+		l->next_shot = l->pos + at + SND_LAT_GAP;
+	}
+	l->pos += n;
+}
+
+static void snd_lat_rec_cb(pa_stream *s, size_t nbytes, void *ud) {
+	SndLat *l = ud;
+	const void *data;
+	while (pa_stream_readable_size(s) > 0) {
+		if (pa_stream_peek(s, &data, &nbytes) < 0) return;
+		if (!nbytes) break;
+		pa_usec_t lat; int neg;
+		gboolean timed = data && pa_stream_get_latency(s, &lat, &neg) >= 0;
+		/* first sample of the chunk was captured lat ago */
+		gint64 t0 = g_get_monotonic_time() - (timed && !neg ? (gint64)lat : 0);
+		const float *x = data;
+		size_t n = nbytes / sizeof(float);
+		for (size_t i = 0; data && i < n; i++) {
+			float a = fabsf(x[i]);
+			if (!l->t_play || !timed) { l->noise = 0.995f * l->noise + 0.005f * a; continue; }
+			gint64 tc = t0 + (gint64)(i * G_USEC_PER_SEC / SND_LAT_RATE);
+			if (tc > l->t_play + G_USEC_PER_SEC) { l->t_play = 0; continue; }   /* missed */
+			if (tc >= l->t_play - 2000 && a > MAX(0.02f, 8 * l->noise)) {
+				if (l->n_rtt < SND_LAT_SHOTS)
+					l->rtt[l->n_rtt++] = (tc - l->t_play) / 1000.0;
+				l->t_play = 0;
+			}
+		}
+		pa_stream_drop(s);
+	}
+	/* done: finish from an idle rather than tear the stream down inside its own callback */
+	if (l->sent == SND_LAT_SHOTS && !l->t_play && l->rec && l->timeout) {
+		g_source_remove(l->timeout);
+		l->timeout = g_idle_add(snd_lat_timeout, l);
+		l->sent++;
+	}
+}
+
+static void snd_lat_measure(GtkButton *btn, gpointer ud) {
+	SndData *sd = ud;
+	SndLat  *l  = sd->lat;
+	guint si = gtk_drop_down_get_selected(GTK_DROP_DOWN(l->sink_dd));
+	guint ri = gtk_drop_down_get_selected(GTK_DROP_DOWN(l->src_dd));
+	if (!sd->pa_ready || si >= l->sink_names->len || ri >= l->src_names->len) {
+		gtk_label_set_text(GTK_LABEL(l->result), "Needs a PipeWire or PulseAudio connection");
+		return;
+	}
+	snd_lat_stop(l, "Measuring\xe2\x80\xa6");
+	gtk_widget_set_sensitive(l->btn, FALSE);
+	l->pos = 0; l->next_shot = SND_LAT_RATE / 2;
+	l->sent = 0; l->t_play = 0; l->noise = 0; l->n_rtt = 0;
+
+	pa_sample_spec ss = { .format = PA_SAMPLE_FLOAT32NE, .rate = SND_LAT_RATE, .channels = 1 };
+	pa_stream_flags_t fl = PA_STREAM_ADJUST_LATENCY | PA_STREAM_AUTO_TIMING_UPDATE |
+			       PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_DONT_MOVE;
+	pa_buffer_attr rb = { .maxlength = (uint32_t)-1, .fragsize = 256 * sizeof(float) };
+	pa_buffer_attr pb = { .maxlength = (uint32_t)-1, .tlength = 1024 * sizeof(float),
+			      .prebuf = (uint32_t)-1, .minreq = (uint32_t)-1 };
+	l->rec  = pa_stream_new(sd->pa_ctx, "Latency probe", &ss, NULL);
+	l->play = pa_stream_new(sd->pa_ctx, "Latency probe", &ss, NULL);
+	if (!l->rec || !l->play) { snd_lat_stop(l, "Could not create streams"); return; }
+	pa_stream_set_read_callback(l->rec, snd_lat_rec_cb, l);
+	pa_stream_set_write_callback(l->play, snd_lat_play_cb, l);
+	if (pa_stream_connect_record(l->rec, g_ptr_array_index(l->src_names, ri), &rb, fl) < 0 ||
+	    pa_stream_connect_playback(l->play, g_ptr_array_index(l->sink_names, si), &pb, fl, NULL, NULL) < 0) {
+		snd_lat_stop(l, "Could not connect streams");
+		return;
+	}
+	l->timeout = g_timeout_add_seconds(SND_LAT_SHOTS + 3, snd_lat_timeout, l);
+}
+
+/* Keep a device dropdown in step with the libpulse device list,
+ * holding on to the selected device by name. */
+static void snd_lat_sync_list(GtkWidget *dd, GtkStringList *sl, GPtrArray *names, GArray *devs) {
+	gboolean same = names->len == devs->len;
+	for (guint i = 0; same && i < devs->len; i++)
+		same = strcmp(g_ptr_array_index(names, i), g_array_index(devs, SndDevice, i).name) == 0;
+	if (same) return;
+	guint sel = gtk_drop_down_get_selected(GTK_DROP_DOWN(dd));
+	char *keep = sel < names->len ? g_strdup(g_ptr_array_index(names, sel)) : NULL;
+	guint new_sel = 0;
+	g_ptr_array_set_size(names, 0);
+	gtk_string_list_splice(sl, 0, g_list_model_get_n_items(G_LIST_MODEL(sl)), NULL);
+	for (guint i = 0; i < devs->len; i++) {
+		SndDevice *d = &g_array_index(devs, SndDevice, i);
+		g_ptr_array_add(names, g_strdup(d->name));
+		gtk_string_list_append(sl, d->desc[0] ? d->desc : d->name);
+		if ((keep && strcmp(keep, d->name) == 0) || (!keep && d->is_default)) new_sel = i;
+	}
+	gtk_drop_down_set_selected(GTK_DROP_DOWN(dd), new_sel);
+	g_free(keep);
+}
+
+static void snd_lat_sync_devices(SndData *sd) {
+	if (!sd->lat) return;
+	snd_lat_sync_list(sd->lat->sink_dd, sd->lat->sink_list, sd->lat->sink_names, sd->sinks);
+	snd_lat_sync_list(sd->lat->src_dd,  sd->lat->src_list,  sd->lat->src_names,  sd->sources);
+}
+
+static void snd_lat_free(SndLat *l) {
+	l->btn = NULL;
+	snd_lat_stop(l, NULL);
+	g_ptr_array_unref(l->sink_names);
+	g_ptr_array_unref(l->src_names);
+	g_free(l);
+}
+
+static GtkWidget *snd_lat_build_page(SndData *sd) {
+	SndLat *l = g_new0(SndLat, 1);
+	sd->lat = l;
+	l->sink_names = g_ptr_array_new_with_free_func(g_free);
+	l->src_names  = g_ptr_array_new_with_free_func(g_free);
+
+	GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 12);
+	gtk_widget_set_margin_start (box, 16);
+	gtk_widget_set_margin_end   (box, 16);
+	gtk_widget_set_margin_top   (box, 12);
+	gtk_widget_set_margin_bottom(box, 12);
+	gtk_box_append(GTK_BOX(box), snd_clock_build_section());
+
+	GtkWidget *frame = make_section_box("Round-Trip Latency");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+	l->sink_list = gtk_string_list_new(NULL);
+	l->sink_dd   = gtk_drop_down_new(G_LIST_MODEL(l->sink_list), NULL);
+	snd_lat_row(inner, "Play on", l->sink_dd);
+	l->src_list  = gtk_string_list_new(NULL);
+	l->src_dd    = gtk_drop_down_new(G_LIST_MODEL(l->src_list), NULL);
+	snd_lat_row(inner, "Listen on", l->src_dd);
+	l->result = gtk_label_new("Pick a sink's monitor to measure the audio graph alone");
+	gtk_label_set_wrap(GTK_LABEL(l->result), TRUE);
+	gtk_widget_set_halign(l->result, GTK_ALIGN_START);
+	l->btn = gtk_button_new_with_label("Measure");
+	gtk_widget_add_css_class(l->btn, "suggested-action");
+	gtk_widget_set_hexpand(l->btn, FALSE);
+	g_signal_connect(l->btn, "clicked", G_CALLBACK(snd_lat_measure), sd);
+	GtkWidget *row = snd_lat_row(inner, "Result", l->result);
+	gtk_box_append(GTK_BOX(row), l->btn);
+	gtk_box_append(GTK_BOX(box), frame);
+
+	GtkWidget *scr = gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scr), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_widget_set_vexpand(scr, TRUE);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scr), box);
+	return scr;
+}
+
+/* ------------------------------------------------------------------ */
+/* libpulse backend                                                     */
+/* ------------------------------------------------------------------ */
+/* One context on the GLib main loop.  Sink, source and server events
+ * from pa_context_subscribe re-query just the affected object and
+ * update its SndDevice record in place; the rows are synced from the
+ * records in one idle, so a burst of events costs one UI update. */
+static gboolean snd_pa_ui_idle(gpointer ud) {
+	SndData *sd=ud;
+	sd->ui_idle=0;
+	for (guint i=0;i<sd->sinks->len;i++) {
+		SndDevice *d=&g_array_index(sd->sinks,SndDevice,i);
+		d->is_default=strcmp(d->name,sd->def_sink)==0;
+	}
+	for (guint i=0;i<sd->sources->len;i++) {
+		SndDevice *d=&g_array_index(sd->sources,SndDevice,i);
+		d->is_default=strcmp(d->name,sd->def_source)==0;
+	}
+	snd_fill_box(sd,sd->out_list,(SndDevice*)sd->sinks->data,sd->sinks->len,"sink");
+	snd_fill_box(sd,sd->in_list,(SndDevice*)sd->sources->data,sd->sources->len,"source");
+	snd_lat_sync_devices(sd);
+	return G_SOURCE_REMOVE;
+}
+
+static void snd_pa_schedule_ui(SndData *sd) {
+	if (!sd->ui_idle) sd->ui_idle=g_idle_add(snd_pa_ui_idle,sd);
+}
+
+static void snd_pa_upsert(GArray *arr, SndDevice *d) {
+	for (guint i=0;i<arr->len;i++) {
+		SndDevice *o=&g_array_index(arr,SndDevice,i);
+		if (o->index!=d->index) continue;
+		snd_device_clear(o);
+		*o=*d;
+		return;
+	}
+	g_array_append_val(arr,*d);
+}
+
+static void snd_pa_remove(GArray *arr, uint32_t index) {
+	for (guint i=0;i<arr->len;i++)
+		if (g_array_index(arr,SndDevice,i).index==index) { g_array_remove_index(arr,i); return; }
+}
+
+static void snd_pa_fill(SndDevice *d, uint32_t index, const char *name, const char *desc,
+			const pa_cvolume *vol, int mute, const char *active_port) {
+	memset(d,0,sizeof(*d));
+	d->index=index;
+	g_strlcpy(d->name,name?name:"",sizeof(d->name));
+	g_strlcpy(d->desc,desc?desc:"",sizeof(d->desc));
+	d->volume=(int)((pa_cvolume_avg(vol)*100.0+PA_VOLUME_NORM/2)/PA_VOLUME_NORM);
+	d->muted=mute;
+	d->channels=vol->channels;
+	g_strlcpy(d->active_port,active_port?active_port:"",sizeof(d->active_port));
+}
+
+static void snd_pa_sink_cb(pa_context *c, const pa_sink_info *i, int eol, void *ud) {
+	SndData *sd=ud;
+	if (eol) { if (eol>0) snd_pa_schedule_ui(sd); return; }
+	SndDevice d;
+	snd_pa_fill(&d,i->index,i->name,i->description,&i->volume,i->mute,
+		    i->active_port?i->active_port->name:NULL);
+	d.ports=g_new0(char*,i->n_ports+1);
+	for (uint32_t p=0;p<i->n_ports;p++) d.ports[d.n_ports++]=g_strdup(i->ports[p]->name);
+	g_strlcpy(d.monitor,i->monitor_source_name?i->monitor_source_name:"",sizeof(d.monitor));
+	snd_pa_upsert(sd->sinks,&d);
+	snd_pa_schedule_ui(sd);
+}
+
+static void snd_pa_source_cb(pa_context *c, const pa_source_info *i, int eol, void *ud) {
+	SndData *sd=ud;
+	if (eol) { if (eol>0) snd_pa_schedule_ui(sd); return; }
+	SndDevice d;
+	snd_pa_fill(&d,i->index,i->name,i->description,&i->volume,i->mute,
+		    i->active_port?i->active_port->name:NULL);
+	d.ports=g_new0(char*,i->n_ports+1);
+	for (uint32_t p=0;p<i->n_ports;p++) d.ports[d.n_ports++]=g_strdup(i->ports[p]->name);
+	snd_pa_upsert(sd->sources,&d);
+	snd_pa_schedule_ui(sd);
+}
+
+static void snd_pa_server_cb(pa_context *c, const pa_server_info *i, void *ud) {
+	SndData *sd=ud;
+	if (!i) return;
+	g_strlcpy(sd->def_sink,i->default_sink_name?i->default_sink_name:"",sizeof(sd->def_sink));
+	g_strlcpy(sd->def_source,i->default_source_name?i->default_source_name:"",sizeof(sd->def_source));
+	snd_pa_schedule_ui(sd);
+}
+
+static void snd_pa_request_all(SndData *sd) {
+	pa_operation *o;
+	if ((o=pa_context_get_server_info(sd->pa_ctx,snd_pa_server_cb,sd))) pa_operation_unref(o);
+	if ((o=pa_context_get_sink_info_list(sd->pa_ctx,snd_pa_sink_cb,sd))) pa_operation_unref(o);
+	if ((o=pa_context_get_source_info_list(sd->pa_ctx,snd_pa_source_cb,sd))) pa_operation_unref(o);
+}
+
+static void snd_pa_event(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, void *ud) {
+	SndData *sd=ud;
+	pa_operation *o=NULL;
+	gboolean removed=(t&PA_SUBSCRIPTION_EVENT_TYPE_MASK)==PA_SUBSCRIPTION_EVENT_REMOVE;
+	switch (t&PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		if (removed) { snd_pa_remove(sd->sinks,idx); snd_pa_schedule_ui(sd); }
+		else o=pa_context_get_sink_info_by_index(c,idx,snd_pa_sink_cb,sd);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		if (removed) { snd_pa_remove(sd->sources,idx); snd_pa_schedule_ui(sd); }
+		else o=pa_context_get_source_info_by_index(c,idx,snd_pa_source_cb,sd);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		o=pa_context_get_server_info(c,snd_pa_server_cb,sd);
+		break;
+	}
+	if (o) pa_operation_unref(o);
+}
+
+static gboolean snd_refresh_cb(gpointer ud);
+static void snd_pa_lost(SndData *sd);
+
+static void snd_pa_state(pa_context *c, void *ud) {
+	SndData *sd=ud;
+	switch (pa_context_get_state(c)) {
+	case PA_CONTEXT_READY: {
+		sd->pa_ready=TRUE;
+		sd->pa_backoff=0;
+		if (sd->timer_id) { g_source_remove(sd->timer_id); sd->timer_id=0; }
+		/* rows built by pactl or on an earlier connection have no meter
+		 * or hold a dead context: rebuild them all on this one */
+		g_array_set_size(sd->sinks,0);
+		g_array_set_size(sd->sources,0);
+		snd_fill_box(sd,sd->out_list,NULL,0,"sink");
+		snd_fill_box(sd,sd->in_list,NULL,0,"source");
+		pa_context_set_subscribe_callback(c,snd_pa_event,sd);
+		pa_operation *o=pa_context_subscribe(c,PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_SOURCE|
+						       PA_SUBSCRIPTION_MASK_SERVER,NULL,NULL);
+		if (o) pa_operation_unref(o);
+		snd_pa_request_all(sd);
+		break;
+	}
+	case PA_CONTEXT_FAILED:
+	case PA_CONTEXT_TERMINATED:
+		snd_pa_lost(sd);
+		break;
+	default:
+		break;
+	}
+}
+
+static gboolean snd_pa_connect(SndData *sd) {
+	if (!sd->sinks) {
+		sd->sinks=g_array_new(FALSE,TRUE,sizeof(SndDevice));
+		sd->sources=g_array_new(FALSE,TRUE,sizeof(SndDevice));
+		g_array_set_clear_func(sd->sinks,snd_device_clear);
+		g_array_set_clear_func(sd->sources,snd_device_clear);
+	}
+	sd->pa=g_rc_box_new0(SndPa);
+	sd->pa->ml=pa_glib_mainloop_new(NULL);
+	sd->pa->ctx=pa_context_new(pa_glib_mainloop_get_api(sd->pa->ml),"Mr.Settings");
+	sd->pa_ctx=sd->pa->ctx;
+	if (!sd->pa_ctx) return FALSE;
+	pa_context_set_state_callback(sd->pa_ctx,snd_pa_state,sd);
+	return pa_context_connect(sd->pa_ctx,NULL,PA_CONTEXT_NOFLAGS,NULL)>=0;
+}
+
+/* Let go of the current connection.  Callbacks into sd stop now; rows
+ * still holding it release it, and with it the main loop adapter, when
+ * they go. */
+static void snd_pa_drop(SndData *sd) {
+	if (sd->pa_ctx) {
+		pa_context_set_state_callback(sd->pa_ctx,NULL,NULL);
+		pa_context_set_subscribe_callback(sd->pa_ctx,NULL,NULL);
+		pa_context_disconnect(sd->pa_ctx);
+	}
+	g_clear_pointer(&sd->pa,snd_pa_unref);
+	sd->pa_ctx=NULL;
+	sd->pa_ready=FALSE;
+}
+
+/* A context that failed or was terminated never comes back, so try a
+ * fresh one after 1, 2, 4 ... 60 s; pactl keeps the page current in
+ * the meantime. */
+static gboolean snd_pa_retry_cb(gpointer ud) {
+	SndData *sd=ud;
+	sd->pa_retry=0;
+	snd_pa_drop(sd);
+	if (!snd_pa_connect(sd)) snd_pa_lost(sd);
+	return G_SOURCE_REMOVE;
+}
+
+static void snd_pa_lost(SndData *sd) {
+	sd->pa_ready=FALSE;
+	if (!sd->timer_id) {
+		snd_refresh_cb(sd);
+		sd->timer_id=g_timeout_add_seconds(10,snd_refresh_cb,sd);
+	}
+	if (!sd->pa_retry) {
+		sd->pa_backoff=sd->pa_backoff?MIN(sd->pa_backoff*2,60):1;
+		sd->pa_retry=g_timeout_add_seconds(sd->pa_backoff,snd_pa_retry_cb,sd);
+	}
+}
+
+static void snd_pa_disconnect(SndData *sd) {
+	snd_pa_drop(sd);
+	if (sd->sinks)   g_array_unref(sd->sinks);
+	if (sd->sources) g_array_unref(sd->sources);
+}
+
 //static void snd_rebuild_list(GtkWidget *listbox, const char *pa_type, const char *dev_type) {
 //    GtkWidget *c;
 //    while ((c=gtk_widget_get_first_child(listbox))) gtk_list_box_remove(GTK_LIST_BOX(listbox),c);
@@ -2825,19 +6083,28 @@ static void snd_rebuild_list(GtkWidget *box, const char *pa_type, const char *de
 
 static gboolean snd_refresh_cb(gpointer ud) {
 	SndData *sd=ud; if(!sd||sd->destroyed)return G_SOURCE_REMOVE;
-	snd_rebuild_list(sd->out_list,"sinks","sink");
-	snd_rebuild_list(sd->in_list,"sources","source");
+	if (sd->pa_ready) { snd_pa_request_all(sd); return G_SOURCE_CONTINUE; }
+	snd_rebuild_list(sd,sd->out_list,"sinks","sink");
+	snd_rebuild_list(sd,sd->in_list,"sources","source");
 	return G_SOURCE_CONTINUE;
 }
 static void snd_page_destroyed(GtkWidget *w, gpointer ud) {
 	SndData *sd=ud; sd->destroyed=TRUE;
 	if(sd->timer_id){g_source_remove(sd->timer_id);sd->timer_id=0;}
+	if(sd->ui_idle){g_source_remove(sd->ui_idle);sd->ui_idle=0;}
+	if(sd->pa_retry){g_source_remove(sd->pa_retry);sd->pa_retry=0;}
+	snd_lat_free(sd->lat);
+	snd_pa_disconnect(sd);
+	g_hash_table_unref(sd->out_rows);
+	g_hash_table_unref(sd->in_rows);
 	g_free(sd);
 }
 
 GtkWidget *sound_settings(void)
 {
 	SndData *sd = g_new0(SndData, 1);
+	sd->out_rows = g_hash_table_new(g_str_hash, g_str_equal);
+	sd->in_rows  = g_hash_table_new(g_str_hash, g_str_equal);
 
 	GtkWidget *root = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
 	gtk_widget_set_hexpand(root, TRUE);
@@ -2878,7 +6145,7 @@ GtkWidget *sound_settings(void)
 	gtk_widget_set_margin_bottom(out_box, 12);
 	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(out_scr), out_box);
 	gtk_stack_add_titled(GTK_STACK(stack), out_scr, "output", "Output");
-	sd->out_list = out_box;   /* GtkBox — snd_rebuild_list uses gtk_box_append */
+	sd->out_list = out_box;   /* GtkBox — snd_fill_box keeps rows in device order */
 
 	/* ── Input tab: same pattern ── */
 	GtkWidget *in_scr = gtk_scrolled_window_new();
@@ -2895,14 +6162,16 @@ GtkWidget *sound_settings(void)
 	gtk_stack_add_titled(GTK_STACK(stack), in_scr, "input", "Input");
 	sd->in_list = in_box;
 
+	/* ── Latency tab: clock settings and round-trip measurement ── */
+	gtk_stack_add_titled(GTK_STACK(stack), snd_lat_build_page(sd), "latency", "Latency");
+
 	gtk_widget_set_vexpand(stack, TRUE);
 	gtk_box_append(GTK_BOX(root), stack);
 
-	/* Populate */
-	snd_rebuild_list(sd->out_list, "sinks",   "sink");
-	snd_rebuild_list(sd->in_list,  "sources", "source");
-
-	sd->timer_id = g_timeout_add_seconds(10, snd_refresh_cb, sd);
+	/* Populate: events from the server keep the page current; without
+	 * a server connection fall back to polling pactl until one succeeds */
+	if (!snd_pa_connect(sd))
+		snd_pa_lost(sd);
 	g_signal_connect(root, "destroy", G_CALLBACK(snd_page_destroyed), sd);
 	return root;
 }
@@ -3389,136 +6658,1681 @@ static char *bright_format_pct(GtkScale *s, double v, gpointer ud) {
 	return g_strdup_printf("%d%%",(int)v);
 }
 
-typedef struct { char output[64]; } BrightXrandrData;
-static void bright_xrandr_changed(GtkRange *range, gpointer ud) {
-	BrightXrandrData *bd=ud;
-	double val=gtk_range_get_value(range)/100.0;
+typedef struct {
+	char   output[64];
+	RRCrtc crtc;          /* 0 when the output is connected but off */
+	double brightness;
+} BrightOutput;
+
+/* Connected outputs and their current brightness from one screen
+ * resources query plus one gamma read per active CRTC.  xrandr derives
+ * --brightness the same way: the largest channel of the last ramp entry. */
+static BrightOutput *bright_query_outputs(int *out_n) {
+	*out_n = 0;
+	GdkDisplay *gd = gdk_display_get_default();
+	if (!gd || !GDK_IS_X11_DISPLAY(gd)) return NULL;
+	Display *xd = gdk_x11_display_get_xdisplay(gd);
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(xd, DefaultRootWindow(xd));
+	if (!res) return NULL;
+	BrightOutput *outs = g_new0(BrightOutput, MAX(res->noutput, 1));
+	int n = 0;
+	for (int i = 0; i < res->noutput; i++) {
+		XRROutputInfo *oi = XRRGetOutputInfo(xd, res, res->outputs[i]);
+		if (!oi) continue;
+		if (oi->connection == RR_Connected) {
+			BrightOutput *o = &outs[n++];
+			snprintf(o->output, sizeof(o->output), "%s", oi->name);
+			o->crtc = oi->crtc;
+			o->brightness = 1.0;
+			XRRCrtcGamma *g = oi->crtc ? XRRGetCrtcGamma(xd, oi->crtc) : NULL;
+			if (g && g->size > 0) {
+				unsigned short last = MAX(g->red[g->size - 1],
+							  MAX(g->green[g->size - 1], g->blue[g->size - 1]));
+				o->brightness = last / 65535.0;
+			}
+			if (g) XRRFreeGamma(g);
+		}
+		XRRFreeOutputInfo(oi);
+	}
+	XRRFreeScreenResources(res);
+	*out_n = n;
+	return outs;
+}
+
+/* ------------------------------------------------------------------ */
+/* gamma engine: per-CRTC ramps from brightness and colour temperature  */
+/* ------------------------------------------------------------------ */
+/* Ramps are computed in-process and uploaded with XRRSetCrtcGamma on a
+ * private X connection, so slider workers and the night-light timer can
+ * use it without touching GDK's connection.  Each CRTC keeps the last
+ * ramp it uploaded; a request with the same (brightness, kelvin) key is
+ * a no-op, which is what makes the night-light timer almost free.
+ * The connection listens for RandR screen and CRTC changes; the next
+ * request after one re-reads the CRTC list and re-uploads every ramp,
+ * so a hotplugged monitor gets the current brightness and night light. */
+#define GAMMA_NEUTRAL_K 6500.0
+
+typedef struct {
+	RRCrtc   crtc;
+	int      size;
+	double   brightness;
+	int      key_b, key_k;      /* quantised inputs of the cached ramp */
+	guint16 *lut;               /* size * 3: red, green, blue */
+} GammaCrtc;
+
+static GMutex     gamma_lock;
+static Display   *gamma_dpy     = NULL;
+static GammaCrtc *gamma_crtcs   = NULL;
+static int        gamma_n_crtcs = 0;
+static double     gamma_kelvin  = GAMMA_NEUTRAL_K;
+static int        gamma_rr_base = -1;   /* RandR event base, -1 without it */
+
+/* Blackbody white point, normalised so 6500 K is (1, 1, 1).
+ * Tanner Helland's fit of the CIE 1964 10° colour-matching data. */
+static void gamma_whitepoint(double kelvin, double wp[3]) {
+	double t[2] = { CLAMP(kelvin, 1000.0, 40000.0) / 100.0, GAMMA_NEUTRAL_K / 100.0 };
+	double c[2][3];
+	for (int k = 0; k < 2; k++) {
+		double T = t[k];
+		if (T <= 66) {
+			c[k][0] = 255;
+			c[k][1] = 99.4708025861 * log(T) - 161.1195681661;
+			c[k][2] = T <= 19 ? 0 : 138.5177312231 * log(T - 10) - 305.0447927307;
+		} else {
+			c[k][0] = 329.698727446 * pow(T - 60, -0.1332047592);
+			c[k][1] = 288.1221695283 * pow(T - 60, -0.0755148492);
+			c[k][2] = 255;
+		}
+	}
+	for (int i = 0; i < 3; i++)
+		wp[i] = CLAMP(CLAMP(c[0][i], 0.0, 255.0) / c[1][i], 0.0, 1.0);
+}
+
+static void gamma_fill_ramp(guint16 *lut, int size, double brightness, double kelvin) {
+	double wp[3];
+	gamma_whitepoint(kelvin, wp);
+	for (int c = 0; c < 3; c++) {
+		double step = 65535.0 * CLAMP(brightness, 0.0, 1.0) * wp[c] / MAX(size - 1, 1);
+		guint16 *out = lut + c * size;
+		for (int i = 0; i < size; i++) out[i] = (guint16)(i * step + 0.5);
+	}
+}
+
+/* Caller holds gamma_lock */
+static void gamma_upload(GammaCrtc *gc) {
+	int kb = (int)lround(gc->brightness * 1000), kk = (int)lround(gamma_kelvin / 10);
+	if (gc->lut && kb == gc->key_b && kk == gc->key_k) return;
+	if (!gc->lut) gc->lut = g_new(guint16, gc->size * 3);
+	gamma_fill_ramp(gc->lut, gc->size, gc->brightness, gamma_kelvin);
+	gc->key_b = kb; gc->key_k = kk;
+	XRRCrtcGamma *g = XRRAllocGamma(gc->size);
+	memcpy(g->red,   gc->lut,                gc->size * sizeof(guint16));
+	memcpy(g->green, gc->lut + gc->size,     gc->size * sizeof(guint16));
+	memcpy(g->blue,  gc->lut + gc->size * 2, gc->size * sizeof(guint16));
+	XRRSetCrtcGamma(gamma_dpy, gc->crtc, g);
+	XRRFreeGamma(g);
+}
+
+/* Caller holds gamma_lock.  Reads the CRTC list; a CRTC seen before
+ * keeps its brightness but not its cached ramp, since a mode set may
+ * have reset the hardware table.  New ones start from the ramp they
+ * have now. */
+static void gamma_enumerate_locked(void) {
+	GammaCrtc *old = gamma_crtcs;
+	int n_old = gamma_n_crtcs;
+	gamma_crtcs = NULL; gamma_n_crtcs = 0;
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(gamma_dpy, DefaultRootWindow(gamma_dpy));
+	if (res) {
+		gamma_crtcs = g_new0(GammaCrtc, MAX(res->ncrtc, 1));
+		for (int i = 0; i < res->ncrtc; i++) {
+			GammaCrtc *gc = &gamma_crtcs[gamma_n_crtcs];
+			gc->crtc = res->crtcs[i];
+			gc->size = XRRGetCrtcGammaSize(gamma_dpy, gc->crtc);
+			if (gc->size <= 1) continue;
+			gc->brightness = -1;
+			for (int j = 0; j < n_old; j++)
+				if (old[j].crtc == gc->crtc) gc->brightness = old[j].brightness;
+			if (gc->brightness < 0) {
+				gc->brightness = 1.0;
+				XRRCrtcGamma *g = XRRGetCrtcGamma(gamma_dpy, gc->crtc);
+				if (g && g->size > 0)
+					gc->brightness = MAX(g->red[g->size - 1],
+							     MAX(g->green[g->size - 1], g->blue[g->size - 1])) / 65535.0;
+				if (g) XRRFreeGamma(g);
+			}
+			gamma_n_crtcs++;
+		}
+		XRRFreeScreenResources(res);
+	}
+	for (int j = 0; j < n_old; j++) g_free(old[j].lut);
+	g_free(old);
+}
+
+/* Caller holds gamma_lock.  Drains the private connection; TRUE when
+ * RandR reported a screen or CRTC change since the last call. */
+static gboolean gamma_changed_locked(void) {
+	gboolean changed = FALSE;
+	while (XPending(gamma_dpy)) {
+		XEvent ev;
+		XNextEvent(gamma_dpy, &ev);
+		if (gamma_rr_base < 0) continue;
+		if (ev.type == gamma_rr_base + RRScreenChangeNotify) {
+			XRRUpdateConfiguration(&ev);
+			changed = TRUE;
+		} else if (ev.type == gamma_rr_base + RRNotify) {
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+/* Caller holds gamma_lock */
+static gboolean gamma_init_locked(void) {
+	if (gamma_dpy) {
+		if (gamma_changed_locked()) {
+			gamma_enumerate_locked();
+			for (int i = 0; i < gamma_n_crtcs; i++) gamma_upload(&gamma_crtcs[i]);
+		}
+		return TRUE;
+	}
+	if (!(gamma_dpy = XOpenDisplay(NULL))) return FALSE;
+	int err;
+	if (XRRQueryExtension(gamma_dpy, &gamma_rr_base, &err))
+		XRRSelectInput(gamma_dpy, DefaultRootWindow(gamma_dpy),
+			       RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+	else
+		gamma_rr_base = -1;
+	gamma_enumerate_locked();
+	return TRUE;
+}
+
+static gboolean gamma_set_brightness(RRCrtc crtc, double brightness) {
+	gboolean ok = FALSE;
+	g_mutex_lock(&gamma_lock);
+	if (gamma_init_locked()) {
+		for (int i = 0; i < gamma_n_crtcs; i++) {
+			if (gamma_crtcs[i].crtc != crtc) continue;
+			gamma_crtcs[i].brightness = brightness;
+			gamma_upload(&gamma_crtcs[i]);
+			ok = TRUE;
+		}
+		XFlush(gamma_dpy);
+	}
+	g_mutex_unlock(&gamma_lock);
+	return ok;
+}
+
+static void gamma_set_kelvin(double kelvin) {
+	g_mutex_lock(&gamma_lock);
+	gamma_kelvin = kelvin;
+	if (gamma_init_locked()) {
+		for (int i = 0; i < gamma_n_crtcs; i++) gamma_upload(&gamma_crtcs[i]);
+		XFlush(gamma_dpy);
+	}
+	g_mutex_unlock(&gamma_lock);
+}
+
+/* ------------------------------------------------------------------ */
+/* night light schedule                                                 */
+/* ------------------------------------------------------------------ */
+/* ~/.config/mrrobotos/mrsettings/brightness/nightlight holds the       */
+/* schedule; the colour fades in after Start and out before End over     */
+/* NIGHT_FADE_MIN minutes, interpolated in mired space.                  */
+#define NIGHT_FADE_MIN  30
+#define NIGHT_TICK_SEC  30
+
+typedef struct {
+	gboolean enabled;
+	int      kelvin, start_h, end_h;
+	guint    timer_id;
+	guint    save_timer;
+} NightLight;
+
+static NightLight night = { FALSE, 4000, 20, 7, 0, 0 };
+
+static char *night_path(void) {
+	return g_build_filename(g_get_user_config_dir(), "mrrobotos", "mrsettings",
+				"brightness", "nightlight", NULL);
+}
+
+static void night_load(void) {
+	char *path = night_path();
+	GKeyFile *kf = g_key_file_new();
+	if (g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL)) {
+		night.enabled = g_key_file_get_boolean(kf, "NightLight", "Enabled", NULL);
+		int k = g_key_file_get_integer(kf, "NightLight", "Temperature", NULL);
+		if (k >= 1000) night.kelvin = k;
+		if (g_key_file_has_key(kf, "NightLight", "Start", NULL))
+			night.start_h = CLAMP(g_key_file_get_integer(kf, "NightLight", "Start", NULL), 0, 23);
+		if (g_key_file_has_key(kf, "NightLight", "End", NULL))
+			night.end_h = CLAMP(g_key_file_get_integer(kf, "NightLight", "End", NULL), 0, 23);
+	}
+	g_key_file_free(kf);
+	g_free(path);
+}
+
+static void night_save(void) {
+	char *path = night_path();
+	char *dir  = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+	GKeyFile *kf = g_key_file_new();
+	g_key_file_set_boolean(kf, "NightLight", "Enabled",     night.enabled);
+	g_key_file_set_integer(kf, "NightLight", "Temperature", night.kelvin);
+	g_key_file_set_integer(kf, "NightLight", "Start",       night.start_h);
+	g_key_file_set_integer(kf, "NightLight", "End",         night.end_h);
+	g_key_file_save_to_file(kf, path, NULL);
+	g_key_file_free(kf);
+	g_free(dir); g_free(path);
+}
+
+static double night_target_kelvin(void) {
+	if (!night.enabled) return GAMMA_NEUTRAL_K;
+	GDateTime *now = g_date_time_new_now_local();
+	double m = g_date_time_get_hour(now) * 60 + g_date_time_get_minute(now)
+		   + g_date_time_get_seconds(now) / 60.0;
+	g_date_time_unref(now);
+	double len   = ((night.end_h - night.start_h + 24) % 24) * 60;
+	double since = fmod(m - night.start_h * 60 + 1440, 1440);
+	if (len == 0) len = 1440;
+	double f = since < len ? MIN(1.0, MIN(since, len - since) / NIGHT_FADE_MIN) : 0.0;
+	double mired = 1e6 / GAMMA_NEUTRAL_K + (1e6 / night.kelvin - 1e6 / GAMMA_NEUTRAL_K) * f;
+	return 1e6 / mired;
+}
+
+static gboolean night_tick(gpointer unused) {
+	gamma_set_kelvin(night_target_kelvin());
+	if (night.enabled) return G_SOURCE_CONTINUE;
+	night.timer_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void night_update(void) {
+	night_tick(NULL);
+	if (night.enabled && !night.timer_id)
+		night.timer_id = g_timeout_add_seconds(NIGHT_TICK_SEC, night_tick, NULL);
+}
+
+/* Started from an idle at launch, like the display hotplug watcher */
+static gboolean night_init(gpointer unused) {
+	night_load();
+	if (night.enabled) night_update();
+	return G_SOURCE_REMOVE;
+}
+
+/* ------------------------------------------------------------------ */
+/* apply channel: one per slider, latest value wins                     */
+/* ------------------------------------------------------------------ */
+/* A slider drag emits value-changed far faster than an apply can run.
+ * The channel keeps only the newest requested value, runs at most one
+ * apply at a time on a worker thread and never more often than its
+ * rate; a release flushes the pending value at once.  The rate is
+ * MaxApplyHz in ~/.config/mrrobotos/mrsettings/brightness/apply
+ * ([Brightness] group), BRIGHT_MAX_APPLY_HZ when unset. */
+#define BRIGHT_MAX_APPLY_HZ 30
+#define BRIGHT_APPLY_HZ_MIN 1
+#define BRIGHT_APPLY_HZ_MAX 240
+
+typedef struct BrightChan BrightChan;
+struct BrightChan {
+	GMutex   lock;
+	GCond    cond;
+	double   pending;
+	gboolean has_pending, in_flight, flush;
+	gint64   last_apply, min_interval;   /* monotonic us */
+	guint    n_applies;
+	char     output[64];
+	RRCrtc   crtc;
+	void   (*apply)(BrightChan *bc, double value);
+};
+
+static void bright_chan_clear(gpointer p) {
+	BrightChan *bc = p;
+	g_mutex_clear(&bc->lock);
+	g_cond_clear(&bc->cond);
+}
+
+static char *bright_apply_path(void) {
+	return g_build_filename(g_get_user_config_dir(), "mrrobotos", "mrsettings",
+				"brightness", "apply", NULL);
+}
+
+static int bright_apply_hz(void) {
+	char *path = bright_apply_path();
+	GKeyFile *kf = g_key_file_new();
+	int hz = BRIGHT_MAX_APPLY_HZ;
+	if (g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL) &&
+	    g_key_file_has_key(kf, "Brightness", "MaxApplyHz", NULL))
+		hz = CLAMP(g_key_file_get_integer(kf, "Brightness", "MaxApplyHz", NULL),
+			   BRIGHT_APPLY_HZ_MIN, BRIGHT_APPLY_HZ_MAX);
+	g_key_file_free(kf);
+	g_free(path);
+	return hz;
+}
+
+static BrightChan *bright_chan_new(const char *output, int hz,
+				   void (*apply)(BrightChan *, double)) {
+	BrightChan *bc = g_atomic_rc_box_new0(BrightChan);
+	g_mutex_init(&bc->lock);
+	g_cond_init(&bc->cond);
+	bc->min_interval = G_USEC_PER_SEC / CLAMP(hz, BRIGHT_APPLY_HZ_MIN, BRIGHT_APPLY_HZ_MAX);
+	bc->apply = apply;
+	snprintf(bc->output, sizeof(bc->output), "%s", output);
+	return bc;
+}
+
+static void bright_chan_unref(gpointer p) {
+	g_atomic_rc_box_release_full(p, bright_chan_clear);
+}
+
+static gpointer bright_chan_thread(gpointer p) {
+	BrightChan *bc = p;
+	g_mutex_lock(&bc->lock);
+	while (bc->has_pending) {
+		gint64 due = bc->last_apply + bc->min_interval;
+		while (!bc->flush && g_get_monotonic_time() < due)
+			g_cond_wait_until(&bc->cond, &bc->lock, due);
+		double v = bc->pending;
+		bc->has_pending = bc->flush = FALSE;
+		g_mutex_unlock(&bc->lock);
+		bc->apply(bc, v);
+		g_mutex_lock(&bc->lock);
+		bc->last_apply = g_get_monotonic_time();
+		bc->n_applies++;
+	}
+	bc->in_flight = FALSE;
+	g_mutex_unlock(&bc->lock);
+	bright_chan_unref(bc);
+	return NULL;
+}
+
+static void bright_chan_push(BrightChan *bc, double value) {
+	g_mutex_lock(&bc->lock);
+	bc->pending = value;
+	bc->has_pending = TRUE;
+	if (!bc->in_flight) {
+		bc->in_flight = TRUE;
+		g_thread_unref(g_thread_new("bright-apply", bright_chan_thread, g_atomic_rc_box_acquire(bc)));
+	}
+	g_mutex_unlock(&bc->lock);
+}
+
+static void bright_chan_flush(BrightChan *bc) {
+	g_mutex_lock(&bc->lock);
+	if (bc->has_pending) {
+		bc->flush = TRUE;
+		g_cond_signal(&bc->cond);
+	}
+	g_mutex_unlock(&bc->lock);
+}
+
+static void bright_xrandr_apply(BrightChan *bc, double value) {
+	if (bc->crtc && gamma_set_brightness(bc->crtc, value)) return;
+	/* no private X connection or output is off: let xrandr handle it */
 	char cmd[256];
-	snprintf(cmd,sizeof(cmd),"xrandr --output %s --brightness %.2f 2>/dev/null",bd->output,val);
+	snprintf(cmd,sizeof(cmd),"xrandr --output %s --brightness %.2f 2>/dev/null",bc->output,value);
 	system(cmd);
 }
 
-GtkWidget *brightness_settings(void) {
-	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
-	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
-	gtk_box_append(GTK_BOX(root),make_page_header("display-brightness-symbolic","Brightness"));
-	gtk_box_append(GTK_BOX(root),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
-	GtkWidget *scr=gtk_scrolled_window_new();
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scr),GTK_POLICY_NEVER,GTK_POLICY_AUTOMATIC);
-	gtk_widget_set_vexpand(scr,TRUE);
-	GtkWidget *content=gtk_box_new(GTK_ORIENTATION_VERTICAL,16);
-	gtk_widget_set_margin_start(content,24); gtk_widget_set_margin_end(content,24);
-	gtk_widget_set_margin_top(content,20);   gtk_widget_set_margin_bottom(content,24);
-	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scr),content);
-	gtk_box_append(GTK_BOX(root),scr);
-	/* per-monitor xrandr brightness only — no hardcoded intel */
-	GtkWidget *mon_frame=make_section_box("Monitor Brightness");
-	GtkWidget *mon_box=g_object_get_data(G_OBJECT(mon_frame),"inner-box");
-	char *xr=run_cmd_str("xrandr --query 2>/dev/null | grep ' connected' | awk '{print $1}'");
-	char **outputs=g_strsplit(xr,"\n",-1); g_free(xr);
-	gboolean any=FALSE;
-	for (int i=0;outputs[i]&&outputs[i][0];i++) {
-		any=TRUE; const char *out=outputs[i];
-		char cmd[256];
-		snprintf(cmd,sizeof(cmd),
-			 "xrandr --verbose 2>/dev/null | awk '/^%s /,/^[^ ]/' | grep -i 'Brightness:' | head -1 | awk '{print $2}'",out);
-		char *bs=run_cmd_str(cmd); g_strstrip(bs);
-		double cb=bs[0]?atof(bs):1.0; g_free(bs);
-		GtkWidget *mr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,12);
-		gtk_widget_set_margin_start(mr,14); gtk_widget_set_margin_end(mr,14);
-		gtk_widget_set_margin_top(mr,10);   gtk_widget_set_margin_bottom(mr,10);
-		GtkWidget *mi=gtk_image_new_from_icon_name(strncmp(out,"eDP",3)==0?"computer-symbolic":"video-display-symbolic");
-		gtk_image_set_pixel_size(GTK_IMAGE(mi),18); gtk_widget_set_valign(mi,GTK_ALIGN_CENTER);
-		gtk_box_append(GTK_BOX(mr),mi);
-		char friendly[64];
-		if      (strncmp(out,"eDP",3)==0)  snprintf(friendly,sizeof(friendly),"Built-in (%s)",out);
-		else if (strncmp(out,"HDMI",4)==0) snprintf(friendly,sizeof(friendly),"HDMI (%s)",out);
-		else if (strncmp(out,"DP",2)==0)   snprintf(friendly,sizeof(friendly),"DisplayPort (%s)",out);
-		else                               snprintf(friendly,sizeof(friendly),"%s",out);
-		GtkWidget *ml=gtk_label_new(friendly);
-		gtk_widget_add_css_class(ml,"dim-label"); gtk_widget_set_size_request(ml,160,-1);
-		gtk_widget_set_valign(ml,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(mr),ml);
-		GtkWidget *ms=gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,10,100,1);
-		gtk_range_set_value(GTK_RANGE(ms),CLAMP(cb*100.0,10.0,100.0));
-		gtk_scale_set_draw_value(GTK_SCALE(ms),TRUE);
-		gtk_scale_set_format_value_func(GTK_SCALE(ms),bright_format_pct,NULL,NULL);
-		gtk_widget_set_hexpand(ms,TRUE);
-		BrightXrandrData *bd=g_new0(BrightXrandrData,1);
-		strncpy(bd->output,out,sizeof(bd->output)-1);
-		g_signal_connect_data(ms,"value-changed",G_CALLBACK(bright_xrandr_changed),bd,(GClosureNotify)g_free,0);
-		gtk_box_append(GTK_BOX(mr),ms); gtk_box_append(GTK_BOX(mon_box),mr);
-		if (outputs[i+1]&&outputs[i+1][0])
-			gtk_box_append(GTK_BOX(mon_box),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+static void bright_xrandr_changed(GtkRange *range, gpointer ud) {
+	bright_chan_push(ud, gtk_range_get_value(range)/100.0);
+}
+
+/* GtkRange claims its own gesture, so watch raw events for the release */
+static gboolean bright_scale_event(GtkEventControllerLegacy *c, GdkEvent *ev, gpointer ud) {
+	GdkEventType t = gdk_event_get_event_type(ev);
+	if (t == GDK_BUTTON_RELEASE || t == GDK_TOUCH_END || t == GDK_KEY_RELEASE)
+		bright_chan_flush(ud);
+	return FALSE;
+}
+
+static void bright_attach_chan(GtkWidget *scale, BrightChan *bc) {
+	g_signal_connect_data(scale,"value-changed",G_CALLBACK(bright_xrandr_changed),
+			      bc,(GClosureNotify)bright_chan_unref,0);
+	GtkEventController *lc=gtk_event_controller_legacy_new();
+	gtk_event_controller_set_propagation_phase(lc,GTK_PHASE_CAPTURE);
+	g_signal_connect_data(lc,"event",G_CALLBACK(bright_scale_event),
+			      g_atomic_rc_box_acquire(bc),(GClosureNotify)bright_chan_unref,0);
+	gtk_widget_add_controller(scale,lc);
+}
+
+/* ------------------------------------------------------------------ */
+/* hardware backlight: /sys/class/backlight + logind SetBrightness      */
+/* ------------------------------------------------------------------ */
+/* Unlike xrandr --brightness this changes the panel's real backlight.
+ * Writes go through org.freedesktop.login1.Session.SetBrightness, which
+ * lets the active session user set it without root or a subprocess.
+ * The system bus is fetched asynchronously while the page is built;
+ * values set before it arrives wait in `queued`. */
+#define BL_SYSFS     "/sys/class/backlight"
+#define BL_EXPONENT  4.0     /* perceptual curve: raw = max * pct^4 */
+#define BL_RAMP_MS   180
+
+typedef struct {
+	const char      *sysfs;            /* BL_SYSFS; tests use a fake tree */
+	char             name[64];
+	int              max, cur;         /* raw sysfs units */
+	int              ramp_from, ramp_to;
+	gint64           ramp_t0;
+	guint            tick_id;
+	gboolean         in_flight, bus_wait;
+	int              queued;           /* -1 when nothing is waiting */
+	GDBusConnection *bus;
+} BlDevice;
+
+static gboolean bl_read_int(const char *sysfs, const char *dev, const char *attr, int *out) {
+	char path[PATH_MAX], buf[32];
+	snprintf(path, sizeof(path), "%s/%s/%s", sysfs, dev, attr);
+	FILE *f = fopen(path, "r");
+	if (!f) return FALSE;
+	gboolean ok = fgets(buf, sizeof(buf), f) != NULL;
+	fclose(f);
+	if (ok) *out = atoi(buf);
+	return ok;
+}
+
+static int bl_to_raw(const BlDevice *bl, double pct) {
+	int raw = (int)lround(bl->max * pow(CLAMP(pct, 0.0, 100.0) / 100.0, BL_EXPONENT));
+	return MAX(raw, 1);   /* never switch the panel fully off from a slider */
+}
+
+static double bl_to_pct(const BlDevice *bl, int raw) {
+	if (bl->max <= 0) return 100.0;
+	return 100.0 * pow(CLAMP(raw, 0, bl->max) / (double)bl->max, 1.0 / BL_EXPONENT);
+}
+
+static void bl_device_clear(gpointer p) {
+	BlDevice *bl = p;
+	g_clear_object(&bl->bus);
+}
+
+static void bl_device_unref(gpointer p) {
+	g_rc_box_release_full(p, bl_device_clear);
+}
+
+/* Enumerate backlight devices; firmware interfaces first, since raw
+ * ones are often exposed alongside them for the same panel. */
+static GPtrArray *bl_enumerate(const char *sysfs) {
+	static const char *types[] = { "firmware", "platform", "raw" };
+	GPtrArray *devs = g_ptr_array_new_with_free_func(bl_device_unref);
+	DIR *dir = opendir(sysfs);
+	if (!dir) return devs;
+	for (guint t = 0; t < G_N_ELEMENTS(types); t++) {
+		struct dirent *de;
+		rewinddir(dir);
+		while ((de = readdir(dir))) {
+			if (de->d_name[0] == '.') continue;
+			char tp[PATH_MAX], *type = NULL;
+			snprintf(tp, sizeof(tp), "%s/%s/type", sysfs, de->d_name);
+			if (!g_file_get_contents(tp, &type, NULL, NULL)) continue;
+			gboolean match = strcmp(g_strstrip(type), types[t]) == 0;
+			g_free(type);
+			if (!match) continue;
+			BlDevice *bl = g_rc_box_new0(BlDevice);
+			bl->sysfs = sysfs;
+			snprintf(bl->name, sizeof(bl->name), "%s", de->d_name);
+			bl->queued = -1;
+			bl->bus_wait = TRUE;
+			if (!bl_read_int(sysfs, bl->name, "max_brightness", &bl->max) || bl->max <= 0 ||
+			    (!bl_read_int(sysfs, bl->name, "actual_brightness", &bl->cur) &&
+			     !bl_read_int(sysfs, bl->name, "brightness", &bl->cur))) {
+				bl_device_unref(bl);
+				continue;
+			}
+			g_ptr_array_add(devs, bl);
+		}
+	}
+	closedir(dir);
+	return devs;
+}
+
+static void bl_write(BlDevice *bl, int raw);
+
+static void bl_flush_queued(BlDevice *bl) {
+	if (bl->queued < 0) return;
+	int v = bl->queued;
+	bl->queued = -1;
+	bl_write(bl, v);
+}
+
+static void bl_bus_ready(GObject *src, GAsyncResult *res, gpointer ud) {
+	GPtrArray       *devs = ud;
+	GDBusConnection *bus  = g_bus_get_finish(res, NULL);
+	for (guint i = 0; i < devs->len; i++) {
+		BlDevice *bl = g_ptr_array_index(devs, i);
+		bl->bus      = bus ? g_object_ref(bus) : NULL;
+		bl->bus_wait = FALSE;
+		bl_flush_queued(bl);
+	}
+	if (bus) g_object_unref(bus);
+	g_ptr_array_unref(devs);
+}
+
+static void bl_write_done(GObject *src, GAsyncResult *res, gpointer ud) {
+	BlDevice *bl  = ud;
+	GError   *err = NULL;
+	GVariant *ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(src), res, &err);
+	if (ret) g_variant_unref(ret);
+	if (err) { g_warning("SetBrightness(%s): %s", bl->name, err->message); g_error_free(err); }
+	bl->in_flight = FALSE;
+	bl_flush_queued(bl);
+	bl_device_unref(bl);
+}
+
+/* One D-Bus call in flight per device; newer values replace queued ones */
+static void bl_write(BlDevice *bl, int raw) {
+	if (bl->in_flight || bl->bus_wait) { bl->queued = raw; return; }
+	if (!bl->bus) {
+		/* no system bus: fall back to sysfs, writable with a udev rule */
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s/brightness", bl->sysfs, bl->name);
+		FILE *f = fopen(path, "w");
+		if (f) { fprintf(f, "%d", raw); fclose(f); }
+		return;
+	}
+	bl->in_flight = TRUE;
+	g_dbus_connection_call(bl->bus, "org.freedesktop.login1",
+			       "/org/freedesktop/login1/session/auto",
+			       "org.freedesktop.login1.Session", "SetBrightness",
+			       g_variant_new("(ssu)", "backlight", bl->name, (guint32)raw),
+			       NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+			       bl_write_done, g_rc_box_acquire(bl));
+}
+
+/* Ease from ramp_from to ramp_to over BL_RAMP_MS, one step per frame */
+static gboolean bl_tick(GtkWidget *w, GdkFrameClock *fc, gpointer ud) {
+	BlDevice *bl  = ud;
+	gint64    now = gdk_frame_clock_get_frame_time(fc);
+	if (!bl->ramp_t0) bl->ramp_t0 = now;
+	double t = MIN(1.0, (now - bl->ramp_t0) / (BL_RAMP_MS * 1000.0));
+	int raw = (int)lround(bl->ramp_from + (bl->ramp_to - bl->ramp_from) * t * (2.0 - t));
+	if (raw != bl->cur) { bl->cur = raw; bl_write(bl, raw); }
+	if (t < 1.0) return G_SOURCE_CONTINUE;
+	bl->tick_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+/* The frame clock stops with the page; land on the target rather than
+ * leaving the panel part-way through the ramp. */
+static void bl_scale_unmapped(GtkWidget *w, gpointer ud) {
+	BlDevice *bl = ud;
+	if (!bl->tick_id) return;
+	gtk_widget_remove_tick_callback(w, bl->tick_id);
+	bl->tick_id = 0;
+	if (bl->cur != bl->ramp_to) { bl->cur = bl->ramp_to; bl_write(bl, bl->cur); }
+}
+
+static void bl_scale_changed(GtkRange *range, gpointer ud) {
+	BlDevice *bl = ud;
+	bl->ramp_from = bl->cur;
+	bl->ramp_to   = bl_to_raw(bl, gtk_range_get_value(range));
+	bl->ramp_t0   = 0;
+	if (!bl->tick_id)
+		bl->tick_id = gtk_widget_add_tick_callback(GTK_WIDGET(range), bl_tick,
+							   g_rc_box_acquire(bl), bl_device_unref);
+}
+
+static GtkWidget *bl_build_section(void) {
+	GPtrArray *devs = bl_enumerate(BL_SYSFS);
+	if (devs->len == 0) { g_ptr_array_unref(devs); return NULL; }
+	GtkWidget *frame = make_section_box("Backlight");
+	GtkWidget *box   = g_object_get_data(G_OBJECT(frame), "inner-box");
+	for (guint i = 0; i < devs->len; i++) {
+		BlDevice *bl = g_ptr_array_index(devs, i);
+		GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+		gtk_widget_set_margin_start(row, 14); gtk_widget_set_margin_end(row, 14);
+		gtk_widget_set_margin_top(row, 10);   gtk_widget_set_margin_bottom(row, 10);
+		GtkWidget *ic = gtk_image_new_from_icon_name("display-brightness-symbolic");
+		gtk_image_set_pixel_size(GTK_IMAGE(ic), 18); gtk_widget_set_valign(ic, GTK_ALIGN_CENTER);
+		gtk_box_append(GTK_BOX(row), ic);
+		GtkWidget *lbl = gtk_label_new(bl->name);
+		gtk_widget_add_css_class(lbl, "dim-label"); gtk_widget_set_size_request(lbl, 160, -1);
+		gtk_widget_set_valign(lbl, GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(row), lbl);
+		GtkWidget *sc = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 1, 100, 1);
+		gtk_range_set_value(GTK_RANGE(sc), bl_to_pct(bl, bl->cur));
+		gtk_scale_set_draw_value(GTK_SCALE(sc), TRUE);
+		gtk_scale_set_format_value_func(GTK_SCALE(sc), bright_format_pct, NULL, NULL);
+		gtk_widget_set_hexpand(sc, TRUE);
+		g_signal_connect_data(sc, "value-changed", G_CALLBACK(bl_scale_changed),
+				      g_rc_box_acquire(bl), (GClosureNotify)bl_device_unref, 0);
+		g_signal_connect_data(sc, "unmap", G_CALLBACK(bl_scale_unmapped),
+				      g_rc_box_acquire(bl), (GClosureNotify)bl_device_unref, 0);
+		gtk_box_append(GTK_BOX(row), sc);
+		gtk_box_append(GTK_BOX(box), row);
+		if (i + 1 < devs->len)
+			gtk_box_append(GTK_BOX(box), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	}
+	g_bus_get(G_BUS_TYPE_SYSTEM, NULL, bl_bus_ready, devs);
+	return frame;
+}
+
+static void night_enable_toggled(GtkSwitch *sw, GParamSpec *ps, gpointer ud) {
+	night.enabled = gtk_switch_get_active(sw);
+	gtk_widget_set_sensitive(GTK_WIDGET(ud), night.enabled);
+	night_save();
+	night_update();
+}
+
+/* Dragging the temperature slider fires value-changed per step; the
+ * gamma follows live but the file is written once things settle. */
+static gboolean night_save_cb(gpointer unused) {
+	night.save_timer = 0;
+	night_save();
+	return G_SOURCE_REMOVE;
+}
+
+static void night_queue_save(void) {
+	if (night.save_timer) g_source_remove(night.save_timer);
+	night.save_timer = g_timeout_add(500, night_save_cb, NULL);
+}
+
+static void night_section_destroyed(GtkWidget *w, gpointer ud) {
+	if (night.save_timer) { g_source_remove(night.save_timer); night_save_cb(NULL); }
+}
+
+static void night_temp_changed(GtkRange *range, gpointer ud) {
+	night.kelvin = (int)gtk_range_get_value(range);
+	night_queue_save();
+	night_update();
+}
+
+static void night_hours_changed(GtkSpinButton *sp, gpointer ud) {
+	int *field = ud;
+	*field = gtk_spin_button_get_value_as_int(sp);
+	night_queue_save();
+	night_update();
+}
+
+static char *night_format_k(GtkScale *s, double v, gpointer ud) {
+	return g_strdup_printf("%d K", (int)v);
+}
+
+static GtkWidget *night_build_section(void) {
+	GtkWidget *frame = make_section_box("Night Light");
+	GtkWidget *box   = g_object_get_data(G_OBJECT(frame), "inner-box");
+
+	GtkWidget *er = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(er, 14); gtk_widget_set_margin_end(er, 14);
+	gtk_widget_set_margin_top(er, 10);   gtk_widget_set_margin_bottom(er, 10);
+	GtkWidget *el = gtk_label_new("Warm colours on a schedule");
+	gtk_widget_add_css_class(el, "dim-label");
+	gtk_widget_set_halign(el, GTK_ALIGN_START); gtk_widget_set_hexpand(el, TRUE);
+	gtk_box_append(GTK_BOX(er), el);
+	GtkWidget *sw = gtk_switch_new();
+	gtk_switch_set_active(GTK_SWITCH(sw), night.enabled);
+	gtk_widget_set_valign(sw, GTK_ALIGN_CENTER);
+	gtk_box_append(GTK_BOX(er), sw);
+	gtk_box_append(GTK_BOX(box), er);
+	gtk_box_append(GTK_BOX(box), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+
+	GtkWidget *opts = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+	gtk_widget_set_sensitive(opts, night.enabled);
+
+	GtkWidget *tr = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(tr, 14); gtk_widget_set_margin_end(tr, 14);
+	gtk_widget_set_margin_top(tr, 10);   gtk_widget_set_margin_bottom(tr, 10);
+	GtkWidget *tl = gtk_label_new("Temperature");
+	gtk_widget_add_css_class(tl, "dim-label"); gtk_widget_set_size_request(tl, 160, -1);
+	gtk_widget_set_halign(tl, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(tr), tl);
+	GtkWidget *ts = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 2500, 6500, 100);
+	gtk_range_set_value(GTK_RANGE(ts), night.kelvin);
+	gtk_scale_set_draw_value(GTK_SCALE(ts), TRUE);
+	gtk_scale_set_format_value_func(GTK_SCALE(ts), night_format_k, NULL, NULL);
+	gtk_widget_set_hexpand(ts, TRUE);
+	g_signal_connect(ts, "value-changed", G_CALLBACK(night_temp_changed), NULL);
+	gtk_box_append(GTK_BOX(tr), ts);
+	gtk_box_append(GTK_BOX(opts), tr);
+	gtk_box_append(GTK_BOX(opts), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+
+	GtkWidget *hr = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+	gtk_widget_set_margin_start(hr, 14); gtk_widget_set_margin_end(hr, 14);
+	gtk_widget_set_margin_top(hr, 10);   gtk_widget_set_margin_bottom(hr, 10);
+	GtkWidget *hl = gtk_label_new("Schedule (hour)");
+	gtk_widget_add_css_class(hl, "dim-label");
+	gtk_widget_set_halign(hl, GTK_ALIGN_START); gtk_widget_set_hexpand(hl, TRUE);
+	gtk_box_append(GTK_BOX(hr), hl);
+	gtk_box_append(GTK_BOX(hr), gtk_label_new("From"));
+	GtkWidget *sp_from = gtk_spin_button_new_with_range(0, 23, 1);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(sp_from), night.start_h);
+	g_signal_connect(sp_from, "value-changed", G_CALLBACK(night_hours_changed), &night.start_h);
+	gtk_box_append(GTK_BOX(hr), sp_from);
+	gtk_box_append(GTK_BOX(hr), gtk_label_new("To"));
+	GtkWidget *sp_to = gtk_spin_button_new_with_range(0, 23, 1);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(sp_to), night.end_h);
+	g_signal_connect(sp_to, "value-changed", G_CALLBACK(night_hours_changed), &night.end_h);
+	gtk_box_append(GTK_BOX(hr), sp_to);
+	gtk_box_append(GTK_BOX(opts), hr);
+
+	gtk_box_append(GTK_BOX(box), opts);
+	g_signal_connect(sw, "notify::active", G_CALLBACK(night_enable_toggled), opts);
+	g_signal_connect(frame, "destroy", G_CALLBACK(night_section_destroyed), NULL);
+	return frame;
+}
+
+GtkWidget *brightness_settings(void) {
+	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
+	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
+	gtk_box_append(GTK_BOX(root),make_page_header("display-brightness-symbolic","Brightness"));
+	gtk_box_append(GTK_BOX(root),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	GtkWidget *scr=gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scr),GTK_POLICY_NEVER,GTK_POLICY_AUTOMATIC);
+	gtk_widget_set_vexpand(scr,TRUE);
+	GtkWidget *content=gtk_box_new(GTK_ORIENTATION_VERTICAL,16);
+	gtk_widget_set_margin_start(content,24); gtk_widget_set_margin_end(content,24);
+	gtk_widget_set_margin_top(content,20);   gtk_widget_set_margin_bottom(content,24);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scr),content);
+	gtk_box_append(GTK_BOX(root),scr);
+	GtkWidget *bl_frame=bl_build_section();
+	if (bl_frame) gtk_box_append(GTK_BOX(content),bl_frame);
+	/* per-monitor xrandr brightness — software gamma on top of the backlight */
+	GtkWidget *mon_frame=make_section_box("Monitor Brightness");
+	GtkWidget *mon_box=g_object_get_data(G_OBJECT(mon_frame),"inner-box");
+	int n_outs=0;
+	BrightOutput *outs=bright_query_outputs(&n_outs);
+	int apply_hz=bright_apply_hz();
+	gboolean any=FALSE;
+	for (int i=0;i<n_outs;i++) {
+		any=TRUE; const char *out=outs[i].output;
+		double cb=outs[i].brightness;
+		GtkWidget *mr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,12);
+		gtk_widget_set_margin_start(mr,14); gtk_widget_set_margin_end(mr,14);
+		gtk_widget_set_margin_top(mr,10);   gtk_widget_set_margin_bottom(mr,10);
+		GtkWidget *mi=gtk_image_new_from_icon_name(strncmp(out,"eDP",3)==0?"computer-symbolic":"video-display-symbolic");
+		gtk_image_set_pixel_size(GTK_IMAGE(mi),18); gtk_widget_set_valign(mi,GTK_ALIGN_CENTER);
+		gtk_box_append(GTK_BOX(mr),mi);
+		char friendly[64];
+		if      (strncmp(out,"eDP",3)==0)  snprintf(friendly,sizeof(friendly),"Built-in (%s)",out);
+		else if (strncmp(out,"HDMI",4)==0) snprintf(friendly,sizeof(friendly),"HDMI (%s)",out);
+		else if (strncmp(out,"DP",2)==0)   snprintf(friendly,sizeof(friendly),"DisplayPort (%s)",out);
+		else                               snprintf(friendly,sizeof(friendly),"%s",out);
+		GtkWidget *ml=gtk_label_new(friendly);
+		gtk_widget_add_css_class(ml,"dim-label"); gtk_widget_set_size_request(ml,160,-1);
+		gtk_widget_set_valign(ml,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(mr),ml);
+		GtkWidget *ms=gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,10,100,1);
+		gtk_range_set_value(GTK_RANGE(ms),CLAMP(cb*100.0,10.0,100.0));
+		gtk_scale_set_draw_value(GTK_SCALE(ms),TRUE);
+		gtk_scale_set_format_value_func(GTK_SCALE(ms),bright_format_pct,NULL,NULL);
+		gtk_widget_set_hexpand(ms,TRUE);
+		BrightChan *bc=bright_chan_new(out,apply_hz,bright_xrandr_apply);
+		bc->crtc=outs[i].crtc;
+		bright_attach_chan(ms,bc);
+		gtk_box_append(GTK_BOX(mr),ms); gtk_box_append(GTK_BOX(mon_box),mr);
+		if (i+1<n_outs)
+			gtk_box_append(GTK_BOX(mon_box),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	}
+	g_free(outs);
+	if (!any) {
+		GtkWidget *na=gtk_label_new("No connected monitors found");
+		gtk_widget_add_css_class(na,"dim-label"); gtk_widget_set_halign(na,GTK_ALIGN_CENTER);
+		gtk_widget_set_margin_top(na,12); gtk_widget_set_margin_bottom(na,12);
+		gtk_box_append(GTK_BOX(mon_box),na);
+	}
+	gtk_box_append(GTK_BOX(content),mon_frame);
+	gtk_box_append(GTK_BOX(content),night_build_section());
+	return root;
+}
+
+/* ================================================================== */
+/* Keyboard                                                             */
+/* ================================================================== */
+/* ------------------------------------------------------------------ */
+/* XKB rules index                                                      */
+/* ------------------------------------------------------------------ */
+/* Layouts and variants with their descriptions and languages come from
+ * evdev.xml, or from evdev.lst on systems that ship no XML.  The file
+ * is parsed once in-process into a flat blob:
+ *   header | layouts | by-name index | variants | strings
+ * Records hold offsets into the string table.  Each layout owns a
+ * contiguous run of variants.  Layouts are stored in description
+ * order for display, and the by-name index gives bsearch lookup by
+ * code.  The same blob is written to ~/.cache/mrrobotos/mrsettings/
+ * and later loaded back as-is.  It is rebuilt whenever the source
+ * file's mtime or size changes.  Keyboard and Region share the one
+ * copy. */
+#define XKB_RULES_DIR    "/usr/share/X11/xkb/rules"
+#define XKB_DB_MAGIC     0x424b584du         /* "MXKB" */
+#define XKB_DB_VERSION   1
+
+typedef struct {
+	guint32 magic, version;
+	gint64  src_mtime;
+	guint64 src_size;
+	guint32 n_layouts, n_variants, str_len, reserved;
+} XkbDbHeader;
+
+typedef struct { guint32 name, desc, langs, first_variant, n_variants; } XkbDbLayout;
+typedef struct { guint32 name, desc, langs; } XkbDbVariant;
+
+typedef struct {
+	char               *blob;
+	gsize               len;
+	const XkbDbHeader  *hdr;
+	const XkbDbLayout  *layouts;         /* by description */
+	const guint32      *by_name;         /* indexes into layouts, by name */
+	const XkbDbVariant *variants;
+	const char         *str;
+} XkbDb;
+
+/* parse-time records; strings are offsets into XkbBuild.str */
+typedef struct { guint32 name, desc; GString *langs; GArray *variants; } XkbBuildLayout;
+typedef struct { guint32 name, desc; GString *langs; } XkbBuildVariant;
+
+typedef struct {
+	GString *str;
+	GArray  *layouts;                    /* XkbBuildLayout */
+	/* evdev.xml parser state */
+	int      in_layouts, in_variant, field;
+	GString *text;
+} XkbBuild;
+
+enum { XKB_F_NONE, XKB_F_NAME, XKB_F_DESC, XKB_F_LANG };
+
+static guint32 xkb_build_str(XkbBuild *b, const char *s, gssize len) {
+	guint32 off = b->str->len;
+	g_string_append_len(b->str, s, len < 0 ? (gssize)strlen(s) : len);
+	g_string_append_c(b->str, '\0');
+	return off;
+}
+
+static void xkb_build_langs(GString *langs, const char *lang) {
+	if (langs->len) g_string_append_c(langs, ',');
+	g_string_append(langs, lang);
+}
+
+static XkbBuildLayout *xkb_build_layout(XkbBuild *b) {
+	XkbBuildLayout l = { 0, 0, g_string_new(NULL), g_array_new(FALSE, FALSE, sizeof(XkbBuildVariant)) };
+	g_array_append_val(b->layouts, l);
+	return &g_array_index(b->layouts, XkbBuildLayout, b->layouts->len - 1);
+}
+
+static void xkb_xml_start(GMarkupParseContext *ctx, const char *el, const char **an, const char **av,
+			  gpointer ud, GError **err) {
+	XkbBuild *b = ud;
+	if (strcmp(el, "layoutList") == 0) { b->in_layouts = TRUE; return; }
+	if (!b->in_layouts) return;
+	if (strcmp(el, "layout") == 0) {
+		xkb_build_layout(b);
+	} else if (strcmp(el, "variant") == 0 && b->layouts->len) {
+		XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, b->layouts->len - 1);
+		XkbBuildVariant v = { 0, 0, g_string_new(NULL) };
+		g_array_append_val(l->variants, v);
+		b->in_variant = TRUE;
+	} else {
+		b->field = strcmp(el, "name") == 0        ? XKB_F_NAME
+			 : strcmp(el, "description") == 0 ? XKB_F_DESC
+			 : strcmp(el, "iso639Id") == 0    ? XKB_F_LANG : XKB_F_NONE;
+		g_string_truncate(b->text, 0);
+	}
+}
+
+static void xkb_xml_text(GMarkupParseContext *ctx, const char *text, gsize len, gpointer ud, GError **err) {
+	XkbBuild *b = ud;
+	if (b->field) g_string_append_len(b->text, text, len);
+}
+
+static void xkb_xml_end(GMarkupParseContext *ctx, const char *el, gpointer ud, GError **err) {
+	XkbBuild *b = ud;
+	if (strcmp(el, "layoutList") == 0) { b->in_layouts = FALSE; return; }
+	if (strcmp(el, "variant") == 0) { b->in_variant = FALSE; return; }
+	if (!b->field || !b->layouts->len) return;
+	XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, b->layouts->len - 1);
+	guint32 *name = &l->name, *desc = &l->desc;
+	GString *langs = l->langs;
+	if (b->in_variant && l->variants->len) {
+		XkbBuildVariant *v = &g_array_index(l->variants, XkbBuildVariant, l->variants->len - 1);
+		name = &v->name; desc = &v->desc; langs = v->langs;
+	}
+	g_strstrip(b->text->str);
+	if      (b->field == XKB_F_NAME) *name = xkb_build_str(b, b->text->str, -1);
+	else if (b->field == XKB_F_DESC) *desc = xkb_build_str(b, b->text->str, -1);
+	else                             xkb_build_langs(langs, b->text->str);
+	b->field = XKB_F_NONE;
+}
+
+static gboolean xkb_parse_xml(XkbBuild *b, const char *data, gsize len) {
+	static const GMarkupParser parser = { xkb_xml_start, xkb_xml_end, xkb_xml_text, NULL, NULL };
+	b->text = g_string_new(NULL);
+	GMarkupParseContext *ctx = g_markup_parse_context_new(&parser, 0, b, NULL);
+	gboolean ok = g_markup_parse_context_parse(ctx, data, len, NULL) &&
+		      g_markup_parse_context_end_parse(ctx, NULL);
+	g_markup_parse_context_free(ctx);
+	g_string_free(b->text, TRUE);
+	return ok;
+}
+
+/* evdev.lst: "! layout" lines are "  code  Description", "! variant"
+ * lines are "  code  layout: Description"; no language data. */
+static gboolean xkb_parse_lst(XkbBuild *b, const char *data, gsize len) {
+	GHashTable *by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	const char *p = data, *end = data + len;
+	int section = 0;                                      /* 1 layout, 2 variant */
+	while (p < end) {
+		const char *nl = memchr(p, '\n', end - p), *le = nl ? nl : end;
+		if (*p == '!') {
+			section = le - p >= 8 && memcmp(p, "! layout", 8) == 0  ? 1
+				: le - p >= 9 && memcmp(p, "! variant", 9) == 0 ? 2 : 0;
+		} else if (section) {
+			while (p < le && *p == ' ') p++;
+			const char *ne = p;
+			while (ne < le && *ne != ' ') ne++;
+			const char *d = ne;
+			while (d < le && *d == ' ') d++;
+			if (ne > p && d < le) {
+				char *code = g_strndup(p, ne - p);
+				if (section == 1) {
+					XkbBuildLayout *l = xkb_build_layout(b);
+					l->name = xkb_build_str(b, p, ne - p);
+					l->desc = xkb_build_str(b, d, le - d);
+					g_hash_table_insert(by_name, code, GUINT_TO_POINTER(b->layouts->len));
+					code = NULL;
+				} else {
+					const char *colon = memchr(d, ':', le - d);
+					char *lname = colon ? g_strndup(d, colon - d) : NULL;
+					guint li = lname ? GPOINTER_TO_UINT(g_hash_table_lookup(by_name, lname)) : 0;
+					if (li) {
+						XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, li - 1);
+						const char *vd = colon + 1;
+						while (vd < le && *vd == ' ') vd++;
+						XkbBuildVariant v = { xkb_build_str(b, p, ne - p), xkb_build_str(b, vd, le - vd),
+								      g_string_new(NULL) };
+						g_array_append_val(l->variants, v);
+					}
+					g_free(lname);
+				}
+				g_free(code);
+			}
+		}
+		p = nl ? nl + 1 : end;
+	}
+	g_hash_table_unref(by_name);
+	return b->layouts->len > 0;
+}
+
+static const char *xkb_build_s(const XkbBuild *b, guint32 off) { return b->str->str + off; }
+
+static int xkb_build_desc_cmp(gconstpointer x, gconstpointer y, gpointer ud) {
+	const XkbBuildLayout *a = x, *c = y;
+	return g_utf8_collate(xkb_build_s(ud, a->desc), xkb_build_s(ud, c->desc));
+}
+
+static int xkb_db_name_cmp(gconstpointer x, gconstpointer y, gpointer ud) {
+	const XkbDb *db = ud;
+	return strcmp(db->str + db->layouts[*(const guint32 *)x].name,
+		      db->str + db->layouts[*(const guint32 *)y].name);
+}
+
+static gboolean xkb_db_attach(XkbDb *db) {
+	if (db->len < sizeof(XkbDbHeader)) return FALSE;
+	const XkbDbHeader *h = (const XkbDbHeader *)db->blob;
+	gsize need = sizeof(*h) + (gsize)h->n_layouts * (sizeof(XkbDbLayout) + sizeof(guint32)) +
+		     (gsize)h->n_variants * sizeof(XkbDbVariant) + h->str_len;
+	if (h->magic != XKB_DB_MAGIC || h->version != XKB_DB_VERSION || db->len != need ||
+	    !h->str_len || h->n_layouts > db->len || h->n_variants > db->len)
+		return FALSE;
+	db->hdr      = h;
+	db->layouts  = (const XkbDbLayout *)(h + 1);
+	db->by_name  = (const guint32 *)(db->layouts + h->n_layouts);
+	db->variants = (const XkbDbVariant *)(db->by_name + h->n_layouts);
+	db->str      = (const char *)(db->variants + h->n_variants);
+	if (db->str[h->str_len - 1] != '\0') return FALSE;
+	for (guint32 i = 0; i < h->n_layouts; i++) {
+		const XkbDbLayout *l = &db->layouts[i];
+		if (l->name >= h->str_len || l->desc >= h->str_len || l->langs >= h->str_len ||
+		    db->by_name[i] >= h->n_layouts ||
+		    l->first_variant > h->n_variants || l->n_variants > h->n_variants - l->first_variant)
+			return FALSE;
+	}
+	for (guint32 i = 0; i < h->n_variants; i++) {
+		const XkbDbVariant *v = &db->variants[i];
+		if (v->name >= h->str_len || v->desc >= h->str_len || v->langs >= h->str_len) return FALSE;
+	}
+	return TRUE;
+}
+
+/* Flatten a parse into the blob format. */
+static XkbDb *xkb_db_from_build(XkbBuild *b, const struct stat *st) {
+	g_array_sort_with_data(b->layouts, xkb_build_desc_cmp, b);
+	guint32 nl = b->layouts->len, nv = 0;
+	for (guint32 i = 0; i < nl; i++) nv += g_array_index(b->layouts, XkbBuildLayout, i).variants->len;
+	/* language lists go into the string table last */
+	guint32 *lang_off = g_new(guint32, nl + nv), k = 0;
+	guint32 empty = xkb_build_str(b, "", 0);
+	for (guint32 i = 0; i < nl; i++) {
+		XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, i);
+		lang_off[k++] = l->langs->len ? xkb_build_str(b, l->langs->str, l->langs->len) : empty;
+		for (guint j = 0; j < l->variants->len; j++) {
+			XkbBuildVariant *v = &g_array_index(l->variants, XkbBuildVariant, j);
+			lang_off[k++] = v->langs->len ? xkb_build_str(b, v->langs->str, v->langs->len) : empty;
+		}
+	}
+
+	XkbDb *db = g_new0(XkbDb, 1);
+	db->len  = sizeof(XkbDbHeader) + (gsize)nl * (sizeof(XkbDbLayout) + sizeof(guint32)) +
+		   (gsize)nv * sizeof(XkbDbVariant) + b->str->len;
+	db->blob = g_malloc0(db->len);
+	XkbDbHeader *h = (XkbDbHeader *)db->blob;
+	*h = (XkbDbHeader){ XKB_DB_MAGIC, XKB_DB_VERSION, st->st_mtime, st->st_size, nl, nv, b->str->len, 0 };
+	XkbDbLayout  *L = (XkbDbLayout *)(h + 1);
+	guint32      *N = (guint32 *)(L + nl);
+	XkbDbVariant *V = (XkbDbVariant *)(N + nl);
+	memcpy(V + nv, b->str->str, b->str->len);
+	k = 0;
+	for (guint32 i = 0, vi = 0; i < nl; i++) {
+		XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, i);
+		L[i] = (XkbDbLayout){ l->name, l->desc, lang_off[k++], vi, l->variants->len };
+		for (guint j = 0; j < l->variants->len; j++, vi++) {
+			XkbBuildVariant *v = &g_array_index(l->variants, XkbBuildVariant, j);
+			V[vi] = (XkbDbVariant){ v->name, v->desc, lang_off[k++] };
+		}
+		N[i] = i;
+	}
+	g_free(lang_off);
+	xkb_db_attach(db);
+	g_qsort_with_data(N, nl, sizeof(guint32), xkb_db_name_cmp, db);
+	return db;
+}
+
+static void xkb_build_clear(XkbBuild *b) {
+	for (guint i = 0; i < b->layouts->len; i++) {
+		XkbBuildLayout *l = &g_array_index(b->layouts, XkbBuildLayout, i);
+		for (guint j = 0; j < l->variants->len; j++)
+			g_string_free(g_array_index(l->variants, XkbBuildVariant, j).langs, TRUE);
+		g_array_unref(l->variants);
+		g_string_free(l->langs, TRUE);
+	}
+	g_array_unref(b->layouts);
+	g_string_free(b->str, TRUE);
+}
+
+/* Load the index for rules_dir (XKB_RULES_DIR outside tests) from
+ * cache_path, or parse and cache it when that is missing or stale. */
+static XkbDb *xkb_db_load(const char *rules_dir, const char *cache_path) {
+	struct stat st;
+	char *src = g_build_filename(rules_dir, "evdev.xml", NULL);
+	gboolean xml = stat(src, &st) == 0;
+	if (!xml) {
+		g_free(src);
+		src = g_build_filename(rules_dir, "evdev.lst", NULL);
+		if (stat(src, &st) < 0) { g_free(src); return NULL; }
+	}
+
+	XkbDb *db = g_new0(XkbDb, 1);
+	if (g_file_get_contents(cache_path, &db->blob, &db->len, NULL) && xkb_db_attach(db) &&
+	    db->hdr->src_mtime == (gint64)st.st_mtime && db->hdr->src_size == (guint64)st.st_size) {
+		g_free(src);
+		return db;
+	}
+	g_free(db->blob);
+	g_free(db);
+
+	char *data; gsize len;
+	gboolean read = g_file_get_contents(src, &data, &len, NULL);
+	g_free(src);
+	if (!read) return NULL;
+	XkbBuild b = { g_string_sized_new(16384), g_array_new(FALSE, FALSE, sizeof(XkbBuildLayout)) };
+	xkb_build_str(&b, "", 0);                             /* offset 0 is "" for missing fields */
+	gboolean ok = xml ? xkb_parse_xml(&b, data, len) : xkb_parse_lst(&b, data, len);
+	g_free(data);
+	db = ok && b.layouts->len ? xkb_db_from_build(&b, &st) : NULL;
+	xkb_build_clear(&b);
+	if (db) {
+		char *dir = g_path_get_dirname(cache_path);
+		g_mkdir_with_parents(dir, 0755);
+		g_free(dir);
+		g_file_set_contents(cache_path, db->blob, db->len, NULL);
+	}
+	return db;
+}
+
+/* The shared index, loaded on first use; NULL without rules files. */
+static const XkbDb *xkb_db(void) {
+	static XkbDb *db;
+	static gboolean tried;
+	if (!tried) {
+		tried = TRUE;
+		char *path = g_build_filename(g_get_user_cache_dir(), "mrrobotos", "mrsettings",
+					      "xkb-rules.cache", NULL);
+		db = xkb_db_load(XKB_RULES_DIR, path);
+		g_free(path);
+	}
+	return db;
+}
+
+static const char *xkb_db_s(const XkbDb *db, guint32 off) { return db->str + off; }
+
+/* Descriptions are translated through the xkeyboard-config catalogue. */
+static const char *xkb_db_desc(const XkbDb *db, guint32 off) {
+	return off ? dgettext("xkeyboard-config", db->str + off) : "";
+}
+
+/* Index into db->layouts of the layout named `name`, or -1. */
+static int xkb_db_find(const XkbDb *db, const char *name) {
+	if (!db || !name) return -1;
+	guint32 lo = 0, hi = db->hdr->n_layouts;
+	while (lo < hi) {
+		guint32 mid = (lo + hi) / 2;
+		int c = strcmp(name, db->str + db->layouts[db->by_name[mid]].name);
+		if (c == 0) return db->by_name[mid];
+		if (c < 0) hi = mid; else lo = mid + 1;
+	}
+	return -1;
+}
+
+/* Variant of layout `li` named `name`, or -1; the result indexes db->variants. */
+static int xkb_db_find_variant(const XkbDb *db, int li, const char *name) {
+	if (!db || li < 0 || !name || !name[0]) return -1;
+	const XkbDbLayout *l = &db->layouts[li];
+	for (guint32 i = 0; i < l->n_variants; i++)
+		if (strcmp(db->str + db->variants[l->first_variant + i].name, name) == 0)
+			return l->first_variant + i;
+	return -1;
+}
+
+/* ------------------------------------------------------------------ */
+/* XKB state                                                            */
+/* ------------------------------------------------------------------ */
+/* The active names are read from the _XKB_RULES_NAMES root property.
+ * A layout is applied the way setxkbmap does it:
+ * - the rules file turns RMLVO (rules/model/layout/variant/options)
+ *   into keymap components;
+ * - the server compiles those with XkbGetKeyboardByName;
+ * - the names are written back to the property for other clients.
+ * Pages register watches.  XkbNewKeyboardNotify and PropertyNotify on
+ * _XKB_RULES_NAMES are selected once on the GDK display, and one
+ * coalesced callback fans out to the watches.  That way a layout
+ * switched by another tool shows up at once.  Both events are needed:
+ * setxkbmap loads the keymap first and rewrites the names after.
+ * Layout and variant are comma lists with one field per group ("us,de"
+ * and ",nodeadkeys").  The page edits the locked group only, so the
+ * other groups are carried over untouched; XkbStateNotify for the group
+ * lock is selected too, so switching groups with a hotkey re-reads. */
+typedef struct {
+	char rules[64], model[64], layout[128], variant[128], options[256];
+	int  group, n_groups;                  /* locked group, fields in layout */
+} XkbNames;
+
+typedef struct { void (*cb)(gpointer); gpointer ud; } XkbWatch;
+
+static int     xkb_event_base = -1;
+static Atom    xkb_names_atom;
+static GSList *xkb_watches;
+static guint   xkb_notify_timer;
+
+static Display *xkb_xdisplay(void) {
+	GdkDisplay *gd = gdk_display_get_default();
+	return gd && GDK_IS_X11_DISPLAY(gd) ? gdk_x11_display_get_xdisplay(gd) : NULL;
+}
+
+/* Field i of a comma list, or "" past its end. */
+static void xkb_group_get(const char *list, int i, char *out, size_t sz) {
+	const char *p = list ? list : "";
+	for (; i > 0 && p; i--)
+		if ((p = strchr(p, ','))) p++;
+	size_t n = p ? strcspn(p, ",") : 0;
+	g_strlcpy(out, p ? p : "", MIN(n + 1, sz));
+}
+
+/* list with field i replaced by val, padded with empty fields as needed
+ * and without trailing empty ones.  Free with g_free. */
+static char *xkb_group_set(const char *list, int i, const char *val) {
+	char **f = g_strsplit(list ? list : "", ",", -1);
+	guint n = MAX(g_strv_length(f), (guint)i + 1);
+	GString *s = g_string_new(NULL);
+	for (guint k = 0; k < n; k++) {
+		if (k) g_string_append_c(s, ',');
+		g_string_append(s, k == (guint)i ? (val ? val : "")
+				: k < g_strv_length(f) ? f[k] : "");
+	}
+	while (s->len && s->str[s->len - 1] == ',') g_string_truncate(s, s->len - 1);
+	g_strfreev(f);
+	return g_string_free(s, FALSE);
+}
+
+static gboolean xkb_get_names(Display *xd, XkbNames *out) {
+	memset(out, 0, sizeof(*out));
+	char *rules = NULL;
+	XkbRF_VarDefsRec vd = { 0 };
+	if (!xd || !XkbRF_GetNamesProp(xd, &rules, &vd)) return FALSE;
+	g_strlcpy(out->rules,   rules      ? rules      : "", sizeof(out->rules));
+	g_strlcpy(out->model,   vd.model   ? vd.model   : "", sizeof(out->model));
+	g_strlcpy(out->layout,  vd.layout  ? vd.layout  : "", sizeof(out->layout));
+	g_strlcpy(out->variant, vd.variant ? vd.variant : "", sizeof(out->variant));
+	g_strlcpy(out->options, vd.options ? vd.options : "", sizeof(out->options));
+	free(rules); free(vd.model); free(vd.layout); free(vd.variant); free(vd.options);
+	out->n_groups = 1;
+	for (const char *p = out->layout; (p = strchr(p, ',')); p++) out->n_groups++;
+	XkbStateRec st;
+	if (XkbGetState(xd, XkbUseCoreKbd, &st) == Success)
+		out->group = MIN(st.locked_group, out->n_groups - 1);
+	return TRUE;
+}
+
+/* Put layout/variant in group `group`, keeping the other groups and the
+ * current rules, model and options, and leave that group locked.
+ * Returns FALSE with a message in err on failure. */
+static gboolean xkb_apply(Display *xd, int group, const char *layout, const char *variant,
+			  char *err, size_t sz) {
+	if (!xd) { g_strlcpy(err, "not running on X11", sz); return FALSE; }
+	XkbNames cur;
+	xkb_get_names(xd, &cur);
+	group = CLAMP(group, 0, XkbNumKbdGroups - 1);
+	char *layouts  = xkb_group_set(cur.layout[0] ? cur.layout : "us", group, layout);
+	char *variants = xkb_group_set(cur.variant, group, variant);
+	const char *rname = cur.rules[0] ? cur.rules : "evdev";
+	char rpath[PATH_MAX];
+	snprintf(rpath, sizeof(rpath), XKB_RULES_DIR "/%s", rname);
+	XkbRF_RulesPtr rules = XkbRF_Load(rpath, "", False, True);
+	if (!rules) { snprintf(err, sz, "cannot load rules %s", rpath); return FALSE; }
+
+	XkbRF_VarDefsRec vd = {
+		.model   = cur.model[0] ? cur.model : "pc105",
+		.layout  = layouts,
+		.variant = variants[0] ? variants : NULL,
+		.options = cur.options[0] ? cur.options : NULL,
+	};
+	XkbComponentNamesRec names = { 0 };
+	gboolean ok = XkbRF_GetComponents(rules, &vd, &names);
+	if (!ok) snprintf(err, sz, "no keymap for %s", layouts);
+	if (ok) {
+		XkbDescPtr kb = XkbGetKeyboardByName(xd, XkbUseCoreKbd, &names, XkbGBN_AllComponentsMask,
+						     XkbGBN_AllComponentsMask & ~XkbGBN_GeometryMask, True);
+		if (kb) {
+			XkbFreeKeyboard(kb, XkbAllComponentsMask, True);
+			XkbRF_SetNamesProp(xd, (char *)rname, &vd);
+			XkbLockGroup(xd, XkbUseCoreKbd, group);
+			XFlush(xd);
+		} else {
+			ok = FALSE;
+			g_strlcpy(err, "the X server rejected the keymap", sz);
+		}
+	}
+	free(names.keymap); free(names.keycodes); free(names.types);
+	free(names.compat); free(names.symbols);  free(names.geometry);
+	XkbRF_Free(rules, True);
+	g_free(layouts); g_free(variants);
+	return ok;
+}
+
+static gboolean xkb_notify_cb(gpointer unused) {
+	xkb_notify_timer = 0;
+	for (GSList *l = xkb_watches; l; l = l->next) {
+		XkbWatch *w = l->data;
+		w->cb(w->ud);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean xkb_xevent(GdkX11Display *gd, gpointer xev, gpointer ud) {
+	XEvent *e = xev;
+	gboolean hit = (e->type == xkb_event_base &&
+			(((XkbEvent *)e)->any.xkb_type == XkbNewKeyboardNotify ||
+			 ((XkbEvent *)e)->any.xkb_type == XkbStateNotify)) ||
+		       (e->type == PropertyNotify && e->xproperty.atom == xkb_names_atom);
+	if (hit && !xkb_notify_timer) xkb_notify_timer = g_timeout_add(50, xkb_notify_cb, NULL);
+	return FALSE;
+}
+
+static void xkb_events_init(void) {
+	Display *xd = xkb_xdisplay();
+	if (!xd || xkb_event_base >= 0) return;
+	int opcode, err_base, major = XkbMajorVersion, minor = XkbMinorVersion;
+	if (!XkbQueryExtension(xd, &opcode, &xkb_event_base, &err_base, &major, &minor)) {
+		xkb_event_base = -1;
+		return;
+	}
+	XkbSelectEvents(xd, XkbUseCoreKbd, XkbNewKeyboardNotifyMask, XkbNewKeyboardNotifyMask);
+	XkbSelectEventDetails(xd, XkbUseCoreKbd, XkbStateNotify,
+			      XkbGroupLockMask, XkbGroupLockMask);
+	/* add to, never replace, the root mask GDK already selected */
+	XWindowAttributes wa;
+	Window root = DefaultRootWindow(xd);
+	if (XGetWindowAttributes(xd, root, &wa))
+		XSelectInput(xd, root, wa.your_event_mask | PropertyChangeMask);
+	xkb_names_atom = XInternAtom(xd, _XKB_RF_NAMES_PROP_ATOM, False);
+	g_signal_connect(gdk_display_get_default(), "xevent", G_CALLBACK(xkb_xevent), NULL);
+}
+
+/* Call cb(ud) after every keymap change until xkb_watch_remove. */
+static gpointer xkb_watch_add(void (*cb)(gpointer), gpointer ud) {
+	xkb_events_init();
+	XkbWatch *w = g_new(XkbWatch, 1);
+	w->cb = cb; w->ud = ud;
+	xkb_watches = g_slist_prepend(xkb_watches, w);
+	return w;
+}
+
+static void xkb_watch_remove(gpointer w) {
+	xkb_watches = g_slist_remove(xkb_watches, w);
+	g_free(w);
+}
+
+/* ------------------------------------------------------------------ */
+/* key repeat                                                           */
+/* ------------------------------------------------------------------ */
+/* Delay and rate go to the server with XkbSetAutoRepeatRate as the
+ * controls move.  They are saved to ~/.config/mrrobotos/mrsettings/
+ * keyboard/repeat, and `mrsettings --apply-keyboard` re-applies them
+ * at session start (from xinitrc).  The test field timestamps the
+ * repeated key-press events of a held key as they reach the app, so it
+ * shows the latency the user actually gets: the initial delay, the
+ * mean repeat interval, and its jitter. */
+#define KBD_REPEAT_MIN_DELAY  150
+#define KBD_REPEAT_MAX_DELAY  1000
+#define KBD_REPEAT_MIN_RATE   5
+#define KBD_REPEAT_MAX_RATE   60
+#define KBD_TEST_MAX          256
+
+typedef struct {
+	gboolean enabled;
+	int      delay_ms, rate;              /* rate in repeats per second */
+} KbdRepeat;
+
+static char *kbd_repeat_path(void) {
+	return g_build_filename(g_get_user_config_dir(), "mrrobotos", "mrsettings",
+				"keyboard", "repeat", NULL);
+}
+
+/* FALSE if nothing has been saved yet */
+static gboolean kbd_repeat_load(KbdRepeat *r) {
+	char *path = kbd_repeat_path();
+	GKeyFile *kf = g_key_file_new();
+	gboolean ok = g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL) &&
+		      g_key_file_has_group(kf, "Repeat");
+	if (ok) {
+		r->enabled  = !g_key_file_has_key(kf, "Repeat", "Enabled", NULL) ||
+			      g_key_file_get_boolean(kf, "Repeat", "Enabled", NULL);
+		r->delay_ms = CLAMP(g_key_file_get_integer(kf, "Repeat", "Delay", NULL),
+				    KBD_REPEAT_MIN_DELAY, KBD_REPEAT_MAX_DELAY);
+		r->rate     = CLAMP(g_key_file_get_integer(kf, "Repeat", "Rate", NULL),
+				    KBD_REPEAT_MIN_RATE, KBD_REPEAT_MAX_RATE);
+	}
+	g_key_file_free(kf);
+	g_free(path);
+	return ok;
+}
+
+static void kbd_repeat_save(const KbdRepeat *r) {
+	char *path = kbd_repeat_path();
+	char *dir  = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+	GKeyFile *kf = g_key_file_new();
+	g_key_file_set_boolean(kf, "Repeat", "Enabled", r->enabled);
+	g_key_file_set_integer(kf, "Repeat", "Delay",   r->delay_ms);
+	g_key_file_set_integer(kf, "Repeat", "Rate",    r->rate);
+	g_key_file_save_to_file(kf, path, NULL);
+	g_key_file_free(kf);
+	g_free(dir); g_free(path);
+}
+
+static void kbd_repeat_read(Display *xd, KbdRepeat *r) {
+	unsigned int delay = 600, interval = 40;
+	XkbGetAutoRepeatRate(xd, XkbUseCoreKbd, &delay, &interval);
+	XKeyboardState ks;
+	XGetKeyboardControl(xd, &ks);
+	r->enabled  = ks.global_auto_repeat == AutoRepeatModeOn;
+	r->delay_ms = CLAMP((int)delay, KBD_REPEAT_MIN_DELAY, KBD_REPEAT_MAX_DELAY);
+	r->rate     = CLAMP((int)lround(1000.0 / MAX(interval, 1u)), KBD_REPEAT_MIN_RATE, KBD_REPEAT_MAX_RATE);
+}
+
+static void kbd_repeat_apply(Display *xd, const KbdRepeat *r) {
+	XkbChangeEnabledControls(xd, XkbUseCoreKbd, XkbRepeatKeysMask, r->enabled ? XkbRepeatKeysMask : 0);
+	XkbSetAutoRepeatRate(xd, XkbUseCoreKbd, r->delay_ms, (unsigned)lround(1000.0 / r->rate));
+	XFlush(xd);
+}
+
+/* `mrsettings --apply-keyboard`: re-apply the saved settings and exit */
+static int kbd_apply_saved_main(void) {
+	KbdRepeat r;
+	if (!kbd_repeat_load(&r)) return 0;
+	Display *xd = XOpenDisplay(NULL);
+	if (!xd) { fprintf(stderr, "mrsettings: cannot open display\n"); return 1; }
+	kbd_repeat_apply(xd, &r);
+	XCloseDisplay(xd);
+	return 0;
+}
+
+typedef struct {
+	KbdRepeat  r;
+	GtkWidget *enable_sw, *delay_scale, *rate_scale, *test_lbl;
+	guint      save_timer;
+	/* test field: press times of the key being held */
+	guint      test_key;
+	int        n_test;
+	gint64     t[KBD_TEST_MAX];
+} KbdRepeatUi;
+
+static gboolean kbd_repeat_save_cb(gpointer ud) {
+	KbdRepeatUi *ru = ud;
+	ru->save_timer = 0;
+	kbd_repeat_save(&ru->r);
+	return G_SOURCE_REMOVE;
+}
+
+static void kbd_repeat_changed(KbdRepeatUi *ru) {
+	ru->r.enabled  = gtk_switch_get_active(GTK_SWITCH(ru->enable_sw));
+	ru->r.delay_ms = (int)gtk_range_get_value(GTK_RANGE(ru->delay_scale));
+	ru->r.rate     = (int)gtk_range_get_value(GTK_RANGE(ru->rate_scale));
+	gtk_widget_set_sensitive(ru->delay_scale, ru->r.enabled);
+	gtk_widget_set_sensitive(ru->rate_scale, ru->r.enabled);
+	Display *xd = xkb_xdisplay();
+	if (xd) kbd_repeat_apply(xd, &ru->r);
+	if (ru->save_timer) g_source_remove(ru->save_timer);
+	ru->save_timer = g_timeout_add(500, kbd_repeat_save_cb, ru);
+}
+
+static void kbd_repeat_switch_cb(GObject *o, GParamSpec *ps, gpointer ud) { kbd_repeat_changed(ud); }
+static void kbd_repeat_scale_cb(GtkRange *r, gpointer ud)                 { kbd_repeat_changed(ud); }
+
+static void kbd_test_report(KbdRepeatUi *ru) {
+	char msg[160];
+	if (ru->n_test < 3) {
+		gtk_label_set_text(GTK_LABEL(ru->test_lbl), ru->n_test < 2
+			? "Hold a key in the field to measure repeat timing"
+			: "Hold the key a little longer");
+		return;
 	}
-	g_strfreev(outputs);
-	if (!any) {
-		GtkWidget *na=gtk_label_new("No connected monitors found");
-		gtk_widget_add_css_class(na,"dim-label"); gtk_widget_set_halign(na,GTK_ALIGN_CENTER);
-		gtk_widget_set_margin_top(na,12); gtk_widget_set_margin_bottom(na,12);
-		gtk_box_append(GTK_BOX(mon_box),na);
+	/* intervals after the first press-to-repeat gap */
+	int n = ru->n_test - 2;
+	double sum = 0, sq = 0, worst = 0;
+	for (int i = 2; i < ru->n_test; i++) sum += (ru->t[i] - ru->t[i - 1]) / 1000.0;
+	double mean = sum / n;
+	for (int i = 2; i < ru->n_test; i++) {
+		double d = (ru->t[i] - ru->t[i - 1]) / 1000.0 - mean;
+		sq += d * d;
+		worst = MAX(worst, fabs(d));
 	}
-	gtk_box_append(GTK_BOX(content),mon_frame);
-	return root;
+	snprintf(msg, sizeof(msg),
+		 "Delay %.0f ms \xc2\xb7 interval %.1f ms (%.1f/s) \xc2\xb7 jitter \xc2\xb1%.1f ms, worst %.1f ms \xc2\xb7 %d repeats",
+		 (ru->t[1] - ru->t[0]) / 1000.0, mean, 1000.0 / mean, sqrt(sq / n), worst, n + 1);
+	gtk_label_set_text(GTK_LABEL(ru->test_lbl), msg);
+}
+
+static gboolean kbd_test_pressed(GtkEventControllerKey *c, guint keyval, guint keycode,
+				 GdkModifierType st, gpointer ud) {
+	KbdRepeatUi *ru = ud;
+	gint64 now = g_get_monotonic_time();
+	if (keycode != ru->test_key) { ru->test_key = keycode; ru->n_test = 0; }
+	if (ru->n_test < KBD_TEST_MAX) ru->t[ru->n_test++] = now;
+	return FALSE;
+}
+
+static void kbd_test_released(GtkEventControllerKey *c, guint keyval, guint keycode,
+			      GdkModifierType st, gpointer ud) {
+	KbdRepeatUi *ru = ud;
+	if (keycode != ru->test_key) return;
+	kbd_test_report(ru);
+	ru->test_key = 0; ru->n_test = 0;
+}
+
+static void kbd_repeat_ui_free(gpointer ud) {
+	KbdRepeatUi *ru = ud;
+	if (ru->save_timer) { g_source_remove(ru->save_timer); kbd_repeat_save(&ru->r); }
+	g_free(ru);
+}
+
+static GtkWidget *kbd_repeat_row(const char *title, GtkWidget *ctl) {
+	GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(row, 14); gtk_widget_set_margin_end(row, 14);
+	gtk_widget_set_margin_top(row, 10);   gtk_widget_set_margin_bottom(row, 10);
+	GtkWidget *l = gtk_label_new(title);
+	gtk_widget_add_css_class(l, "dim-label"); gtk_widget_set_size_request(l, 80, -1);
+	gtk_widget_set_halign(l, GTK_ALIGN_START); gtk_widget_set_valign(l, GTK_ALIGN_CENTER);
+	gtk_box_append(GTK_BOX(row), l);
+	gtk_widget_set_hexpand(ctl, TRUE);
+	gtk_box_append(GTK_BOX(row), ctl);
+	return row;
+}
+
+static char *kbd_format_ms(GtkScale *s, double v, gpointer ud)   { return g_strdup_printf("%d ms", (int)v); }
+static char *kbd_format_rate(GtkScale *s, double v, gpointer ud) { return g_strdup_printf("%d/s", (int)v); }
+
+static GtkWidget *kbd_repeat_scale(double lo, double hi, double step, double val, GtkScaleFormatValueFunc fmt) {
+	GtkWidget *sc = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, lo, hi, step);
+	gtk_range_set_value(GTK_RANGE(sc), val);
+	gtk_scale_set_draw_value(GTK_SCALE(sc), TRUE);
+	gtk_scale_set_value_pos(GTK_SCALE(sc), GTK_POS_RIGHT);
+	gtk_scale_set_format_value_func(GTK_SCALE(sc), fmt, NULL, NULL);
+	return sc;
+}
+
+static GtkWidget *kbd_repeat_build_section(void) {
+	GtkWidget *frame = make_section_box("Key Repeat");
+	GtkWidget *inner = g_object_get_data(G_OBJECT(frame), "inner-box");
+	KbdRepeatUi *ru = g_new0(KbdRepeatUi, 1);
+	ru->r = (KbdRepeat){ TRUE, 600, 25 };
+	Display *xd = xkb_xdisplay();
+	if (xd) kbd_repeat_read(xd, &ru->r);
+
+	ru->enable_sw = gtk_switch_new();
+	gtk_switch_set_active(GTK_SWITCH(ru->enable_sw), ru->r.enabled);
+	gtk_widget_set_halign(ru->enable_sw, GTK_ALIGN_END);
+	gtk_box_append(GTK_BOX(inner), kbd_repeat_row("Repeat", ru->enable_sw));
+	gtk_box_append(GTK_BOX(inner), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	ru->delay_scale = kbd_repeat_scale(KBD_REPEAT_MIN_DELAY, KBD_REPEAT_MAX_DELAY, 10, ru->r.delay_ms, kbd_format_ms);
+	gtk_box_append(GTK_BOX(inner), kbd_repeat_row("Delay", ru->delay_scale));
+	gtk_box_append(GTK_BOX(inner), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	ru->rate_scale = kbd_repeat_scale(KBD_REPEAT_MIN_RATE, KBD_REPEAT_MAX_RATE, 1, ru->r.rate, kbd_format_rate);
+	gtk_box_append(GTK_BOX(inner), kbd_repeat_row("Rate", ru->rate_scale));
+	gtk_box_append(GTK_BOX(inner), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
+	gtk_widget_set_sensitive(ru->delay_scale, ru->r.enabled);
+	gtk_widget_set_sensitive(ru->rate_scale, ru->r.enabled);
+
+	GtkWidget *entry = gtk_entry_new();
+	gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Hold a key here to test");
+	GtkEventController *kc = gtk_event_controller_key_new();
+	gtk_event_controller_set_propagation_phase(kc, GTK_PHASE_CAPTURE);
+	g_signal_connect(kc, "key-pressed",  G_CALLBACK(kbd_test_pressed),  ru);
+	g_signal_connect(kc, "key-released", G_CALLBACK(kbd_test_released), ru);
+	gtk_widget_add_controller(entry, kc);
+	gtk_box_append(GTK_BOX(inner), kbd_repeat_row("Test", entry));
+	ru->test_lbl = gtk_label_new(NULL);
+	gtk_widget_add_css_class(ru->test_lbl, "dim-label"); gtk_widget_add_css_class(ru->test_lbl, "caption");
+	gtk_label_set_wrap(GTK_LABEL(ru->test_lbl), TRUE);
+	gtk_label_set_xalign(GTK_LABEL(ru->test_lbl), 0.0f);
+	gtk_widget_set_margin_start(ru->test_lbl, 14); gtk_widget_set_margin_end(ru->test_lbl, 14);
+	gtk_widget_set_margin_bottom(ru->test_lbl, 12);
+	gtk_box_append(GTK_BOX(inner), ru->test_lbl);
+	kbd_test_report(ru);
+
+	g_signal_connect(ru->enable_sw,   "notify::active", G_CALLBACK(kbd_repeat_switch_cb), ru);
+	g_signal_connect(ru->delay_scale, "value-changed",  G_CALLBACK(kbd_repeat_scale_cb),  ru);
+	g_signal_connect(ru->rate_scale,  "value-changed",  G_CALLBACK(kbd_repeat_scale_cb),  ru);
+	g_object_set_data_full(G_OBJECT(frame), "repeat-ui", ru, kbd_repeat_ui_free);
+	return frame;
 }
 
-/* ================================================================== */
-/* Keyboard                                                             */
-/* ================================================================== */
+/* ------------------------------------------------------------------ */
+/* Keyboard page                                                        */
+/* ------------------------------------------------------------------ */
+/* Dropdown positions index the shared XKB rules index directly: layout
+ * i is db->layouts[i], and variant j > 0 is that layout's (j-1)th. */
 typedef struct {
-	GtkWidget *layout_dd, *variant_dd, *status_lbl;
+	GtkWidget *layout_dd, *variant_dd, *status_lbl, *current_lbl;
 	GtkStringList *layout_list;
+	const XkbDb *db;
+	gpointer watch;
+	int group;                           /* the group the dropdowns edit */
 	char current_layout[64], current_variant[64];
 } KbdData;
 
 static void kbd_apply(GtkWidget *btn, gpointer ud) {
 	KbdData *kd=ud;
+	const XkbDb *db=kd->db;
 	guint li=gtk_drop_down_get_selected(GTK_DROP_DOWN(kd->layout_dd));
-	GObject *lo=g_list_model_get_item(gtk_drop_down_get_model(GTK_DROP_DOWN(kd->layout_dd)),li);
-	const char *layout=lo?gtk_string_object_get_string(GTK_STRING_OBJECT(lo)):"us";
-	if(lo)g_object_unref(lo);
 	guint vi=gtk_drop_down_get_selected(GTK_DROP_DOWN(kd->variant_dd));
-	GObject *vo=g_list_model_get_item(gtk_drop_down_get_model(GTK_DROP_DOWN(kd->variant_dd)),vi);
-	const char *variant=vo?gtk_string_object_get_string(GTK_STRING_OBJECT(vo)):"";
-	if(vo)g_object_unref(vo);
-	char cmd[512];
-	if (variant&&variant[0]&&strcmp(variant,"(none)")!=0)
-		snprintf(cmd,sizeof(cmd),"setxkbmap -layout '%s' -variant '%s' 2>/dev/null",layout,variant);
+	if (!db || li>=db->hdr->n_layouts) return;
+	const XkbDbLayout *l=&db->layouts[li];
+	const char *layout=xkb_db_s(db,l->name);
+	const char *variant=vi>0&&vi<=l->n_variants?xkb_db_s(db,db->variants[l->first_variant+vi-1].name):"";
+	char msg[256], err[160];
+	if (xkb_apply(xkb_xdisplay(),kd->group,layout,variant,err,sizeof(err)))
+		snprintf(msg,sizeof(msg),"Applied to group %d: %s%s%s",kd->group+1,
+			 layout,variant[0]?" / ":"",variant);
 	else
-		snprintf(cmd,sizeof(cmd),"setxkbmap -layout '%s' 2>/dev/null",layout);
-	system(cmd);
-	char msg[128];
-	snprintf(msg,sizeof(msg),"Applied: %s%s%s",layout,
-		 (variant&&variant[0]&&strcmp(variant,"(none)")!=0)?" / ":"",
-		 (variant&&variant[0]&&strcmp(variant,"(none)")!=0)?variant:"");
+		snprintf(msg,sizeof(msg),"Could not apply %s: %s",layout,err);
 	gtk_label_set_text(GTK_LABEL(kd->status_lbl),msg);
 }
 
 static void kbd_layout_changed(GtkDropDown *dd, GParamSpec *ps, gpointer ud) {
 	KbdData *kd=ud;
+	const XkbDb *db=kd->db;
 	guint li=gtk_drop_down_get_selected(dd);
-	GObject *lo=g_list_model_get_item(gtk_drop_down_get_model(GTK_DROP_DOWN(kd->layout_dd)),li);
-	if(!lo)return;
-	const char *layout=gtk_string_object_get_string(GTK_STRING_OBJECT(lo));
-	g_object_unref(lo);
-	char cmd[256];
-	snprintf(cmd,sizeof(cmd),
-		 "grep -A999 '^! variant' /usr/share/X11/xkb/rules/evdev.lst 2>/dev/null"
-		 " | grep '%s$' | awk '{print $1}'",layout);
-	char *raw=run_cmd_str(cmd); char **variants=g_strsplit(raw,"\n",-1); g_free(raw);
 	GtkStringList *vl=gtk_string_list_new(NULL);
 	gtk_string_list_append(vl,"(none)");
-	for(int i=0;variants[i]&&variants[i][0];i++) gtk_string_list_append(vl,variants[i]);
-	g_strfreev(variants);
+	if (db && li<db->hdr->n_layouts) {
+		const XkbDbLayout *l=&db->layouts[li];
+		for (guint32 i=0;i<l->n_variants;i++)
+			gtk_string_list_append(vl,xkb_db_desc(db,db->variants[l->first_variant+i].desc));
+	}
 	gtk_drop_down_set_model(GTK_DROP_DOWN(kd->variant_dd),G_LIST_MODEL(vl));
+	g_object_unref(vl);
 	gtk_drop_down_set_selected(GTK_DROP_DOWN(kd->variant_dd),0);
 }
 
+/* "Current: us, [de / nodeadkeys]" with the locked group bracketed
+ * when there is more than one. */
+static void kbd_format_current(const XkbNames *n, char *out, size_t sz) {
+	GString *s=g_string_new("Current: ");
+	for (int g=0;g<n->n_groups;g++) {
+		char l[64], v[64];
+		xkb_group_get(n->layout,g,l,sizeof(l));
+		xkb_group_get(n->variant,g,v,sizeof(v));
+		gboolean mark=n->n_groups>1&&g==n->group;
+		g_string_append_printf(s,"%s%s%s%s%s%s",g?", ":"",mark?"[":"",
+				       l[0]?l:"us",v[0]?" / ":"",v,mark?"]":"");
+	}
+	g_strlcpy(out,s->str,sz);
+	g_string_free(s,TRUE);
+}
+
+/* Read the active names and show them: label, and the locked group in
+ * both dropdowns. */
+static void kbd_show_current(gpointer ud) {
+	KbdData *kd=ud;
+	XkbNames n;
+	if (!xkb_get_names(xkb_xdisplay(),&n)) n.n_groups=1;
+	kd->group=n.group;
+	xkb_group_get(n.layout,n.group,kd->current_layout,sizeof(kd->current_layout));
+	if (!kd->current_layout[0]) g_strlcpy(kd->current_layout,"us",sizeof(kd->current_layout));
+	xkb_group_get(n.variant,n.group,kd->current_variant,sizeof(kd->current_variant));
+	char cm[320]; kbd_format_current(&n,cm,sizeof(cm));
+	gtk_label_set_text(GTK_LABEL(kd->current_lbl),cm);
+	int li=xkb_db_find(kd->db,kd->current_layout);
+	if (li<0) return;
+	gtk_drop_down_set_selected(GTK_DROP_DOWN(kd->layout_dd),li);
+	int vi=xkb_db_find_variant(kd->db,li,kd->current_variant);
+	gtk_drop_down_set_selected(GTK_DROP_DOWN(kd->variant_dd),
+				   vi>=0?vi-kd->db->layouts[li].first_variant+1:0);
+}
+
+static void kbd_page_destroyed(GtkWidget *w, gpointer ud) {
+	KbdData *kd=ud;
+	if (kd->watch) xkb_watch_remove(kd->watch);
+	g_free(kd);
+}
+
 GtkWidget *keyboard_settings(void) {
 	KbdData *kd=g_new0(KbdData,1);
-	char *cr=run_cmd_str("setxkbmap -query 2>/dev/null | grep '^layout' | awk '{print $2}' | tr -d '\\n'");
-	g_strstrip(cr); strncpy(kd->current_layout,cr[0]?cr:"us",sizeof(kd->current_layout)-1); g_free(cr);
-	char *vr=run_cmd_str("setxkbmap -query 2>/dev/null | grep '^variant' | awk '{print $2}' | tr -d '\\n'");
-	g_strstrip(vr); strncpy(kd->current_variant,vr,sizeof(kd->current_variant)-1); g_free(vr);
 	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
 	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
 	gtk_box_append(GTK_BOX(root),make_page_header("input-keyboard-symbolic","Keyboard"));
@@ -3538,9 +8352,8 @@ GtkWidget *keyboard_settings(void) {
 	gtk_image_set_pixel_size(GTK_IMAGE(kbd_ico), 128);
 	gtk_widget_set_halign(kbd_ico, GTK_ALIGN_CENTER);
 	gtk_box_append(GTK_BOX(kbd_hdr), kbd_ico);
-	char cm[128]; snprintf(cm,sizeof(cm),"Current: %s%s%s",kd->current_layout,
-			       kd->current_variant[0]?" / ":"",kd->current_variant);
-	GtkWidget *cl = gtk_label_new(cm);
+	GtkWidget *cl = gtk_label_new("");
+	kd->current_lbl = cl;
 	gtk_widget_add_css_class(cl, "dim-label");
 	gtk_widget_set_halign(cl, GTK_ALIGN_CENTER);
 	gtk_box_append(GTK_BOX(kbd_hdr), cl);
@@ -3552,15 +8365,11 @@ GtkWidget *keyboard_settings(void) {
 	//gtk_box_append(GTK_BOX(content),cl);
 	GtkWidget *lf=make_section_box("Keyboard Layout");
 	GtkWidget *lb=g_object_get_data(G_OBJECT(lf),"inner-box");
-	char *lr=run_cmd_str("awk '/^! layout/{found=1;next} found&&/^! /{found=0} found&&NF>=2{print $1}' /usr/share/X11/xkb/rules/evdev.lst 2>/dev/null");
-	char **la=g_strsplit(lr,"\n",-1); g_free(lr);
-	GtkStringList *ll=gtk_string_list_new(NULL); int ci=0,idx=0;
-	for(int i=0;la[i]&&la[i][0];i++){
-		gtk_string_list_append(ll,la[i]);
-		if(strcmp(la[i],kd->current_layout)==0)ci=idx;
-		idx++;
-	}
-	g_strfreev(la); kd->layout_list=ll;
+	kd->db=xkb_db();
+	GtkStringList *ll=gtk_string_list_new(NULL);
+	for(guint32 i=0;kd->db&&i<kd->db->hdr->n_layouts;i++)
+		gtk_string_list_append(ll,xkb_db_desc(kd->db,kd->db->layouts[i].desc));
+	kd->layout_list=ll;
 	GtkWidget *lr2=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,12);
 	gtk_widget_set_margin_start(lr2,14); gtk_widget_set_margin_end(lr2,14);
 	gtk_widget_set_margin_top(lr2,12);   gtk_widget_set_margin_bottom(lr2,8);
@@ -3569,8 +8378,9 @@ GtkWidget *keyboard_settings(void) {
 	gtk_widget_set_halign(ll2,GTK_ALIGN_START); gtk_widget_set_valign(ll2,GTK_ALIGN_CENTER);
 	gtk_box_append(GTK_BOX(lr2),ll2);
 	GtkWidget *ld=gtk_drop_down_new(G_LIST_MODEL(ll),NULL);
-	gtk_drop_down_set_selected(GTK_DROP_DOWN(ld),ci);
 	gtk_drop_down_set_enable_search(GTK_DROP_DOWN(ld),TRUE);
+	gtk_drop_down_set_expression(GTK_DROP_DOWN(ld),
+		gtk_property_expression_new(GTK_TYPE_STRING_OBJECT,NULL,"string"));
 	gtk_widget_set_hexpand(ld,TRUE); kd->layout_dd=ld;
 	gtk_box_append(GTK_BOX(lr2),ld); gtk_box_append(GTK_BOX(lb),lr2);
 	gtk_box_append(GTK_BOX(lb),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
@@ -3584,21 +8394,14 @@ GtkWidget *keyboard_settings(void) {
 	GtkStringList *vl_init=gtk_string_list_new(NULL); gtk_string_list_append(vl_init,"(none)");
 	GtkWidget *vd=gtk_drop_down_new(G_LIST_MODEL(vl_init),NULL);
 	gtk_drop_down_set_enable_search(GTK_DROP_DOWN(vd),TRUE);
+	gtk_drop_down_set_expression(GTK_DROP_DOWN(vd),
+		gtk_property_expression_new(GTK_TYPE_STRING_OBJECT,NULL,"string"));
 	gtk_widget_set_hexpand(vd,TRUE); kd->variant_dd=vd;
 	gtk_box_append(GTK_BOX(vr2),vd); gtk_box_append(GTK_BOX(lb),vr2);
 	g_signal_connect(ld,"notify::selected",G_CALLBACK(kbd_layout_changed),kd);
 	kbd_layout_changed(GTK_DROP_DOWN(ld),NULL,kd);
-	if (kd->current_variant[0]) {
-		GListModel *vm=gtk_drop_down_get_model(GTK_DROP_DOWN(vd));
-		guint vn=g_list_model_get_n_items(vm);
-		for(guint j=0;j<vn;j++){
-			GObject *o=g_list_model_get_item(vm,j);
-			if(strcmp(gtk_string_object_get_string(GTK_STRING_OBJECT(o)),kd->current_variant)==0){
-				gtk_drop_down_set_selected(GTK_DROP_DOWN(vd),j); g_object_unref(o); break;
-			}
-			g_object_unref(o);
-		}
-	}
+	kbd_show_current(kd);
+	kd->watch=xkb_watch_add(kbd_show_current,kd);
 	gtk_box_append(GTK_BOX(content),lf);
 	GtkWidget *ab=gtk_button_new_with_label("Apply Layout");
 	gtk_widget_add_css_class(ab,"suggested-action"); gtk_widget_add_css_class(ab,"pill");
@@ -3608,150 +8411,1275 @@ GtkWidget *keyboard_settings(void) {
 	GtkWidget *sl=gtk_label_new("");
 	gtk_widget_add_css_class(sl,"dim-label"); gtk_widget_set_halign(sl,GTK_ALIGN_CENTER);
 	kd->status_lbl=sl; gtk_box_append(GTK_BOX(content),sl);
-	g_signal_connect_swapped(root,"destroy",G_CALLBACK(g_free),kd);
+	gtk_box_append(GTK_BOX(content),kbd_repeat_build_section());
+	g_signal_connect(root,"destroy",G_CALLBACK(kbd_page_destroyed),kd);
 	return root;
 }
 
 /* ================================================================== */
 /* Users & Groups                                                       */
 /* ================================================================== */
+/* ------------------------------------------------------------------ */
+/* group index                                                          */
+/* ------------------------------------------------------------------ */
+/* One getgrent pass copies every group and inverts the member lists
+ * into user -> gids, so admin badges and the group list need no
+ * subprocesses and no further passes over the database.  getgrent only
+ * sees the sources that enumerate, though, so a user it lists nowhere
+ * is answered through getgrouplist, which asks NSS initgroups, unless
+ * they are in /etc/passwd and their primary group was enumerated: then
+ * the files are all there is.  A directory user (SSSD, LDAP with
+ * enumeration off) always gets asked.  The answer is cached like the
+ * rest. */
+typedef struct {
+	char  *name;
+	gid_t  gid;
+	char **mem;
+} GrpEntry;
+
+typedef struct {
+	GPtrArray  *groups;   /* GrpEntry, in getgrent order */
+	GHashTable *by_name;  /* group name -> GrpEntry */
+	GHashTable *by_gid;   /* gid -> GrpEntry */
+	GHashTable *by_user;  /* member name -> GArray of gid_t */
+	GHashTable *local;    /* user names in /etc/passwd */
+	int       (*initgroups)(const char *, gid_t, gid_t *, int *);
+} GrpIndex;
+
+static void grp_entry_free(gpointer p) {
+	GrpEntry *e=p;
+	g_free(e->name); g_strfreev(e->mem); g_free(e);
+}
+
+static void grp_gids_free(gpointer p) { g_array_unref(p); }
+
+/* Index from group and passwd streams: getgrent and /etc/passwd when
+ * NULL, else fgetgrent and fgetpwent on them. */
+static GrpIndex *grp_index_new_from(FILE *f, FILE *pwf) {
+	GrpIndex *gi=g_new0(GrpIndex,1);
+	gi->groups=g_ptr_array_new_with_free_func(grp_entry_free);
+	gi->by_name=g_hash_table_new(g_str_hash,g_str_equal);
+	gi->by_gid=g_hash_table_new(NULL,NULL);
+	gi->by_user=g_hash_table_new_full(g_str_hash,g_str_equal,g_free,grp_gids_free);
+	gi->local=g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL);
+	gi->initgroups=getgrouplist;
+	FILE *pwsrc=pwf?pwf:fopen("/etc/passwd","r");
+	struct passwd *pw;
+	while (pwsrc && (pw=fgetpwent(pwsrc)))
+		g_hash_table_add(gi->local,g_strdup(pw->pw_name));
+	if (pwsrc && !pwf) fclose(pwsrc);
+	if (!f) setgrent();
+	struct group *gr;
+	while ((gr=f?fgetgrent(f):getgrent())) {
+		GrpEntry *e=g_new(GrpEntry,1);
+		e->name=g_strdup(gr->gr_name); e->gid=gr->gr_gid;
+		e->mem=g_strdupv(gr->gr_mem?gr->gr_mem:(char *[]){ NULL });
+		g_ptr_array_add(gi->groups,e);
+		g_hash_table_insert(gi->by_name,e->name,e);
+		g_hash_table_insert(gi->by_gid,GUINT_TO_POINTER(e->gid),e);
+		for (int m=0;e->mem[m];m++) {
+			GArray *a=g_hash_table_lookup(gi->by_user,e->mem[m]);
+			if (!a) {
+				a=g_array_new(FALSE,FALSE,sizeof(gid_t));
+				g_hash_table_insert(gi->by_user,g_strdup(e->mem[m]),a);
+			}
+			g_array_append_val(a,e->gid);
+		}
+	}
+	if (!f) endgrent();
+	return gi;
+}
+
+static GrpIndex *grp_index_new(void) { return grp_index_new_from(NULL,NULL); }
+
+static void grp_index_free(GrpIndex *gi) {
+	g_hash_table_unref(gi->local);
+	g_hash_table_unref(gi->by_user);
+	g_hash_table_unref(gi->by_gid);
+	g_hash_table_unref(gi->by_name);
+	g_ptr_array_unref(gi->groups);
+	g_free(gi);
+}
+
+/* Supplementary gids of pw (the primary gid is not included). */
+static GArray *grp_index_user(GrpIndex *gi, const struct passwd *pw) {
+	GArray *a=g_hash_table_lookup(gi->by_user,pw->pw_name);
+	if (a) return a;
+	a=g_array_new(FALSE,FALSE,sizeof(gid_t));
+	if (!g_hash_table_contains(gi->local,pw->pw_name) ||
+	    !g_hash_table_contains(gi->by_gid,GUINT_TO_POINTER(pw->pw_gid))) {
+		int n=32;
+		gid_t *g=g_new(gid_t,n);
+		if (gi->initgroups(pw->pw_name,pw->pw_gid,g,&n)<0) {
+			g=g_renew(gid_t,g,n);
+			if (gi->initgroups(pw->pw_name,pw->pw_gid,g,&n)<0) n=0;
+		}
+		for (int i=0;i<n;i++) if (g[i]!=pw->pw_gid) g_array_append_val(a,g[i]);
+		g_free(g);
+	}
+	g_hash_table_insert(gi->by_user,g_strdup(pw->pw_name),a);
+	return a;
+}
+
+static gboolean grp_index_user_in(GrpIndex *gi, const struct passwd *pw, const char *group) {
+	GrpEntry *e=g_hash_table_lookup(gi->by_name,group);
+	gid_t gid;
+	if (e) gid=e->gid;
+	else {
+		struct group *gr=getgrnam(group);
+		if (!gr) return FALSE;
+		gid=gr->gr_gid;
+	}
+	if (pw->pw_gid==gid) return TRUE;
+	GArray *a=grp_index_user(gi,pw);
+	for (guint i=0;i<a->len;i++) if (g_array_index(a,gid_t,i)==gid) return TRUE;
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+/* account lists                                                        */
+/* ------------------------------------------------------------------ */
+/* With SSSD or LDAP, enumerating can return tens of thousands of
+ * entries and take seconds.  So a worker thread walks the databases
+ * and posts batches of UsrItems to two GListStores, each behind a
+ * filtered GtkListView.  The page is usable, and searchable, while the
+ * rest streams in.  Avatars are decoded at row size on a small pool
+ * the first time a row is bound, so home directories that are never
+ * scrolled to are never touched.  Pages are built once and kept, so
+ * it is unmapping, not destruction, that cancels the walk and drops any
+ * batch or avatar still queued; an unfinished walk starts over when the
+ * page is shown again.  Every walk and avatar job carries the generation
+ * it was started under, and bumping UsrLoad.gen retires them all.  Only
+ * one walk runs at a time: getpwent and getgrent keep a single position
+ * per process, so a walk that is still winding down when the page comes
+ * back is left to post its final batch, and the new one starts from
+ * there. */
+#define USR_BATCH      512
+#define USR_AVATAR_PX  40
+
+typedef enum { USR_USER, USR_GROUP } UsrKind;
+
+#define USR_TYPE_ITEM (usr_item_get_type())
+G_DECLARE_FINAL_TYPE(UsrItem, usr_item, USR, ITEM, GObject)
+
+struct _UsrItem {
+	GObject     parent_instance;
+	UsrKind     kind;
+	char       *name, *detail, *id, *home;
+	char       *key;                   /* casefolded name and detail, for search */
+	gboolean    admin, avatar_tried;
+	GdkTexture *avatar;
+	GtkWidget  *img;                   /* bound image, not a reference */
+};
+
+G_DEFINE_FINAL_TYPE(UsrItem, usr_item, G_TYPE_OBJECT)
+
+static void usr_item_finalize(GObject *o) {
+	UsrItem *it = USR_ITEM(o);
+	g_free(it->name); g_free(it->detail); g_free(it->id); g_free(it->home); g_free(it->key);
+	g_clear_object(&it->avatar);
+	G_OBJECT_CLASS(usr_item_parent_class)->finalize(o);
+}
+
+static void usr_item_class_init(UsrItemClass *klass) { G_OBJECT_CLASS(klass)->finalize = usr_item_finalize; }
+static void usr_item_init(UsrItem *it) {}
+
+static UsrItem *usr_item_new(UsrKind kind, const char *name, char *detail, char *id) {
+	UsrItem *it = g_object_new(USR_TYPE_ITEM, NULL);
+	it->kind = kind; it->name = g_strdup(name); it->detail = detail; it->id = id;
+	char *k = g_strconcat(name, " ", detail, NULL);
+	it->key = g_utf8_casefold(k, -1);
+	g_free(k);
+	return it;
+}
+
+typedef struct {
+	gint          gen;                 /* atomic; bumped to cancel */
+	gboolean      walking;             /* a walk thread exists, current or not */
+	gboolean      complete, mapped;
+	const char   *passwd_file, *group_file;   /* both or neither; NULL: NSS */
+	GListStore   *users, *groups;
+	GtkFilter    *filter;
+	char         *query;               /* casefolded search text */
+	GThreadPool  *avatars;
+	GtkWidget    *status;
+	guint         n_users, n_groups;
+} UsrLoad;
+
+typedef struct {
+	UsrLoad    *ul;
+	gint        gen;
+	GListStore *store;                 /* NULL: enumeration finished */
+	GPtrArray  *items;
+} UsrBatch;
+
+static gboolean usr_load_stale(UsrLoad *ul, gint gen) { return g_atomic_int_get(&ul->gen) != gen; }
+
+static void usr_load_clear(gpointer p) {
+	UsrLoad *ul = p;
+	g_object_unref(ul->users); g_object_unref(ul->groups);
+	g_object_unref(ul->filter);
+	g_free(ul->query);
+}
+
+static void usr_load_unref(UsrLoad *ul) { g_atomic_rc_box_release_full(ul, usr_load_clear); }
+
+static void usr_load_status(UsrLoad *ul, gboolean done) {
+	char buf[96];
+	snprintf(buf, sizeof(buf), "%s%u users \xc2\xb7 %u groups", done ? "" : "Loading\xe2\x80\xa6 ",
+		 ul->n_users, ul->n_groups);
+	gtk_label_set_text(GTK_LABEL(ul->status), buf);
+}
+
+static void usr_load_start(UsrLoad *ul);
+
+static gboolean usr_batch_idle(gpointer ud) {
+	UsrBatch *b = ud;
+	UsrLoad *ul = b->ul;
+	gboolean stale = usr_load_stale(ul, b->gen);
+	if (!b->store) {
+		/* final batch: the thread has ended its pass over the databases */
+		ul->walking = FALSE;
+		if (stale) {
+			if (ul->mapped) usr_load_start(ul);
+			return G_SOURCE_REMOVE;
+		}
+		ul->complete = TRUE;
+	} else if (stale) {
+		return G_SOURCE_REMOVE;
+	} else {
+		g_list_store_splice(b->store, g_list_model_get_n_items(G_LIST_MODEL(b->store)), 0,
+				    b->items->pdata, b->items->len);
+		if (b->store == ul->users) ul->n_users  += b->items->len;
+		else                       ul->n_groups += b->items->len;
+	}
+	usr_load_status(ul, b->store == NULL);
+	return G_SOURCE_REMOVE;
+}
+
+static void usr_batch_free(gpointer ud) {
+	UsrBatch *b = ud;
+	if (b->items) g_ptr_array_unref(b->items);
+	usr_load_unref(b->ul);
+	g_free(b);
+}
+
+/* Hand the items gathered so far to the main loop; returns a fresh array. */
+static GPtrArray *usr_batch_post(UsrLoad *ul, gint gen, GListStore *store, GPtrArray *items) {
+	UsrBatch *b = g_new0(UsrBatch, 1);
+	b->ul = g_atomic_rc_box_acquire(ul); b->gen = gen; b->store = store; b->items = items;
+	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, usr_batch_idle, b, usr_batch_free);
+	return store ? g_ptr_array_new_with_free_func(g_object_unref) : NULL;
+}
+
+static gpointer usr_load_thread(gpointer ud) {
+	UsrBatch *walk = ud;                 /* store and items unused */
+	UsrLoad *ul = walk->ul;
+	gint gen = walk->gen;
+	gboolean nss = !ul->passwd_file;
+	FILE *gf = nss ? NULL : fopen(ul->group_file,  "r");
+	FILE *pf = nss ? NULL : fopen(ul->passwd_file, "r");
+	GrpIndex *gi = nss ? grp_index_new() : grp_index_new_from(gf, pf);
+	if (gf) fclose(gf);
+	if (pf) rewind(pf);
+	GPtrArray *items = g_ptr_array_new_with_free_func(g_object_unref);
+	for (guint i = 0; i < gi->groups->len && !usr_load_stale(ul, gen); i++) {
+		GrpEntry *gr = g_ptr_array_index(gi->groups, i);
+		if (!gr->mem[0] && gr->gid < 1000) continue;
+		g_ptr_array_add(items, usr_item_new(USR_GROUP, gr->name, g_strjoinv(", ", gr->mem),
+						    g_strdup_printf("GID %u", (unsigned)gr->gid)));
+		if (items->len == USR_BATCH) items = usr_batch_post(ul, gen, ul->groups, items);
+	}
+	items = usr_batch_post(ul, gen, ul->groups, items);
+	if (nss) setpwent();
+	struct passwd *pw;
+	while (!usr_load_stale(ul, gen) && (pw = nss ? getpwent() : pf ? fgetpwent(pf) : NULL)) {
+		if (pw->pw_uid < 1000 || pw->pw_uid > 65000) continue;
+		if (!pw->pw_dir || strncmp(pw->pw_dir, "/home", 5) != 0) continue;
+		UsrItem *it = usr_item_new(USR_USER, pw->pw_name,
+					   g_strdup_printf("UID %u \xc2\xb7 %s", (unsigned)pw->pw_uid, pw->pw_shell),
+					   NULL);
+		it->home  = g_strdup(pw->pw_dir);
+		it->admin = grp_index_user_in(gi, pw, "wheel");
+		g_ptr_array_add(items, it);
+		if (items->len == USR_BATCH) items = usr_batch_post(ul, gen, ul->users, items);
+	}
+	if (nss) endpwent();
+	else if (pf) fclose(pf);
+	g_ptr_array_unref(usr_batch_post(ul, gen, ul->users, items));
+	grp_index_free(gi);
+	/* the last batch takes over this thread's reference, so the
+	 * final release always happens on the main thread */
+	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, usr_batch_idle, walk, usr_batch_free);
+	return NULL;
+}
+
+/* avatars */
+typedef struct {
+	UsrLoad    *ul;
+	UsrItem    *it;                    /* only touched on the main thread */
+	char       *home;
+	int         px;
+	gint        gen;
+	GdkTexture *tex;                   /* built by the pool */
+} UsrAvatarJob;
+
+static gboolean usr_avatar_idle(gpointer ud) {
+	UsrAvatarJob *j = ud;
+	if (usr_load_stale(j->ul, j->gen)) {
+		j->it->avatar_tried = FALSE;   /* skipped; try again on the next bind */
+		return G_SOURCE_REMOVE;
+	}
+	if (!j->tex) return G_SOURCE_REMOVE;
+	g_set_object(&j->it->avatar, j->tex);
+	if (j->it->img) gtk_image_set_from_paintable(GTK_IMAGE(j->it->img), GDK_PAINTABLE(j->tex));
+	return G_SOURCE_REMOVE;
+}
+
+static void usr_avatar_job_free(gpointer ud) {
+	UsrAvatarJob *j = ud;
+	g_clear_object(&j->tex);
+	g_free(j->home);
+	g_object_unref(j->it);
+	usr_load_unref(j->ul);
+	g_free(j);
+}
+
+static void usr_avatar_load(gpointer data, gpointer unused) {
+	UsrAvatarJob *j = data;
+	char *path = g_build_filename(j->home, ".face", NULL);
+	GdkPixbuf *pb = usr_load_stale(j->ul, j->gen) ? NULL
+		: gdk_pixbuf_new_from_file_at_scale(path, j->px, j->px, TRUE, NULL);
+	g_free(path);
+	if (pb) {
+		GBytes *px = gdk_pixbuf_read_pixel_bytes(pb);
+		j->tex = gdk_memory_texture_new(gdk_pixbuf_get_width(pb), gdk_pixbuf_get_height(pb),
+						gdk_pixbuf_get_has_alpha(pb) ? GDK_MEMORY_R8G8B8A8 : GDK_MEMORY_R8G8B8,
+						px, gdk_pixbuf_get_rowstride(pb));
+		g_bytes_unref(px);
+		g_object_unref(pb);
+	}
+	/* released on the main thread, like the batches */
+	g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, usr_avatar_idle, j, usr_avatar_job_free);
+}
+
+/* rows */
+static void usr_setup_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_start(row, 6); gtk_widget_set_margin_end(row, 6);
+	gtk_widget_set_margin_top(row, 6);   gtk_widget_set_margin_bottom(row, 6);
+	GtkWidget *img = gtk_image_new();
+	gtk_image_set_pixel_size(GTK_IMAGE(img), GPOINTER_TO_INT(ud));
+	gtk_box_append(GTK_BOX(row), img);
+	GtkWidget *inf = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+	gtk_widget_set_hexpand(inf, TRUE);
+	GtkWidget *nl = gtk_label_new(NULL);
+	gtk_widget_set_halign(nl, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(inf), nl);
+	GtkWidget *dl = gtk_label_new(NULL);
+	gtk_widget_add_css_class(dl, "dim-label"); gtk_widget_add_css_class(dl, "caption");
+	gtk_widget_set_halign(dl, GTK_ALIGN_START);
+	gtk_label_set_ellipsize(GTK_LABEL(dl), PANGO_ELLIPSIZE_END);
+	gtk_box_append(GTK_BOX(inf), dl);
+	gtk_box_append(GTK_BOX(row), inf);
+	GtkWidget *tag = gtk_label_new(NULL);
+	gtk_widget_set_valign(tag, GTK_ALIGN_CENTER);
+	gtk_box_append(GTK_BOX(row), tag);
+	gtk_list_item_set_child(li, row);
+}
+
+static void usr_bind_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	UsrLoad *ul = ud;
+	UsrItem *it = gtk_list_item_get_item(li);
+	GtkWidget *img = gtk_widget_get_first_child(gtk_list_item_get_child(li));
+	GtkWidget *inf = gtk_widget_get_next_sibling(img);
+	GtkWidget *tag = gtk_widget_get_next_sibling(inf);
+	GtkWidget *nl  = gtk_widget_get_first_child(inf);
+	gtk_label_set_text(GTK_LABEL(nl), it->name);
+	gtk_label_set_text(GTK_LABEL(gtk_widget_get_next_sibling(nl)), it->detail);
+	gtk_widget_set_visible(gtk_widget_get_next_sibling(nl), it->detail[0] != '\0');
+	if (it->kind == USR_GROUP) {
+		gtk_image_set_from_icon_name(GTK_IMAGE(img), "system-users-symbolic");
+		gtk_label_set_text(GTK_LABEL(tag), it->id);
+		gtk_widget_add_css_class(tag, "dim-label"); gtk_widget_add_css_class(tag, "caption");
+		return;
+	}
+	gtk_label_set_text(GTK_LABEL(tag), "sudo");
+	gtk_widget_add_css_class(tag, "tag");
+	gtk_widget_set_visible(tag, it->admin);
+	it->img = img;
+	if (it->avatar) { gtk_image_set_from_paintable(GTK_IMAGE(img), GDK_PAINTABLE(it->avatar)); return; }
+	gtk_image_set_from_icon_name(GTK_IMAGE(img), "avatar-default-symbolic");
+	if (it->avatar_tried) return;
+	it->avatar_tried = TRUE;
+	UsrAvatarJob *j = g_new0(UsrAvatarJob, 1);
+	j->ul = g_atomic_rc_box_acquire(ul); j->it = g_object_ref(it);
+	j->home = g_strdup(it->home); j->gen = g_atomic_int_get(&ul->gen);
+	j->px = USR_AVATAR_PX * gtk_widget_get_scale_factor(img);
+	g_thread_pool_push(ul->avatars, j, NULL);
+}
+
+static void usr_unbind_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	UsrItem *it = gtk_list_item_get_item(li);
+	if (it) it->img = NULL;
+}
+
+static gboolean usr_filter_func(gpointer item, gpointer ud) {
+	UsrLoad *ul = ud;
+	return !ul->query || strstr(USR_ITEM(item)->key, ul->query);
+}
+
+static void usr_search_changed(GtkSearchEntry *e, gpointer ud) {
+	UsrLoad *ul = ud;
+	const char *t = gtk_editable_get_text(GTK_EDITABLE(e));
+	char *q = t[0] ? g_utf8_casefold(t, -1) : NULL;
+	GtkFilterChange ch = GTK_FILTER_CHANGE_DIFFERENT;
+	if (!ul->query)                 ch = GTK_FILTER_CHANGE_MORE_STRICT;
+	else if (!q)                    ch = GTK_FILTER_CHANGE_LESS_STRICT;
+	else if (strstr(q, ul->query))  ch = GTK_FILTER_CHANGE_MORE_STRICT;
+	else if (strstr(ul->query, q))  ch = GTK_FILTER_CHANGE_LESS_STRICT;
+	g_free(ul->query); ul->query = q;
+	gtk_filter_changed(ul->filter, ch);
+}
+
+static GtkWidget *usr_list_new(UsrLoad *ul, GListStore *store, int icon_px) {
+	GtkFilterListModel *fm = gtk_filter_list_model_new(G_LIST_MODEL(g_object_ref(store)),
+							   g_object_ref(ul->filter));
+	gtk_filter_list_model_set_incremental(fm, TRUE);
+	GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+	g_signal_connect(factory, "setup",  G_CALLBACK(usr_setup_cb),  GINT_TO_POINTER(icon_px));
+	g_signal_connect(factory, "bind",   G_CALLBACK(usr_bind_cb),   ul);
+	g_signal_connect(factory, "unbind", G_CALLBACK(usr_unbind_cb), ul);
+	GtkWidget *list = gtk_list_view_new(GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(fm))), factory);
+	gtk_widget_add_css_class(list, "navigation-sidebar");
+	GtkWidget *sw = gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(sw), 200);
+	gtk_scrolled_window_set_has_frame(GTK_SCROLLED_WINDOW(sw), TRUE);
+	gtk_widget_set_vexpand(sw, TRUE);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(sw), list);
+	return sw;
+}
+
+static void usr_load_start(UsrLoad *ul) {
+	g_list_store_remove_all(ul->users);
+	g_list_store_remove_all(ul->groups);
+	ul->n_users = ul->n_groups = 0;
+	usr_load_status(ul, FALSE);
+	ul->walking = TRUE;
+	UsrBatch *walk = g_new0(UsrBatch, 1);
+	walk->ul = g_atomic_rc_box_acquire(ul);
+	walk->gen = g_atomic_int_get(&ul->gen);
+	g_thread_unref(g_thread_new("usr-load", usr_load_thread, walk));
+}
+
+/* (Re)start the walk unless a full listing is already in the stores;
+ * if an old walk is still finishing, its final batch starts the new one. */
+static void usr_page_mapped(GtkWidget *w, gpointer ud) {
+	UsrLoad *ul = ud;
+	ul->mapped = TRUE;
+	if (ul->walking || ul->complete) return;
+	usr_load_start(ul);
+}
+
+static void usr_page_unmapped(GtkWidget *w, gpointer ud) {
+	UsrLoad *ul = ud;
+	ul->mapped = FALSE;
+	g_atomic_int_inc(&ul->gen);         /* retires the walk, its batches and queued avatars */
+}
+
+static void usr_page_destroyed(GtkWidget *w, gpointer ud) {
+	UsrLoad *ul = ud;
+	g_atomic_int_inc(&ul->gen);
+	g_thread_pool_free(ul->avatars, FALSE, FALSE);      /* queued jobs see the stale gen and skip */
+	usr_load_unref(ul);
+}
+
+static UsrLoad *usr_load_new(void) {
+	UsrLoad *ul = g_atomic_rc_box_new0(UsrLoad);
+	ul->users   = g_list_store_new(USR_TYPE_ITEM);
+	ul->groups  = g_list_store_new(USR_TYPE_ITEM);
+	ul->filter  = GTK_FILTER(gtk_custom_filter_new(usr_filter_func, ul, NULL));
+	ul->avatars = g_thread_pool_new(usr_avatar_load, NULL, 2, FALSE, NULL);
+	return ul;
+}
+
+static GtkWidget *usr_heading(const char *title) {
+	GtkWidget *l = gtk_label_new(title);
+	gtk_widget_add_css_class(l, "title-4"); gtk_widget_set_halign(l, GTK_ALIGN_START);
+	gtk_widget_set_margin_top(l, 12); gtk_widget_set_margin_bottom(l, 8);
+	return l;
+}
+
 GtkWidget *users_settings(void) {
 	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
 	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
 	gtk_box_append(GTK_BOX(root),make_page_header("system-users-symbolic","Users & Groups"));
 	gtk_box_append(GTK_BOX(root),gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
-	GtkWidget *scr=gtk_scrolled_window_new();
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scr),GTK_POLICY_NEVER,GTK_POLICY_AUTOMATIC);
-	gtk_widget_set_vexpand(scr,TRUE);
 	GtkWidget *vb=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
+	gtk_widget_set_vexpand(vb,TRUE);
 	gtk_widget_set_margin_start(vb,16); gtk_widget_set_margin_end(vb,16);
 	gtk_widget_set_margin_top(vb,12);   gtk_widget_set_margin_bottom(vb,12);
-	/* Users */
-	GtkWidget *ul=gtk_label_new("Users");
-	gtk_widget_add_css_class(ul,"title-4"); gtk_widget_set_halign(ul,GTK_ALIGN_START);
-	gtk_widget_set_margin_bottom(ul,8); gtk_box_append(GTK_BOX(vb),ul);
-	GtkWidget *user_list=gtk_list_box_new();
-	gtk_list_box_set_selection_mode(GTK_LIST_BOX(user_list),GTK_SELECTION_NONE);
-	gtk_widget_add_css_class(user_list,"boxed-list");
-	gtk_widget_set_margin_bottom(user_list,20);
-	setpwent();
-	struct passwd *pw;
-	while ((pw=getpwent())) {
-		if (pw->pw_uid<1000||pw->pw_uid>65000) continue;
-		if (!pw->pw_dir||strncmp(pw->pw_dir,"/home",5)!=0) continue;
-		GtkWidget *row=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,12);
-		gtk_widget_set_margin_start(row,14); gtk_widget_set_margin_end(row,14);
-		gtk_widget_set_margin_top(row,10);   gtk_widget_set_margin_bottom(row,10);
-		char avatarp[512]; snprintf(avatarp,sizeof(avatarp),"%s/.face",pw->pw_dir);
-		GtkWidget *av;
-		if (g_file_test(avatarp,G_FILE_TEST_EXISTS)) av=gtk_image_new_from_file(avatarp);
-		else av=gtk_image_new_from_icon_name("avatar-default-symbolic");
-		gtk_image_set_pixel_size(GTK_IMAGE(av),40); gtk_box_append(GTK_BOX(row),av);
-		GtkWidget *inf=gtk_box_new(GTK_ORIENTATION_VERTICAL,2); gtk_widget_set_hexpand(inf,TRUE);
-		GtkWidget *nl=gtk_label_new(pw->pw_name);
-		gtk_widget_add_css_class(nl,"body"); gtk_widget_set_halign(nl,GTK_ALIGN_START);
-		gtk_box_append(GTK_BOX(inf),nl);
-		char uid_str[64]; snprintf(uid_str,sizeof(uid_str),"UID %d · %s",pw->pw_uid,pw->pw_shell);
-		GtkWidget *sl=gtk_label_new(uid_str);
-		gtk_widget_add_css_class(sl,"dim-label"); gtk_widget_add_css_class(sl,"caption");
-		gtk_widget_set_halign(sl,GTK_ALIGN_START); gtk_box_append(GTK_BOX(inf),sl);
-		gtk_box_append(GTK_BOX(row),inf);
-		char chk[256];
-		snprintf(chk,sizeof(chk),"groups %s 2>/dev/null | grep -qw wheel && echo yes",pw->pw_name);
-		FILE *gf=popen(chk,"r"); char gbuf[8]="";
-		if(gf){fgets(gbuf,sizeof(gbuf),gf);pclose(gf);}
-		if (strncmp(gbuf,"yes",3)==0) {
-			GtkWidget *badge=gtk_label_new("sudo");
-			gtk_widget_add_css_class(badge,"tag"); gtk_widget_set_valign(badge,GTK_ALIGN_CENTER);
-			gtk_box_append(GTK_BOX(row),badge);
-		}
-		gtk_list_box_append(GTK_LIST_BOX(user_list),row);
-	}
-	endpwent();
-	gtk_box_append(GTK_BOX(vb),user_list);
-	/* Groups */
-	GtkWidget *gl=gtk_label_new("Groups");
-	gtk_widget_add_css_class(gl,"title-4"); gtk_widget_set_halign(gl,GTK_ALIGN_START);
-	gtk_widget_set_margin_bottom(gl,8); gtk_box_append(GTK_BOX(vb),gl);
-	GtkWidget *grp_list=gtk_list_box_new();
-	gtk_list_box_set_selection_mode(GTK_LIST_BOX(grp_list),GTK_SELECTION_NONE);
-	gtk_widget_add_css_class(grp_list,"boxed-list");
-	setgrent();
-	struct group *gr;
-	while ((gr=getgrent())) {
-		int hm=gr->gr_mem&&gr->gr_mem[0];
-		if (!hm&&gr->gr_gid<1000) continue;
-		GtkWidget *row=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,12);
-		gtk_widget_set_margin_start(row,14); gtk_widget_set_margin_end(row,14);
-		gtk_widget_set_margin_top(row,8);    gtk_widget_set_margin_bottom(row,8);
-		GtkWidget *ni=gtk_image_new_from_icon_name("system-users-symbolic");
-		gtk_image_set_pixel_size(GTK_IMAGE(ni),24); gtk_box_append(GTK_BOX(row),ni);
-		GtkWidget *inf=gtk_box_new(GTK_ORIENTATION_VERTICAL,2); gtk_widget_set_hexpand(inf,TRUE);
-		GtkWidget *gn=gtk_label_new(gr->gr_name); gtk_widget_set_halign(gn,GTK_ALIGN_START);
-		gtk_box_append(GTK_BOX(inf),gn);
-		if (hm) {
-			GString *ms=g_string_new(NULL);
-			for(int m=0;gr->gr_mem[m];m++){if(m)g_string_append(ms,", ");g_string_append(ms,gr->gr_mem[m]);}
-			GtkWidget *ml=gtk_label_new(ms->str);
-			gtk_widget_add_css_class(ml,"dim-label"); gtk_widget_add_css_class(ml,"caption");
-			gtk_widget_set_halign(ml,GTK_ALIGN_START);
-			gtk_label_set_ellipsize(GTK_LABEL(ml),PANGO_ELLIPSIZE_END);
-			gtk_box_append(GTK_BOX(inf),ml); g_string_free(ms,TRUE);
-		}
-		gtk_box_append(GTK_BOX(row),inf);
-		char gs[32]; snprintf(gs,sizeof(gs),"GID %d",gr->gr_gid);
-		GtkWidget *gidl=gtk_label_new(gs);
-		gtk_widget_add_css_class(gidl,"dim-label"); gtk_widget_add_css_class(gidl,"caption");
-		gtk_widget_set_valign(gidl,GTK_ALIGN_CENTER); gtk_box_append(GTK_BOX(row),gidl);
-		gtk_list_box_append(GTK_LIST_BOX(grp_list),row);
-	}
-	endgrent();
-	gtk_box_append(GTK_BOX(vb),grp_list);
-	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scr),vb);
-	gtk_box_append(GTK_BOX(root),scr);
+	gtk_box_append(GTK_BOX(root),vb);
+
+	UsrLoad *ul = usr_load_new();
+
+	GtkWidget *se = gtk_search_entry_new();
+	gtk_search_entry_set_placeholder_text(GTK_SEARCH_ENTRY(se), "Search users and groups");
+	g_signal_connect(se, "search-changed", G_CALLBACK(usr_search_changed), ul);
+	gtk_box_append(GTK_BOX(vb), se);
+	ul->status = gtk_label_new(NULL);
+	gtk_widget_add_css_class(ul->status, "dim-label"); gtk_widget_add_css_class(ul->status, "caption");
+	gtk_widget_set_halign(ul->status, GTK_ALIGN_START); gtk_widget_set_margin_top(ul->status, 6);
+	gtk_box_append(GTK_BOX(vb), ul->status);
+	usr_load_status(ul, FALSE);
+
+	gtk_box_append(GTK_BOX(vb), usr_heading("Users"));
+	gtk_box_append(GTK_BOX(vb), usr_list_new(ul, ul->users, USR_AVATAR_PX));
+	gtk_box_append(GTK_BOX(vb), usr_heading("Groups"));
+	gtk_box_append(GTK_BOX(vb), usr_list_new(ul, ul->groups, 24));
+
+	g_signal_connect(root, "map",     G_CALLBACK(usr_page_mapped),    ul);
+	g_signal_connect(root, "unmap",   G_CALLBACK(usr_page_unmapped),  ul);
+	g_signal_connect(root, "destroy", G_CALLBACK(usr_page_destroyed), ul);
 	return root;
 }
 
 /* ================================================================== */
 /* Date & Time                                                          */
 /* ================================================================== */
+/* ------------------------------------------------------------------ */
+/* timezone index                                                       */
+/* ------------------------------------------------------------------ */
+/* Zone names come from tzdata.zi, Z and L lines, which is the set that
+ * `timedatectl list-timezones` prints.  Country and coordinates come
+ * from zone.tab, which names one country for each zone.  zone1970.tab
+ * fills in the zones zone.tab does not list, and links inherit from
+ * their target.  Each zone also gets its UTC offset at load time.
+ * The index is built once, off the main thread, on first use, and
+ * never changes after that.  Search goes
+ * through a trigram index over "name\ncountries\nUTC+hh:mm": a query
+ * of three or more bytes intersects its trigrams' postings and checks
+ * the candidates for the substring.  If nothing matches exactly, zones
+ * sharing most of the query's trigrams are offered, so a typo still
+ * lands. */
+#define TZ_DIR        "/usr/share/zoneinfo"
+#define TZ_FUZZY_PCT  60
+
+typedef struct {
+	char   *name;
+	char   *country;               /* display name, "" when unknown */
+	char   *search;                /* lowercased search text */
+	double  lat, lon;              /* NAN when unknown */
+	int     offset;                /* seconds east of UTC, now */
+	char    offset_str[16];        /* "UTC+05:30" */
+} TzZone;
+
+typedef struct {
+	TzZone     *zones;             /* sorted by name */
+	guint       n;
+	GHashTable *tri;               /* trigram -> GArray of guint16 zone indexes */
+} TzDb;
+
+typedef struct { char *codes; double lat, lon; } TzTabEntry;
+
+static guint32 tz_trigram(const char *s) {
+	return (guint8)s[0] << 16 | (guint8)s[1] << 8 | (guint8)s[2];
+}
+
+/* lowercase, '_' as space, so "new york" finds America/New_York */
+static char *tz_fold(const char *s) {
+	char *f = g_ascii_strdown(s, -1);
+	for (char *p = f; *p; p++) if (*p == '_') *p = ' ';
+	return f;
+}
+
+/* ISO 6709 +DDMM+DDDMM or +DDMMSS+DDDMMSS */
+static double tz_coord(const char *s, int deg_digits, const char **end) {
+	int len = 1 + deg_digits;
+	while (g_ascii_isdigit(s[len])) len++;
+	int sec = len - 1 - deg_digits > 2;
+	double v = 0;
+	for (int i = 1; i <= deg_digits; i++) v = v * 10 + (s[i] - '0');
+	const char *p = s + 1 + deg_digits;
+	v += ((p[0] - '0') * 10 + (p[1] - '0')) / 60.0;
+	if (sec) v += ((p[2] - '0') * 10 + (p[3] - '0')) / 3600.0;
+	*end = s + len;
+	return s[0] == '-' ? -v : v;
+}
+
+static void tz_tab_free(gpointer p) {
+	TzTabEntry *e = p;
+	g_free(e->codes); g_free(e);
+}
+
+/* zone.tab / zone1970.tab -> name -> TzTabEntry; zone.tab wins */
+static void tz_read_tab(const char *dir, GHashTable *tab, const char *file, gboolean replace) {
+	char *path = g_build_filename(dir, file, NULL), *buf = NULL;
+	g_file_get_contents(path, &buf, NULL, NULL);
+	g_free(path);
+	if (!buf) return;
+	for (char *line = buf, *next; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+		if (line[0] == '#') continue;
+		char **f = g_strsplit(line, "\t", 4);
+		if (g_strv_length(f) >= 3 && (f[1][0] == '+' || f[1][0] == '-') &&
+		    (replace || !g_hash_table_contains(tab, f[2]))) {
+			TzTabEntry *e = g_new(TzTabEntry, 1);
+			const char *p;
+			e->codes = g_strdup(f[0]);
+			e->lat   = tz_coord(f[1], 2, &p);
+			e->lon   = *p == '+' || *p == '-' ? tz_coord(p, 3, &p) : NAN;
+			g_hash_table_replace(tab, g_strdup(f[2]), e);
+		}
+		g_strfreev(f);
+	}
+	g_free(buf);
+}
+
+static GHashTable *tz_read_countries(const char *dir) {
+	GHashTable *c = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	char *path = g_build_filename(dir, "iso3166.tab", NULL), *buf = NULL;
+	g_file_get_contents(path, &buf, NULL, NULL);
+	g_free(path);
+	for (char *line = buf, *next; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+		char *tab = strchr(line, '\t');
+		if (line[0] == '#' || !tab) continue;
+		g_hash_table_insert(c, g_strndup(line, tab - line), g_strdup(tab + 1));
+	}
+	g_free(buf);
+	return c;
+}
+
+static int tz_zone_cmp(const void *a, const void *b) {
+	return strcmp(((const TzZone *)a)->name, ((const TzZone *)b)->name);
+}
+
+static void tz_db_add_trigrams(TzDb *db, guint16 idx) {
+	const char *s = db->zones[idx].search;
+	for (size_t i = 0, n = strlen(s); i + 3 <= n; i++) {
+		gpointer key = GUINT_TO_POINTER(tz_trigram(s + i));
+		GArray *a = g_hash_table_lookup(db->tri, key);
+		if (!a) {
+			a = g_array_new(FALSE, FALSE, sizeof(guint16));
+			g_hash_table_insert(db->tri, key, a);
+		}
+		if (!a->len || g_array_index(a, guint16, a->len - 1) != idx) g_array_append_val(a, idx);
+	}
+}
+
+/* Build the index from the tables in dir (TZ_DIR outside tests).  UTC
+ * offsets come from GLib's own zone loader whatever dir is. */
+static TzDb *tz_db_build(const char *dir) {
+	/* names: tzdata.zi, else whatever the tab files list */
+	GHashTable *names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);  /* name -> link target or "" */
+	char *zi_path = g_build_filename(dir, "tzdata.zi", NULL), *zi = NULL;
+	g_file_get_contents(zi_path, &zi, NULL, NULL);
+	g_free(zi_path);
+	for (char *line = zi, *next; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+		if ((line[0] != 'Z' && line[0] != 'L') || line[1] != ' ') continue;
+		char **f = g_strsplit(line + 2, " ", 3);
+		if (line[0] == 'Z' && f[0])
+			g_hash_table_replace(names, g_strdup(f[0]), g_strdup(""));
+		else if (line[0] == 'L' && f[0] && f[1])
+			g_hash_table_replace(names, g_strdup(f[1]), g_strdup(f[0]));
+		g_strfreev(f);
+	}
+	g_free(zi);
+
+	GHashTable *tab = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, tz_tab_free);
+	tz_read_tab(dir, tab, "zone.tab", TRUE);
+	tz_read_tab(dir, tab, "zone1970.tab", FALSE);
+	if (!g_hash_table_size(names)) {
+		GHashTableIter it;
+		gpointer k;
+		g_hash_table_iter_init(&it, tab);
+		while (g_hash_table_iter_next(&it, &k, NULL)) g_hash_table_insert(names, g_strdup(k), g_strdup(""));
+		g_hash_table_insert(names, g_strdup("UTC"), g_strdup(""));
+	}
+	GHashTable *countries = tz_read_countries(dir);
+
+	TzDb *db = g_new0(TzDb, 1);
+	db->n = MIN(g_hash_table_size(names), G_MAXUINT16);
+	db->zones = g_new0(TzZone, db->n);
+	db->tri = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_array_unref);
+	GHashTableIter it;
+	gpointer k, v;
+	guint i = 0;
+	g_hash_table_iter_init(&it, names);
+	while (i < db->n && g_hash_table_iter_next(&it, &k, &v)) db->zones[i++].name = g_strdup(k);
+	qsort(db->zones, db->n, sizeof(TzZone), tz_zone_cmp);
+
+	GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+	GDateTime *now = g_date_time_new_now_utc();
+	gint64 unix_now = g_date_time_to_unix(now);
+	g_date_time_unref(now);
+	for (i = 0; i < db->n; i++) {
+		TzZone *z = &db->zones[i];
+		TzTabEntry *e = g_hash_table_lookup(tab, z->name);
+		const char *target = g_hash_table_lookup(names, z->name);
+		if (!e && target && target[0]) e = g_hash_table_lookup(tab, target);
+
+		GString *cs = g_string_new(NULL);
+		char **codes = g_strsplit(e ? e->codes : "", ",", -1);
+		for (int c = 0; codes[c]; c++) {
+			const char *cn = g_hash_table_lookup(countries, codes[c]);
+			if (!cn) continue;
+			if (!z->country) z->country = g_strdup(cn);
+			g_string_append_printf(cs, "%s%s", cs->len ? ", " : "", cn);
+		}
+		g_strfreev(codes);
+		if (!z->country) z->country = g_strdup("");
+		z->lat = e ? e->lat : NAN;
+		z->lon = e ? e->lon : NAN;
+
+		/* loading a zone is most of the build; links share their target's */
+		const char *real = target && target[0] ? target : z->name;
+		gpointer off;
+		if (g_hash_table_lookup_extended(offsets, real, NULL, &off)) z->offset = GPOINTER_TO_INT(off);
+		else {
+			GTimeZone *tz = g_time_zone_new_identifier(real);
+			if (tz) {
+				int iv = g_time_zone_find_interval(tz, G_TIME_TYPE_UNIVERSAL, unix_now);
+				z->offset = iv >= 0 ? g_time_zone_get_offset(tz, iv) : 0;
+				g_time_zone_unref(tz);
+			}
+			g_hash_table_insert(offsets, (gpointer)real, GINT_TO_POINTER(z->offset));
+		}
+		int a = ABS(z->offset);
+		snprintf(z->offset_str, sizeof(z->offset_str), "UTC%c%02d:%02d",
+			 z->offset < 0 ? '-' : '+', a / 3600, a / 60 % 60);
+
+		char *text = g_strdup_printf("%s\n%s\n%s", z->name, cs->str, z->offset_str);
+		z->search = tz_fold(text);
+		g_free(text);
+		g_string_free(cs, TRUE);
+		tz_db_add_trigrams(db, i);
+	}
+	g_hash_table_unref(offsets);
+	g_hash_table_unref(countries);
+	g_hash_table_unref(tab);
+	g_hash_table_unref(names);
+	return db;
+}
+
+/* The build runs once, on a worker thread; widgets waiting for it are
+ * held weakly and called back on the main thread. */
+typedef struct { GWeakRef ref; void (*cb)(GtkWidget *, const TzDb *); } TzDbWaiter;
+
+static TzDb   *tz_db_ready;
+static GSList *tz_db_waiters;
+
+static gboolean tz_db_built_idle(gpointer ud) {
+	tz_db_ready = ud;
+	tz_db_waiters = g_slist_reverse(tz_db_waiters);
+	for (GSList *l = tz_db_waiters; l; l = l->next) {
+		TzDbWaiter *w = l->data;
+		GtkWidget *widget = g_weak_ref_get(&w->ref);
+		if (widget) { w->cb(widget, tz_db_ready); g_object_unref(widget); }
+		g_weak_ref_clear(&w->ref);
+		g_free(w);
+	}
+	g_clear_pointer(&tz_db_waiters, g_slist_free);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer tz_db_thread(gpointer ud) {
+	g_idle_add(tz_db_built_idle, tz_db_build(TZ_DIR));
+	return NULL;
+}
+
+/* Call cb(widget, db) once the index exists, unless widget is gone. */
+static void tz_db_when_ready(GtkWidget *widget, void (*cb)(GtkWidget *, const TzDb *)) {
+	if (tz_db_ready) { cb(widget, tz_db_ready); return; }
+	if (!tz_db_waiters) g_thread_unref(g_thread_new("tz-index", tz_db_thread, NULL));
+	TzDbWaiter *w = g_new(TzDbWaiter, 1);
+	g_weak_ref_init(&w->ref, widget);
+	w->cb = cb;
+	tz_db_waiters = g_slist_prepend(tz_db_waiters, w);
+}
+
+static int tz_db_find(const TzDb *db, const char *name) {
+	TzZone key = { .name = (char *)name };
+	const TzZone *z = name ? bsearch(&key, db->zones, db->n, sizeof(TzZone), tz_zone_cmp) : NULL;
+	return z ? (int)(z - db->zones) : -1;
+}
+
+/* Set hit[i] for every zone matching q; returns the number of hits.
+ * An empty query matches everything. */
+static guint tz_db_query(const TzDb *db, const char *q, guint8 *hit) {
+	char *f = tz_fold(q);
+	size_t len = strlen(f);
+	guint n = 0;
+	memset(hit, 0, db->n);
+	if (len < 3) {
+		for (guint i = 0; i < db->n; i++) n += hit[i] = strstr(db->zones[i].search, f) != NULL;
+		g_free(f);
+		return n;
+	}
+	/* count, per zone, how many of the query's distinct trigrams it has */
+	guint16 *cnt = g_new0(guint16, db->n);
+	GHashTable *seen = g_hash_table_new(NULL, NULL);
+	guint ntri = 0;
+	for (size_t i = 0; i + 3 <= len; i++) {
+		gpointer key = GUINT_TO_POINTER(tz_trigram(f + i));
+		if (!g_hash_table_add(seen, key)) continue;
+		ntri++;
+		GArray *a = g_hash_table_lookup(db->tri, key);
+		for (guint j = 0; a && j < a->len; j++) cnt[g_array_index(a, guint16, j)]++;
+	}
+	for (guint i = 0; i < db->n; i++)
+		if (cnt[i] == ntri && strstr(db->zones[i].search, f)) { hit[i] = 1; n++; }
+	if (!n && ntri >= 2)
+		for (guint i = 0; i < db->n; i++)
+			if (cnt[i] * 100 >= ntri * TZ_FUZZY_PCT) { hit[i] = 1; n++; }
+	g_hash_table_unref(seen);
+	g_free(cnt);
+	g_free(f);
+	return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* timezone picker                                                      */
+/* ------------------------------------------------------------------ */
+/* Both the Date & Time and the Region pages use this picker.  Each one
+ * filters the same shared model (tz_model, one TzItem per zone in
+ * index order) with its own search hits.  The current zone is pushed
+ * in with tz_picker_select as timedate1 reports it. */
+#define TZ_TYPE_ITEM (tz_item_get_type())
+G_DECLARE_FINAL_TYPE(TzItem, tz_item, TZ, ITEM, GObject)
+
+struct _TzItem {
+	GObject parent_instance;
+	guint   idx;
+};
+
+G_DEFINE_FINAL_TYPE(TzItem, tz_item, G_TYPE_OBJECT)
+static void tz_item_class_init(TzItemClass *klass) {}
+static void tz_item_init(TzItem *it) {}
+
+static GListModel *tz_model;
+
+static GListModel *tz_model_get(const TzDb *db) {
+	if (tz_model) return tz_model;
+	GListStore *s = g_list_store_new(TZ_TYPE_ITEM);
+	gpointer *items = g_new(gpointer, db->n);
+	for (guint i = 0; i < db->n; i++) {
+		TzItem *it = g_object_new(TZ_TYPE_ITEM, NULL);
+		it->idx = i;
+		items[i] = it;
+	}
+	g_list_store_splice(s, 0, 0, items, db->n);
+	for (guint i = 0; i < db->n; i++) g_object_unref(items[i]);
+	g_free(items);
+	return tz_model = G_LIST_MODEL(s);
+}
+
+typedef struct {
+	const TzDb         *db;
+	GtkWidget          *entry, *list, *status;
+	GtkSingleSelection *sel;
+	GtkFilter          *filter;
+	guint8             *hit;           /* per zone, from the last query */
+	char               *current;
+} TzPicker;
+
+static void tz_picker_free(gpointer p) {
+	TzPicker *tp = p;
+	g_clear_object(&tp->filter);
+	g_free(tp->hit); g_free(tp->current); g_free(tp);
+}
+
+/* Name of the selected zone, or NULL. */
+static const char *tz_picker_selected(GtkWidget *picker) {
+	TzPicker *tp = g_object_get_data(G_OBJECT(picker), "tz-picker");
+	TzItem *it = tp && tp->sel ? gtk_single_selection_get_selected_item(tp->sel) : NULL;
+	return it ? tp->db->zones[it->idx].name : NULL;
+}
+
+static gboolean tz_filter_func(gpointer item, gpointer ud) {
+	TzPicker *tp = ud;
+	return tp->hit[TZ_ITEM(item)->idx];
+}
+
+static void tz_picker_search(GtkSearchEntry *e, gpointer ud) {
+	TzPicker *tp = ud;
+	if (!tp->db) return;
+	guint n = tz_db_query(tp->db, gtk_editable_get_text(GTK_EDITABLE(e)), tp->hit);
+	gtk_filter_changed(tp->filter, GTK_FILTER_CHANGE_DIFFERENT);
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%u of %u timezones", n, tp->db->n);
+	gtk_label_set_text(GTK_LABEL(tp->status), buf);
+}
+
+static void tz_setup_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+	gtk_widget_set_margin_top(row, 4); gtk_widget_set_margin_bottom(row, 4);
+	GtkWidget *inf = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+	gtk_widget_set_hexpand(inf, TRUE);
+	GtkWidget *nl = gtk_label_new(NULL);
+	gtk_widget_set_halign(nl, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(inf), nl);
+	GtkWidget *cl = gtk_label_new(NULL);
+	gtk_widget_add_css_class(cl, "dim-label"); gtk_widget_add_css_class(cl, "caption");
+	gtk_widget_set_halign(cl, GTK_ALIGN_START);
+	gtk_label_set_ellipsize(GTK_LABEL(cl), PANGO_ELLIPSIZE_END);
+	gtk_box_append(GTK_BOX(inf), cl);
+	gtk_box_append(GTK_BOX(row), inf);
+	GtkWidget *ol = gtk_label_new(NULL);
+	gtk_widget_add_css_class(ol, "dim-label");
+	gtk_widget_set_valign(ol, GTK_ALIGN_CENTER);
+	gtk_box_append(GTK_BOX(row), ol);
+	gtk_list_item_set_child(li, row);
+}
+
+static void tz_bind_cb(GtkSignalListItemFactory *f, GtkListItem *li, gpointer ud) {
+	TzPicker *tp = ud;
+	const TzZone *z = &tp->db->zones[TZ_ITEM(gtk_list_item_get_item(li))->idx];
+	GtkWidget *inf = gtk_widget_get_first_child(gtk_list_item_get_child(li));
+	GtkWidget *nl  = gtk_widget_get_first_child(inf);
+	char cap[160];
+	if (isnan(z->lat))
+		g_strlcpy(cap, z->country, sizeof(cap));
+	else
+		snprintf(cap, sizeof(cap), "%s%s%.1f\xc2\xb0%c %.1f\xc2\xb0%c", z->country,
+			 z->country[0] ? " \xc2\xb7 " : "", fabs(z->lat), z->lat < 0 ? 'S' : 'N',
+			 fabs(z->lon), z->lon < 0 ? 'W' : 'E');
+	gtk_label_set_text(GTK_LABEL(nl), z->name);
+	gtk_label_set_text(GTK_LABEL(gtk_widget_get_next_sibling(nl)), cap);
+	gtk_widget_set_visible(gtk_widget_get_next_sibling(nl), cap[0] != '\0');
+	gtk_label_set_text(GTK_LABEL(gtk_widget_get_next_sibling(inf)), z->offset_str);
+}
+
+static void tz_picker_ready(GtkWidget *picker, const TzDb *db) {
+	TzPicker *tp = g_object_get_data(G_OBJECT(picker), "tz-picker");
+	tp->db  = db;
+	tp->hit = g_malloc(db->n);
+	memset(tp->hit, 1, db->n);
+	tp->filter = GTK_FILTER(gtk_custom_filter_new(tz_filter_func, tp, NULL));
+	GtkFilterListModel *fm = gtk_filter_list_model_new(g_object_ref(tz_model_get(db)),
+							   g_object_ref(tp->filter));
+	tp->sel = gtk_single_selection_new(G_LIST_MODEL(fm));
+	gtk_single_selection_set_autoselect(tp->sel, FALSE);
+	gtk_single_selection_set_can_unselect(tp->sel, TRUE);
+	gtk_single_selection_set_selected(tp->sel, GTK_INVALID_LIST_POSITION);
+	gtk_list_view_set_model(GTK_LIST_VIEW(tp->list), GTK_SELECTION_MODEL(tp->sel));
+	g_object_unref(tp->sel);                    /* the list view holds it */
+	int cur = tz_db_find(db, tp->current);
+	if (cur >= 0) gtk_list_view_scroll_to(GTK_LIST_VIEW(tp->list), cur, GTK_LIST_SCROLL_SELECT, NULL);
+	gtk_widget_set_sensitive(tp->entry, TRUE);
+	tz_picker_search(GTK_SEARCH_ENTRY(tp->entry), tp);
+}
+
+/* Select `name` unless the user is searching; before the index is
+ * loaded it is remembered and selected once the list appears. */
+static void tz_picker_select(GtkWidget *picker, const char *name) {
+	TzPicker *tp = g_object_get_data(G_OBJECT(picker), "tz-picker");
+	if (g_strcmp0(tp->current, name) == 0) return;
+	g_free(tp->current);
+	tp->current = g_strdup(name);
+	int cur = tp->db ? tz_db_find(tp->db, name) : -1;
+	if (cur >= 0 && !gtk_editable_get_text(GTK_EDITABLE(tp->entry))[0])
+		gtk_list_view_scroll_to(GTK_LIST_VIEW(tp->list), cur, GTK_LIST_SCROLL_SELECT, NULL);
+}
+
+/* Search entry over a list of every timezone. */
+static GtkWidget *tz_picker_new(void) {
+	TzPicker *tp = g_new0(TzPicker, 1);
+	GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+	tp->entry = gtk_search_entry_new();
+	gtk_search_entry_set_placeholder_text(GTK_SEARCH_ENTRY(tp->entry), "Search by city, country or UTC offset");
+	gtk_widget_set_sensitive(tp->entry, FALSE);
+	g_signal_connect(tp->entry, "search-changed", G_CALLBACK(tz_picker_search), tp);
+	gtk_box_append(GTK_BOX(box), tp->entry);
+
+	GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+	g_signal_connect(factory, "setup", G_CALLBACK(tz_setup_cb), tp);
+	g_signal_connect(factory, "bind",  G_CALLBACK(tz_bind_cb),  tp);
+	tp->list = gtk_list_view_new(NULL, factory);
+	gtk_widget_add_css_class(tp->list, "navigation-sidebar");
+	GtkWidget *sw = gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(sw), 220);
+	gtk_scrolled_window_set_has_frame(GTK_SCROLLED_WINDOW(sw), TRUE);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(sw), tp->list);
+	gtk_box_append(GTK_BOX(box), sw);
+
+	tp->status = gtk_label_new("Loading timezones\xe2\x80\xa6");
+	gtk_widget_add_css_class(tp->status, "dim-label"); gtk_widget_add_css_class(tp->status, "caption");
+	gtk_widget_set_halign(tp->status, GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(box), tp->status);
+
+	g_object_set_data_full(G_OBJECT(box), "tz-picker", tp, tz_picker_free);
+	tz_db_when_ready(box, tz_picker_ready);
+	return box;
+}
+
+/* ------------------------------------------------------------------ */
+/* timedate1                                                            */
+/* ------------------------------------------------------------------ */
+/* Everything goes through org.freedesktop.timedate1 on the system bus
+ * and nothing blocks the main loop:
+ * - one proxy is created asynchronously the first time a page watches;
+ * - state comes from its property cache;
+ * - PropertiesChanged fans out to the watches, so a change made with
+ *   timedatectl shows up at once;
+ * - calls pass interactive=TRUE so polkit can ask for a password.
+ * timedated exits when idle, and the proxy then drops its cache.  The
+ * last values seen are kept in td_state, so the pages keep showing
+ * them. */
+typedef struct { void (*cb)(gpointer); gpointer ud; } TdWatch;
+
+static struct {
+	char    *timezone;             /* NULL until the first reply */
+	gboolean ntp, can_ntp;
+	char    *error;                /* why there is no proxy, if there isn't */
+} td_state;
+
+static GDBusProxy *td_proxy;
+static gboolean    td_requested;
+static GSList     *td_watches;
+
+static void td_notify(void) {
+	for (GSList *l = td_watches; l; l = l->next) {
+		TdWatch *w = l->data;
+		w->cb(w->ud);
+	}
+}
+
+static void td_sync(void) {
+	GVariant *v;
+	if (td_proxy && (v = g_dbus_proxy_get_cached_property(td_proxy, "Timezone"))) {
+		g_free(td_state.timezone);
+		td_state.timezone = g_variant_dup_string(v, NULL);
+		g_variant_unref(v);
+	}
+	if (td_proxy && (v = g_dbus_proxy_get_cached_property(td_proxy, "NTP"))) {
+		td_state.ntp = g_variant_get_boolean(v);
+		g_variant_unref(v);
+	}
+	if (td_proxy && (v = g_dbus_proxy_get_cached_property(td_proxy, "CanNTP"))) {
+		td_state.can_ntp = g_variant_get_boolean(v);
+		g_variant_unref(v);
+	}
+	td_notify();
+}
+
+static void td_changed(GDBusProxy *p, GVariant *changed, GStrv invalidated, gpointer ud) { td_sync(); }
+
+static void td_proxy_ready(GObject *src, GAsyncResult *res, gpointer ud) {
+	GError *err = NULL;
+	td_proxy = g_dbus_proxy_new_for_bus_finish(res, &err);
+	if (!td_proxy) {
+		/* usually no system bus; the watches show it, and the next
+		 * td_connect tries again */
+		g_warning("timedate1: %s", err->message);
+		g_free(td_state.error);
+		td_state.error = g_strdup(err->message);
+		g_error_free(err);
+		td_requested = FALSE;
+		td_notify();
+		return;
+	}
+	g_signal_connect(td_proxy, "g-properties-changed", G_CALLBACK(td_changed), NULL);
+	td_sync();
+}
+
+/* Create the proxy unless it exists or is on its way. */
+static void td_connect(void) {
+	if (td_requested) return;
+	td_requested = TRUE;
+	g_clear_pointer(&td_state.error, g_free);
+	g_dbus_proxy_new_for_bus(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES, NULL,
+				 "org.freedesktop.timedate1", "/org/freedesktop/timedate1",
+				 "org.freedesktop.timedate1", NULL, td_proxy_ready, NULL);
+}
+
+/* Call cb(ud) now if the state is known, then after every change (or
+ * a failure to connect), until td_watch_remove. */
+static gpointer td_watch_add(void (*cb)(gpointer), gpointer ud) {
+	td_connect();
+	TdWatch *w = g_new(TdWatch, 1);
+	w->cb = cb; w->ud = ud;
+	td_watches = g_slist_prepend(td_watches, w);
+	if (td_state.timezone) cb(ud);
+	return w;
+}
+
+static void td_watch_remove(gpointer w) {
+	td_watches = g_slist_remove(td_watches, w);
+	g_free(w);
+}
+
+typedef struct { GWeakRef status; char what[48]; } TdCall;
+
+static void td_call_done(GObject *src, GAsyncResult *res, gpointer ud) {
+	TdCall *c = ud;
+	GError *err = NULL;
+	GVariant *ret = g_dbus_proxy_call_finish(G_DBUS_PROXY(src), res, &err);
+	if (ret) g_variant_unref(ret);
+	GtkWidget *lbl = g_weak_ref_get(&c->status);
+	if (lbl) {
+		char msg[256] = "";
+		if (err) {
+			g_dbus_error_strip_remote_error(err);
+			snprintf(msg, sizeof(msg), "Could not %s: %s", c->what, err->message);
+		}
+		gtk_label_set_text(GTK_LABEL(lbl), msg);
+		g_object_unref(lbl);
+	}
+	if (err) {
+		g_error_free(err);
+		td_sync();                      /* put the controls back to the real state */
+	}
+	g_weak_ref_clear(&c->status);
+	g_free(c);
+}
+
+/* Call a timedate1 method; failures are reported in `status`. */
+static void td_call(const char *method, GVariant *args, const char *what, GtkWidget *status) {
+	if (!td_proxy) {
+		g_variant_unref(g_variant_ref_sink(args));
+		if (status) gtk_label_set_text(GTK_LABEL(status), "The time and date service is not available");
+		return;
+	}
+	TdCall *c = g_new0(TdCall, 1);
+	g_weak_ref_init(&c->status, status);
+	g_strlcpy(c->what, what, sizeof(c->what));
+	/* no timeout: the polkit dialog waits for the user */
+	g_dbus_proxy_call(td_proxy, method, args, G_DBUS_CALL_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION,
+			  G_MAXINT, NULL, td_call_done, c);
+}
+
+/* ------------------------------------------------------------------ */
+/* Date & Time page                                                     */
+/* ------------------------------------------------------------------ */
 static GtkWidget *dt_time_label=NULL, *dt_date_label=NULL, *dt_tz_label=NULL;
+static GtkWidget *dt_ntp_switch=NULL, *dt_manual_row=NULL, *dt_tz_pick=NULL, *dt_status=NULL;
+static GtkWidget *dt_date_btn=NULL, *dt_cal=NULL, *dt_hour=NULL, *dt_min=NULL;
+static GTimeZone *dt_zone       = NULL;    /* timedate1's zone, for the clock */
+static gpointer   dt_watch      = NULL;
+static gulong     dt_ntp_sig    = 0;
 static guint      dt_tick_id    = 0;
+static gboolean   dt_ntp_shown  = FALSE;   /* NTP state the page last showed */
+static gboolean   dt_err_shown  = FALSE;   /* dt_status holds td_state.error */
 
 static gboolean dt_tick(gpointer ud) {
 	if (!dt_time_label) {
 		dt_tick_id = 0;
 		return G_SOURCE_REMOVE;
 	}
-	time_t now=time(NULL); struct tm *tm=localtime(&now);
-	char tb[32],db[64];
-	strftime(tb,sizeof(tb),"%H:%M:%S",tm);
-	strftime(db,sizeof(db),"%A, %B %d %Y",tm);
+	/* localtime() would keep the zone the process started with */
+	GDateTime *now=dt_zone?g_date_time_new_now(dt_zone):g_date_time_new_now_local();
+	char *tb=g_date_time_format(now,"%H:%M:%S"), *db=g_date_time_format(now,"%A, %B %d %Y");
 	gtk_label_set_text(GTK_LABEL(dt_time_label),tb);
 	gtk_label_set_text(GTK_LABEL(dt_date_label),db);
+	g_free(tb); g_free(db); g_date_time_unref(now);
 	return G_SOURCE_CONTINUE;
 }
+/* The button's "status" label reports failures; the page updates
+ * itself from PropertiesChanged on success. */
 static void dt_apply_tz(GtkWidget *btn, gpointer ud) {
-	GtkDropDown *dd=GTK_DROP_DOWN(ud);
-	GtkStringList *sl=GTK_STRING_LIST(gtk_drop_down_get_model(dd));
-	const char *tz=gtk_string_list_get_string(sl,gtk_drop_down_get_selected(dd));
-	char cmd[256]; snprintf(cmd,sizeof(cmd),"timedatectl set-timezone '%s' 2>/dev/null",tz);
-	system(cmd);
-	char *cur=run_cmd_str("timedatectl show --property=Timezone --value 2>/dev/null | tr -d '\\n'");
-	gtk_label_set_text(GTK_LABEL(dt_tz_label),cur); g_free(cur);
+	const char *tz=tz_picker_selected(GTK_WIDGET(ud));
+	if (!tz) return;
+	td_call("SetTimezone",g_variant_new("(sb)",tz,TRUE),"set the timezone",
+		g_object_get_data(G_OBJECT(btn),"status"));
 }
 static void dt_toggle_ntp(GtkSwitch *sw, GParamSpec *ps, gpointer ud) {
-	if (gtk_switch_get_active(sw)) system("timedatectl set-ntp true 2>/dev/null");
-	else                           system("timedatectl set-ntp false 2>/dev/null");
+	td_call("SetNTP",g_variant_new("(bb)",gtk_switch_get_active(sw),TRUE),
+		"change automatic time",dt_status);
+}
+
+static void dt_show_date(void) {
+	GDateTime *d=gtk_calendar_get_date(GTK_CALENDAR(dt_cal));
+	char *s=g_date_time_format(d,"%x");
+	gtk_menu_button_set_label(GTK_MENU_BUTTON(dt_date_btn),s);
+	g_free(s); g_date_time_unref(d);
+}
+static void dt_day_selected(GtkCalendar *c, gpointer ud) { dt_show_date(); }
+
+/* Fill the manual controls with the current time in timedate1's zone. */
+static void dt_manual_reset(void) {
+	GDateTime *now=dt_zone?g_date_time_new_now(dt_zone):g_date_time_new_now_local();
+	gtk_calendar_select_day(GTK_CALENDAR(dt_cal),now);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(dt_hour),g_date_time_get_hour(now));
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(dt_min),g_date_time_get_minute(now));
+	g_date_time_unref(now);
+	dt_show_date();
+}
+static void dt_set_time(GtkWidget *btn, gpointer ud) {
+	GDateTime *d=gtk_calendar_get_date(GTK_CALENDAR(dt_cal));
+	GDateTime *t=g_date_time_new(dt_zone?dt_zone:g_date_time_get_timezone(d),
+				     g_date_time_get_year(d),g_date_time_get_month(d),g_date_time_get_day_of_month(d),
+				     gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dt_hour)),
+				     gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dt_min)),0);
+	g_date_time_unref(d);
+	if (!t) return;
+	gint64 usec=g_date_time_to_unix(t)*G_USEC_PER_SEC;
+	g_date_time_unref(t);
+	td_call("SetTime",g_variant_new("(xbb)",usec,FALSE,TRUE),"set the time",dt_status);
+}
+
+/* timedate1 watch: zone, NTP switch, manual controls, picker.  When
+ * NTP goes off the manual controls start from now, not from whenever
+ * the page was built. */
+static void dt_show_state(gpointer ud) {
+	const char *tz=td_state.timezone;
+	gtk_label_set_text(GTK_LABEL(dt_tz_label),tz&&tz[0]?tz:"Unknown");
+	g_clear_pointer(&dt_zone,g_time_zone_unref);
+	if (tz&&tz[0]) dt_zone=g_time_zone_new_identifier(tz);
+	if (td_state.error) {
+		char msg[320];
+		snprintf(msg,sizeof(msg),"The time and date service is not available: %s",td_state.error);
+		gtk_label_set_text(GTK_LABEL(dt_status),msg);
+		dt_err_shown=TRUE;
+	} else if (dt_err_shown) {
+		gtk_label_set_text(GTK_LABEL(dt_status),"");
+		dt_err_shown=FALSE;
+	}
+	g_signal_handler_block(dt_ntp_switch,dt_ntp_sig);
+	gtk_switch_set_active(GTK_SWITCH(dt_ntp_switch),td_state.ntp);
+	g_signal_handler_unblock(dt_ntp_switch,dt_ntp_sig);
+	gtk_widget_set_sensitive(dt_ntp_switch,td_state.can_ntp);
+	gtk_widget_set_sensitive(dt_manual_row,!td_state.ntp);
+	if (dt_ntp_shown&&!td_state.ntp) dt_manual_reset();
+	dt_ntp_shown=td_state.ntp;
+	tz_picker_select(dt_tz_pick,tz);
+	dt_tick(NULL);
+}
+
+/* Back on screen: the manual controls start from now, and a failed
+ * connection is tried again. */
+static void dt_page_mapped(GtkWidget *w, gpointer ud) {
+	dt_manual_reset();
+	td_connect();
 }
 
 static void dt_page_destroyed(GtkWidget *w, gpointer ud) {
+	if (dt_watch) { td_watch_remove(dt_watch); dt_watch = NULL; }
 	dt_time_label = NULL;
 	dt_date_label = NULL;
 	dt_tz_label   = NULL;
+	dt_ntp_switch = dt_manual_row = dt_tz_pick = dt_status = NULL;
+	dt_date_btn   = dt_cal = dt_hour = dt_min = NULL;
+	dt_ntp_shown  = dt_err_shown = FALSE;
+	g_clear_pointer(&dt_zone, g_time_zone_unref);
 	if (dt_tick_id) { g_source_remove(dt_tick_id); dt_tick_id = 0; }
 }
 
+static GtkWidget *dt_spin(int max) {
+	GtkWidget *sp=gtk_spin_button_new_with_range(0,max,1);
+	gtk_spin_button_set_wrap(GTK_SPIN_BUTTON(sp),TRUE);
+	gtk_spin_button_set_numeric(GTK_SPIN_BUTTON(sp),TRUE);
+	gtk_orientable_set_orientation(GTK_ORIENTABLE(sp),GTK_ORIENTATION_VERTICAL);
+	return sp;
+}
+
 GtkWidget *datetime_settings(void) {
 	GtkWidget *root=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
 	gtk_widget_set_hexpand(root,TRUE); gtk_widget_set_vexpand(root,TRUE);
@@ -3790,23 +9718,46 @@ GtkWidget *datetime_settings(void) {
 	GtkWidget *nl=gtk_label_new("Automatic (NTP)");
 	gtk_widget_set_hexpand(nl,TRUE); gtk_widget_set_halign(nl,GTK_ALIGN_START);
 	gtk_box_append(GTK_BOX(nr),nl);
-	GtkWidget *nsw=gtk_switch_new();
-	char *ns=run_cmd_str("timedatectl show --property=NTP --value 2>/dev/null | tr -d '\\n'");
-	gtk_switch_set_active(GTK_SWITCH(nsw),strncmp(ns,"yes",3)==0); g_free(ns);
+	GtkWidget *nsw=gtk_switch_new(); dt_ntp_switch=nsw;
+	gtk_widget_set_sensitive(nsw,FALSE);
 	gtk_widget_set_valign(nsw,GTK_ALIGN_CENTER);
-	g_signal_connect(nsw,"notify::active",G_CALLBACK(dt_toggle_ntp),NULL);
+	dt_ntp_sig=g_signal_connect(nsw,"notify::active",G_CALLBACK(dt_toggle_ntp),NULL);
 	gtk_box_append(GTK_BOX(nr),nsw);
 	gtk_list_box_append(GTK_LIST_BOX(ntp_list),nr);
+	/* manual date and time, while NTP is off */
+	GtkWidget *mr=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,8); dt_manual_row=mr;
+	gtk_widget_set_margin_start(mr,14); gtk_widget_set_margin_end(mr,14);
+	gtk_widget_set_margin_top(mr,10);   gtk_widget_set_margin_bottom(mr,10);
+	gtk_widget_set_sensitive(mr,FALSE);
+	GtkWidget *ml=gtk_label_new("Set Manually");
+	gtk_widget_set_hexpand(ml,TRUE); gtk_widget_set_halign(ml,GTK_ALIGN_START);
+	gtk_box_append(GTK_BOX(mr),ml);
+	dt_cal=gtk_calendar_new();
+	g_signal_connect(dt_cal,"day-selected",G_CALLBACK(dt_day_selected),NULL);
+	GtkWidget *pop=gtk_popover_new(); gtk_popover_set_child(GTK_POPOVER(pop),dt_cal);
+	dt_date_btn=gtk_menu_button_new();
+	gtk_menu_button_set_popover(GTK_MENU_BUTTON(dt_date_btn),pop);
+	gtk_widget_set_valign(dt_date_btn,GTK_ALIGN_CENTER);
+	gtk_box_append(GTK_BOX(mr),dt_date_btn);
+	dt_hour=dt_spin(23); gtk_box_append(GTK_BOX(mr),dt_hour);
+	GtkWidget *colon=gtk_label_new(":"); gtk_box_append(GTK_BOX(mr),colon);
+	dt_min=dt_spin(59);  gtk_box_append(GTK_BOX(mr),dt_min);
+	GtkWidget *setb=gtk_button_new_with_label("Set");
+	gtk_widget_set_valign(setb,GTK_ALIGN_CENTER);
+	g_signal_connect(setb,"clicked",G_CALLBACK(dt_set_time),NULL);
+	gtk_box_append(GTK_BOX(mr),setb);
+	gtk_list_box_append(GTK_LIST_BOX(ntp_list),mr);
 	gtk_box_append(GTK_BOX(vb),ntp_list);
+	dt_status=gtk_label_new("");
+	gtk_widget_add_css_class(dt_status,"dim-label"); gtk_widget_set_halign(dt_status,GTK_ALIGN_START);
+	gtk_label_set_wrap(GTK_LABEL(dt_status),TRUE);
+	gtk_box_append(GTK_BOX(vb),dt_status);
 	/* timezone — full searchable list, pre-selected to current */
 	{
 		GtkWidget *tz_frame = make_section_box("Timezone");
 		GtkWidget *tz_inner = g_object_get_data(G_OBJECT(tz_frame), "inner-box");
 
 		/* current timezone display */
-		char *ctz = run_cmd_str(
-					"timedatectl show --property=Timezone --value 2>/dev/null | tr -d '\n'");
-		g_strstrip(ctz);
 		GtkWidget *tz_cur_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
 		gtk_widget_set_margin_start(tz_cur_row, 14); gtk_widget_set_margin_end(tz_cur_row, 14);
 		gtk_widget_set_margin_top(tz_cur_row, 12);   gtk_widget_set_margin_bottom(tz_cur_row, 12);
@@ -3819,7 +9770,7 @@ GtkWidget *datetime_settings(void) {
 		GtkWidget *tz_cur_lbl = gtk_label_new("Current Timezone");
 		gtk_widget_set_halign(tz_cur_lbl, GTK_ALIGN_START);
 		gtk_box_append(GTK_BOX(tz_cur_inf), tz_cur_lbl);
-		dt_tz_label = gtk_label_new(ctz[0] ? ctz : "Unknown");
+		dt_tz_label = gtk_label_new("\xe2\x80\xa6");
 		gtk_widget_add_css_class(dt_tz_label, "dim-label");
 		gtk_widget_set_halign(dt_tz_label, GTK_ALIGN_START);
 		gtk_box_append(GTK_BOX(tz_cur_inf), dt_tz_label);
@@ -3827,43 +9778,27 @@ GtkWidget *datetime_settings(void) {
 		gtk_box_append(GTK_BOX(tz_inner), tz_cur_row);
 		gtk_box_append(GTK_BOX(tz_inner), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
 
-		/* searchable timezone dropdown */
-		char *tz_raw = run_cmd_str("timedatectl list-timezones 2>/dev/null");
-		char **tz_lines = g_strsplit(tz_raw, "\n", -1);
-		g_free(tz_raw);
-		GtkStringList *tz_model = gtk_string_list_new(NULL);
-		guint tz_cur_idx = 0, tz_i = 0;
-		for (int i = 0; tz_lines[i] && tz_lines[i][0]; i++) {
-			gtk_string_list_append(tz_model, tz_lines[i]);
-			if (strcmp(tz_lines[i], ctz) == 0) tz_cur_idx = tz_i;
-			tz_i++;
-		}
-		g_strfreev(tz_lines);
-		g_free(ctz);
-
-		GtkWidget *tz_sel_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-		gtk_widget_set_margin_start(tz_sel_row, 14); gtk_widget_set_margin_end(tz_sel_row, 14);
-		gtk_widget_set_margin_top(tz_sel_row, 10);   gtk_widget_set_margin_bottom(tz_sel_row, 10);
-		GtkWidget *tz_sel_lbl = gtk_label_new("Select Timezone");
-		gtk_widget_add_css_class(tz_sel_lbl, "dim-label");
-		gtk_widget_set_hexpand(tz_sel_lbl, TRUE);
-		gtk_widget_set_halign(tz_sel_lbl, GTK_ALIGN_START);
-		gtk_widget_set_valign(tz_sel_lbl, GTK_ALIGN_CENTER);
-		gtk_box_append(GTK_BOX(tz_sel_row), tz_sel_lbl);
-		GtkWidget *tdd = gtk_drop_down_new(G_LIST_MODEL(tz_model), NULL);
-		gtk_drop_down_set_enable_search(GTK_DROP_DOWN(tdd), TRUE);
-		gtk_drop_down_set_selected(GTK_DROP_DOWN(tdd), tz_cur_idx);
-		gtk_widget_set_size_request(tdd, 260, -1);
-		gtk_box_append(GTK_BOX(tz_sel_row), tdd);
+		/* searchable timezone list */
+		GtkWidget *tz_sel = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+		gtk_widget_set_margin_start(tz_sel, 14); gtk_widget_set_margin_end(tz_sel, 14);
+		gtk_widget_set_margin_top(tz_sel, 10);   gtk_widget_set_margin_bottom(tz_sel, 12);
+		dt_tz_pick = tz_picker_new();
+		gtk_box_append(GTK_BOX(tz_sel), dt_tz_pick);
 		GtkWidget *ta = gtk_button_new_with_label("Apply");
 		gtk_widget_add_css_class(ta, "suggested-action");
-		g_signal_connect(ta, "clicked", G_CALLBACK(dt_apply_tz), tdd);
-		gtk_box_append(GTK_BOX(tz_sel_row), ta);
-		gtk_box_append(GTK_BOX(tz_inner), tz_sel_row);
+		gtk_widget_set_halign(ta, GTK_ALIGN_END);
+		g_object_set_data(G_OBJECT(ta), "status", dt_status);
+		g_signal_connect(ta, "clicked", G_CALLBACK(dt_apply_tz), dt_tz_pick);
+		gtk_box_append(GTK_BOX(tz_sel), ta);
+		gtk_box_append(GTK_BOX(tz_inner), tz_sel);
 		gtk_box_append(GTK_BOX(vb), tz_frame);
 	}
 	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scr),vb);
 	gtk_box_append(GTK_BOX(root),scr);
+	dt_manual_reset();
+	if (dt_watch) td_watch_remove(dt_watch);
+	dt_watch = td_watch_add(dt_show_state, NULL);
+	g_signal_connect(root, "map",     G_CALLBACK(dt_page_mapped),    NULL);
 	g_signal_connect(root, "destroy", G_CALLBACK(dt_page_destroyed), NULL);
 	return root;
 }
@@ -3898,6 +9833,34 @@ static void region_apply_format(GtkWidget *btn, gpointer ud) {
 	system(cmd);
 }
 
+/* Active layout by description, e.g. "English (US, intl., with dead keys)" */
+static void region_kb_update(gpointer label) {
+	XkbNames n;
+	xkb_get_names(xkb_xdisplay(), &n);
+	char layout[64], variant[64];
+	xkb_group_get(n.layout, n.group, layout, sizeof(layout));
+	xkb_group_get(n.variant, n.group, variant, sizeof(variant));
+	const XkbDb *xdb = xkb_db();
+	const char *kb_code = layout[0] ? layout : "us";
+	int kb_li = xkb_db_find(xdb, kb_code), kb_vi = xkb_db_find_variant(xdb, kb_li, variant);
+	const char *kb_name = kb_li >= 0 ? xkb_db_desc(xdb, xdb->layouts[kb_li].desc) : kb_code;
+	const char *kb_vname = kb_vi >= 0 ? xkb_db_desc(xdb, xdb->variants[kb_vi].desc) : variant;
+	char kb_display[256];
+	if (kb_vi >= 0)
+		snprintf(kb_display, sizeof(kb_display), "%s", kb_vname);
+	else if (variant[0])
+		snprintf(kb_display, sizeof(kb_display), "%s (%s)", kb_name, kb_vname);
+	else
+		snprintf(kb_display, sizeof(kb_display), "%s", kb_name);
+	gtk_label_set_text(GTK_LABEL(label), kb_display);
+}
+
+static void region_tz_update(gpointer picker) {
+	const char *tz = td_state.timezone;
+	gtk_label_set_text(GTK_LABEL(g_object_get_data(G_OBJECT(picker), "current-label")),
+			   tz && tz[0] ? tz : "Unknown");
+	tz_picker_select(picker, tz);
+}
 
 static void region_goto_keyboard(GtkWidget *btn, gpointer ud) {
 	if (!sidebar_listbox) return;
@@ -4101,10 +10064,7 @@ GtkWidget *region_settings(void) {
 	GtkWidget *tz_frame = make_bat_box("Timezone");
 	GtkWidget *tz_inner = g_object_get_data(G_OBJECT(tz_frame), "inner-box");
 
-	char *cur_tz = run_cmd_str(
-				   "timedatectl show --property=Timezone --value 2>/dev/null | tr -d '\n'");
-	g_strstrip(cur_tz);
-
+	GtkWidget *tz_cur = NULL;
 	/* current timezone display row */
 	{
 		GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 14);
@@ -4120,52 +10080,38 @@ GtkWidget *region_settings(void) {
 		gtk_widget_add_css_class(t, "title-4");
 		gtk_widget_set_halign(t, GTK_ALIGN_START);
 		gtk_box_append(GTK_BOX(inf), t);
-		GtkWidget *v = gtk_label_new(cur_tz[0] ? cur_tz : "Unknown");
-		gtk_widget_add_css_class(v, "dim-label");
-		gtk_widget_set_halign(v, GTK_ALIGN_START);
-		gtk_box_append(GTK_BOX(inf), v);
+		tz_cur = gtk_label_new("\xe2\x80\xa6");
+		gtk_widget_add_css_class(tz_cur, "dim-label");
+		gtk_widget_set_halign(tz_cur, GTK_ALIGN_START);
+		gtk_box_append(GTK_BOX(inf), tz_cur);
 		gtk_box_append(GTK_BOX(row), inf);
 		gtk_box_append(GTK_BOX(tz_inner), row);
 		gtk_box_append(GTK_BOX(tz_inner), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
 	}
 
-	/* searchable timezone dropdown */
+	/* searchable timezone list */
 	{
-		char *tz_raw = run_cmd_str("timedatectl list-timezones 2>/dev/null");
-		char **tz_lines = g_strsplit(tz_raw, "\n", -1);
-		g_free(tz_raw);
-		GtkStringList *tz_model = gtk_string_list_new(NULL);
-		guint tz_cur_idx = 0, tz_i = 0;
-		for (int i = 0; tz_lines[i] && tz_lines[i][0]; i++) {
-			gtk_string_list_append(tz_model, tz_lines[i]);
-			if (strcmp(tz_lines[i], cur_tz) == 0) tz_cur_idx = tz_i;
-			tz_i++;
-		}
-		g_strfreev(tz_lines);
-
-		GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-		gtk_widget_set_margin_start(row, 16); gtk_widget_set_margin_end(row, 16);
-		gtk_widget_set_margin_top(row, 10);   gtk_widget_set_margin_bottom(row, 10);
-		GtkWidget *lbl = gtk_label_new("Select Timezone");
-		gtk_widget_add_css_class(lbl, "dim-label");
-		gtk_widget_set_hexpand(lbl, TRUE);
-		gtk_widget_set_halign(lbl, GTK_ALIGN_START);
-		gtk_widget_set_valign(lbl, GTK_ALIGN_CENTER);
-		gtk_box_append(GTK_BOX(row), lbl);
-
-		GtkWidget *tz_dd = gtk_drop_down_new(G_LIST_MODEL(tz_model), NULL);
-		gtk_drop_down_set_enable_search(GTK_DROP_DOWN(tz_dd), TRUE);
-		gtk_drop_down_set_selected(GTK_DROP_DOWN(tz_dd), tz_cur_idx);
-		gtk_widget_set_size_request(tz_dd, 260, -1);
-		gtk_box_append(GTK_BOX(row), tz_dd);
-
+		GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+		gtk_widget_set_margin_start(box, 16); gtk_widget_set_margin_end(box, 16);
+		gtk_widget_set_margin_top(box, 10);   gtk_widget_set_margin_bottom(box, 12);
+		GtkWidget *pick = tz_picker_new();
+		g_object_set_data(G_OBJECT(pick), "current-label", tz_cur);
+		gtk_box_append(GTK_BOX(box), pick);
 		GtkWidget *tz_apply = gtk_button_new_with_label("Apply");
 		gtk_widget_add_css_class(tz_apply, "suggested-action");
-		g_signal_connect(tz_apply, "clicked", G_CALLBACK(dt_apply_tz), tz_dd);
-		gtk_box_append(GTK_BOX(row), tz_apply);
-		gtk_box_append(GTK_BOX(tz_inner), row);
+		gtk_widget_set_halign(tz_apply, GTK_ALIGN_END);
+		g_signal_connect(tz_apply, "clicked", G_CALLBACK(dt_apply_tz), pick);
+		gtk_box_append(GTK_BOX(box), tz_apply);
+		GtkWidget *st = gtk_label_new("");
+		gtk_widget_add_css_class(st, "dim-label");
+		gtk_widget_set_halign(st, GTK_ALIGN_START);
+		gtk_label_set_wrap(GTK_LABEL(st), TRUE);
+		g_object_set_data(G_OBJECT(tz_apply), "status", st);
+		gtk_box_append(GTK_BOX(box), st);
+		gtk_box_append(GTK_BOX(tz_inner), box);
+		g_signal_connect_swapped(pick, "destroy", G_CALLBACK(td_watch_remove),
+					 td_watch_add(region_tz_update, pick));
 	}
-	g_free(cur_tz);
 	gtk_box_append(GTK_BOX(vb), tz_frame);
 
 	/* ======================================================
@@ -4174,20 +10120,6 @@ GtkWidget *region_settings(void) {
 	GtkWidget *inp_frame = make_bat_box("Input Sources");
 	GtkWidget *inp_inner = g_object_get_data(G_OBJECT(inp_frame), "inner-box");
 
-	char *kb_layout  = run_cmd_str(
-				       "setxkbmap -query 2>/dev/null | grep '^layout' | awk '{print $2}' | tr -d '\n'");
-	char *kb_variant = run_cmd_str(
-				       "setxkbmap -query 2>/dev/null | grep '^variant' | awk '{print $2}' | tr -d '\n'");
-	g_strstrip(kb_layout); g_strstrip(kb_variant);
-
-	char kb_display[128];
-	if (kb_variant && kb_variant[0])
-		snprintf(kb_display, sizeof(kb_display), "%s (%s)",
-			 kb_layout[0] ? kb_layout : "us", kb_variant);
-	else
-		snprintf(kb_display, sizeof(kb_display), "%s",
-			 kb_layout[0] ? kb_layout : "us");
-
 	GtkWidget *kb_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 14);
 	gtk_widget_set_margin_start(kb_row, 16); gtk_widget_set_margin_end(kb_row, 16);
 	gtk_widget_set_margin_top(kb_row, 14);   gtk_widget_set_margin_bottom(kb_row, 14);
@@ -4201,7 +10133,10 @@ GtkWidget *region_settings(void) {
 	gtk_widget_add_css_class(kb_t, "title-4");
 	gtk_widget_set_halign(kb_t, GTK_ALIGN_START);
 	gtk_box_append(GTK_BOX(kb_inf), kb_t);
-	GtkWidget *kb_v = gtk_label_new(kb_display);
+	GtkWidget *kb_v = gtk_label_new(NULL);
+	region_kb_update(kb_v);
+	g_signal_connect_swapped(kb_v, "destroy", G_CALLBACK(xkb_watch_remove),
+				 xkb_watch_add(region_kb_update, kb_v));
 	gtk_widget_add_css_class(kb_v, "dim-label");
 	gtk_widget_set_halign(kb_v, GTK_ALIGN_START);
 	gtk_box_append(GTK_BOX(kb_inf), kb_v);
@@ -4212,7 +10147,6 @@ GtkWidget *region_settings(void) {
 	g_signal_connect(kb_btn, "clicked", G_CALLBACK(region_goto_keyboard), NULL);
 	gtk_box_append(GTK_BOX(kb_row), kb_btn);
 	gtk_box_append(GTK_BOX(inp_inner), kb_row);
-	g_free(kb_layout); g_free(kb_variant);
 	gtk_box_append(GTK_BOX(vb), inp_frame);
 
 	g_free(cur_lang); g_free(cur_fmt);
@@ -7412,6 +13346,9 @@ int main(int argc, char **argv) {
 
 	const char *jump_to = NULL;
 
+	if (argc > 1 && !strcmp(argv[1], "--apply-keyboard"))
+		return kbd_apply_saved_main();
+
 	for (int i = 1; i < argc; i++) {
 		if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
 			printf(
@@ -7442,6 +13379,7 @@ int main(int argc, char **argv) {
 			       "  --sharing            Open directly to Sharing settings\n"
 			       "  --applications       Open directly to Applications settings\n"
 			       "  --about              Open directly to About\n"
+			       "  --apply-keyboard     Apply saved key repeat settings and exit\n"
 			       "  -h, --help           Show this help message\n"
 			       );
 			return 0;
@@ -7634,6 +13572,9 @@ static void activate(GtkApplication *app, gpointer user_data) {
 							   GTK_STYLE_PROVIDER_PRIORITY_USER);
 
 		g_object_unref(css);
+		g_idle_add(disp_hotplug_init, NULL);
+		g_idle_add(night_init, NULL);
+		g_idle_add(bat_hist_init, NULL);
 		GtkWidget *box=gtk_box_new(GTK_ORIENTATION_HORIZONTAL,0);
 		GtkWidget *sv=gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
 		gtk_widget_set_size_request(sv,240,-1);
@@ -0,0 +1,227 @@
+/*
+ * test-backlight.c — hardware backlight tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Devices come from a synthetic /sys/class/backlight.  Writes go to a
+ * fake logind Session served from this process on a private bus that
+ * stands in for the system bus, as in test-datetime.c, so dbus-daemon
+ * must be installed.  Nothing here needs a display. */
+#include "test-common.h"
+
+#define LD_IFACE "org.freedesktop.login1.Session"
+#define LD_PATH  "/org/freedesktop/login1/session/auto"
+
+static const char ld_fake_xml[] =
+	"<node><interface name='" LD_IFACE "'>"
+	"<method name='SetBrightness'><arg type='s' direction='in'/><arg type='s' direction='in'/>"
+	"<arg type='u' direction='in'/></method>"
+	"</interface></node>";
+
+static struct {
+	GTestDBus       *bus;
+	GDBusConnection *conn;
+	GArray          *values;          /* every SetBrightness, in order */
+} fake;
+
+static void fake_call(GDBusConnection *c, const char *sender, const char *path,
+		      const char *iface, const char *method, GVariant *args,
+		      GDBusMethodInvocation *inv, gpointer ud) {
+	const char *subsystem, *name;
+	guint32 value;
+	g_variant_get(args, "(&s&su)", &subsystem, &name, &value);
+	g_assert_cmpstr(subsystem, ==, "backlight");
+	if (strcmp(name, "intel_backlight") != 0) {
+		g_dbus_method_invocation_return_dbus_error(inv, "org.freedesktop.DBus.Error.FileNotFound",
+							   "No such device");
+		return;
+	}
+	g_array_append_val(fake.values, value);
+	g_dbus_method_invocation_return_value(inv, NULL);
+}
+
+static const GDBusInterfaceVTable fake_vtable = { fake_call, NULL, NULL };
+
+static void fake_up(void) {
+	if (fake.bus) return;
+	fake.values = g_array_new(FALSE, FALSE, sizeof(guint32));
+	fake.bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+	g_test_dbus_up(fake.bus);
+	const char *addr = g_test_dbus_get_bus_address(fake.bus);
+	g_setenv("DBUS_SYSTEM_BUS_ADDRESS", addr, TRUE);
+
+	GError *err = NULL;
+	fake.conn = g_dbus_connection_new_for_address_sync(addr,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+		NULL, NULL, &err);
+	g_assert_no_error(err);
+	GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(ld_fake_xml, &err);
+	g_assert_no_error(err);
+	g_dbus_connection_register_object(fake.conn, LD_PATH, node->interfaces[0],
+					  &fake_vtable, NULL, NULL, &err);
+	g_assert_no_error(err);
+	g_dbus_node_info_unref(node);
+	GVariant *r = g_dbus_connection_call_sync(fake.conn, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+						  "org.freedesktop.DBus", "RequestName",
+						  g_variant_new("(su)", "org.freedesktop.login1", 4 /* DO_NOT_QUEUE */),
+						  G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &err);
+	g_assert_no_error(err);
+	g_variant_unref(r);
+}
+
+/* Iterate until the fake has seen n calls and the device is idle */
+static void bl_test_wait(BlDevice *bl, guint n) {
+	gint64 end = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+	while (fake.values->len < n || bl->in_flight || bl->bus_wait) {
+		g_assert_cmpint(g_get_monotonic_time(), <, end);
+		g_main_context_iteration(NULL, FALSE);
+		g_usleep(1000);
+	}
+}
+
+/* acpi_video0 (firmware, no actual_brightness), intel_backlight (raw)
+ * and two that must be skipped: max_brightness 0, and no type */
+static char *bl_test_tree(void) {
+	char *root = tree_new("backlight");
+	tree_put(root, "intel_backlight/type", "raw\n", -1);
+	tree_put(root, "intel_backlight/max_brightness", "96000\n", -1);
+	tree_put(root, "intel_backlight/actual_brightness", "6000\n", -1);
+	tree_put(root, "intel_backlight/brightness", "6000\n", -1);
+	tree_put(root, "acpi_video0/type", "firmware\n", -1);
+	tree_put(root, "acpi_video0/max_brightness", "100\n", -1);
+	tree_put(root, "acpi_video0/brightness", "40\n", -1);
+	tree_put(root, "broken/type", "platform\n", -1);
+	tree_put(root, "broken/max_brightness", "0\n", -1);
+	tree_put(root, "broken/brightness", "0\n", -1);
+	tree_put(root, "untyped/max_brightness", "255\n", -1);
+	tree_put(root, "untyped/brightness", "255\n", -1);
+	return root;
+}
+
+static void test_bl_enumerate(void) {
+	char *root = bl_test_tree();
+	GPtrArray *devs = bl_enumerate(root);
+	g_assert_cmpuint(devs->len, ==, 2);
+	BlDevice *fw = g_ptr_array_index(devs, 0), *raw = g_ptr_array_index(devs, 1);
+	g_assert_cmpstr(fw->name, ==, "acpi_video0");        /* firmware first */
+	g_assert_cmpint(fw->max, ==, 100);
+	g_assert_cmpint(fw->cur, ==, 40);
+	g_assert_cmpstr(raw->name, ==, "intel_backlight");
+	g_assert_cmpint(raw->max, ==, 96000);
+	g_assert_cmpint(raw->cur, ==, 6000);
+	g_assert_true(raw->sysfs == root);
+	g_assert_true(raw->bus_wait);
+	g_assert_cmpint(raw->queued, ==, -1);
+	g_ptr_array_unref(devs);
+
+	devs = bl_enumerate("/nonexistent");
+	g_assert_cmpuint(devs->len, ==, 0);
+	g_ptr_array_unref(devs);
+	g_free(root);
+}
+
+/* Half the slider is 1/16 of the range, the ends are 1 and max, and
+ * the curve round-trips once raw steps are finer than a percent */
+static void test_bl_curve(void) {
+	BlDevice bl = { .max = 96000 };
+	g_assert_cmpint(bl_to_raw(&bl, 100), ==, 96000);
+	g_assert_cmpint(bl_to_raw(&bl, 50), ==, 6000);
+	g_assert_cmpint(bl_to_raw(&bl, 0), ==, 1);
+	g_assert_cmpint(bl_to_raw(&bl, 150), ==, 96000);
+	g_assert_cmpfloat_with_epsilon(bl_to_pct(&bl, 6000), 50.0, 1e-9);
+	int prev = 0;
+	for (int pct = 1; pct <= 100; pct++) {
+		int raw = bl_to_raw(&bl, pct);
+		g_assert_cmpint(raw, >=, prev);
+		if (pct >= 20) g_assert_cmpfloat(fabs(bl_to_pct(&bl, raw) - pct), <, 0.05);
+		prev = raw;
+	}
+	BlDevice none = { .max = 0 };
+	g_assert_cmpfloat(bl_to_pct(&none, 5), ==, 100.0);
+}
+
+/* Without a system bus the value goes to the sysfs file */
+static void test_bl_sysfs_fallback(void) {
+	char *root = bl_test_tree();
+	GPtrArray *devs = bl_enumerate(root);
+	BlDevice *bl = g_ptr_array_index(devs, 1);
+	bl_write(bl, 1234);                                     /* bus not there yet */
+	g_assert_cmpint(bl->queued, ==, 1234);
+	bl->bus_wait = FALSE;                                   /* as bl_bus_ready with no bus */
+	bl_flush_queued(bl);
+	g_assert_cmpint(bl->queued, ==, -1);
+	char *path = g_build_filename(root, "intel_backlight", "brightness", NULL), *got = NULL;
+	g_assert_true(g_file_get_contents(path, &got, NULL, NULL));
+	g_assert_cmpstr(got, ==, "1234");
+	g_free(got); g_free(path);
+	g_ptr_array_unref(devs);
+	g_free(root);
+}
+
+/* A value set before the bus arrives is sent once it does; a burst
+ * while a call is in flight sends only the last value after it. */
+static void test_bl_logind(void) {
+	fake_up();
+	char *root = bl_test_tree();
+	GPtrArray *devs = bl_enumerate(root);
+	BlDevice *bl = g_ptr_array_index(devs, 1);
+	bl_write(bl, 500);
+	g_bus_get(G_BUS_TYPE_SYSTEM, NULL, bl_bus_ready, g_ptr_array_ref(devs));
+	bl_test_wait(bl, 1);
+	g_assert_nonnull(bl->bus);
+	g_assert_cmpuint(g_array_index(fake.values, guint32, 0), ==, 500);
+
+	for (int v = 1000; v <= 10000; v += 1000) bl_write(bl, v);
+	g_assert_true(bl->in_flight);
+	g_assert_cmpint(bl->queued, ==, 10000);
+	bl_test_wait(bl, 3);
+	g_assert_cmpuint(fake.values->len, ==, 3);
+	g_assert_cmpuint(g_array_index(fake.values, guint32, 1), ==, 1000);
+	g_assert_cmpuint(g_array_index(fake.values, guint32, 2), ==, 10000);
+
+	/* a refused call is reported, and the next value still goes out */
+	BlDevice *fw = g_ptr_array_index(devs, 0);
+	g_test_expect_message(NULL, G_LOG_LEVEL_WARNING, "SetBrightness(acpi_video0): *No such device*");
+	bl_write(fw, 50);
+	while (fw->in_flight) g_main_context_iteration(NULL, TRUE);
+	g_test_assert_expected_messages();
+	bl_write(bl, 7);
+	bl_test_wait(bl, 4);
+	g_assert_cmpuint(g_array_index(fake.values, guint32, 3), ==, 7);
+
+	g_ptr_array_unref(devs);
+	g_free(root);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/backlight/enumerate",      test_bl_enumerate);
+	g_test_add_func("/backlight/curve",          test_bl_curve);
+	g_test_add_func("/backlight/sysfs-fallback", test_bl_sysfs_fallback);
+	g_test_add_func("/backlight/logind",         test_bl_logind);
+
+	int ret = g_test_run();
+	if (fake.bus) {
+		g_object_unref(fake.conn);
+		g_test_dbus_down(fake.bus);
+		g_object_unref(fake.bus);
+	}
+	return ret;
+}
@@ -0,0 +1,296 @@
+/*
+ * test-battery.c — battery page sysfs tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* A synthetic power_supply tree, rewritten in place because the page
+ * keeps its attributes open, and uevents sent over a socketpair.  The
+ * card test needs GTK and is skipped without a display.  The history
+ * file goes to the test's isolated cache directory. */
+#include "test-common.h"
+
+static void bat_test_rewrite(const char *root, const char *path, const char *contents) {
+	char *full = g_build_filename(root, path, NULL);
+	FILE *f = fopen(full, "w");
+	g_assert_nonnull(f);
+	fputs(contents, f);
+	fclose(f);
+	g_free(full);
+}
+
+/* a 12 V pack at 80% drawing 1.5 A; BAT0 only when `bat0` */
+static char *bat_test_tree(gboolean bat0) {
+	static const char *const attrs[][2] = {
+		{ "capacity", "80\n" }, { "status", "Discharging\n" },
+		{ "charge_full", "4000000\n" }, { "charge_full_design", "5000000\n" },
+		{ "charge_now", "3000000\n" }, { "current_now", "1500000\n" },
+		{ "voltage_now", "12000000\n" }, { "temp", "315\n" },
+		{ "manufacturer", "SMP\n" }, { "model_name", "5B10W13930\n" },
+		{ "technology", "Li-poly\n" },
+	};
+	char *root = tree_new("power_supply");
+	for (guint i = 0; i < G_N_ELEMENTS(attrs); i++) {
+		char *path = g_build_filename(bat0 ? "BAT0" : "BAT1", attrs[i][0], NULL);
+		tree_put(root, path, attrs[i][1], -1);
+		g_free(path);
+	}
+	tree_put(root, "AC/online", "0\n", -1);
+	return root;
+}
+
+static BatData *bat_test_data(const char *root) {
+	BatData *bd = g_new0(BatData, 1);
+	bd->nl_fd = bd->gov_fd = bd->epp_fd = -1;
+	for (int i = 0; i < BA_N; i++) bd->fd[i] = -1;
+	bd->sysfs = root;
+	return bd;
+}
+
+/* BAT1 is found when there is no BAT0; an attribute the driver lacks
+ * (cycle_count here) stays closed and reads as N/A */
+static void test_bat_open(void) {
+	char *root = bat_test_tree(FALSE);
+	BatData *bd = bat_test_data(root);
+	bat_open(bd);
+	g_assert_cmpstr(bd->node, ==, "BAT1");
+	g_assert_cmpstr(bd->s_charge_design, ==, "5000000");
+	g_assert_cmpstr(bd->s_model, ==, "5B10W13930");
+	g_assert_cmpint(bd->fd[BA_CYCLES], <, 0);
+	char v[32];
+	bat_pread(bd->fd[BA_CYCLES], v, sizeof(v));
+	g_assert_cmpstr(v, ==, "N/A");
+
+	bat_test_rewrite(root, "BAT1/current_now", "2500000\n");
+	bat_pread(bd->fd[BA_CURRENT], v, sizeof(v));
+	g_assert_cmpstr(v, ==, "2500000");
+	bat_close(bd);
+	g_assert_cmpstr(bd->node, ==, "");
+	g_free(bd); g_free(root);
+
+	root = tree_new("empty");
+	bd = bat_test_data(root);
+	bat_open(bd);
+	g_assert_cmpstr(bd->node, ==, "");
+	bat_close(bd);
+	g_free(bd); g_free(root);
+}
+
+/* Only power_supply uevents schedule a re-read, and a burst schedules one */
+static void test_bat_uevent(void) {
+	int sv[2];
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv), ==, 0);
+	BatData *bd = bat_test_data("/nonexistent");
+	static const char other[] = "change@/devices/virtual/net/wlan0\0ACTION=change\0SUBSYSTEM=net\0";
+	static const char bat[]   = "change@/devices/LNXSYSTM:00/PNP0C0A:00/power_supply/BAT0\0"
+				    "ACTION=change\0SUBSYSTEM=power_supply\0POWER_SUPPLY_STATUS=Charging\0";
+	g_assert_cmpint(send(sv[1], other, sizeof(other), 0), ==, sizeof(other));
+	bat_uevent_cb(sv[0], G_IO_IN, bd);
+	g_assert_cmpuint(bd->refresh_idle, ==, 0);
+
+	g_assert_cmpint(send(sv[1], bat, sizeof(bat), 0), ==, sizeof(bat));
+	g_assert_cmpint(send(sv[1], bat, sizeof(bat), 0), ==, sizeof(bat));
+	bat_uevent_cb(sv[0], G_IO_IN, bd);
+	guint idle = bd->refresh_idle;
+	g_assert_cmpuint(idle, !=, 0);
+	g_assert_cmpint(send(sv[1], bat, sizeof(bat), 0), ==, sizeof(bat));
+	bat_uevent_cb(sv[0], G_IO_IN, bd);
+	g_assert_cmpuint(bd->refresh_idle, ==, idle);           /* still the one idle */
+	g_assert_cmpint(recv(sv[0], (char[8]){ 0 }, 8, MSG_DONTWAIT), <, 0);   /* drained */
+
+	g_source_remove(bd->refresh_idle);
+	close(sv[0]); close(sv[1]);
+	g_free(bd);
+}
+
+static const char *bat_test_card(GtkWidget *card) {
+	return gtk_label_get_text(GTK_LABEL(gtk_widget_get_first_child(card)));
+}
+
+/* With uevents available the poll follows current, voltage and charge
+ * only; capacity and status wait for their uevent */
+static void test_bat_power_poll(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	g_assert_cmpint(BAT_POWER_S, <=, 5);
+	char *root = bat_test_tree(TRUE);
+	BatData *bd = bat_test_data(root);
+	bd->gauge = g_object_ref_sink(gtk_drawing_area_new());
+	bd->gauge_data = g_new0(BatGaugeData, 1);
+	bd->devlbl = g_object_ref_sink(gtk_label_new(NULL));
+	GtkWidget **cards[] = { &bd->card_health, &bd->card_power, &bd->card_time,
+				&bd->card_cycles, &bd->card_voltage, &bd->card_temp };
+	for (guint i = 0; i < G_N_ELEMENTS(cards); i++)
+		*cards[i] = g_object_ref_sink(make_bat_card("", "N/A"));
+
+	bat_open(bd);
+	bat_read_and_update(bd);
+	g_assert_cmpint(bd->gauge_data->capacity, ==, 80);
+	g_assert_cmpstr(bat_test_card(bd->card_health),  ==, "80%");
+	g_assert_cmpstr(bat_test_card(bd->card_power),   ==, "18.00 W");
+	g_assert_cmpstr(bat_test_card(bd->card_time),    ==, "2h 0m");
+	g_assert_cmpstr(bat_test_card(bd->card_voltage), ==, "12.00 V");
+	g_assert_cmpstr(bat_test_card(bd->card_temp),    ==, "31.5 °C");
+
+	bat_test_rewrite(root, "BAT0/current_now", "3000000\n");
+	bat_test_rewrite(root, "BAT0/voltage_now", "11500000\n");
+	bat_test_rewrite(root, "BAT0/capacity", "50\n");
+	bd->nl_watch = 1;                                       /* as if the socket were open */
+	g_assert_true(bat_timer_cb(bd) == G_SOURCE_CONTINUE);
+	bd->nl_watch = 0;
+	g_assert_cmpstr(bat_test_card(bd->card_power),   ==, "34.50 W");
+	g_assert_cmpstr(bat_test_card(bd->card_time),    ==, "1h 0m");
+	g_assert_cmpstr(bat_test_card(bd->card_voltage), ==, "11.50 V");
+	g_assert_cmpint(bd->gauge_data->capacity, ==, 80);
+
+	/* without the socket the poll reads everything */
+	bat_timer_cb(bd);
+	g_assert_cmpint(bd->gauge_data->capacity, ==, 50);
+
+	bat_close(bd);
+	for (guint i = 0; i < G_N_ELEMENTS(cards); i++) g_object_unref(*cards[i]);
+	g_object_unref(bd->devlbl); g_object_unref(bd->gauge);
+	g_free(bd->gauge_data); g_free(bd); g_free(root);
+}
+
+/* ------------------------------------------------------------------ */
+/* history                                                              */
+/* ------------------------------------------------------------------ */
+#define BAT_TEST_WEEK (7 * 86400 / BAT_HIST_PERIOD_S)
+
+/* Sample i of a week ending at `now`: a sawtooth discharge with power
+ * following the charge, so every bucket sees a spread of values. */
+static BatSample bat_test_sample(guint32 now, guint i) {
+	BatSample s = { .t = now - (BAT_TEST_WEEK - 1 - i) * BAT_HIST_PERIOD_S };
+	s.capacity   = 100 - i % 101;
+	s.status     = BS_DISCHARGING;
+	s.energy_mwh = s.capacity * 500;
+	s.power_mw   = -(4000 + (gint32)(i % 7) * 1000);
+	return s;
+}
+
+static void bat_test_hist_reset(void) {
+	memset(bat_hist.buckets, 0, sizeof(bat_hist.buckets));
+	bat_hist.hdr->head = 0;
+}
+
+static void bat_test_hist_unmap(void) {
+	munmap(bat_hist.hdr, bat_hist.map_len);
+	bat_hist.hdr = NULL; bat_hist.ring = NULL;
+}
+
+/* the ring is in the cache file and survives a remap, i.e. a restart */
+static void test_bat_hist_persist(void) {
+	g_assert_true(bat_hist_map());
+	g_assert_cmpuint(bat_hist.hdr->head, ==, 0);
+	bat_test_hist_reset();
+	for (guint i = 0; i < 3; i++) {
+		BatSample s = bat_test_sample(1000000, i);
+		bat_hist_append(&s);
+	}
+	bat_test_hist_unmap();
+	g_assert_true(bat_hist_map());
+	g_assert_cmpuint(bat_hist.hdr->head, ==, 3);
+	BatSample want = bat_test_sample(1000000, 2);
+	g_assert_cmpmem(&bat_hist.ring[2], sizeof(BatSample), &want, sizeof(BatSample));
+
+	/* a file from another layout starts over */
+	bat_hist.hdr->version = 99;
+	bat_test_hist_unmap();
+	g_assert_true(bat_hist_map());
+	g_assert_cmpuint(bat_hist.hdr->head, ==, 0);
+	g_assert_cmpuint(bat_hist.hdr->version, ==, 1);
+	bat_test_hist_unmap();
+}
+
+/* Every in-range sample lands in exactly one bucket of each range, and
+ * each bucket's mean lies between its min and max. */
+static void test_bat_hist_buckets(void) {
+	g_assert_true(bat_hist_map());
+	bat_test_hist_reset();
+	guint32 now = (guint32)(g_get_real_time() / G_USEC_PER_SEC);
+	for (guint i = 0; i < BAT_TEST_WEEK; i++) {
+		BatSample s = bat_test_sample(now, i);
+		bat_hist_append(&s);
+	}
+	g_assert_cmpuint(bat_hist.hdr->head, ==, BAT_TEST_WEEK);
+	for (guint r = 0; r < BAT_N_RANGES; r++) {
+		guint32 width = bat_ranges[r].secs / BAT_HIST_BUCKETS;
+		gint64 first = (now - bat_ranges[r].secs) / width, last = now / width;
+		guint want = 0, got = 0;
+		for (guint i = 0; i < BAT_TEST_WEEK; i++) {
+			gint64 id = bat_test_sample(now, i).t / width;
+			want += id >= first && id <= last;
+		}
+		for (gint64 id = first; id <= last; id++) {
+			const BatBucket *b = &bat_hist.buckets[r][id % (BAT_HIST_BUCKETS + 1)];
+			g_assert_cmpint(b->id, ==, id);
+			got += b->n[BH_CHARGE];
+			for (int m = 0; m < BH_N; m++) {
+				if (!b->n[m]) continue;
+				float mean = b->sum[m] / b->n[m];
+				g_assert_cmpfloat(b->min[m], <=, mean + 1e-3f);
+				g_assert_cmpfloat(mean, <=, b->max[m] + 1e-3f);
+			}
+		}
+		g_assert_cmpuint(got, ==, want);
+	}
+	bat_test_hist_unmap();
+}
+
+static void bat_bench_append(gpointer data) {
+	guint32 now = GPOINTER_TO_UINT(data);
+	bat_test_hist_reset();
+	for (guint i = 0; i < BAT_TEST_WEEK; i++) {
+		BatSample s = bat_test_sample(now, i);
+		bat_hist_append(&s);
+	}
+}
+
+static void bat_bench_draw(gpointer data) {
+	cairo_t *cr = cairo_create(data);
+	for (int r = 0; r < (int)BAT_N_RANGES; r++)
+		for (int m = 0; m < BH_N; m++) {
+			BatHistView hv = { r, m };
+			bat_hist_draw(NULL, cr, 600, 160, &hv);
+		}
+	cairo_destroy(cr);
+}
+
+/* a week of 5 s samples into the mapped file, then every graph */
+static void test_bat_hist_bench(void) {
+	g_assert_true(bat_hist_map());
+	guint32 now = (guint32)(g_get_real_time() / G_USEC_PER_SEC);
+	bench_run("append a week of 5 s samples", bat_bench_append, GUINT_TO_POINTER(now), 20000);
+	cairo_surface_t *surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 600, 160);
+	bench_run("draw 3 ranges x 3 metrics", bat_bench_draw, surf, 5000);
+	cairo_surface_destroy(surf);
+	bat_test_hist_unmap();
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/battery/open",       test_bat_open);
+	g_test_add_func("/battery/uevent",     test_bat_uevent);
+	g_test_add_func("/battery/power-poll", test_bat_power_poll);
+	g_test_add_func("/battery/history/persist", test_bat_hist_persist);
+	g_test_add_func("/battery/history/buckets", test_bat_hist_buckets);
+	g_test_add_func("/battery/history/bench",   test_bat_hist_bench);
+
+	return g_test_run();
+}
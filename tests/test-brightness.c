@@ -0,0 +1,133 @@
+/*
+ * test-brightness.c — monitor brightness apply channel tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Needs nothing: the channel's apply is replaced by one that records
+ * what it was given. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* apply channel                                                        */
+/* ------------------------------------------------------------------ */
+static struct {
+	GMutex lock;
+	guint  n;
+	double last;
+	gulong sleep_us;                        /* how long one apply takes */
+} applied;
+
+static void bright_test_apply(BrightChan *bc, double value) {
+	if (applied.sleep_us) g_usleep(applied.sleep_us);
+	g_mutex_lock(&applied.lock);
+	applied.n++;
+	applied.last = value;
+	g_mutex_unlock(&applied.lock);
+}
+
+/* Wait for the worker to finish; FALSE after five seconds. */
+static gboolean bright_test_settle(BrightChan *bc) {
+	gint64 end = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+	for (;;) {
+		g_mutex_lock(&bc->lock);
+		gboolean busy = bc->in_flight;
+		g_mutex_unlock(&bc->lock);
+		if (!busy) return TRUE;
+		if (g_get_monotonic_time() > end) return FALSE;
+		g_usleep(1000);
+	}
+}
+
+/* 500 value-changed events, `gap_us` apart, then the release.  The
+ * applies may not outrun `hz`, and the last one is the final value. */
+static void bright_test_drag(int hz, gulong gap_us, gulong apply_us) {
+	memset(&applied, 0, sizeof(applied));
+	applied.sleep_us = apply_us;
+	BrightChan *bc = bright_chan_new("TEST-1", hz, bright_test_apply);
+	gint64 start = g_get_monotonic_time();
+	for (int i = 1; i <= 500; i++) {
+		bright_chan_push(bc, i / 500.0);
+		if (gap_us) g_usleep(gap_us);
+	}
+	bright_chan_flush(bc);
+	g_assert_true(bright_test_settle(bc));
+	double secs = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+	g_assert_cmpuint(applied.n, ==, bc->n_applies);
+	g_assert_cmpuint(applied.n, >=, 1);
+	/* one at t=0, one per interval after, and the flushed one */
+	g_assert_cmpuint(applied.n, <=, (guint)(secs * hz) + 2);
+	g_assert_cmpfloat(applied.last, ==, 1.0);
+	g_assert_false(bc->has_pending);
+	g_test_message("hz %d, gap %lu us: %u applies in %.2f s", hz, gap_us, applied.n, secs);
+	bright_chan_unref(bc);
+}
+
+static void test_bright_chan_burst(void) {
+	bright_test_drag(BRIGHT_MAX_APPLY_HZ, 0, 0);
+	g_assert_cmpuint(applied.n, <=, 3);          /* all 500 land before the 2nd */
+}
+
+static void test_bright_chan_drag(void) {
+	bright_test_drag(100, 1000, 0);
+	g_assert_cmpuint(applied.n, >, 1);           /* it keeps up during the drag */
+}
+
+/* applies slower than the events: still only the newest value runs */
+static void test_bright_chan_slow_apply(void) {
+	bright_test_drag(BRIGHT_APPLY_HZ_MAX, 200, 5000);
+}
+
+/* ------------------------------------------------------------------ */
+/* configured rate                                                      */
+/* ------------------------------------------------------------------ */
+static void bright_test_config(const char *contents) {
+	char *path = bright_apply_path(), *dir = g_path_get_dirname(path);
+	g_assert_cmpint(g_mkdir_with_parents(dir, 0755), ==, 0);
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+	g_free(dir); g_free(path);
+}
+
+/* G_TEST_OPTION_ISOLATE_DIRS gives every test its own XDG_CONFIG_HOME */
+static void test_bright_apply_hz(void) {
+	g_assert_cmpint(bright_apply_hz(), ==, BRIGHT_MAX_APPLY_HZ);
+	bright_test_config("[Brightness]\nMaxApplyHz=60\n");
+	g_assert_cmpint(bright_apply_hz(), ==, 60);
+	bright_test_config("[Brightness]\nMaxApplyHz=0\n");
+	g_assert_cmpint(bright_apply_hz(), ==, BRIGHT_APPLY_HZ_MIN);
+	bright_test_config("[Brightness]\nMaxApplyHz=100000\n");
+	g_assert_cmpint(bright_apply_hz(), ==, BRIGHT_APPLY_HZ_MAX);
+	bright_test_config("[Brightness]\n");
+	g_assert_cmpint(bright_apply_hz(), ==, BRIGHT_MAX_APPLY_HZ);
+
+	BrightChan *bc = bright_chan_new("TEST-1", 60, bright_test_apply);
+	g_assert_cmpint(bc->min_interval, ==, G_USEC_PER_SEC / 60);
+	bright_chan_unref(bc);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/brightness/chan/burst",      test_bright_chan_burst);
+	g_test_add_func("/brightness/chan/drag",       test_bright_chan_drag);
+	g_test_add_func("/brightness/chan/slow-apply", test_bright_chan_slow_apply);
+	g_test_add_func("/brightness/apply-hz",        test_bright_apply_hz);
+
+	return g_test_run();
+}
@@ -0,0 +1,85 @@
+/*
+ * test-common.h — shared setup for the mrsettings test programs
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The program is one translation unit of static functions, so each test
+ * program includes it whole and calls them directly; its main() is
+ * renamed out of the way.  Fixtures live in tests/fixtures and are found
+ * through G_TEST_SRCDIR. */
+#define main mrsettings_main
+#include "../mrsettings.c"
+#undef main
+
+G_GNUC_UNUSED static char *fixture_path(const char *dir, const char *name) {
+	return g_test_build_filename(G_TEST_DIST, "fixtures", dir, name, NULL);
+}
+
+G_GNUC_UNUSED static char *fixture_read(const char *dir, const char *name, gsize *len) {
+	char *path = fixture_path(dir, name), *buf = NULL;
+	GError *err = NULL;
+	g_file_get_contents(path, &buf, len, &err);
+	g_assert_no_error(err);
+	g_free(path);
+	return buf;
+}
+
+/* ------------------------------------------------------------------ */
+/* benchmarks                                                           */
+/* ------------------------------------------------------------------ */
+/* A benchmark is an ordinary test that times repeated calls of fn and
+ * reports the mean with the test output.  `make check` runs three so
+ * the code path stays covered; `make bench` passes -m perf, which runs
+ * up to 200 (or two seconds' worth) and fails the test when the mean is
+ * over budget_us.  Budgets are for an ordinary laptop, with headroom. */
+G_GNUC_UNUSED static double bench_run(const char *what, void (*fn)(gpointer),
+				      gpointer data, double budget_us) {
+	int runs = 0;
+	fn(data);                                           /* warm caches */
+	g_test_timer_start();
+	do { fn(data); runs++; }
+	while (runs < 3 || (g_test_perf() && runs < 200 && g_test_timer_elapsed() < 2.0));
+	double us = g_test_timer_elapsed() * 1e6 / runs;
+	g_test_minimized_result(us, "%s: %.1f us (mean of %d, budget %.0f us)",
+				what, us, runs, budget_us);
+	if (g_test_perf()) g_assert_cmpfloat(us, <=, budget_us);
+	return us;
+}
+
+/* ------------------------------------------------------------------ */
+/* fake sysfs and /proc trees                                           */
+/* ------------------------------------------------------------------ */
+/* A scratch root in the test's isolated cache directory, so every test
+ * starts from an empty tree and nothing is left behind. */
+G_GNUC_UNUSED static char *tree_new(const char *name) {
+	char *root = g_build_filename(g_get_user_cache_dir(), name, NULL);
+	g_assert_cmpint(g_mkdir_with_parents(root, 0755), ==, 0);
+	return root;
+}
+
+/* Write root/path, making parents; len -1 for a string. */
+G_GNUC_UNUSED static void tree_put(const char *root, const char *path,
+				   const char *contents, gssize len) {
+	char *full = g_build_filename(root, path, NULL), *dir = g_path_get_dirname(full);
+	GError *err = NULL;
+	g_assert_cmpint(g_mkdir_with_parents(dir, 0755), ==, 0);
+	g_file_set_contents(full, contents, len, &err);
+	g_assert_no_error(err);
+	g_free(dir); g_free(full);
+}
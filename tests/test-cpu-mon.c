@@ -0,0 +1,171 @@
+/*
+ * test-cpu-mon.c — CPU activity sampler tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The sampler runs against a synthetic sysfs and /proc/stat.  It keeps
+ * its files open and preads them, so the tests rewrite them in place
+ * rather than with tree_put, which replaces the file. */
+#include "test-common.h"
+
+static void cpu_test_rewrite(const char *root, const char *path, const char *contents) {
+	char *full = g_build_filename(root, path, NULL);
+	FILE *f = fopen(full, "w");
+	g_assert_nonnull(f);
+	fputs(contents, f);
+	fclose(f);
+	g_free(full);
+}
+
+/* /proc/stat for n cores: core i has busy[i] and idle[i] ticks, cores
+ * listed in `offline` are left out, and an intr line of `intr` counters
+ * pads it the way a real one is padded */
+static char *cpu_test_stat(int n, const guint64 *busy, const guint64 *idle, int offline, int intr) {
+	GString *s = g_string_new("cpu  1 2 3 4 5 6 7 8 0 0\n");
+	for (int i = 0; i < n; i++) {
+		if (i == offline) continue;
+		/* user nice system idle iowait irq softirq steal */
+		g_string_append_printf(s, "cpu%d %" G_GUINT64_FORMAT " 0 %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+				       " 7 0 3 0 0 0\n", i, busy[i] / 2, busy[i] - busy[i] / 2 - 3, idle[i]);
+	}
+	g_string_append(s, "intr 123456");
+	for (int i = 0; i < intr; i++) g_string_append(s, " 0");
+	g_string_append(s, "\nctxt 987654\nbtime 1700000000\nprocesses 4242\n");
+	return g_string_free(s, FALSE);
+}
+
+/* n cores of a 4 GHz part; core `no_freq` has no cpufreq */
+static char *cpu_test_tree(int n, int no_freq) {
+	char *root = tree_new("cpu-mon");
+	char path[96], val[32];
+	for (int i = 0; i < n; i++) {
+		if (i == no_freq) {
+			snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/online", i);
+			tree_put(root, path, "1\n", -1);
+			continue;
+		}
+		snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+		tree_put(root, path, "4000000\n", -1);
+		snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+		snprintf(val, sizeof(val), "%d\n", 800000 + i * 100000);
+		tree_put(root, path, val, -1);
+	}
+	tree_put(root, "sys/devices/system/cpu/cpufreq/boost", "1\n", -1);
+	return root;
+}
+
+static float cpu_test_last(const CpuSampler *s, const float *ring, int i) {
+	return ring[i * CPU_MON_HIST + (s->head + CPU_MON_HIST - 1) % CPU_MON_HIST];
+}
+
+static void test_cpu_sample(void) {
+	char *root = cpu_test_tree(8, 3);
+	tree_put(root, "sys/class/hwmon/hwmon0/name", "acpitz\n", -1);
+	tree_put(root, "sys/class/hwmon/hwmon0/temp1_input", "27800\n", -1);
+	tree_put(root, "sys/class/hwmon/hwmon1/name", "coretemp\n", -1);
+	tree_put(root, "sys/class/hwmon/hwmon1/temp1_input", "55000\n", -1);
+	guint64 busy[8], idle[8];
+	for (int i = 0; i < 8; i++) { busy[i] = 1000; idle[i] = 5000; }
+	char *stat = cpu_test_stat(8, busy, idle, -1, 4000);        /* > the first buffer */
+	tree_put(root, "proc/stat", stat, -1);
+	g_free(stat);
+
+	char *sys = g_build_filename(root, "sys", NULL), *proc = g_build_filename(root, "proc", NULL);
+	CpuSampler *s = cpu_sampler_open(sys, proc);
+	g_assert_nonnull(s);
+	g_assert_cmpint(s->n, ==, 8);
+	cpu_sampler_sample(s);
+	g_assert_cmpint(s->count, ==, 1);
+	g_assert_cmpuint(s->buf_sz, >, 4096 + 8 * 128);                 /* grown */
+	for (int i = 0; i < 8; i++) g_assert_cmpfloat(cpu_test_last(s, s->util, i), ==, 0);   /* no delta yet */
+
+	/* core i: busy for i of 7 parts; core 5 goes offline */
+	for (int i = 0; i < 8; i++) { busy[i] += 10 * i; idle[i] += 10 * (7 - i); }
+	stat = cpu_test_stat(8, busy, idle, 5, 4000);
+	cpu_test_rewrite(root, "proc/stat", stat);
+	g_free(stat);
+	cpu_test_rewrite(root, "sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "3900000\n");
+	cpu_test_rewrite(root, "sys/class/hwmon/hwmon1/temp1_input", "71500\n");
+	cpu_sampler_sample(s);
+	g_assert_cmpint(s->count, ==, 2);
+	for (int i = 0; i < 8; i++) {
+		float want = i == 0 || i == 5 ? 0 : i / 7.0f;
+		g_assert_cmpfloat_with_epsilon(cpu_test_last(s, s->util, i), want, 1e-4);
+	}
+	g_assert_cmpfloat(cpu_test_last(s, s->freq, 0), ==, 3900000);
+	g_assert_cmpfloat(cpu_test_last(s, s->freq, 2), ==, 1000000);
+	g_assert_cmpfloat(cpu_test_last(s, s->freq, 3), ==, 0);     /* no cpufreq */
+	g_assert_true(isnan(s->core[3].max_khz));
+	g_assert_cmpfloat(s->core[0].max_khz, ==, 4000000);
+	g_assert_cmpfloat_with_epsilon(s->temp[(s->head + CPU_MON_HIST - 1) % CPU_MON_HIST], 71.5, 1e-4);
+	cpu_sampler_close(s);
+	g_free(sys); g_free(proc);
+	g_free(root);
+}
+
+/* No hwmon chip that is known: the x86_pkg_temp thermal zone. */
+static void test_cpu_thermal_zone(void) {
+	char *root = cpu_test_tree(2, -1);
+	tree_put(root, "sys/class/hwmon/hwmon0/name", "nvme\n", -1);
+	tree_put(root, "sys/class/hwmon/hwmon0/temp1_input", "40000\n", -1);
+	tree_put(root, "sys/class/thermal/thermal_zone0/type", "acpitz\n", -1);
+	tree_put(root, "sys/class/thermal/thermal_zone0/temp", "30000\n", -1);
+	tree_put(root, "sys/class/thermal/thermal_zone2/type", "x86_pkg_temp\n", -1);
+	tree_put(root, "sys/class/thermal/thermal_zone2/temp", "64000\n", -1);
+	char *sys = g_build_filename(root, "sys", NULL);
+	CpuSampler *s = cpu_sampler_open(sys, root);              /* and no /proc/stat */
+	g_assert_nonnull(s);
+	g_assert_cmpint(s->stat_fd, <, 0);
+	cpu_sampler_sample(s);
+	g_assert_cmpfloat_with_epsilon(s->temp[0], 64.0, 1e-4);
+	cpu_sampler_close(s);
+	g_free(sys);
+	g_free(root);
+}
+
+static void cpu_bench_once(gpointer data) {
+	cpu_sampler_sample(data);
+}
+
+/* one tick on a 256-thread machine */
+static void test_cpu_bench(void) {
+	char *root = cpu_test_tree(256, -1);
+	guint64 busy[256], idle[256];
+	for (int i = 0; i < 256; i++) { busy[i] = 1000 + i; idle[i] = 90000 + i * 7; }
+	char *stat = cpu_test_stat(256, busy, idle, -1, 4000);
+	tree_put(root, "proc/stat", stat, -1);
+	g_free(stat);
+	char *sys = g_build_filename(root, "sys", NULL), *proc = g_build_filename(root, "proc", NULL);
+	CpuSampler *s = cpu_sampler_open(sys, proc);
+	g_assert_cmpint(s->n, ==, 256);
+	bench_run("sample 256 CPUs", cpu_bench_once, s, 2000);
+	cpu_sampler_close(s);
+	g_free(sys); g_free(proc);
+	g_free(root);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/cpu-mon/sample",       test_cpu_sample);
+	g_test_add_func("/cpu-mon/thermal-zone", test_cpu_thermal_zone);
+	g_test_add_func("/cpu-mon/bench",        test_cpu_bench);
+
+	return g_test_run();
+}
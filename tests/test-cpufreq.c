@@ -0,0 +1,169 @@
+/*
+ * test-cpufreq.c — power mode helper tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* mrsettings-cpufreq against a fake 256-CPU sysfs tree, both called
+ * directly and as the built program with --sysfs-root.  Needs no
+ * privileges. */
+#include "test-common.h"
+#define main cpufreq_helper_main
+#include "../mrsettings-cpufreq.c"
+#undef main
+
+#define CPUFREQ_TEST_N       256
+#define CPUFREQ_TEST_OFFLINE 200      /* no cpufreq directory */
+#define CPUFREQ_TEST_NO_EPP  100      /* acpi-cpufreq: no EPP */
+
+/* cpu0..cpu255 as intel_pstate leaves them in balanced mode, plus the
+ * neighbours a real cpu directory has */
+static char *cpufreq_test_tree(void) {
+	char *root = tree_new("cpu");
+	char path[64];
+	for (int i = 0; i < CPUFREQ_TEST_N; i++) {
+		if (i == CPUFREQ_TEST_OFFLINE) {
+			snprintf(path, sizeof(path), "cpu%d/online", i);
+			tree_put(root, path, "0\n", -1);
+			continue;
+		}
+		snprintf(path, sizeof(path), "cpu%d/cpufreq/scaling_governor", i);
+		tree_put(root, path, "powersave\n", -1);
+		if (i == CPUFREQ_TEST_NO_EPP) continue;
+		snprintf(path, sizeof(path), "cpu%d/cpufreq/energy_performance_preference", i);
+		tree_put(root, path, "balance_performance\n", -1);
+	}
+	tree_put(root, "cpuidle/current_driver", "intel_idle\n", -1);
+	tree_put(root, "cpufreq/boost", "1\n", -1);
+	tree_put(root, "online", "0-255\n", -1);
+	return root;
+}
+
+static char *cpufreq_test_read(const char *root, int cpu, const char *attr) {
+	char *path = g_strdup_printf("%s/cpu%d/cpufreq/%s", root, cpu, attr), *buf = NULL;
+	g_file_get_contents(path, &buf, NULL, NULL);
+	g_free(path);
+	return buf;
+}
+
+static void test_cpufreq_apply(void) {
+	char *root = cpufreq_test_tree();
+	GArray *res = cpufreq_apply(root, "powersave", "power");
+	g_assert_nonnull(res);
+	g_assert_cmpuint(res->len, ==, CPUFREQ_TEST_N);
+	for (guint i = 0; i < res->len; i++) {
+		CpufreqResult *r = &g_array_index(res, CpufreqResult, i);
+		g_assert_cmpint(r->cpu, ==, i);
+		g_assert_false(cpufreq_result_bad(r));
+		if (r->cpu == CPUFREQ_TEST_OFFLINE) {
+			g_assert_cmpstr(r->gov, ==, "absent");
+			continue;
+		}
+		g_assert_cmpstr(r->gov, ==, "ok");
+		g_assert_cmpstr(r->epp, ==, r->cpu == CPUFREQ_TEST_NO_EPP ? "absent" : "ok");
+		char *epp = cpufreq_test_read(root, r->cpu, "energy_performance_preference");
+		/* "balance_performance" is longer; nothing of it may be left */
+		if (epp) g_assert_cmpstr(epp, ==, "power");
+		g_free(epp);
+	}
+	g_array_unref(res);
+	g_free(root);
+}
+
+/* An attribute that can't be written fails its core and only its core. */
+static void test_cpufreq_error(void) {
+	char *root = cpufreq_test_tree();
+	char *epp = g_build_filename(root, "cpu7/cpufreq/energy_performance_preference", NULL);
+	g_assert_cmpint(unlink(epp), ==, 0);
+	g_assert_cmpint(mkdir(epp, 0755), ==, 0);
+	GArray *res = cpufreq_apply(root, "performance", "performance");
+	int bad = 0;
+	for (guint i = 0; i < res->len; i++)
+		bad += cpufreq_result_bad(&g_array_index(res, CpufreqResult, i));
+	g_assert_cmpint(bad, ==, 1);
+	CpufreqResult *r = &g_array_index(res, CpufreqResult, 7);
+	g_assert_cmpstr(r->gov, ==, "ok");
+	g_assert_true(g_str_has_prefix(r->epp, "error:"));
+	g_array_unref(res);
+	g_free(epp);
+	g_free(root);
+}
+
+/* The installed program: its report, exit codes, and no "default". */
+static void test_cpufreq_program(void) {
+	char *root = cpufreq_test_tree();
+	char *prog = g_test_build_filename(G_TEST_BUILT, "..", "mrsettings-cpufreq", NULL);
+	char *out = NULL, *argv[] = { prog, "performance", "balance_power", "--sysfs-root", root, NULL };
+	int status;
+	GError *err = NULL;
+	g_unsetenv("PKEXEC_UID");
+	g_spawn_sync(NULL, argv, NULL, G_SPAWN_DEFAULT, NULL, NULL, &out, NULL, &status, &err);
+	g_assert_no_error(err);
+	g_assert_true(WIFEXITED(status));
+	g_assert_cmpint(WEXITSTATUS(status), ==, 0);
+	char **lines = g_strsplit(out, "\n", -1);
+	g_assert_cmpuint(g_strv_length(lines), ==, CPUFREQ_TEST_N + 1);   /* trailing "" */
+	g_assert_cmpstr(lines[0], ==, "cpu0 ok ok");
+	g_assert_cmpstr(lines[CPUFREQ_TEST_NO_EPP], ==, "cpu100 ok absent");
+	g_assert_cmpstr(lines[CPUFREQ_TEST_OFFLINE], ==, "cpu200 absent absent");
+	g_strfreev(lines);
+	g_free(out);
+
+	argv[2] = "default";
+	g_spawn_sync(NULL, argv, NULL, G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &out, NULL, &status, &err);
+	g_assert_no_error(err);
+	g_assert_true(WIFEXITED(status));
+	g_assert_cmpint(WEXITSTATUS(status), ==, 2);
+	g_assert_cmpstr(out, ==, "");
+	char *gov = cpufreq_test_read(root, 0, "scaling_governor");
+	g_assert_cmpstr(gov, ==, "performance");        /* untouched */
+	g_free(gov);
+	g_free(out);
+	g_free(prog);
+	g_free(root);
+}
+
+typedef struct { char *root; int flip; } CpufreqBench;
+
+static void cpufreq_bench_once(gpointer data) {
+	CpufreqBench *b = data;
+	b->flip ^= 1;
+	GArray *res = b->flip ? cpufreq_apply(b->root, "performance", "performance")
+			      : cpufreq_apply(b->root, "powersave", "balance_performance");
+	g_array_unref(res);
+}
+
+/* One power mode change on a 256-thread machine.  The plain files of
+ * the fake tree cost more than sysfs attributes; well under the time a
+ * click should take either way. */
+static void test_cpufreq_bench(void) {
+	CpufreqBench b = { cpufreq_test_tree(), 0 };
+	bench_run("apply 256 CPUs", cpufreq_bench_once, &b, 150000);
+	g_free(b.root);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/cpufreq/apply-256", test_cpufreq_apply);
+	g_test_add_func("/cpufreq/error",     test_cpufreq_error);
+	g_test_add_func("/cpufreq/program",   test_cpufreq_program);
+	g_test_add_func("/cpufreq/bench",     test_cpufreq_bench);
+
+	return g_test_run();
+}
@@ -0,0 +1,275 @@
+/*
+ * test-datetime.c — timedate1 client and Date & Time page tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* A fake org.freedesktop.timedate1 is served from this process on a
+ * private bus (GTestDBus, so dbus-daemon must be installed) that stands
+ * in for the system bus.  It is a few lines of GDBus rather than
+ * python-dbusmock so `make check` needs nothing else.  The page tests
+ * need GTK and are skipped without a display.  Order matters: the
+ * no-bus tests run before the fake bus exists. */
+#include "test-common.h"
+
+#define TD_IFACE "org.freedesktop.timedate1"
+#define TD_PATH  "/org/freedesktop/timedate1"
+
+static const char td_fake_xml[] =
+	"<node><interface name='" TD_IFACE "'>"
+	"<property name='Timezone' type='s' access='read'/>"
+	"<property name='NTP' type='b' access='read'/>"
+	"<property name='CanNTP' type='b' access='read'/>"
+	"<method name='SetTimezone'><arg type='s' direction='in'/><arg type='b' direction='in'/></method>"
+	"<method name='SetNTP'><arg type='b' direction='in'/><arg type='b' direction='in'/></method>"
+	"<method name='SetTime'><arg type='x' direction='in'/><arg type='b' direction='in'/>"
+	"<arg type='b' direction='in'/></method>"
+	"</interface></node>";
+
+static struct {
+	GTestDBus       *bus;
+	GDBusConnection *conn;
+	char            *timezone;
+	gboolean         ntp;
+	int              set_time_calls;
+} fake;
+
+static GVariant *fake_get(GDBusConnection *c, const char *sender, const char *path,
+			  const char *iface, const char *prop, GError **err, gpointer ud) {
+	if (!strcmp(prop, "Timezone")) return g_variant_new_string(fake.timezone);
+	if (!strcmp(prop, "NTP"))      return g_variant_new_boolean(fake.ntp);
+	return g_variant_new_boolean(TRUE);
+}
+
+static void fake_changed(const char *prop, GVariant *value) {
+	GVariantBuilder b;
+	g_variant_builder_init(&b, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&b, "{sv}", prop, value);
+	g_dbus_connection_emit_signal(fake.conn, NULL, TD_PATH, "org.freedesktop.DBus.Properties",
+				      "PropertiesChanged",
+				      g_variant_new("(sa{sv}as)", TD_IFACE, &b, NULL), NULL);
+}
+
+static void fake_call(GDBusConnection *c, const char *sender, const char *path,
+		      const char *iface, const char *method, GVariant *args,
+		      GDBusMethodInvocation *inv, gpointer ud) {
+	if (!strcmp(method, "SetTimezone")) {
+		const char *tz;
+		g_variant_get(args, "(&sb)", &tz, NULL);
+		if (!g_str_has_prefix(tz, "Europe/")) {
+			g_dbus_method_invocation_return_dbus_error(inv, "org.freedesktop.timedate1.InvalidTimeZone",
+								   "Invalid or not installed time zone");
+			return;
+		}
+		g_free(fake.timezone);
+		fake.timezone = g_strdup(tz);
+		fake_changed("Timezone", g_variant_new_string(tz));
+	} else if (!strcmp(method, "SetNTP")) {
+		g_variant_get(args, "(bb)", &fake.ntp, NULL);
+		fake_changed("NTP", g_variant_new_boolean(fake.ntp));
+	} else {
+		fake.set_time_calls++;
+	}
+	g_dbus_method_invocation_return_value(inv, NULL);
+}
+
+static const GDBusInterfaceVTable fake_vtable = { fake_call, fake_get, NULL };
+
+/* Start the bus and the fake service once, and point the system bus
+ * at it. */
+static void fake_up(void) {
+	if (fake.bus) return;
+	fake.timezone = g_strdup("Europe/Istanbul");
+	fake.ntp = TRUE;
+	fake.bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+	g_test_dbus_up(fake.bus);
+	const char *addr = g_test_dbus_get_bus_address(fake.bus);
+	g_setenv("DBUS_SYSTEM_BUS_ADDRESS", addr, TRUE);
+
+	GError *err = NULL;
+	fake.conn = g_dbus_connection_new_for_address_sync(addr,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+		NULL, NULL, &err);
+	g_assert_no_error(err);
+	GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(td_fake_xml, &err);
+	g_assert_no_error(err);
+	g_dbus_connection_register_object(fake.conn, TD_PATH, node->interfaces[0],
+					  &fake_vtable, NULL, NULL, &err);
+	g_assert_no_error(err);
+	g_dbus_node_info_unref(node);
+	GVariant *r = g_dbus_connection_call_sync(fake.conn, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+						  "org.freedesktop.DBus", "RequestName",
+						  g_variant_new("(su)", TD_IFACE, 4 /* DO_NOT_QUEUE */),
+						  G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &err);
+	g_assert_no_error(err);
+	guint32 reply;
+	g_variant_get(r, "(u)", &reply);
+	g_assert_cmpuint(reply, ==, 1);                   /* primary owner */
+	g_variant_unref(r);
+}
+
+static int td_test_calls;
+static void td_test_record(gpointer ud) { td_test_calls++; }
+
+/* Iterate until *flag changes from `from`, failing after five seconds. */
+static void td_test_wait(const gboolean *flag, gboolean from) {
+	gint64 end = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+	while (*flag == from) {
+		g_assert_cmpint(g_get_monotonic_time(), <, end);
+		g_main_context_iteration(NULL, FALSE);
+		g_usleep(1000);
+	}
+}
+
+static void td_test_wait_calls(int n) {
+	gint64 end = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+	while (td_test_calls < n) {
+		g_assert_cmpint(g_get_monotonic_time(), <, end);
+		g_main_context_iteration(NULL, FALSE);
+		g_usleep(1000);
+	}
+}
+
+/* No system bus: the watches hear about it, and the next one retries. */
+static void test_td_no_bus(void) {
+	char *addr = g_strdup_printf("unix:path=%s/no-such-bus", g_get_user_cache_dir());
+	g_setenv("DBUS_SYSTEM_BUS_ADDRESS", addr, TRUE);
+	td_test_calls = 0;
+	g_test_expect_message(NULL, G_LOG_LEVEL_WARNING, "timedate1: *");
+	gpointer w = td_watch_add(td_test_record, NULL);
+	g_assert_true(td_requested);
+	td_test_wait(&td_requested, TRUE);
+	g_test_assert_expected_messages();
+	g_assert_cmpint(td_test_calls, ==, 1);
+	g_assert_null(td_proxy);
+	g_assert_nonnull(td_state.error);
+	g_assert_null(td_state.timezone);
+
+	g_test_expect_message(NULL, G_LOG_LEVEL_WARNING, "timedate1: *");
+	gpointer w2 = td_watch_add(td_test_record, NULL);
+	g_assert_true(td_requested);                      /* tried again */
+	g_assert_null(td_state.error);
+	td_test_wait(&td_requested, TRUE);
+	g_test_assert_expected_messages();
+	g_assert_nonnull(td_state.error);
+	g_assert_cmpint(td_test_calls, ==, 3);            /* both watches */
+	td_watch_remove(w2);
+	td_watch_remove(w);
+	g_free(addr);
+}
+
+/* The page says so, and mapping it again connects once a bus exists. */
+static void test_td_page_no_bus(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	g_assert_null(td_proxy);
+	char *addr = g_strdup_printf("unix:path=%s/no-such-bus", g_get_user_cache_dir());
+	g_setenv("DBUS_SYSTEM_BUS_ADDRESS", addr, TRUE);
+	g_test_expect_message(NULL, G_LOG_LEVEL_WARNING, "timedate1: *");
+	GtkWidget *page = g_object_ref_sink(datetime_settings());
+	td_test_wait(&td_requested, TRUE);
+	g_test_assert_expected_messages();
+	g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(dt_tz_label)), ==, "Unknown");
+	g_assert_true(g_str_has_prefix(gtk_label_get_text(GTK_LABEL(dt_status)),
+				       "The time and date service is not available: "));
+
+	fake_up();
+	dt_page_mapped(page, NULL);
+	g_assert_true(td_requested);
+	while (!td_state.timezone) g_main_context_iteration(NULL, TRUE);
+	g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(dt_tz_label)), ==, "Europe/Istanbul");
+	g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(dt_status)), ==, "");
+	g_object_unref(page);
+	g_assert_null(dt_status);
+	g_free(addr);
+}
+
+/* State comes from the property cache and follows PropertiesChanged;
+ * a refused call leaves it alone. */
+static void test_td_fake(void) {
+	fake_up();
+	td_test_calls = 0;
+	gpointer w = td_watch_add(td_test_record, NULL);
+	td_test_wait_calls(1);                            /* at once if the page test connected */
+	g_assert_nonnull(td_proxy);
+	g_assert_cmpstr(td_state.timezone, ==, "Europe/Istanbul");
+	g_assert_true(td_state.ntp);
+	g_assert_true(td_state.can_ntp);
+
+	td_call("SetNTP", g_variant_new("(bb)", FALSE, TRUE), "change automatic time", NULL);
+	td_test_wait(&td_state.ntp, TRUE);
+	td_call("SetTimezone", g_variant_new("(sb)", "Europe/Berlin", TRUE), "set the timezone", NULL);
+	while (strcmp(td_state.timezone, "Europe/Berlin")) g_main_context_iteration(NULL, TRUE);
+
+	int n = td_test_calls;
+	td_call("SetTimezone", g_variant_new("(sb)", "Mars/Olympus", TRUE), "set the timezone", NULL);
+	td_test_wait_calls(n + 1);                        /* td_call_done resyncs */
+	g_assert_cmpstr(td_state.timezone, ==, "Europe/Berlin");
+
+	td_call("SetNTP", g_variant_new("(bb)", TRUE, TRUE), "change automatic time", NULL);
+	td_test_wait(&td_state.ntp, FALSE);
+	td_watch_remove(w);
+}
+
+/* NTP going off resets the manual controls to the current time. */
+static void test_td_page_ntp_off(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	fake_up();
+	if (!fake.ntp) {
+		td_call("SetNTP", g_variant_new("(bb)", TRUE, TRUE), "change automatic time", NULL);
+		td_test_wait(&td_state.ntp, FALSE);
+	}
+	GtkWidget *page = g_object_ref_sink(datetime_settings());
+	while (!dt_zone) g_main_context_iteration(NULL, TRUE);
+	g_assert_false(gtk_widget_get_sensitive(dt_manual_row));
+
+	GDateTime *now = g_date_time_new_now(dt_zone);
+	int hour = g_date_time_get_hour(now);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(dt_hour), (hour + 5) % 24);
+	g_date_time_unref(now);
+
+	gtk_switch_set_active(GTK_SWITCH(dt_ntp_switch), FALSE);       /* calls SetNTP */
+	td_test_wait(&td_state.ntp, TRUE);
+	g_assert_false(fake.ntp);
+	g_assert_true(gtk_widget_get_sensitive(dt_manual_row));
+	now = g_date_time_new_now(dt_zone);
+	int shown = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dt_hour));
+	g_assert_true(shown == hour || shown == g_date_time_get_hour(now));
+	g_date_time_unref(now);
+
+	int before = fake.set_time_calls;
+	dt_set_time(NULL, NULL);
+	while (fake.set_time_calls == before) g_main_context_iteration(NULL, TRUE);
+	g_object_unref(page);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/datetime/no-bus",       test_td_no_bus);
+	g_test_add_func("/datetime/page-no-bus",  test_td_page_no_bus);
+	g_test_add_func("/datetime/timedated",    test_td_fake);
+	g_test_add_func("/datetime/page-ntp-off", test_td_page_ntp_off);
+
+	int ret = g_test_run();
+	if (fake.bus) {
+		g_clear_object(&fake.conn);
+		g_test_dbus_down(fake.bus);
+		g_object_unref(fake.bus);
+	}
+	return ret;
+}
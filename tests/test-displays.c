@@ -0,0 +1,258 @@
+/*
+ * test-displays.c — Displays page tests and canvas benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The arrangement canvas and the Placement lists on a made-up set of
+ * monitors, and the page after a hotplug with a fake xrandr on PATH.
+ * They need GTK, so they run under Xvfb in `make check` and are skipped
+ * without a display. */
+#include "test-common.h"
+
+/* n monitors of 1920x1080 side by side, the first n_active switched on */
+static DispData *disp_test_data(int n, int n_active) {
+	DispData *dd = g_new0(DispData, 1);
+	dd->n_monitors = n;
+	dd->monitors   = g_new0(DispMonitor, n);
+	dd->tab_btns   = g_new0(GtkWidget *, n);
+	dd->mon_stack  = g_object_ref_sink(gtk_stack_new());
+	for (int i = 0; i < n; i++) {
+		DispMonitor *m = &dd->monitors[i];
+		g_snprintf(m->name, sizeof(m->name), "DP-%d", i + 1);
+		g_snprintf(m->label, sizeof(m->label), "Monitor %d", i + 1);
+		m->connected = TRUE;
+		m->active = i < n_active;
+		m->w = 1920; m->h = 1080; m->x = i * 1920;
+		m->refresh = 60.0;
+		m->modes = g_new0(char *, 1);
+		m->modes[0] = g_strdup("1920x1080 @ 60.00 Hz");
+		m->n_modes = 1;
+		gtk_stack_add_named(GTK_STACK(dd->mon_stack), gtk_label_new(NULL), m->name);
+	}
+	return dd;
+}
+
+static void disp_test_free(DispData *dd) {
+	g_object_unref(dd->mon_stack);
+	disp_free_monitors(dd->monitors, dd->n_monitors);
+	g_free(dd->tab_btns);
+	g_free(dd);
+}
+
+static GtkStringList *disp_test_pos_list(DispData *dd, int idx) {
+	static const char *dirs[] = { "Right of", "Left of", "Above", "Below" };
+	GtkStringList *sl = gtk_string_list_new(NULL);
+	for (int i = 0; i < dd->n_monitors; i++) {
+		if (i == idx || !dd->monitors[i].active) continue;
+		for (int d = 0; d < 4; d++) {
+			char *e = g_strdup_printf("%s %s", dirs[d], dd->monitors[i].name);
+			gtk_string_list_append(sl, e);
+			g_free(e);
+		}
+	}
+	return sl;
+}
+
+/* ------------------------------------------------------------------ */
+/* Placement entries                                                    */
+/* ------------------------------------------------------------------ */
+/* The list is built with the panel; switching a monitor on later must
+ * not shift what the other entries mean. */
+static void test_disp_pos_entry(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	DispData *dd = disp_test_data(3, 2);
+	GtkStringList *sl = disp_test_pos_list(dd, 1);    /* "... DP-1" only */
+	GListModel *model = G_LIST_MODEL(sl);
+	g_assert_cmpuint(g_list_model_get_n_items(model), ==, 4);
+
+	g_assert_cmpuint(disp_pos_entry(dd, 1, model), ==, 0);   /* Right of DP-1 */
+
+	/* DP-3 comes on left of DP-1, and DP-2 moves above DP-3 alone */
+	dd->monitors[2].active = TRUE;
+	dd->monitors[2].x = 0;
+	dd->monitors[0].x = 1920;
+	dd->monitors[1].x = 0; dd->monitors[1].y = -1080;
+	g_assert_cmpuint(disp_pos_entry(dd, 1, model), ==, GTK_INVALID_LIST_POSITION);
+
+	/* and next to DP-1 again: found by name, not by counting */
+	dd->monitors[1].x = 3840; dd->monitors[1].y = 0;
+	g_assert_cmpuint(disp_pos_entry(dd, 1, model), ==, 0);
+	dd->monitors[1].x = 1920; dd->monitors[1].y = -1080;
+	g_assert_cmpuint(disp_pos_entry(dd, 1, model), ==, 2);   /* Above DP-1 */
+
+	g_object_unref(sl);
+	disp_test_free(dd);
+}
+
+/* ------------------------------------------------------------------ */
+/* dragging with 6 monitors                                             */
+/* ------------------------------------------------------------------ */
+typedef struct {
+	DispData  *dd;
+	DispCanvas *dc;
+	int        step;
+} DispBench;
+
+/* one frame of a drag: the pointer moves, the monitor snaps, and the
+ * canvas is snapshotted into a render node */
+static void disp_bench_frame(gpointer data) {
+	DispBench *b = data;
+	double ox = 40.0 * sin(b->step * 0.3), oy = 25.0 * cos(b->step * 0.2);
+	b->step++;
+	disp_canvas_drag_update(NULL, ox, oy, b->dc);
+	GtkSnapshot *s = gtk_snapshot_new();
+	disp_canvas_snapshot(GTK_WIDGET(b->dc), s);
+	GskRenderNode *node = gtk_snapshot_free_to_node(s);
+	g_assert_nonnull(node);
+	gsk_render_node_unref(node);
+}
+
+static void disp_bench_relayout(gpointer data) {
+	DispBench *b = data;
+	disp_canvas_relayout(b->dc);
+}
+
+static void test_disp_bench_drag(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	DispBench b = { .dd = disp_test_data(6, 6) };
+	for (int i = 0; i < 6; i++) {                      /* two rows of three */
+		b.dd->monitors[i].x = (i % 3) * 1920;
+		b.dd->monitors[i].y = (i / 3) * 1080;
+	}
+	GtkWidget *win = gtk_window_new();
+	GtkWidget *canvas = disp_canvas_new(b.dd);
+	b.dd->canvas = canvas;
+	gtk_widget_set_size_request(canvas, 900, 400);
+	gtk_window_set_child(GTK_WINDOW(win), canvas);
+	gtk_window_present(GTK_WINDOW(win));
+	while (gtk_widget_get_width(canvas) == 0) g_main_context_iteration(NULL, TRUE);
+	b.dc = DISP_CANVAS(canvas);
+
+	/* grab the middle of the fifth monitor */
+	disp_canvas_relayout(b.dc);
+	graphene_rect_t *r = &b.dc->items[4].rect;
+	disp_canvas_drag_begin(NULL, r->origin.x + r->size.width / 2,
+			       r->origin.y + r->size.height / 2, b.dc);
+	g_assert_cmpint(b.dc->drag_idx, ==, 4);
+	/* a 60 Hz frame is 16.7 ms; a drag frame should be a small part of it */
+	bench_run("drag frame, 6 monitors", disp_bench_frame, &b, 1000);
+	disp_canvas_drag_end(NULL, 0, 0, b.dc);
+	g_assert_cmpint(b.dc->drag_idx, ==, -1);
+	/* a model change costs a relayout; dragging must not */
+	bench_run("relayout, 6 monitors", disp_bench_relayout, &b, 5000);
+
+	gtk_window_destroy(GTK_WINDOW(win));
+	while (g_main_context_iteration(NULL, FALSE));
+	disp_test_free(b.dd);
+}
+
+/* ------------------------------------------------------------------ */
+/* hotplug with the page open                                           */
+/* ------------------------------------------------------------------ */
+#define DISP_TEST_SCREEN "Screen 0: minimum 8 x 8, current 5760 x 1080, maximum 32767 x 32767\n"
+#define DISP_TEST_EDP    "eDP-1 connected primary 1920x1080+0+0 (normal left inverted right x axis y axis) 344mm x 194mm\n" \
+			 "   1920x1080     60.00*+  48.00\n"
+#define DISP_TEST_HDMI   "HDMI-1 connected 1920x1080+%d+0 (normal left inverted right x axis y axis) 527mm x 296mm\n" \
+			 "   1920x1080     60.00*+  50.00\n   1280x720      60.00\n"
+#define DISP_TEST_DP     "DP-2 connected 1920x1080+1920+0 (normal left inverted right x axis y axis) 527mm x 296mm\n" \
+			 "   1920x1080     60.00*+\n"
+
+/* An xrandr that prints whatever disp_test_xrandr last wrote */
+static char *disp_test_fake_xrandr(void) {
+	char *root = tree_new("fake-xrandr"), *out = g_build_filename(root, "query", NULL);
+	char *script = g_strdup_printf("#!/bin/sh\nexec cat '%s'\n", out);
+	tree_put(root, "bin/xrandr", script, -1);
+	char *bin = g_build_filename(root, "bin", NULL), *exe = g_build_filename(bin, "xrandr", NULL);
+	g_assert_cmpint(chmod(exe, 0755), ==, 0);
+	char *path = g_strdup_printf("%s:%s", bin, g_getenv("PATH"));
+	g_setenv("PATH", path, TRUE);
+	g_free(path); g_free(exe); g_free(bin); g_free(script); g_free(root);
+	return out;
+}
+
+static void disp_test_xrandr(const char *out, const char *text) {
+	GError *err = NULL;
+	g_file_set_contents(out, text, -1, &err);
+	g_assert_no_error(err);
+}
+
+/* The settled screen change goes through disp_profile_apply with no
+ * saved profile; the open page must show the new set, keep the monitor
+ * that was selected, and drop out of the list when destroyed. */
+static void test_disp_hotplug_page(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	GdkDisplay *gd = gdk_display_get_default();
+	if (!GDK_IS_X11_DISPLAY(gd)) { g_test_skip("needs an X display"); return; }
+	Display *xd = gdk_x11_display_get_xdisplay(gd);
+	char *out = disp_test_fake_xrandr();
+	disp_test_xrandr(out, DISP_TEST_SCREEN DISP_TEST_EDP);
+
+	GtkWidget *page = g_object_ref_sink(displays_settings());
+	g_assert_nonnull(disp_pages);
+	DispData *dd = disp_pages->data;
+	g_assert_true(dd->root == page);
+	g_assert_cmpint(dd->n_monitors, ==, 1);
+
+	char *two = g_strdup_printf(DISP_TEST_SCREEN DISP_TEST_EDP DISP_TEST_HDMI, 1920);
+	disp_test_xrandr(out, two);
+	g_clear_pointer(&disp_hotplug_setup, g_free);         /* a set not seen before */
+	g_assert_false(disp_profile_apply(xd, g_get_monotonic_time()));
+	g_assert_cmpint(dd->n_monitors, ==, 2);
+	g_assert_cmpstr(dd->monitors[1].name, ==, "HDMI-1");
+	g_assert_cmpint(dd->monitors[1].n_modes, ==, 2);
+	g_assert_nonnull(gtk_stack_get_child_by_name(GTK_STACK(dd->mon_stack), "HDMI-1"));
+	g_assert_true(gtk_widget_get_parent(dd->body) == page);
+
+	/* select HDMI-1; DP-2 comes in ahead of it in xrandr's order */
+	disp_select_monitor(dd, 1);
+	char *three = g_strdup_printf(DISP_TEST_SCREEN DISP_TEST_EDP DISP_TEST_DP DISP_TEST_HDMI, 3840);
+	disp_test_xrandr(out, three);
+	g_clear_pointer(&disp_hotplug_setup, g_free);
+	disp_profile_apply(xd, g_get_monotonic_time());
+	g_assert_cmpint(dd->n_monitors, ==, 3);
+	g_assert_cmpstr(dd->monitors[dd->selected].name, ==, "HDMI-1");
+	g_assert_cmpint(dd->monitors[dd->selected].x, ==, 3840);
+	g_assert_cmpstr(gtk_stack_get_visible_child_name(GTK_STACK(dd->mon_stack)), ==, "HDMI-1");
+
+	/* the same set again is not a hotplug: the page is left alone */
+	GtkWidget *body = dd->body;
+	disp_profile_apply(xd, g_get_monotonic_time());
+	g_assert_true(dd->body == body);
+
+	/* HDMI-1 unplugged: back to the first monitor */
+	disp_test_xrandr(out, DISP_TEST_SCREEN DISP_TEST_EDP);
+	g_clear_pointer(&disp_hotplug_setup, g_free);
+	disp_profile_apply(xd, g_get_monotonic_time());
+	g_assert_cmpint(dd->n_monitors, ==, 1);
+	g_assert_cmpint(dd->selected, ==, 0);
+
+	g_object_unref(page);
+	g_assert_null(disp_pages);
+	g_free(three); g_free(two); g_free(out);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/displays/pos-entry",     test_disp_pos_entry);
+	g_test_add_func("/displays/bench-drag",    test_disp_bench_drag);
+	g_test_add_func("/displays/hotplug-page",  test_disp_hotplug_page);
+
+	return g_test_run();
+}
@@ -0,0 +1,237 @@
+/*
+ * test-edid.c — EDID parser and monitor identification tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The blobs in tests/fixtures/edid are base blocks laid out like those
+ * of the panels they are named after, plus two broken ones.  The sysfs tests build a fake
+ * /sys/class/drm; the RandR comparison needs an X display and is
+ * skipped without one. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* EDID                                                                 */
+/* ------------------------------------------------------------------ */
+static gboolean edid_parse_fixture(const char *name, DispEdid *e) {
+	gsize len;
+	char *raw = fixture_read("edid", name, &len);
+	gboolean ok = disp_edid_parse((const guint8 *)raw, len, e);
+	g_free(raw);
+	return ok;
+}
+
+static void test_edid_desktop(void) {
+	DispEdid e;
+	g_assert_true(edid_parse_fixture("dell-u2415.bin", &e));
+	g_assert_true(e.valid);
+	g_assert_cmpstr(e.vendor, ==, "DEL");
+	g_assert_cmpuint(e.product, ==, 0xa0b1);
+	g_assert_cmpstr(e.model, ==, "DELL U2415");
+	g_assert_cmpstr(e.serial, ==, "CFV9N5B61ABL");   /* text descriptor wins */
+	g_assert_cmpint(e.pref_w, ==, 1920);
+	g_assert_cmpint(e.pref_h, ==, 1200);
+	g_assert_cmpfloat_with_epsilon(e.pref_rr, 59.950, 0.001);
+	g_assert_cmpint(e.mm_w, ==, 518);                 /* from the timing, not the cm field */
+	g_assert_cmpint(e.mm_h, ==, 324);
+	g_assert_cmpstr(e.key, ==, "648e6d7e3c81882b");
+}
+
+static void test_edid_laptop(void) {
+	DispEdid e;
+	g_assert_true(edid_parse_fixture("boe-nv156fhm.bin", &e));
+	g_assert_cmpstr(e.vendor, ==, "BOE");
+	g_assert_cmpstr(e.model, ==, "");                 /* 0xfe text is not a name */
+	g_assert_cmpstr(e.serial, ==, "");
+	g_assert_cmpint(e.pref_w, ==, 1920);
+	g_assert_cmpint(e.pref_h, ==, 1080);
+	g_assert_cmpfloat_with_epsilon(e.pref_rr, 59.918, 0.001);
+	g_assert_cmpint(e.mm_w, ==, 344);
+	g_assert_cmpint(e.mm_h, ==, 193);
+}
+
+static void test_edid_numeric_serial(void) {
+	DispEdid e;
+	g_assert_true(edid_parse_fixture("lg-ultrafine.bin", &e));
+	g_assert_cmpstr(e.vendor, ==, "GSM");
+	g_assert_cmpstr(e.model, ==, "LG ULTRAFINE");
+	g_assert_cmpstr(e.serial, ==, "12345");
+	g_assert_cmpint(e.pref_w, ==, 3840);
+	g_assert_cmpint(e.pref_h, ==, 2160);
+	g_assert_cmpfloat_with_epsilon(e.pref_rr, 59.997, 0.001);
+}
+
+/* two units of one model differ only in serial; their keys must too */
+static void test_edid_key_per_unit(void) {
+	DispEdid a, b, c;
+	g_assert_true(edid_parse_fixture("dell-u2415.bin", &a));
+	g_assert_true(edid_parse_fixture("dell-u2415-second.bin", &b));
+	g_assert_true(edid_parse_fixture("dell-u2415.bin", &c));
+	g_assert_cmpstr(a.model, ==, b.model);
+	g_assert_cmpstr(a.key, !=, b.key);
+	g_assert_cmpstr(a.key, ==, c.key);
+}
+
+static void test_edid_rejects(void) {
+	DispEdid e;
+	g_assert_false(edid_parse_fixture("bad-checksum.bin", &e));
+	g_assert_false(e.valid);
+	g_assert_false(edid_parse_fixture("truncated.bin", &e));
+	guint8 zero[128] = { 0 };
+	g_assert_false(disp_edid_parse(zero, sizeof(zero), &e));
+}
+
+/* ------------------------------------------------------------------ */
+/* DRM sysfs lookup                                                     */
+/* ------------------------------------------------------------------ */
+/* card<c>-<conn> with the given status, connector_id and EDID fixture */
+static void drm_put(const char *root, int card, const char *conn, long id, const char *fixture) {
+	char dir[64], val[32];
+	g_snprintf(dir, sizeof(dir), "card%d-%s", card, conn);
+	char *path = g_build_filename(dir, "status", NULL);
+	tree_put(root, path, fixture ? "connected\n" : "disconnected\n", -1);
+	g_free(path);
+	g_snprintf(val, sizeof(val), "%ld\n", id);
+	path = g_build_filename(dir, "connector_id", NULL);
+	tree_put(root, path, val, -1);
+	g_free(path);
+	gsize len = 0;
+	char *blob = fixture ? fixture_read("edid", fixture, &len) : g_strdup("");
+	path = g_build_filename(dir, "edid", NULL);
+	tree_put(root, path, blob, len);
+	g_free(path);
+	g_free(blob);
+}
+
+static void test_edid_sysfs_single(void) {
+	char *root = tree_new("drm");
+	drm_put(root, 0, "eDP-1", 95, "boe-nv156fhm.bin");
+	drm_put(root, 0, "HDMI-A-1", 103, NULL);
+	DispEdid e;
+	g_assert_true(disp_edid_from_sysfs(root, "eDP-1", 0, &e));
+	g_assert_cmpstr(e.vendor, ==, "BOE");
+	g_assert_false(disp_edid_from_sysfs(root, "HDMI-1", 0, &e));      /* nothing plugged in */
+	g_assert_false(disp_edid_from_sysfs(root, "DP-1", 0, &e));
+	g_free(root);
+}
+
+/* Two GPUs, each with a monitor on its first HDMI port: RandR calls
+ * both HDMI-1 (give or take a provider suffix), so only the connector
+ * id can tell them apart. */
+static void test_edid_sysfs_two_gpus(void) {
+	char *root = tree_new("drm");
+	drm_put(root, 0, "HDMI-A-1", 77, "dell-u2415.bin");
+	drm_put(root, 1, "HDMI-A-1", 77 + 40, "dell-u2415-second.bin");
+	DispEdid a, b, e;
+	g_assert_true(edid_parse_fixture("dell-u2415.bin", &a));
+	g_assert_true(edid_parse_fixture("dell-u2415-second.bin", &b));
+
+	g_assert_true(disp_edid_from_sysfs(root, "HDMI-1", 77, &e));
+	g_assert_cmpstr(e.key, ==, a.key);
+	g_assert_true(disp_edid_from_sysfs(root, "HDMI-1", 117, &e));
+	g_assert_cmpstr(e.key, ==, b.key);
+	g_assert_false(disp_edid_from_sysfs(root, "HDMI-1", 5, &e));       /* no such connector */
+
+	/* without an id the match is ambiguous and must not pick one */
+	g_assert_false(disp_edid_from_sysfs(root, "HDMI-1", 0, &e));
+	g_assert_false(e.valid);
+	g_free(root);
+}
+
+/* ------------------------------------------------------------------ */
+/* enumeration cost                                                     */
+/* ------------------------------------------------------------------ */
+typedef struct {
+	char *root;
+	long  ids[8];
+	char  outputs[8][16];
+} EdidBench;
+
+static void edid_bench_sysfs(gpointer data) {
+	EdidBench *b = data;
+	for (int i = 0; i < 8; i++) {
+		DispEdid e;
+		g_assert_true(disp_edid_from_sysfs(b->root, b->outputs[i], b->ids[i], &e));
+	}
+}
+
+/* a docked laptop with two GPUs: 2 x 4 connected connectors */
+static void test_edid_bench_sysfs(void) {
+	static const char *conns[] = { "eDP-1", "HDMI-A-1", "DP-1", "DP-2" };
+	static const char *names[] = { "eDP-1", "HDMI-1",   "DP-1", "DP-2" };
+	static const char *blobs[] = { "boe-nv156fhm.bin", "dell-u2415.bin",
+				       "dell-u2415-second.bin", "lg-ultrafine.bin" };
+	EdidBench b = { .root = tree_new("drm") };
+	for (int card = 0; card < 2; card++)
+		for (int i = 0; i < 4; i++) {
+			int k = card * 4 + i;
+			b.ids[k] = 70 + k;
+			g_snprintf(b.outputs[k], sizeof(b.outputs[k]), "%s", names[i]);
+			drm_put(b.root, card, conns[i], b.ids[k], blobs[i]);
+		}
+	bench_run("identify 8 outputs from sysfs", edid_bench_sysfs, &b, 2000);
+	g_free(b.root);
+}
+
+static void edid_bench_randr(gpointer data) {
+	int n = 0;
+	g_free(disp_connected_ids(data, &n));
+}
+
+static void edid_bench_xrandr_verbose(gpointer data) {
+	const char *argv[] = { data, "--verbose", NULL };
+	char *out = NULL;
+	int status = 0;
+	g_assert_true(g_spawn_sync(NULL, (char **)argv, NULL, G_SPAWN_STDERR_TO_DEV_NULL,
+				   NULL, NULL, &out, NULL, &status, NULL));
+	g_free(out);
+}
+
+/* The in-process enumeration (RandR properties, EDIDs parsed here) next
+ * to the `xrandr --verbose` it replaces, on whatever X server runs the
+ * tests. */
+static void test_edid_bench_randr(void) {
+	char *xrandr = g_find_program_in_path("xrandr");
+	GdkDisplay *gd = xrandr && gtk_init_check() ? gdk_display_get_default() : NULL;
+	if (!gd || !GDK_IS_X11_DISPLAY(gd)) {
+		g_test_skip("needs an X display and xrandr");
+		g_free(xrandr);
+		return;
+	}
+	Display *xd = gdk_x11_display_get_xdisplay(gd);
+	double ours = bench_run("identify outputs through RandR", edid_bench_randr, xd, 5000);
+	double theirs = bench_run("xrandr --verbose", edid_bench_xrandr_verbose, xrandr, 1e6);
+	if (g_test_perf()) g_assert_cmpfloat(ours, <, theirs);
+	g_free(xrandr);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/edid/desktop",           test_edid_desktop);
+	g_test_add_func("/edid/laptop",            test_edid_laptop);
+	g_test_add_func("/edid/numeric-serial",    test_edid_numeric_serial);
+	g_test_add_func("/edid/key-per-unit",      test_edid_key_per_unit);
+	g_test_add_func("/edid/rejects",           test_edid_rejects);
+	g_test_add_func("/edid/sysfs-single",      test_edid_sysfs_single);
+	g_test_add_func("/edid/sysfs-two-gpus",    test_edid_sysfs_two_gpus);
+	g_test_add_func("/edid/bench-sysfs",       test_edid_bench_sysfs);
+	g_test_add_func("/edid/bench-randr",       test_edid_bench_randr);
+
+	return g_test_run();
+}
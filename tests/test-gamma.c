@@ -0,0 +1,181 @@
+/*
+ * test-gamma.c — gamma ramp tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Ramp generation is pure arithmetic.  The upload and CRTC tests use
+ * the X server's own gamma tables, so they run under Xvfb in `make
+ * check` and are skipped without a display. */
+#include "test-common.h"
+
+static void test_gamma_whitepoint(void) {
+	double wp[3], prev[3] = { 1, 1, 1 };
+	gamma_whitepoint(GAMMA_NEUTRAL_K, wp);
+	for (int c = 0; c < 3; c++) g_assert_cmpfloat_with_epsilon(wp[c], 1.0, 1e-9);
+
+	/* warmer: red stays, green and blue fall, blue fastest */
+	for (double k = 6000; k >= 1000; k -= 500) {
+		gamma_whitepoint(k, wp);
+		g_assert_cmpfloat(wp[0], ==, 1.0);
+		g_assert_cmpfloat(wp[1], <=, prev[1]);
+		g_assert_cmpfloat(wp[2], <=, prev[2]);
+		g_assert_cmpfloat(wp[2], <=, wp[1]);
+		memcpy(prev, wp, sizeof(wp));
+	}
+	g_assert_cmpfloat(wp[2], ==, 0.0);                      /* 1000 K: no blue */
+
+	double lo[3];
+	gamma_whitepoint(100, lo);                              /* clamped to 1000 K */
+	for (int c = 0; c < 3; c++) g_assert_cmpfloat(lo[c], ==, wp[c]);
+
+	gamma_whitepoint(10000, wp);                            /* cooler: blue clipped at 1 */
+	g_assert_cmpfloat(wp[2], ==, 1.0);
+	g_assert_cmpfloat(wp[0], <, 1.0);
+}
+
+static void test_gamma_fill_ramp(void) {
+	guint16 lut[256 * 3];
+	gamma_fill_ramp(lut, 256, 1.0, GAMMA_NEUTRAL_K);
+	for (int c = 0; c < 3; c++)                             /* identity */
+		for (int i = 0; i < 256; i++) g_assert_cmpuint(lut[c * 256 + i], ==, i * 257);
+
+	gamma_fill_ramp(lut, 256, 0.5, GAMMA_NEUTRAL_K);
+	g_assert_cmpuint(lut[0], ==, 0);
+	g_assert_cmpuint(lut[255], ==, 32768);
+
+	double wp[3];
+	gamma_whitepoint(3400, wp);
+	gamma_fill_ramp(lut, 256, 0.8, 3400);
+	for (int c = 0; c < 3; c++) {
+		const guint16 *ch = lut + c * 256;
+		g_assert_cmpuint(ch[0], ==, 0);
+		g_assert_cmpuint(ch[255], ==, (guint)(65535.0 * 0.8 * wp[c] + 0.5));
+		for (int i = 1; i < 256; i++) g_assert_cmpuint(ch[i], >=, ch[i - 1]);
+	}
+	g_assert_cmpuint(lut[255], >, lut[256 + 255]);          /* red > green > blue */
+	g_assert_cmpuint(lut[256 + 255], >, lut[512 + 255]);
+
+	gamma_fill_ramp(lut, 256, 1.7, GAMMA_NEUTRAL_K);        /* brightness clamped */
+	g_assert_cmpuint(lut[255], ==, 65535);
+	gamma_fill_ramp(lut, 1, 1.0, GAMMA_NEUTRAL_K);          /* degenerate size */
+	g_assert_cmpuint(lut[0], ==, 0);
+}
+
+typedef struct {
+	guint16 lut[4096 * 3];
+	double  kelvin;
+} GammaBench;
+
+static void gamma_bench_once(gpointer data) {
+	GammaBench *b = data;
+	b->kelvin = b->kelvin > 6000 ? 2000 : b->kelvin + 37;  /* a new ramp every call */
+	gamma_fill_ramp(b->lut, 4096, 0.9, b->kelvin);
+}
+
+/* a 4096-entry ramp, the largest gamma size current drivers report */
+static void test_gamma_bench(void) {
+	GammaBench *b = g_new0(GammaBench, 1);
+	b->kelvin = 2000;
+	bench_run("ramp, 4096 entries", gamma_bench_once, b, 100);
+	g_free(b);
+}
+
+/* ------------------------------------------------------------------ */
+/* uploaded to the server                                               */
+/* ------------------------------------------------------------------ */
+static gboolean gamma_test_display(void) {
+	g_mutex_lock(&gamma_lock);
+	gboolean ok = gamma_init_locked() && gamma_n_crtcs > 0;
+	g_mutex_unlock(&gamma_lock);
+	if (!ok) g_test_skip("needs an X display with RandR gamma");
+	return ok;
+}
+
+/* what the server holds for crtc matches a freshly filled ramp */
+static void gamma_test_expect(RRCrtc crtc, double brightness, double kelvin) {
+	XSync(gamma_dpy, False);
+	XRRCrtcGamma *g = XRRGetCrtcGamma(gamma_dpy, crtc);
+	g_assert_nonnull(g);
+	guint16 *want = g_new(guint16, g->size * 3);
+	gamma_fill_ramp(want, g->size, brightness, kelvin);
+	for (int i = 0; i < g->size; i++) {
+		g_assert_cmpuint(g->red[i],   ==, want[i]);
+		g_assert_cmpuint(g->green[i], ==, want[g->size + i]);
+		g_assert_cmpuint(g->blue[i],  ==, want[g->size * 2 + i]);
+	}
+	g_free(want);
+	XRRFreeGamma(g);
+}
+
+static void test_gamma_x11_upload(void) {
+	if (!gamma_test_display()) return;
+	RRCrtc crtc = gamma_crtcs[0].crtc;
+	g_assert_true(gamma_set_brightness(crtc, 0.7));
+	gamma_set_kelvin(4000);
+	gamma_test_expect(crtc, 0.7, 4000);
+	g_assert_false(gamma_set_brightness(0, 0.5));          /* not a CRTC */
+	gamma_set_kelvin(GAMMA_NEUTRAL_K);
+	g_assert_true(gamma_set_brightness(crtc, 1.0));
+	gamma_test_expect(crtc, 1.0, GAMMA_NEUTRAL_K);
+}
+
+/* A list read before the monitor appeared is refreshed; the CRTC keeps
+ * its brightness and gets the ramp again even though the key matches. */
+static void test_gamma_x11_reenumerate(void) {
+	if (!gamma_test_display()) return;
+	RRCrtc crtc = gamma_crtcs[0].crtc;
+	gamma_set_kelvin(3000);
+	g_assert_true(gamma_set_brightness(crtc, 0.6));
+
+	g_mutex_lock(&gamma_lock);
+	int n = gamma_n_crtcs;
+	gamma_n_crtcs = 0;                                      /* stale: no CRTCs yet */
+	g_mutex_unlock(&gamma_lock);
+	g_assert_false(gamma_set_brightness(crtc, 0.6));
+
+	XRRCrtcGamma *flat = XRRAllocGamma(gamma_crtcs[0].size); /* as a mode set leaves it */
+	XRRSetCrtcGamma(gamma_dpy, crtc, flat);
+	XRRFreeGamma(flat);
+
+	g_mutex_lock(&gamma_lock);
+	gamma_n_crtcs = n;
+	gamma_enumerate_locked();
+	g_assert_cmpint(gamma_n_crtcs, ==, n);
+	g_assert_cmpfloat(gamma_crtcs[0].brightness, ==, 0.6);
+	g_assert_null(gamma_crtcs[0].lut);
+	g_assert_false(gamma_changed_locked());
+	g_mutex_unlock(&gamma_lock);
+
+	gamma_set_kelvin(3000);
+	gamma_test_expect(crtc, 0.6, 3000);
+	gamma_set_kelvin(GAMMA_NEUTRAL_K);
+	g_assert_true(gamma_set_brightness(crtc, 1.0));
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/gamma/whitepoint",      test_gamma_whitepoint);
+	g_test_add_func("/gamma/fill-ramp",       test_gamma_fill_ramp);
+	g_test_add_func("/gamma/bench",           test_gamma_bench);
+	g_test_add_func("/gamma/x11/upload",      test_gamma_x11_upload);
+	g_test_add_func("/gamma/x11/reenumerate", test_gamma_x11_reenumerate);
+
+	return g_test_run();
+}
@@ -0,0 +1,211 @@
+/*
+ * test-grp-index.c — group membership index tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The index is built from the group(5) and passwd(5) fixtures with
+ * fgetgrent/fgetpwent, and getgrouplist is replaced by a table, so the
+ * NSS sources of the machine running the tests do not matter. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* fake initgroups                                                      */
+/* ------------------------------------------------------------------ */
+static int initgroups_calls;
+
+/* Like getgrouplist: fills what fits, returns -1 and the needed size
+ * when the buffer is short.  Only the users named here have groups
+ * outside the fixtures. */
+static int fake_initgroups(const char *user, gid_t gid, gid_t *groups, int *ngroups) {
+	gid_t all[64];
+	int n = 0;
+	all[n++] = gid;
+	if (strcmp(user, "erin") == 0)  all[n++] = 63;
+	if (strcmp(user, "frank") == 0) all[n++] = 100;
+	if (strcmp(user, "gina") == 0)
+		for (int i = 0; i < 40; i++) all[n++] = 2000 + i;
+	initgroups_calls++;
+	int fit = MIN(n, *ngroups);
+	memcpy(groups, all, fit * sizeof(gid_t));
+	int ret = n <= *ngroups ? n : -1;
+	*ngroups = n;
+	return ret;
+}
+
+static GrpIndex *grp_fixture(void) {
+	char *gpath = fixture_path("", "group"), *ppath = fixture_path("", "passwd");
+	FILE *gf = fopen(gpath, "r"), *pf = fopen(ppath, "r");
+	g_assert_nonnull(gf);
+	g_assert_nonnull(pf);
+	GrpIndex *gi = grp_index_new_from(gf, pf);
+	gi->initgroups = fake_initgroups;
+	initgroups_calls = 0;
+	fclose(gf); fclose(pf);
+	g_free(gpath); g_free(ppath);
+	return gi;
+}
+
+static struct passwd grp_user(const char *name, gid_t gid) {
+	return (struct passwd){ .pw_name = (char *)name, .pw_gid = gid };
+}
+
+static gboolean grp_has(GArray *a, gid_t gid) {
+	for (guint i = 0; i < a->len; i++) if (g_array_index(a, gid_t, i) == gid) return TRUE;
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+/* group index                                                          */
+/* ------------------------------------------------------------------ */
+static void test_grp_index_entries(void) {
+	GrpIndex *gi = grp_fixture();
+	g_assert_cmpuint(gi->groups->len, ==, 8);
+	GrpEntry *w = g_hash_table_lookup(gi->by_name, "wheel");
+	g_assert_nonnull(w);
+	g_assert_cmpuint(w->gid, ==, 10);
+	g_assert_cmpuint(g_strv_length(w->mem), ==, 2);
+	g_assert_true(g_hash_table_lookup(gi->by_gid, GUINT_TO_POINTER(63)) ==
+		      g_hash_table_lookup(gi->by_name, "audio"));
+	g_assert_cmpstr(((GrpEntry *)g_ptr_array_index(gi->groups, 0))->name, ==, "root");
+	g_assert_cmpuint(g_hash_table_size(gi->local), ==, 6);
+	grp_index_free(gi);
+}
+
+/* local users whose primary group is indexed are answered from the files */
+static void test_grp_index_membership(void) {
+	GrpIndex *gi = grp_fixture();
+	struct passwd alice = grp_user("alice", 1000), bob = grp_user("bob", 1001),
+		      carol = grp_user("carol", 1002), dave = grp_user("dave", 4998);
+
+	GArray *a = grp_index_user(gi, &alice);
+	g_assert_cmpuint(a->len, ==, 2);                  /* in group file order */
+	g_assert_cmpuint(g_array_index(a, gid_t, 0), ==, 10);
+	g_assert_cmpuint(g_array_index(a, gid_t, 1), ==, 63);
+
+	g_assert_true (grp_index_user_in(gi, &alice, "wheel"));
+	g_assert_false(grp_index_user_in(gi, &bob,   "wheel"));
+	g_assert_true (grp_index_user_in(gi, &bob,   "audio"));
+	g_assert_true (grp_index_user_in(gi, &carol, "wheel"));
+	g_assert_false(grp_index_user_in(gi, &dave,  "wheel"));
+	g_assert_true (grp_index_user_in(gi, &dave,  "staff"));   /* primary group */
+
+	/* a user with no memberships is cached as an empty list */
+	GArray *d = grp_index_user(gi, &dave);
+	g_assert_cmpuint(d->len, ==, 0);
+	g_assert_true(grp_index_user(gi, &dave) == d);
+	g_assert_cmpint(initgroups_calls, ==, 0);
+	grp_index_free(gi);
+}
+
+/* Everyone else goes to initgroups once: a directory user whose primary
+ * group happens to be enumerated, and a local user whose is not. */
+static void test_grp_index_fallback(void) {
+	GrpIndex *gi = grp_fixture();
+	struct passwd erin = grp_user("erin", 10), frank = grp_user("frank", 5000),
+		      gina = grp_user("gina", 100);
+
+	g_assert_true (grp_index_user_in(gi, &erin, "audio"));
+	g_assert_cmpint(initgroups_calls, ==, 1);
+	g_assert_true (grp_index_user_in(gi, &erin, "wheel"));   /* primary group */
+	g_assert_false(grp_index_user_in(gi, &erin, "users"));
+	g_assert_cmpint(initgroups_calls, ==, 1);               /* cached */
+
+	GArray *f = grp_index_user(gi, &frank);
+	g_assert_cmpuint(f->len, ==, 1);                        /* primary not repeated */
+	g_assert_true(grp_has(f, 100));
+	g_assert_true(grp_index_user_in(gi, &frank, "users"));
+	g_assert_cmpint(initgroups_calls, ==, 2);
+
+	/* more groups than the first buffer holds */
+	GArray *g = grp_index_user(gi, &gina);
+	g_assert_cmpuint(g->len, ==, 40);
+	g_assert_true(grp_has(g, 2000));
+	g_assert_true(grp_has(g, 2039));
+	g_assert_cmpint(initgroups_calls, ==, 4);
+	grp_index_free(gi);
+}
+
+/* ------------------------------------------------------------------ */
+/* 10,000 users                                                         */
+/* ------------------------------------------------------------------ */
+/* Every user has a personal group and belongs to one of 247 shared
+ * groups; every tenth is in wheel.  All are local, so nothing reaches
+ * initgroups.  One run builds the index and answers the admin check for
+ * every user, which is what opening Users & Groups costs. */
+#define GRP_BENCH_USERS 10000
+
+typedef struct {
+	char *group, *passwd;
+} GrpBench;
+
+static void grp_bench_run(gpointer data) {
+	GrpBench *b = data;
+	FILE *gf = fopen(b->group, "r"), *pf = fopen(b->passwd, "r");
+	GrpIndex *gi = grp_index_new_from(gf, pf);
+	gi->initgroups = fake_initgroups;
+	fclose(gf); fclose(pf);
+	int admins = 0;
+	for (int i = 0; i < GRP_BENCH_USERS; i++) {
+		char name[16];
+		g_snprintf(name, sizeof(name), "u%05d", i);
+		struct passwd pw = grp_user(name, 20000 + i);
+		admins += grp_index_user_in(gi, &pw, "wheel");
+	}
+	g_assert_cmpint(admins, ==, GRP_BENCH_USERS / 10);
+	grp_index_free(gi);
+}
+
+static void test_grp_index_bench(void) {
+	char *root = tree_new("nss");
+	GString *grp = g_string_new("wheel:x:10:"), *pw = g_string_new(NULL);
+	for (int i = 0; i < GRP_BENCH_USERS; i += 10)
+		g_string_append_printf(grp, "%su%05d", i ? "," : "", i);
+	g_string_append_c(grp, '\n');
+	for (int s = 0; s < 247; s++) {
+		g_string_append_printf(grp, "shared%03d:x:%d:", s, 3000 + s);
+		for (int i = s; i < GRP_BENCH_USERS; i += 247)
+			g_string_append_printf(grp, "%su%05d", i == s ? "" : ",", i);
+		g_string_append_c(grp, '\n');
+	}
+	for (int i = 0; i < GRP_BENCH_USERS; i++) {
+		g_string_append_printf(grp, "u%05d:x:%d:\n", i, 20000 + i);
+		g_string_append_printf(pw, "u%05d:x:%d:%d::/home/u%05d:/bin/sh\n",
+				       i, 20000 + i, 20000 + i, i);
+	}
+	tree_put(root, "group", grp->str, grp->len);
+	tree_put(root, "passwd", pw->str, pw->len);
+	GrpBench b = { g_build_filename(root, "group", NULL), g_build_filename(root, "passwd", NULL) };
+	initgroups_calls = 0;
+	bench_run("index 10,000 users and check wheel", grp_bench_run, &b, 50000);
+	g_assert_cmpint(initgroups_calls, ==, 0);
+	g_free(b.group); g_free(b.passwd);
+	g_string_free(grp, TRUE); g_string_free(pw, TRUE);
+	g_free(root);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/grp-index/entries",      test_grp_index_entries);
+	g_test_add_func("/grp-index/membership",   test_grp_index_membership);
+	g_test_add_func("/grp-index/fallback",     test_grp_index_fallback);
+	g_test_add_func("/grp-index/bench",        test_grp_index_bench);
+
+	return g_test_run();
+}
@@ -0,0 +1,125 @@
+/*
+ * test-kbd-repeat.c — key repeat persistence and X server tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Persistence needs nothing; the /kbd-repeat/x11 tests talk to the X
+ * server in $DISPLAY (`make check` starts Xvfb when there is none) and
+ * are skipped without one. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* key repeat persistence                                               */
+/* ------------------------------------------------------------------ */
+/* G_TEST_OPTION_ISOLATE_DIRS gives every test its own XDG_CONFIG_HOME */
+static void test_kbd_repeat_unsaved(void) {
+	KbdRepeat r = { TRUE, 123, 45 };
+	g_assert_false(kbd_repeat_load(&r));
+	g_assert_cmpint(r.delay_ms, ==, 123);             /* untouched */
+}
+
+static void test_kbd_repeat_round_trip(void) {
+	const KbdRepeat cases[] = {
+		{ TRUE,  250, 30 },
+		{ FALSE, KBD_REPEAT_MAX_DELAY, KBD_REPEAT_MIN_RATE },
+		{ TRUE,  KBD_REPEAT_MIN_DELAY, KBD_REPEAT_MAX_RATE },
+	};
+	for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+		KbdRepeat r = { 0 };
+		kbd_repeat_save(&cases[i]);
+		g_assert_true(kbd_repeat_load(&r));
+		g_assert_cmpint(r.enabled,  ==, cases[i].enabled);
+		g_assert_cmpint(r.delay_ms, ==, cases[i].delay_ms);
+		g_assert_cmpint(r.rate,     ==, cases[i].rate);
+	}
+}
+
+static void test_kbd_repeat_hand_edited(void) {
+	char *path = kbd_repeat_path(), *dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+	g_assert_true(g_file_set_contents(path, "[Repeat]\nDelay=5\nRate=500\n", -1, NULL));
+	KbdRepeat r = { 0 };
+	g_assert_true(kbd_repeat_load(&r));
+	g_assert_true(r.enabled);                          /* missing key means on */
+	g_assert_cmpint(r.delay_ms, ==, KBD_REPEAT_MIN_DELAY);
+	g_assert_cmpint(r.rate,     ==, KBD_REPEAT_MAX_RATE);
+	g_free(dir); g_free(path);
+}
+
+/* ------------------------------------------------------------------ */
+/* applied to the server                                                */
+/* ------------------------------------------------------------------ */
+static Display *kbd_test_display(KbdRepeat *orig) {
+	Display *xd = XOpenDisplay(NULL);
+	if (!xd) g_test_skip("needs an X display");
+	else kbd_repeat_read(xd, orig);
+	return xd;
+}
+
+static void kbd_test_expect(Display *xd, const KbdRepeat *want) {
+	KbdRepeat got = { 0 };
+	XSync(xd, False);
+	kbd_repeat_read(xd, &got);
+	g_assert_cmpint(got.enabled,  ==, want->enabled);
+	g_assert_cmpint(got.delay_ms, ==, want->delay_ms);
+	g_assert_cmpint(got.rate,     ==, want->rate);
+}
+
+static void test_kbd_repeat_x11_apply(void) {
+	KbdRepeat orig;
+	Display *xd = kbd_test_display(&orig);
+	if (!xd) return;
+	const KbdRepeat cases[] = {
+		{ TRUE,  300, 25 },
+		{ TRUE,  KBD_REPEAT_MIN_DELAY, 50 },
+		{ FALSE, 500, 10 },
+		{ TRUE,  660, 30 },                        /* 33 ms interval rounds back */
+	};
+	for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+		kbd_repeat_apply(xd, &cases[i]);
+		kbd_test_expect(xd, &cases[i]);
+	}
+	kbd_repeat_apply(xd, &orig);
+	XCloseDisplay(xd);
+}
+
+/* what xinitrc runs at session start: saved settings reach the server */
+static void test_kbd_repeat_x11_apply_saved(void) {
+	KbdRepeat orig;
+	Display *xd = kbd_test_display(&orig);
+	if (!xd) return;
+	const KbdRepeat saved = { TRUE, 420, 40 };
+	kbd_repeat_save(&saved);
+	g_assert_cmpint(kbd_apply_saved_main(), ==, 0);
+	kbd_test_expect(xd, &saved);
+	kbd_repeat_apply(xd, &orig);
+	XCloseDisplay(xd);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/kbd-repeat/unsaved",         test_kbd_repeat_unsaved);
+	g_test_add_func("/kbd-repeat/round-trip",      test_kbd_repeat_round_trip);
+	g_test_add_func("/kbd-repeat/hand-edited",     test_kbd_repeat_hand_edited);
+	g_test_add_func("/kbd-repeat/x11/apply",       test_kbd_repeat_x11_apply);
+	g_test_add_func("/kbd-repeat/x11/apply-saved", test_kbd_repeat_x11_apply_saved);
+
+	return g_test_run();
+}
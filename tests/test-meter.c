@@ -0,0 +1,167 @@
+/*
+ * test-meter.c — level meter and spectrum tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The FFT is checked against a plain DFT of the same windowed samples.
+ * The idle-tick test needs GTK for a frame clock and is skipped without
+ * a display; no sound server is involved. */
+#include "test-common.h"
+
+/* |DFT|^2 of the Hann-windowed x, the slow way */
+static void meter_test_dft(const SndFftPlan *p, const float *x, double *pw) {
+	for (int k = 0; k < SND_FFT_M; k++) {
+		double re = 0, im = 0;
+		for (int n = 0; n < SND_FFT_N; n++) {
+			double a = -2 * M_PI * (double)k * n / SND_FFT_N, v = x[n] * p->win[n];
+			re += v * cos(a); im += v * sin(a);
+		}
+		pw[k] = re * re + im * im;
+	}
+}
+
+static void test_meter_fft_dft(void) {
+	SndFftPlan *p = g_new(SndFftPlan, 1);
+	snd_fft_plan_init(p);
+	float x[SND_FFT_N], pw[SND_FFT_M];
+	double *ref = g_new(double, SND_FFT_M), max = 0;
+	for (int n = 0; n < SND_FFT_N; n++)                      /* two tones and noise */
+		x[n] = 0.5f * sinf(2 * M_PI * 37.3 * n / SND_FFT_N) + 0.2f * cosf(2 * M_PI * 301 * n / SND_FFT_N)
+		       + 0.05f * (float)g_test_rand_double_range(-1, 1);
+	snd_fft_power(p, x, pw);
+	meter_test_dft(p, x, ref);
+	for (int k = 0; k < SND_FFT_M; k++) max = MAX(max, ref[k]);
+	for (int k = 0; k < SND_FFT_M; k++)
+		g_assert_cmpfloat(fabs(pw[k] - ref[k]), <=, 1e-4 * max);
+	g_free(ref);
+	g_free(p);
+}
+
+/* A full-scale sine on a bin is a full bar; the Hann window spreads it
+ * to the two neighbours at a quarter of the power and no further.  The
+ * window is the symmetric one (N-1), hence the loose epsilons. */
+static void test_meter_fft_sine(void) {
+	SndFftPlan *p = g_new(SndFftPlan, 1);
+	snd_fft_plan_init(p);
+	float x[SND_FFT_N], pw[SND_FFT_M], bars[SND_SPEC_BARS];
+	const int k0 = 64;                                      /* 1.5 kHz */
+	for (int n = 0; n < SND_FFT_N; n++) x[n] = sinf(2 * M_PI * k0 * n / SND_FFT_N);
+	snd_fft_power(p, x, pw);
+	const float norm = 1.0f / ((SND_FFT_N / 4.0f) * (SND_FFT_N / 4.0f));
+	g_assert_cmpfloat_with_epsilon(pw[k0] * norm, 1.0, 5e-3);
+	g_assert_cmpfloat_with_epsilon(pw[k0 - 1] * norm, 0.25, 5e-3);
+	g_assert_cmpfloat_with_epsilon(pw[k0 + 1] * norm, 0.25, 5e-3);
+	for (int k = 0; k < SND_FFT_M; k++)
+		if (abs(k - k0) > 1) g_assert_cmpfloat(pw[k] * norm, <, 1e-6);
+
+	snd_fft_bars(p, pw, bars);
+	int lit = 0;
+	for (int b = 0; b < SND_SPEC_BARS; b++) {
+		gboolean has = p->band[b] <= k0 && k0 < p->band[b + 1];
+		if (has) g_assert_cmpfloat_with_epsilon(bars[b], 1.0, 1e-3);
+		lit += bars[b] > 0;
+	}
+	g_assert_cmpint(lit, <=, 2);                            /* k0's band, maybe a neighbour's */
+
+	for (int n = 0; n < SND_FFT_N; n++) x[n] = 0.0005f * sinf(2 * M_PI * k0 * n / SND_FFT_N);
+	snd_fft_power(p, x, pw);
+	snd_fft_bars(p, pw, bars);
+	for (int b = 0; b < SND_SPEC_BARS; b++) g_assert_cmpfloat(bars[b], ==, 0);   /* below -60 dB */
+	g_free(p);
+}
+
+/* bands from 40 Hz to Nyquist, in order, each at least one bin */
+static void test_meter_bands(void) {
+	SndFftPlan *p = g_new(SndFftPlan, 1);
+	snd_fft_plan_init(p);
+	g_assert_cmpint(p->band[0], ==, (int)(40.0 * SND_FFT_N / SND_SPEC_RATE));
+	g_assert_cmpint(p->band[SND_SPEC_BARS], ==, SND_FFT_M);
+	for (int b = 0; b < SND_SPEC_BARS; b++) g_assert_cmpint(p->band[b], <, p->band[b + 1]);
+	g_free(p);
+}
+
+typedef struct {
+	SndFftPlan *p;
+	float x[SND_FFT_N], pw[SND_FFT_M], bars[SND_SPEC_BARS];
+} MeterBench;
+
+static void meter_bench_once(gpointer data) {
+	MeterBench *b = data;
+	snd_fft_power(b->p, b->x, b->pw);
+	snd_fft_bars(b->p, b->pw, b->bars);
+}
+
+/* one spectrum window, as the worker does it about 23 times a second */
+static void test_meter_bench(void) {
+	MeterBench *b = g_new0(MeterBench, 1);
+	b->p = g_new(SndFftPlan, 1);
+	snd_fft_plan_init(b->p);
+	for (int n = 0; n < SND_FFT_N; n++) b->x[n] = (float)g_test_rand_double_range(-1, 1);
+	bench_run("fft+bands, 1024 samples", meter_bench_once, b, 100);
+	g_free(b->p);
+	g_free(b);
+}
+
+/* The tick runs while the level falls, removes itself at zero, and a
+ * peak above the floor brings it back. */
+static void test_meter_idle_tick(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	GtkWidget *win = gtk_window_new();
+	GtkWidget *w = snd_meter_new(NULL, NULL);
+	SndMeter *m = SND_METER(w);
+	gtk_window_set_child(GTK_WINDOW(win), w);
+	gtk_window_present(GTK_WINDOW(win));
+	while (!gtk_widget_get_mapped(w)) g_main_context_iteration(NULL, TRUE);
+	g_assert_cmpuint(m->tick, ==, 0);                      /* no source: never started */
+
+	m->in_peak = 0.0005f;                                   /* below the floor */
+	if (snd_meter_pos(m->in_peak) > 0) snd_meter_wake(m);
+	g_assert_cmpuint(m->tick, ==, 0);
+
+	m->in_peak = 0.5f;
+	snd_meter_wake(m);
+	g_assert_cmpuint(m->tick, !=, 0);
+	gint64 end = g_get_monotonic_time() + 10 * G_USEC_PER_SEC;
+	gboolean rose = FALSE;
+	while (m->tick) {
+		g_assert_cmpint(g_get_monotonic_time(), <, end);
+		g_main_context_iteration(NULL, TRUE);
+		rose |= m->level > 0.5f;
+	}
+	g_assert_true(rose);
+	g_assert_cmpfloat(m->level, ==, 0);
+	g_assert_cmpfloat(m->hold, ==, 0);
+
+	m->in_peak = 0.1f;
+	snd_meter_wake(m);
+	g_assert_cmpuint(m->tick, !=, 0);
+	gtk_window_destroy(GTK_WINDOW(win));
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/meter/fft-dft",   test_meter_fft_dft);
+	g_test_add_func("/meter/fft-sine",  test_meter_fft_sine);
+	g_test_add_func("/meter/bands",     test_meter_bands);
+	g_test_add_func("/meter/bench",     test_meter_bench);
+	g_test_add_func("/meter/idle-tick", test_meter_idle_tick);
+
+	return g_test_run();
+}
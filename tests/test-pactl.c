@@ -0,0 +1,190 @@
+/*
+ * test-pactl.c — `pactl list` parser tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Recorded output from a laptop with a USB headset, and synthetic
+ * 100-device listings.  No sound server is needed. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* pactl list sinks|sources                                             */
+/* ------------------------------------------------------------------ */
+static void test_pactl_sinks(void) {
+	gsize len;
+	char *raw = fixture_read("pactl", "sinks.txt", &len);
+	int n = 0;
+	SndDevice *d = snd_parse_pactl(raw, len, "Sink #",
+				       "alsa_output.usb-GN_Netcom_A_S_Jabra_Link_380-00.analog-stereo", &n);
+	g_assert_cmpint(n, ==, 2);
+
+	g_assert_cmpuint(d[0].index, ==, 47);
+	g_assert_cmpstr(d[0].name, ==, "alsa_output.pci-0000_00_1f.3.analog-stereo");
+	g_assert_cmpstr(d[0].desc, ==, "Built-in Audio Analog Stereo");
+	g_assert_cmpint(d[0].volume, ==, 65);
+	g_assert_false(d[0].muted);
+	g_assert_false(d[0].is_default);
+	g_assert_cmpstr(d[0].monitor, ==, "alsa_output.pci-0000_00_1f.3.analog-stereo.monitor");
+	g_assert_cmpstr(d[0].active_port, ==, "analog-output-speaker");
+	/* properties and formats share the port indent but are not ports */
+	g_assert_cmpint(d[0].n_ports, ==, 2);
+	g_assert_cmpstr(d[0].ports[0], ==, "analog-output-speaker");
+	g_assert_cmpstr(d[0].ports[1], ==, "analog-output-headphones");
+	g_assert_null(d[0].ports[2]);
+
+	g_assert_cmpuint(d[1].index, ==, 63);
+	g_assert_cmpstr(d[1].desc, ==, "Jabra Link 380: Analog Stereo");
+	g_assert_cmpint(d[1].volume, ==, 100);
+	g_assert_true(d[1].muted);
+	g_assert_true(d[1].is_default);
+	g_assert_cmpint(d[1].n_ports, ==, 1);
+	g_assert_cmpstr(d[1].active_port, ==, "analog-output");
+
+	snd_free_devices(d, n);
+	g_free(raw);
+}
+
+static void test_pactl_sources(void) {
+	gsize len;
+	char *raw = fixture_read("pactl", "sources.txt", &len);
+	int n = 0;
+	SndDevice *d = snd_parse_pactl(raw, len, "Source #", "alsa_input.pci-0000_00_1f.3.analog-stereo", &n);
+	g_assert_cmpint(n, ==, 2);
+
+	g_assert_cmpuint(d[0].index, ==, 48);
+	g_assert_cmpstr(d[0].desc, ==, "Monitor of Built-in Audio Analog Stereo");
+	g_assert_cmpint(d[0].n_ports, ==, 0);
+	g_assert_cmpstr(d[0].active_port, ==, "");
+	g_assert_false(d[0].is_default);
+
+	g_assert_cmpuint(d[1].index, ==, 49);
+	g_assert_cmpint(d[1].volume, ==, 38);           /* not the 10% base volume */
+	g_assert_true(d[1].is_default);
+	g_assert_cmpint(d[1].n_ports, ==, 2);
+	g_assert_cmpstr(d[1].ports[1], ==, "analog-input-headset-mic");
+	g_assert_cmpstr(d[1].active_port, ==, "analog-input-internal-mic");
+
+	snd_free_devices(d, n);
+	g_free(raw);
+}
+
+static void test_pactl_wrong_header(void) {
+	gsize len;
+	char *raw = fixture_read("pactl", "sinks.txt", &len);
+	int n = -1;
+	SndDevice *d = snd_parse_pactl(raw, len, "Source #", NULL, &n);
+	g_assert_cmpint(n, ==, 0);
+	g_free(d);
+	d = snd_parse_pactl("", 0, "Sink #", NULL, &n);
+	g_assert_cmpint(n, ==, 0);
+	g_free(d);
+	g_free(raw);
+}
+
+/* sinks-100.txt follows a pattern: sink i has index 200+i, volume
+ * (i*7)%101, is muted when i%5 == 0 and has i%4 ports with the last one
+ * active.  Every fourth description is Cyrillic and every fourth has a
+ * colon in it. */
+static void test_pactl_sinks_100(void) {
+	gsize len;
+	char *raw = fixture_read("pactl", "sinks-100.txt", &len);
+	int n = 0;
+	SndDevice *d = snd_parse_pactl(raw, len, "Sink #", "alsa_output.synthetic-042.analog-stereo", &n);
+	g_assert_cmpint(n, ==, 100);
+
+	for (int i = 0; i < n; i++) {
+		char name[64], port[16];
+		g_snprintf(name, sizeof(name), "alsa_output.synthetic-%03d.analog-stereo", i);
+		g_assert_cmpuint(d[i].index, ==, 200 + i);
+		g_assert_cmpstr(d[i].name, ==, name);
+		g_assert_cmpint(d[i].volume, ==, (i * 7) % 101);
+		g_assert_cmpint(d[i].muted, ==, i % 5 == 0);
+		g_assert_cmpint(d[i].is_default, ==, i == 42);
+		g_assert_cmpint(d[i].n_ports, ==, i % 4);
+		g_snprintf(port, sizeof(port), "port-%d", i % 4 - 1);
+		g_assert_cmpstr(d[i].active_port, ==, i % 4 ? port : "");
+		g_assert_true(g_str_has_prefix(d[i].monitor, name));
+	}
+	g_assert_cmpstr(d[2].desc, ==, "HDMI / DisplayPort 2: Output");
+	g_assert_cmpstr(d[3].desc, ==, "Встроенное аудио 3");
+	g_assert_cmpstr(d[5].desc, ==, "Sortie analogique stéréo 5");
+
+	snd_free_devices(d, n);
+	g_free(raw);
+}
+
+/* even sources are monitors without ports, odd ones microphones with two */
+static void test_pactl_sources_100(void) {
+	gsize len;
+	char *raw = fixture_read("pactl", "sources-100.txt", &len);
+	int n = 0;
+	SndDevice *d = snd_parse_pactl(raw, len, "Source #", NULL, &n);
+	g_assert_cmpint(n, ==, 100);
+
+	for (int i = 0; i < n; i++) {
+		g_assert_cmpuint(d[i].index, ==, 400 + i);
+		g_assert_cmpint(d[i].volume, ==, (i * 13) % 101);
+		g_assert_cmpint(d[i].muted, ==, i % 3 == 0);
+		g_assert_false(d[i].is_default);
+		g_assert_cmpint(d[i].n_ports, ==, i % 2 ? 2 : 0);
+		g_assert_cmpstr(d[i].active_port, ==, i % 2 ? "analog-input-mic" : "");
+	}
+
+	snd_free_devices(d, n);
+	g_free(raw);
+}
+
+typedef struct {
+	char *raw;
+	gsize len;
+	const char *hdr;
+} PactlBench;
+
+static void pactl_bench_parse(gpointer data) {
+	PactlBench *b = data;
+	int n = 0;
+	SndDevice *d = snd_parse_pactl(b->raw, b->len, b->hdr, NULL, &n);
+	g_assert_cmpint(n, ==, 100);
+	snd_free_devices(d, n);
+}
+
+/* 100 devices is about 80 KiB of text; one parse should stay well under
+ * a millisecond so a refresh never shows up as a frame drop */
+static void test_pactl_bench(void) {
+	PactlBench sinks = { .hdr = "Sink #" }, sources = { .hdr = "Source #" };
+	sinks.raw = fixture_read("pactl", "sinks-100.txt", &sinks.len);
+	sources.raw = fixture_read("pactl", "sources-100.txt", &sources.len);
+	bench_run("parse 100 sinks", pactl_bench_parse, &sinks, 1000);
+	bench_run("parse 100 sources", pactl_bench_parse, &sources, 1000);
+	g_free(sinks.raw);
+	g_free(sources.raw);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/pactl/sinks",            test_pactl_sinks);
+	g_test_add_func("/pactl/sources",          test_pactl_sources);
+	g_test_add_func("/pactl/wrong-header",     test_pactl_wrong_header);
+	g_test_add_func("/pactl/sinks-100",        test_pactl_sinks_100);
+	g_test_add_func("/pactl/sources-100",      test_pactl_sources_100);
+	g_test_add_func("/pactl/bench",            test_pactl_bench);
+
+	return g_test_run();
+}
@@ -0,0 +1,189 @@
+/*
+ * test-snd-rows.c — sound device row refresh tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Needs a display (skipped without one).  Rows are built without a
+ * libpulse context, so slider moves go to a fake pactl on PATH that
+ * only logs its arguments. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* fixtures                                                             */
+/* ------------------------------------------------------------------ */
+static char *snd_test_ports[] = { "analog-output-speaker", "analog-output-headphones" };
+
+static void snd_test_dev(SndDevice *d, const char *name, int volume) {
+	memset(d, 0, sizeof(*d));
+	g_strlcpy(d->name, name, sizeof(d->name));
+	g_snprintf(d->desc, sizeof(d->desc), "Device %s", name);
+	d->volume = volume;
+	d->ports = snd_test_ports;
+	d->n_ports = G_N_ELEMENTS(snd_test_ports);
+	g_strlcpy(d->active_port, snd_test_ports[0], sizeof(d->active_port));
+}
+
+/* A pactl that appends its arguments to the returned log */
+static char *snd_test_fake_pactl(void) {
+	char *root = tree_new("fake-pactl"), *log = g_build_filename(root, "log", NULL);
+	char *script = g_strdup_printf("#!/bin/sh\necho \"$@\" >> '%s'\n", log);
+	tree_put(root, "bin/pactl", script, -1);
+	char *bin = g_build_filename(root, "bin", NULL), *exe = g_build_filename(bin, "pactl", NULL);
+	g_assert_cmpint(chmod(exe, 0755), ==, 0);
+	char *path = g_strdup_printf("%s:%s", bin, g_getenv("PATH"));
+	g_setenv("PATH", path, TRUE);
+	g_free(path); g_free(exe); g_free(bin); g_free(script); g_free(root);
+	return log;
+}
+
+static SndRow *snd_test_row(SndData *sd, const char *name) {
+	SndRow *row = g_hash_table_lookup(sd->out_rows, name);
+	g_assert_nonnull(row);
+	return row;
+}
+
+static int snd_test_value(SndRow *row) {
+	return (int)gtk_range_get_value(GTK_RANGE(row->scale));
+}
+
+/* Let the channel's pactl run and be reaped. */
+static void snd_test_settle(SndRow *row) {
+	gint64 end = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+	while ((row->vc->in_flight || row->vc->has_pending) && g_get_monotonic_time() < end)
+		g_main_context_iteration(NULL, TRUE);
+	g_assert_false(row->vc->in_flight);
+	g_assert_false(row->vc->has_pending);
+}
+
+/* ------------------------------------------------------------------ */
+/* refresh keeps rows                                                   */
+/* ------------------------------------------------------------------ */
+/* Drags on one device interleaved with refreshes carrying external
+ * volume changes for both: the dragged slider keeps the user's value,
+ * the other follows the server, and no row, slider or port dropdown is
+ * ever replaced. */
+static void test_snd_rows_drag_vs_external(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	char *log = snd_test_fake_pactl();
+	SndData sd = { 0 };
+	sd.out_list = g_object_ref_sink(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+	sd.out_rows = g_hash_table_new(g_str_hash, g_str_equal);
+
+	SndDevice devs[2];
+	snd_test_dev(&devs[0], "alsa_output.a", 40);
+	snd_test_dev(&devs[1], "alsa_output.b", 60);
+	snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+	SndRow *a = snd_test_row(&sd, "alsa_output.a"), *b = snd_test_row(&sd, "alsa_output.b");
+	GtkWidget *a_frame = a->frame, *a_scale = a->scale, *a_ports = a->port_dd, *b_frame = b->frame;
+	g_object_add_weak_pointer(G_OBJECT(a_frame), (gpointer *)&a_frame);
+	g_object_add_weak_pointer(G_OBJECT(b_frame), (gpointer *)&b_frame);
+	g_assert_cmpint(snd_test_value(a), ==, 40);
+
+	for (int i = 0; i < 50; i++) {
+		int user = 10 + i, ext = 90 - i;
+		/* press and move: what snd_scale_event and GtkRange do */
+		a->dragging = TRUE;
+		gtk_range_set_value(GTK_RANGE(a->scale), user);
+		/* the server reports something else for both meanwhile */
+		devs[0].volume = ext;
+		devs[1].volume = ext;
+		g_strlcpy(devs[0].active_port, snd_test_ports[i % 2], sizeof(devs[0].active_port));
+		snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+
+		g_assert_true(snd_test_row(&sd, "alsa_output.a") == a);
+		g_assert_true(snd_test_row(&sd, "alsa_output.b") == b);
+		g_assert_true(a->scale == a_scale && a->port_dd == a_ports);
+		g_assert_cmpint(snd_test_value(a), ==, user);          /* not snapped back */
+		g_assert_cmpint(snd_test_value(b), ==, ext);
+		g_assert_cmpuint(gtk_drop_down_get_selected(GTK_DROP_DOWN(a->port_dd)), ==, i % 2);
+
+		/* release; once the change is through, the server's value wins again */
+		a->dragging = FALSE;
+		snd_test_settle(a);
+		devs[0].volume = user;
+		snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+		g_assert_cmpint(snd_test_value(a), ==, user);
+	}
+	devs[0].volume = 33;
+	snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+	g_assert_cmpint(snd_test_value(a), ==, 33);
+
+	/* the last drag value reached pactl */
+	char *out = NULL;
+	g_assert_true(g_file_get_contents(log, &out, NULL, NULL));
+	g_assert_nonnull(strstr(out, "set-sink-volume alsa_output.a 59%"));
+	g_assert_null(strstr(out, "alsa_output.b"));           /* refreshes echo nothing */
+	g_free(out);
+
+	g_assert_nonnull(a_frame);
+	g_assert_nonnull(b_frame);
+	g_assert_true(gtk_widget_get_first_child(sd.out_list) == a_frame);
+	g_assert_true(gtk_widget_get_last_child(sd.out_list) == b_frame);
+
+	g_object_remove_weak_pointer(G_OBJECT(a_frame), (gpointer *)&a_frame);
+	g_object_remove_weak_pointer(G_OBJECT(b_frame), (gpointer *)&b_frame);
+	g_hash_table_unref(sd.out_rows);
+	g_object_unref(sd.out_list);
+	g_free(log);
+}
+
+/* Devices coming, going and moving: only the changed ones get rows. */
+static void test_snd_rows_add_remove(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	SndData sd = { 0 };
+	sd.out_list = g_object_ref_sink(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+	sd.out_rows = g_hash_table_new(g_str_hash, g_str_equal);
+
+	SndDevice devs[3];
+	snd_test_dev(&devs[0], "a", 10);
+	snd_test_dev(&devs[1], "b", 20);
+	snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+	SndRow *a = snd_test_row(&sd, "a");
+	GtkWidget *b_frame = snd_test_row(&sd, "b")->frame;
+	g_object_add_weak_pointer(G_OBJECT(b_frame), (gpointer *)&b_frame);
+
+	/* c arrives ahead of a, b goes */
+	snd_test_dev(&devs[0], "c", 30);
+	snd_test_dev(&devs[1], "a", 10);
+	g_strlcpy(devs[1].desc, "Renamed", sizeof(devs[1].desc));
+	snd_fill_box(&sd, sd.out_list, devs, 2, "sink");
+	g_assert_true(snd_test_row(&sd, "a") == a);
+	g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(a->desc_lbl)), ==, "Renamed");
+	g_assert_null(b_frame);
+	g_assert_null(g_hash_table_lookup(sd.out_rows, "b"));
+	g_assert_true(gtk_widget_get_first_child(sd.out_list) == snd_test_row(&sd, "c")->frame);
+	g_assert_true(gtk_widget_get_last_child(sd.out_list) == a->frame);
+	g_assert_cmpuint(g_hash_table_size(sd.out_rows), ==, 2);
+
+	snd_fill_box(&sd, sd.out_list, NULL, 0, "sink");
+	g_assert_cmpuint(g_hash_table_size(sd.out_rows), ==, 0);
+	g_assert_null(gtk_widget_get_first_child(sd.out_list));
+
+	g_hash_table_unref(sd.out_rows);
+	g_object_unref(sd.out_list);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/snd-rows/drag-vs-external", test_snd_rows_drag_vs_external);
+	g_test_add_func("/snd-rows/add-remove",       test_snd_rows_add_remove);
+
+	return g_test_run();
+}
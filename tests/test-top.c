@@ -0,0 +1,167 @@
+/*
+ * test-top.c — top consumers scanner tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The scanner runs against a synthetic /proc of stat and schedstat
+ * files.  The panel test needs GTK for its list and is skipped without
+ * a display. */
+#include "test-common.h"
+
+/* <pid>/stat with utime+stime = ticks, and <pid>/schedstat with
+ * `slices` timeslices */
+static void top_test_pid(const char *root, int pid, const char *comm, guint64 ticks, guint64 slices) {
+	char path[32], buf[256];
+	snprintf(path, sizeof(path), "%d/stat", pid);
+	snprintf(buf, sizeof(buf), "%d (%s) S 1 %d %d 0 -1 4194560 1200 0 3 0 %" G_GUINT64_FORMAT
+		 " %" G_GUINT64_FORMAT " 0 0 20 0 4 0 1234 0 0\n", pid, comm, pid, pid, ticks / 2, ticks - ticks / 2);
+	tree_put(root, path, buf, -1);
+	snprintf(path, sizeof(path), "%d/schedstat", pid);
+	snprintf(buf, sizeof(buf), "%" G_GUINT64_FORMAT " 1000 %" G_GUINT64_FORMAT "\n", ticks * 10000000, slices);
+	tree_put(root, path, buf, -1);
+}
+
+static const TopEntry *top_test_find(TopScanner *t, int pid) {
+	for (guint i = 0; i < t->out->len; i++)
+		if (g_array_index(t->out, TopEntry, i).pid == pid) return &g_array_index(t->out, TopEntry, i);
+	return NULL;
+}
+
+/* the pids the panel test and the scan test both use, before and after */
+static void top_test_tree(const char *root, gboolean after) {
+	top_test_pid(root, 100, "Web Content", after ? 150 : 100, 10);
+	top_test_pid(root, 200, "a) (b", after ? 120 : 100, 10);
+	top_test_pid(root, 300, "idle", 100, 10);
+	top_test_pid(root, 400, "make", after ? 600 : 400, after ? 310 : 10);
+	top_test_pid(root, 600, "reused", after ? 5 : 1000, 10);
+	if (after) top_test_pid(root, 500, "new", 900, 10);
+	else       top_test_pid(root, 1, "systemd", 50, 10);
+	tree_put(root, "self", "not a pid", -1);
+	tree_put(root, "stat", "cpu 1 2 3 4\n", -1);
+}
+
+static void test_top_scan(void) {
+	char *root = tree_new("proc");
+	top_test_tree(root, FALSE);
+	TopScanner *t = top_scanner_open(root);
+	g_assert_nonnull(t);
+	top_scan(t);
+	g_assert_cmpuint(t->out->len, ==, 0);            /* baseline */
+	g_assert_cmpuint(g_hash_table_size(t->prev), ==, 6);
+
+	char *gone = g_build_filename(root, "1", NULL);
+	char *stat = g_build_filename(gone, "stat", NULL), *sst = g_build_filename(gone, "schedstat", NULL);
+	g_assert_cmpint(unlink(stat), ==, 0);
+	g_assert_cmpint(unlink(sst), ==, 0);
+	g_assert_cmpint(rmdir(gone), ==, 0);
+	top_test_tree(root, TRUE);
+	g_usleep(10000);
+	top_scan(t);
+
+	/* moved: 400, 100, 200; not 300 (idle), 500 (new), 600 (reused) */
+	g_assert_cmpuint(t->out->len, ==, 3);
+	g_assert_cmpint(g_array_index(t->out, TopEntry, 0).pid, ==, 400);
+	g_assert_cmpint(g_array_index(t->out, TopEntry, 1).pid, ==, 100);
+	g_assert_cmpint(g_array_index(t->out, TopEntry, 2).pid, ==, 200);
+	g_assert_cmpuint(t->total_ticks, ==, 200 + 50 + 20);
+	const TopEntry *e = top_test_find(t, 100);
+	g_assert_cmpstr(e->comm, ==, "Web Content");
+	g_assert_cmpuint(e->d_ticks, ==, 50);
+	g_assert_cmpfloat(e->wakeups, ==, 0);
+	g_assert_cmpstr(top_test_find(t, 200)->comm, ==, "a) (b");
+	e = top_test_find(t, 400);
+	g_assert_cmpfloat(e->wakeups, >, 0);
+	g_assert_cmpfloat(e->cpu, >, top_test_find(t, 100)->cpu);
+	/* 1 is swept, 500 is remembered */
+	g_assert_false(g_hash_table_contains(t->prev, GINT_TO_POINTER(1)));
+	g_assert_true(g_hash_table_contains(t->prev, GINT_TO_POINTER(500)));
+	top_scanner_close(t);
+	g_free(stat); g_free(sst); g_free(gone);
+	g_free(root);
+}
+
+static void top_bench_once(gpointer data) {
+	top_scan(data);
+}
+
+/* one pass over a busy desktop's worth of processes */
+static void test_top_bench(void) {
+	char *root = tree_new("proc");
+	for (int i = 0; i < 1000; i++)
+		top_test_pid(root, 1000 + i, "worker", i * 3, i);
+	TopScanner *t = top_scanner_open(root);
+	bench_run("scan 1000 pids", top_bench_once, t, 10000);
+	g_assert_cmpuint(g_hash_table_size(t->prev), ==, 1000);
+	top_scanner_close(t);
+	g_free(root);
+}
+
+static void top_test_wait(TopPanel *tp) {
+	while (tp->scanning) g_main_context_iteration(NULL, TRUE);
+}
+
+/* Scans run off the main thread and come back to the list; one that
+ * outlives its mapping, or the panel, is dropped. */
+static void test_top_panel(void) {
+	if (!gtk_init_check()) { g_test_skip("needs a display"); return; }
+	char *root = tree_new("proc");
+	top_test_tree(root, FALSE);
+	GtkWidget *frame = g_object_ref_sink(top_build_section());
+	TopPanel *tp = g_object_get_data(G_OBJECT(frame), "top-panel");
+	tp->procfs = root;
+
+	top_map(NULL, tp);
+	g_assert_true(tp->scanning);
+	g_assert_null(tp->t);                            /* the scan has it */
+	top_test_wait(tp);
+	g_assert_nonnull(tp->t);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(tp->store)), ==, 0);
+
+	top_test_tree(root, TRUE);
+	top_tick(tp);
+	top_tick(tp);                                    /* busy: skipped */
+	top_test_wait(tp);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(tp->store)), ==, 3);
+	TopItem *it = g_list_model_get_item(G_LIST_MODEL(tp->store), 0);
+	g_assert_cmpint(it->e.pid, ==, 400);
+	g_object_unref(it);
+
+	top_tick(tp);
+	top_unmap(NULL, tp);
+	g_assert_false(tp->scanning);
+	g_assert_null(tp->t);
+	top_map(NULL, tp);                               /* remap while the old scan runs */
+	top_tick(tp);
+	g_object_unref(frame);                           /* and go away */
+	for (int i = 0; i < 50; i++) {
+		g_main_context_iteration(NULL, FALSE);
+		g_usleep(2000);
+	}
+	g_free(root);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/top/scan",  test_top_scan);
+	g_test_add_func("/top/bench", test_top_bench);
+	g_test_add_func("/top/panel", test_top_panel);
+
+	return g_test_run();
+}
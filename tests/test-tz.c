@@ -0,0 +1,248 @@
+/*
+ * test-tz.c — timezone index tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The index is built from small zoneinfo tables written into the test's
+ * cache directory.  UTC offsets come from GLib, so the checks on them
+ * run only where the system has tzdata; so does the benchmark of the
+ * system's own tables. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* fixtures                                                             */
+/* ------------------------------------------------------------------ */
+static char *tz_test_tree(void) {
+	char *root = tree_new("zoneinfo");
+	tree_put(root, "tzdata.zi",
+		 "# version 2024a\n"
+		 "R E 1981 ma - Mar lastSu 1u 1 S\n"
+		 "Z Europe/Berlin 0:53:28 - LMT 1893 Ap\n"
+		 "1 c CE%sT 1945 May 24 2\n"
+		 "Z Asia/Kolkata 5:53:28 - LMT 1854 Jun 28\n"
+		 "5:30 - IST\n"
+		 "Z America/New_York -4:56:2 - LMT 1883 N 18 17u\n"
+		 "Z Antarctica/Troll 0 - -00 2005 F 12\n"
+		 "Z Etc/UTC 0 - UTC\n"
+		 "L Etc/UTC UTC\n"
+		 "L Asia/Kolkata Asia/Calcutta\n", -1);
+	tree_put(root, "zone.tab",
+		 "# country-code\tcoordinates\tTZ\tcomments\n"
+		 "DE\t+5230+01322\tEurope/Berlin\tmost of Germany\n"
+		 "IN\t+2232+08822\tAsia/Kolkata\n"
+		 "US\t+404251-0740023\tAmerica/New_York\tEastern (most areas)\n", -1);
+	tree_put(root, "zone1970.tab",
+		 "#codes\tcoordinates\tTZ\tcomments\n"
+		 "DE,DK\t+5230+01322\tEurope/Berlin\tmost of Germany\n"
+		 "AQ\t-720041+0023206\tAntarctica/Troll\tTroll\n", -1);
+	tree_put(root, "iso3166.tab",
+		 "#code\tname\n"
+		 "AQ\tAntarctica\nDE\tGermany\nDK\tDenmark\nIN\tIndia\nUS\tUnited States\n", -1);
+	return root;
+}
+
+static void tz_test_db_free(TzDb *db) {
+	for (guint i = 0; i < db->n; i++) {
+		g_free(db->zones[i].name); g_free(db->zones[i].country); g_free(db->zones[i].search);
+	}
+	g_free(db->zones);
+	g_hash_table_unref(db->tri);
+	g_free(db);
+}
+
+static const TzZone *tz_test_zone(const TzDb *db, const char *name) {
+	int i = tz_db_find(db, name);
+	g_assert_cmpint(i, >=, 0);
+	return &db->zones[i];
+}
+
+/* the names of the zones q finds, comma-separated in index order */
+static char *tz_test_query(const TzDb *db, const char *q) {
+	guint8 *hit = g_malloc(db->n);
+	guint n = tz_db_query(db, q, hit), seen = 0;
+	GString *s = g_string_new(NULL);
+	for (guint i = 0; i < db->n; i++)
+		if (hit[i]) {
+			g_string_append_printf(s, "%s%s", s->len ? "," : "", db->zones[i].name);
+			seen++;
+		}
+	g_assert_cmpuint(n, ==, seen);
+	g_free(hit);
+	return g_string_free(s, FALSE);
+}
+
+static void tz_test_expect(const TzDb *db, const char *q, const char *want) {
+	char *got = tz_test_query(db, q);
+	g_assert_cmpstr(got, ==, want);
+	g_free(got);
+}
+
+/* GLib has the zone, so offsets can be checked */
+static gboolean tz_test_have_tzdata(void) {
+	GTimeZone *tz = g_time_zone_new_identifier("Asia/Kolkata");
+	if (tz) g_time_zone_unref(tz);
+	return tz != NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* index                                                                */
+/* ------------------------------------------------------------------ */
+/* Names from tzdata.zi, countries and coordinates from zone.tab, then
+ * zone1970.tab for zones zone.tab lacks, and links inherit from their
+ * targets. */
+static void test_tz_build(void) {
+	char *root = tz_test_tree();
+	TzDb *db = tz_db_build(root);
+	g_assert_cmpuint(db->n, ==, 7);
+	for (guint i = 1; i < db->n; i++)
+		g_assert_cmpint(strcmp(db->zones[i - 1].name, db->zones[i].name), <, 0);
+
+	const TzZone *z = tz_test_zone(db, "Europe/Berlin");
+	g_assert_cmpstr(z->country, ==, "Germany");                        /* zone.tab wins */
+	g_assert_cmpfloat_with_epsilon(z->lat, 52.5, 1e-9);
+	g_assert_cmpfloat_with_epsilon(z->lon, 13 + 22 / 60.0, 1e-9);
+	z = tz_test_zone(db, "America/New_York");
+	g_assert_cmpfloat_with_epsilon(z->lat, 40 + 42 / 60.0 + 51 / 3600.0, 1e-9);
+	g_assert_cmpfloat_with_epsilon(z->lon, -(74 + 23 / 3600.0), 1e-9);
+	z = tz_test_zone(db, "Antarctica/Troll");
+	g_assert_cmpstr(z->country, ==, "Antarctica");                     /* zone1970.tab */
+	g_assert_cmpfloat_with_epsilon(z->lat, -(72 + 41 / 3600.0), 1e-9);
+	z = tz_test_zone(db, "Asia/Calcutta");                             /* a link */
+	g_assert_cmpstr(z->country, ==, "India");
+	g_assert_cmpfloat_with_epsilon(z->lat, 22 + 32 / 60.0, 1e-9);
+	z = tz_test_zone(db, "UTC");
+	g_assert_cmpstr(z->country, ==, "");
+	g_assert_true(isnan(z->lat));
+	g_assert_cmpstr(z->offset_str, ==, "UTC+00:00");
+	g_assert_cmpint(tz_db_find(db, "Mars/Olympus"), ==, -1);
+
+	if (tz_test_have_tzdata()) {
+		g_assert_cmpint(tz_test_zone(db, "Asia/Kolkata")->offset, ==, 19800);
+		g_assert_cmpstr(tz_test_zone(db, "Asia/Calcutta")->offset_str, ==, "UTC+05:30");
+		g_assert_cmpint(tz_test_zone(db, "America/New_York")->offset, <, 0);
+	}
+	tz_test_db_free(db);
+	g_free(root);
+}
+
+/* no tzdata.zi: the names the tab files list, plus UTC */
+static void test_tz_build_tabs_only(void) {
+	char *root = tz_test_tree(), *zi = g_build_filename(root, "tzdata.zi", NULL);
+	g_assert_cmpint(unlink(zi), ==, 0);
+	TzDb *db = tz_db_build(root);
+	g_assert_cmpuint(db->n, ==, 5);
+	tz_test_zone(db, "Antarctica/Troll");
+	tz_test_zone(db, "UTC");
+	g_assert_cmpint(tz_db_find(db, "Asia/Calcutta"), ==, -1);
+	tz_test_db_free(db);
+	g_free(zi); g_free(root);
+}
+
+static void test_tz_query(void) {
+	char *root = tz_test_tree();
+	TzDb *db = tz_db_build(root);
+	tz_test_expect(db, "berl", "Europe/Berlin");
+	tz_test_expect(db, "BERL", "Europe/Berlin");                      /* case folded */
+	tz_test_expect(db, "new york", "America/New_York");               /* '_' as space */
+	tz_test_expect(db, "india", "Asia/Calcutta,Asia/Kolkata");        /* by country */
+	tz_test_expect(db, "germ", "Europe/Berlin");
+	tz_test_expect(db, "denmark", "");                                /* zone.tab's country only */
+	tz_test_expect(db, "berlim", "Europe/Berlin");                    /* typo: 3 of 4 trigrams */
+	tz_test_expect(db, "xyzzy", "");
+	tz_test_expect(db, "eu", "Europe/Berlin");                         /* short: plain substring */
+	tz_test_expect(db, "", "America/New_York,Antarctica/Troll,Asia/Calcutta,Asia/Kolkata,"
+			       "Etc/UTC,Europe/Berlin,UTC");
+	if (tz_test_have_tzdata()) tz_test_expect(db, "+05:30", "Asia/Calcutta,Asia/Kolkata");
+	tz_test_db_free(db);
+	g_free(root);
+}
+
+/* ------------------------------------------------------------------ */
+/* benchmark                                                            */
+/* ------------------------------------------------------------------ */
+/* 400 zones and 200 links over 40 countries, about tzdata's size */
+static char *tz_test_big_tree(void) {
+	char *root = tree_new("zoneinfo-big");
+	GString *zi = g_string_new("# version 9999z\n"), *tab = g_string_new(NULL), *iso = g_string_new(NULL);
+	for (int i = 0; i < 400; i++) {
+		g_string_append_printf(zi, "Z Area%d/City_%03d 0 - UTC\n", i % 10, i);
+		g_string_append_printf(tab, "%c%c\t+%02d%02d+%03d%02d\tArea%d/City_%03d\n",
+				       'A' + i % 40 / 26, 'A' + i % 40 % 26, i % 90, i % 60, i % 180, i % 60, i % 10, i);
+	}
+	for (int i = 0; i < 200; i++)
+		g_string_append_printf(zi, "L Area%d/City_%03d Old/Name_%03d\n", i % 10, i, i);
+	for (int k = 0; k < 40; k++)
+		g_string_append_printf(iso, "%c%c\tCountry %02d\n", 'A' + k / 26, 'A' + k % 26, k);
+	tree_put(root, "tzdata.zi", zi->str, zi->len);
+	tree_put(root, "zone.tab", tab->str, tab->len);
+	tree_put(root, "iso3166.tab", iso->str, iso->len);
+	g_string_free(zi, TRUE); g_string_free(tab, TRUE); g_string_free(iso, TRUE);
+	return root;
+}
+
+static void tz_bench_build(gpointer dir) {
+	tz_test_db_free(tz_db_build(dir));
+}
+
+typedef struct { const TzDb *db; const char *const *q; guint8 *hit; } TzBench;
+
+static void tz_bench_query(gpointer data) {
+	TzBench *b = data;
+	for (int i = 0; b->q[i]; i++) tz_db_query(b->db, b->q[i], b->hit);
+}
+
+static void tz_bench_queries(const char *what, const TzDb *db, const char *const *q) {
+	TzBench b = { db, q, g_malloc(db->n) };
+	bench_run(what, tz_bench_query, &b, 500);
+	g_free(b.hit);
+}
+
+static void test_tz_bench(void) {
+	static const char *const synth_q[] = { "city 12", "country 07", "+00:00", "aera3", "ci", NULL };
+	char *root = tz_test_big_tree();
+	bench_run("build from 600 synthetic zones", tz_bench_build, root, 30000);
+	TzDb *db = tz_db_build(root);
+	g_assert_cmpuint(db->n, ==, 600);
+	tz_bench_queries("5 searches over 600 synthetic zones", db, synth_q);
+	tz_test_db_free(db);
+	g_free(root);
+
+	/* the real tables, with every zone's offset loaded; this runs on the
+	 * tz-index thread, so its budget is for the picker appearing, not a frame */
+	static const char *const sys_q[] = { "berl", "+05:30", "new york", "berlim", "eu", NULL };
+	if (!g_file_test(TZ_DIR "/tzdata.zi", G_FILE_TEST_EXISTS) || !tz_test_have_tzdata()) {
+		g_test_message("no tzdata in " TZ_DIR "; skipped the system benchmark");
+		return;
+	}
+	bench_run("build from " TZ_DIR, tz_bench_build, (gpointer)TZ_DIR, 250000);
+	db = tz_db_build(TZ_DIR);
+	tz_bench_queries("5 searches over " TZ_DIR, db, sys_q);
+	tz_test_db_free(db);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/tz/build",           test_tz_build);
+	g_test_add_func("/tz/build-tabs-only", test_tz_build_tabs_only);
+	g_test_add_func("/tz/query",           test_tz_query);
+	g_test_add_func("/tz/bench",           test_tz_bench);
+
+	return g_test_run();
+}
@@ -0,0 +1,168 @@
+/*
+ * test-users.c — background account walk tests and benchmark
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The walk reads synthetic passwd and group files instead of NSS.  The
+ * lists need GTK for their status label, so these run under Xvfb in
+ * `make check` and are skipped without a display. */
+#include "test-common.h"
+
+typedef struct {
+	char    *passwd, *group;
+	UsrLoad *ul;
+	int      n_users, n_admins;
+} UsrTest;
+
+/* n users with uids from 10000 and personal groups; every seventh is in
+ * wheel, and a few system accounts that the page must leave out */
+static gboolean usr_test_setup(UsrTest *t, int n) {
+	if (!gtk_init_check()) {
+		g_test_skip("needs a display");
+		return FALSE;
+	}
+	char *root = tree_new("nss");
+	GString *pw = g_string_new("root:x:0:0::/root:/bin/sh\nnobody:x:65534:65534::/:/sbin/nologin\n");
+	GString *grp = g_string_new("root:x:0:\nwheel:x:10:");
+	t->n_admins = 0;
+	for (int i = 0; i < n; i += 7, t->n_admins++)
+		g_string_append_printf(grp, "%su%05d", i ? "," : "", i);
+	g_string_append_c(grp, '\n');
+	for (int i = 0; i < n; i++) {
+		g_string_append_printf(pw, "u%05d:x:%d:%d::/home/u%05d:/bin/bash\n", i, 10000 + i, 10000 + i, i);
+		g_string_append_printf(grp, "u%05d:x:%d:\n", i, 10000 + i);
+	}
+	tree_put(root, "passwd", pw->str, pw->len);
+	tree_put(root, "group", grp->str, grp->len);
+	t->passwd = g_build_filename(root, "passwd", NULL);
+	t->group  = g_build_filename(root, "group", NULL);
+	t->n_users = n;
+	t->ul = usr_load_new();
+	t->ul->status = g_object_ref_sink(gtk_label_new(NULL));
+	t->ul->passwd_file = t->passwd;
+	t->ul->group_file  = t->group;
+	g_string_free(pw, TRUE); g_string_free(grp, TRUE);
+	g_free(root);
+	return TRUE;
+}
+
+static void usr_test_wait_complete(UsrLoad *ul) {
+	while (!ul->complete) g_main_context_iteration(NULL, TRUE);
+}
+
+static void usr_test_teardown(UsrTest *t) {
+	UsrLoad *ul = t->ul;
+	GtkWidget *status = ul->status;
+	usr_page_unmapped(NULL, ul);
+	while (ul->walking) g_main_context_iteration(NULL, TRUE);
+	usr_page_destroyed(NULL, ul);
+	while (g_main_context_iteration(NULL, FALSE));
+	g_object_unref(status);
+	g_free(t->passwd); g_free(t->group);
+}
+
+static void usr_test_check_lists(UsrTest *t) {
+	UsrLoad *ul = t->ul;
+	g_assert_cmpuint(ul->n_users, ==, t->n_users);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(ul->users)), ==, t->n_users);
+	/* personal groups and wheel; root has no members and a low gid */
+	g_assert_cmpuint(ul->n_groups, ==, t->n_users + 1);
+	int admins = 0;
+	for (int i = 0; i < t->n_users; i++) {
+		UsrItem *it = g_list_model_get_item(G_LIST_MODEL(ul->users), i);
+		char name[16];
+		g_snprintf(name, sizeof(name), "u%05d", i);
+		g_assert_cmpstr(it->name, ==, name);            /* in order, no repeats */
+		admins += it->admin;
+		g_object_unref(it);
+	}
+	g_assert_cmpint(admins, ==, t->n_admins);
+}
+
+static void test_users_walk(void) {
+	UsrTest t;
+	if (!usr_test_setup(&t, 2000)) return;
+	usr_page_mapped(NULL, t.ul);
+	g_assert_true(t.ul->walking);
+	usr_test_wait_complete(t.ul);
+	g_assert_false(t.ul->walking);
+	usr_test_check_lists(&t);
+	usr_test_teardown(&t);
+}
+
+/* Leaving and coming back while the walk runs must not start a second
+ * walk beside it; the first one's final batch starts the new walk, whose
+ * listing is whole. */
+static void test_users_remap(void) {
+	UsrTest t;
+	if (!usr_test_setup(&t, 20000)) return;
+	usr_page_mapped(NULL, t.ul);
+	usr_page_unmapped(NULL, t.ul);
+	g_assert_true(t.ul->walking);
+	usr_page_mapped(NULL, t.ul);
+	g_assert_true(t.ul->walking);
+	g_assert_false(t.ul->complete);
+	usr_test_wait_complete(t.ul);
+	usr_test_check_lists(&t);
+
+	/* once complete, mapping again keeps the listing */
+	usr_page_unmapped(NULL, t.ul);
+	usr_page_mapped(NULL, t.ul);
+	g_assert_false(t.ul->walking);
+	g_assert_cmpuint(t.ul->n_users, ==, t.n_users);
+	usr_test_teardown(&t);
+}
+
+/* ------------------------------------------------------------------ */
+/* 50,000 accounts                                                      */
+/* ------------------------------------------------------------------ */
+static void usr_bench_walk(gpointer data) {
+	UsrTest *t = data;
+	t->ul->complete = FALSE;
+	usr_page_mapped(NULL, t->ul);
+	usr_test_wait_complete(t->ul);
+}
+
+/* The page must be usable at once: the first batch should reach the
+ * store within a frame or two, whatever the walk costs in total. */
+static void test_users_bench(void) {
+	UsrTest t;
+	if (!usr_test_setup(&t, 50000)) return;
+	g_test_timer_start();
+	usr_page_mapped(NULL, t.ul);
+	while (t.ul->n_users == 0) g_main_context_iteration(NULL, TRUE);
+	double first_us = g_test_timer_elapsed() * 1e6;
+	g_test_minimized_result(first_us, "first batch of 50,000 accounts: %.1f us (budget 50000 us)",
+				first_us);
+	if (g_test_perf()) g_assert_cmpfloat(first_us, <=, 50000);
+	usr_test_wait_complete(t.ul);
+	usr_test_check_lists(&t);
+	bench_run("walk 50,000 accounts", usr_bench_walk, &t, 2e6);
+	usr_test_teardown(&t);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/users/walk",             test_users_walk);
+	g_test_add_func("/users/remap",            test_users_remap);
+	g_test_add_func("/users/bench",            test_users_bench);
+
+	return g_test_run();
+}
@@ -0,0 +1,347 @@
+/*
+ * test-xkb.c — keyboard layout tests
+ * Copyright (C) 2026 Merih Bora Poçan (MrRobotOS)
+ * https://github.com/borapocan/mrsettings
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* The rules index and group lists need nothing: the index is built from
+ * synthetic rules files shaped like xkeyboard-config's.  The /xkb/x11
+ * tests load keymaps into the X server in $DISPLAY (`make check` starts
+ * Xvfb when there is none) and are skipped without one or without the
+ * XKB rules. */
+#include "test-common.h"
+
+/* ------------------------------------------------------------------ */
+/* group lists                                                          */
+/* ------------------------------------------------------------------ */
+static void test_xkb_group_get(void) {
+	static const struct { const char *list; int i; const char *want; } cases[] = {
+		{ "us",        0, "us" },
+		{ "us",        1, ""   },
+		{ "us,de",     1, "de" },
+		{ ",nodeadkeys", 0, "" },
+		{ ",nodeadkeys", 1, "nodeadkeys" },
+		{ "us,de,fr",  2, "fr" },
+		{ "",          0, ""   },
+		{ NULL,        0, ""   },
+	};
+	for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+		char out[64];
+		xkb_group_get(cases[i].list, cases[i].i, out, sizeof(out));
+		g_assert_cmpstr(out, ==, cases[i].want);
+	}
+	char small[3];
+	xkb_group_get("us,dvorak", 1, small, sizeof(small));
+	g_assert_cmpstr(small, ==, "dv");
+}
+
+static void test_xkb_group_set(void) {
+	static const struct { const char *list; int i; const char *val, *want; } cases[] = {
+		{ "us",          0, "de",         "de"            },
+		{ "us",          1, "de",         "us,de"         },
+		{ "us,de",       0, "fr",         "fr,de"         },
+		{ "",            1, "nodeadkeys", ",nodeadkeys"   },
+		{ ",nodeadkeys", 1, "",           ""              },    /* no trailing empties */
+		{ ",nodeadkeys", 0, "intl",       "intl,nodeadkeys" },
+		{ "us",          2, "fr",         "us,,fr"        },
+		{ NULL,          0, "us",         "us"            },
+	};
+	for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+		char *got = xkb_group_set(cases[i].list, cases[i].i, cases[i].val);
+		g_assert_cmpstr(got, ==, cases[i].want);
+		g_free(got);
+	}
+}
+
+static void test_xkb_format_current(void) {
+	XkbNames n = { .layout = "us,de", .variant = ",nodeadkeys", .group = 1, .n_groups = 2 };
+	char out[320];
+	kbd_format_current(&n, out, sizeof(out));
+	g_assert_cmpstr(out, ==, "Current: us, [de / nodeadkeys]");
+	XkbNames one = { .layout = "fr", .variant = "", .n_groups = 1 };
+	kbd_format_current(&one, out, sizeof(out));
+	g_assert_cmpstr(out, ==, "Current: fr");
+}
+
+/* ------------------------------------------------------------------ */
+/* rules index                                                          */
+/* ------------------------------------------------------------------ */
+/* evdev.xml with a model list to skip, then n layouts "l000".. of nv
+ * variants "v0".. each.  Layout i is described "Language <n-1-i>", so
+ * description order is the reverse of name order. */
+static char *xkb_test_xml(int n, int nv) {
+	GString *s = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<xkbConfigRegistry version=\"1.1\">\n"
+				  "  <modelList>\n");
+	for (int i = 0; i < 100; i++)
+		g_string_append_printf(s, "    <model><configItem><name>pc%d</name>"
+				       "<description>Generic %d-key PC</description></configItem></model>\n", i, i);
+	g_string_append(s, "  </modelList>\n  <layoutList>\n");
+	for (int i = 0; i < n; i++) {
+		g_string_append_printf(s, "    <layout>\n      <configItem>\n        <name>l%03d</name>\n"
+				       "        <shortDescription>l%d</shortDescription>\n"
+				       "        <description>Language %03d</description>\n"
+				       "        <languageList><iso639Id>eng</iso639Id><iso639Id>x%02d</iso639Id></languageList>\n"
+				       "      </configItem>\n      <variantList>\n", i, i, n - 1 - i, i % 100);
+		for (int j = 0; j < nv; j++)
+			g_string_append_printf(s, "        <variant><configItem><name>v%d</name>"
+					       "<description>Language %03d (variant %d)</description>"
+					       "<languageList><iso639Id>y%d</iso639Id></languageList>"
+					       "</configItem></variant>\n", j, n - 1 - i, j, j);
+		g_string_append(s, "      </variantList>\n    </layout>\n");
+	}
+	g_string_append(s, "  </layoutList>\n  <optionList/>\n</xkbConfigRegistry>\n");
+	return g_string_free(s, FALSE);
+}
+
+/* the same layouts as evdev.lst */
+static char *xkb_test_lst(int n, int nv) {
+	GString *s = g_string_new("! model\n  pc105           Generic 105-key PC\n\n! layout\n");
+	for (int i = 0; i < n; i++)
+		g_string_append_printf(s, "  l%03d            Language %03d\n", i, n - 1 - i);
+	g_string_append(s, "\n! variant\n");
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < nv; j++)
+			g_string_append_printf(s, "  v%-14d l%03d: Language %03d (variant %d)\n", j, i, n - 1 - i, j);
+	g_string_append(s, "\n! option\n  grp                  Switching to another layout\n");
+	return g_string_free(s, FALSE);
+}
+
+static void xkb_test_db_free(XkbDb *db) {
+	g_free(db->blob);
+	g_free(db);
+}
+
+static void xkb_test_check(const XkbDb *db, int n, int nv, gboolean langs) {
+	g_assert_nonnull(db);
+	g_assert_cmpuint(db->hdr->n_layouts, ==, n);
+	g_assert_cmpuint(db->hdr->n_variants, ==, n * nv);
+	/* description order, and every layout found by name */
+	for (int i = 0; i < n; i++) {
+		char want[32], name[16];
+		g_snprintf(want, sizeof(want), "Language %03d", i);
+		g_assert_cmpstr(xkb_db_s(db, db->layouts[i].desc), ==, want);
+		g_snprintf(name, sizeof(name), "l%03d", i);
+		int li = xkb_db_find(db, name);
+		g_assert_cmpint(li, ==, n - 1 - i);
+		g_assert_cmpuint(db->layouts[li].n_variants, ==, nv);
+		int vi = xkb_db_find_variant(db, li, "v1");
+		g_assert_cmpint(vi, ==, (int)db->layouts[li].first_variant + 1);
+		g_snprintf(want, sizeof(want), "Language %03d (variant 1)", n - 1 - i);
+		g_assert_cmpstr(xkb_db_s(db, db->variants[vi].desc), ==, want);
+		if (langs) {
+			g_snprintf(want, sizeof(want), "eng,x%02d", i % 100);
+			g_assert_cmpstr(xkb_db_s(db, db->layouts[li].langs), ==, want);
+			g_assert_cmpstr(xkb_db_s(db, db->variants[vi].langs), ==, "y1");
+		}
+	}
+	g_assert_cmpint(xkb_db_find(db, "pc105"), ==, -1);       /* models are not layouts */
+	g_assert_cmpint(xkb_db_find(db, "zz"), ==, -1);
+	g_assert_cmpint(xkb_db_find_variant(db, 0, "nope"), ==, -1);
+}
+
+static void test_xkb_db_xml(void) {
+	char *root = tree_new("xkb"), *xml = xkb_test_xml(40, 3);
+	tree_put(root, "rules/evdev.xml", xml, -1);
+	char *rules = g_build_filename(root, "rules", NULL), *cache = g_build_filename(root, "cache", NULL);
+	XkbDb *db = xkb_db_load(rules, cache);
+	xkb_test_check(db, 40, 3, TRUE);
+	xkb_test_db_free(db);
+	g_free(cache); g_free(rules); g_free(xml); g_free(root);
+}
+
+static void test_xkb_db_lst(void) {
+	char *root = tree_new("xkb"), *lst = xkb_test_lst(40, 3);
+	tree_put(root, "rules/evdev.lst", lst, -1);
+	char *rules = g_build_filename(root, "rules", NULL), *cache = g_build_filename(root, "cache", NULL);
+	XkbDb *db = xkb_db_load(rules, cache);
+	xkb_test_check(db, 40, 3, FALSE);
+	xkb_test_db_free(db);
+	g_assert_null(xkb_db_load(root, cache));                 /* no rules files at all */
+	g_free(cache); g_free(rules); g_free(lst); g_free(root);
+}
+
+/* The cache is used while the source is unchanged, rebuilt when its
+ * size or mtime changes, and ignored when it does not validate. */
+static void test_xkb_db_cache(void) {
+	char *root = tree_new("xkb"), *xml = xkb_test_xml(20, 2);
+	tree_put(root, "rules/evdev.xml", xml, -1);
+	char *rules = g_build_filename(root, "rules", NULL), *cache = g_build_filename(root, "cache", NULL);
+	XkbDb *db = xkb_db_load(rules, cache);
+	xkb_test_check(db, 20, 2, TRUE);
+
+	/* mark the cached copy; a load that returns the mark came from it */
+	char *blob = NULL; gsize len = 0;
+	g_assert_true(g_file_get_contents(cache, &blob, &len, NULL));
+	g_assert_cmpmem(blob, len, db->blob, db->len);
+	char *desc = blob + (db->str - db->blob) + db->layouts[0].desc;
+	desc[0] = 'X';
+	g_assert_true(g_file_set_contents(cache, blob, len, NULL));
+	xkb_test_db_free(db);
+	db = xkb_db_load(rules, cache);
+	g_assert_cmpstr(xkb_db_s(db, db->layouts[0].desc), ==, "Xanguage 000");
+	xkb_test_db_free(db);
+
+	/* a changed source replaces it */
+	g_free(xml);
+	xml = xkb_test_xml(25, 2);
+	tree_put(root, "rules/evdev.xml", xml, -1);
+	db = xkb_db_load(rules, cache);
+	xkb_test_check(db, 25, 2, TRUE);
+	xkb_test_db_free(db);
+
+	/* so does a truncated one */
+	g_assert_true(g_file_set_contents(cache, blob, 100, NULL));
+	db = xkb_db_load(rules, cache);
+	xkb_test_check(db, 25, 2, TRUE);
+	xkb_test_db_free(db);
+
+	g_free(blob); g_free(cache); g_free(rules); g_free(xml); g_free(root);
+}
+
+typedef struct { char *rules, *cache; XkbDb *db; } XkbBench;
+
+static void xkb_bench_cold(gpointer data) {
+	XkbBench *b = data;
+	unlink(b->cache);
+	xkb_test_db_free(xkb_db_load(b->rules, b->cache));
+}
+
+static void xkb_bench_warm(gpointer data) {
+	XkbBench *b = data;
+	xkb_test_db_free(xkb_db_load(b->rules, b->cache));
+}
+
+/* every layout by name, then its last variant */
+static void xkb_bench_lookup(gpointer data) {
+	const XkbDb *db = ((XkbBench *)data)->db;
+	for (guint32 i = 0; i < db->hdr->n_layouts; i++) {
+		int li = xkb_db_find(db, xkb_db_s(db, db->layouts[i].name));
+		g_assert_cmpint(xkb_db_find_variant(db, li, "v5"), >=, 0);
+	}
+}
+
+/* 200 layouts of 6 variants: about the size of xkeyboard-config's */
+static void test_xkb_db_bench(void) {
+	char *root = tree_new("xkb"), *xml = xkb_test_xml(200, 6);
+	tree_put(root, "rules/evdev.xml", xml, -1);
+	XkbBench b = { g_build_filename(root, "rules", NULL), g_build_filename(root, "cache", NULL) };
+	bench_run("cold parse, 200 layouts x 6 variants", xkb_bench_cold, &b, 20000);
+	bench_run("warm load from the cache", xkb_bench_warm, &b, 1000);
+	b.db = xkb_db_load(b.rules, b.cache);
+	bench_run("look up 200 layouts and a variant each", xkb_bench_lookup, &b, 200);
+	xkb_test_db_free(b.db);
+	g_free(b.rules); g_free(b.cache); g_free(xml); g_free(root);
+}
+
+/* ------------------------------------------------------------------ */
+/* applied to the server                                                */
+/* ------------------------------------------------------------------ */
+static void xkb_test_set_names(Display *xd, const XkbNames *n) {
+	XkbRF_VarDefsRec vd = {
+		.model = (char *)n->model, .layout = (char *)n->layout,
+		.variant = n->variant[0] ? (char *)n->variant : NULL,
+		.options = n->options[0] ? (char *)n->options : NULL,
+	};
+	XkbRF_SetNamesProp(xd, (char *)n->rules, &vd);
+}
+
+/* Saves the names in orig and starts from a single "us" group. */
+static Display *xkb_test_display(XkbNames *orig) {
+	Display *xd = XOpenDisplay(NULL);
+	if (!xd) { g_test_skip("needs an X display"); return NULL; }
+	if (!xkb_get_names(xd, orig) || !g_file_test(XKB_RULES_DIR "/evdev", G_FILE_TEST_EXISTS)) {
+		g_test_skip("needs the XKB rules");
+		XCloseDisplay(xd);
+		return NULL;
+	}
+	XkbNames us = *orig;
+	g_strlcpy(us.layout, "us", sizeof(us.layout));
+	us.variant[0] = 0;
+	xkb_test_set_names(xd, &us);
+	XkbLockGroup(xd, XkbUseCoreKbd, 0);
+	return xd;
+}
+
+static void xkb_test_expect(Display *xd, const char *layout, const char *variant, int group) {
+	XkbNames n;
+	XSync(xd, False);
+	g_assert_true(xkb_get_names(xd, &n));
+	g_assert_cmpstr(n.layout,  ==, layout);
+	g_assert_cmpstr(n.variant, ==, variant);
+	g_assert_cmpint(n.group,   ==, group);
+}
+
+/* put the names back, then recompile them all through group orig->group */
+static void xkb_test_restore(Display *xd, const XkbNames *orig) {
+	xkb_test_set_names(xd, orig);
+	char l[64], v[64], err[160];
+	xkb_group_get(orig->layout, orig->group, l, sizeof(l));
+	xkb_group_get(orig->variant, orig->group, v, sizeof(v));
+	g_assert_true(xkb_apply(xd, orig->group, l, v, err, sizeof(err)));
+	XCloseDisplay(xd);
+}
+
+/* editing one group leaves the others alone and keeps it locked */
+static void test_xkb_x11_apply_group(void) {
+	XkbNames orig;
+	Display *xd = xkb_test_display(&orig);
+	if (!xd) return;
+	char err[160];
+	g_assert_true(xkb_apply(xd, 0, "us", "", err, sizeof(err)));
+	xkb_test_expect(xd, "us", "", 0);
+	g_assert_true(xkb_apply(xd, 1, "de", "nodeadkeys", err, sizeof(err)));
+	xkb_test_expect(xd, "us,de", ",nodeadkeys", 1);
+	g_assert_true(xkb_apply(xd, 0, "fr", "", err, sizeof(err)));
+	xkb_test_expect(xd, "fr,de", ",nodeadkeys", 0);
+	g_assert_true(xkb_apply(xd, 1, "de", "", err, sizeof(err)));
+	xkb_test_expect(xd, "fr,de", "", 1);
+	xkb_test_restore(xd, &orig);
+}
+
+/* a group switched by another client is what the page reads next */
+static void test_xkb_x11_external_switch(void) {
+	XkbNames orig;
+	Display *xd = xkb_test_display(&orig);
+	if (!xd) return;
+	char err[160], out[320];
+	g_assert_true(xkb_apply(xd, 0, "us", "", err, sizeof(err)));
+	g_assert_true(xkb_apply(xd, 1, "de", "nodeadkeys", err, sizeof(err)));
+	XkbLockGroup(xd, XkbUseCoreKbd, 0);
+	xkb_test_expect(xd, "us,de", ",nodeadkeys", 0);
+	XkbNames n;
+	xkb_get_names(xd, &n);
+	kbd_format_current(&n, out, sizeof(out));
+	g_assert_cmpstr(out, ==, "Current: [us], de / nodeadkeys");
+	xkb_test_restore(xd, &orig);
+}
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+	g_test_add_func("/xkb/group-get",           test_xkb_group_get);
+	g_test_add_func("/xkb/group-set",           test_xkb_group_set);
+	g_test_add_func("/xkb/format-current",      test_xkb_format_current);
+	g_test_add_func("/xkb/db/xml",              test_xkb_db_xml);
+	g_test_add_func("/xkb/db/lst",              test_xkb_db_lst);
+	g_test_add_func("/xkb/db/cache",            test_xkb_db_cache);
+	g_test_add_func("/xkb/db/bench",            test_xkb_db_bench);
+	g_test_add_func("/xkb/x11/apply-group",     test_xkb_x11_apply_group);
+	g_test_add_func("/xkb/x11/external-switch", test_xkb_x11_external_switch);
+
+	return g_test_run();
+}